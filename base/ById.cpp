@@ -16,8 +16,10 @@
 
 #include <unordered_map>
 #include <typeinfo>
+#include <atomic>
 
 #include <QObject>
+#include <QReadWriteLock>
 
 //#define DEBUG_BY_ID 1
 
@@ -48,30 +50,37 @@ int IdAlloc::getNextId()
 
 class AnyById::Impl
 {
-public:    
+public:
+    Impl() : m_releaseGeneration(0) { }
+    
     ~Impl() {
-        QMutexLocker locker(&m_mutex);
         bool empty = true;
-        for (const auto &p: m_items) {
-            if (p.second && p.second.use_count() > 0) {
-                empty = false;
-                break;
+        for (const auto &shard: m_shards) {
+            QReadLocker locker(&shard.lock);
+            for (const auto &p: shard.items) {
+                if (p.second && p.second.use_count() > 0) {
+                    empty = false;
+                    break;
+                }
             }
         }
         if (!empty) {
             SVCERR << "WARNING: ById map is not empty at close; some items have not been released" << endl;
             SVCERR << "         Unreleased items are:" << endl;
-            for (const auto &p: m_items) {
-                auto ptr = p.second;
-                if (ptr && ptr.use_count() > 0) {
-                    QString message = QString("id #%1: type %2")
-                        .arg(p.first).arg(typeid(*ptr.get()).name());
-                    if (auto qobj = std::dynamic_pointer_cast<QObject>(ptr)) {
-                        message += QString(", object name \"%1\"")
-                            .arg(qobj->objectName());
+            for (const auto &shard: m_shards) {
+                QReadLocker locker(&shard.lock);
+                for (const auto &p: shard.items) {
+                    auto ptr = p.second;
+                    if (ptr && ptr.use_count() > 0) {
+                        QString message = QString("id #%1: type %2")
+                            .arg(p.first).arg(typeid(*ptr.get()).name());
+                        if (auto qobj = std::dynamic_pointer_cast<QObject>(ptr)) {
+                            message += QString(", object name \"%1\"")
+                                .arg(qobj->objectName());
+                        }
+                        message += QString(", use count %1").arg(ptr.use_count());
+                        SVCERR << "         - " << message << endl; 
                     }
-                    message += QString(", use count %1").arg(ptr.use_count());
-                    SVCERR << "         - " << message << endl; 
                 }
             }
         }
@@ -86,16 +95,17 @@ public:
         SVCERR << "ById::add(#" << id << ") of type "
                << typeid(*item.get()).name() << endl;
 #endif
-        QMutexLocker locker(&m_mutex);
-        if (m_items.find(id) != m_items.end()) {
+        Shard &shard = shardFor(id);
+        QWriteLocker locker(&shard.lock);
+        if (shard.items.find(id) != shard.items.end()) {
             SVCERR << "ById::add: item with id " << id
                    << " is already recorded (existing item type is "
-                   << typeid(*m_items.find(id)->second.get()).name()
+                   << typeid(*shard.items.find(id)->second.get()).name()
                    << ", proposed is "
                    << typeid(*item.get()).name() << ")" << endl;
             throw std::logic_error("item id is already recorded in add");
         }
-        m_items[id] = item;
+        shard.items[id] = item;
         return id;
     }
 
@@ -106,30 +116,63 @@ public:
 #ifdef DEBUG_BY_ID
         SVCERR << "ById::release(#" << id << ")" << endl;
 #endif
-        QMutexLocker locker(&m_mutex);
-        if (m_items.find(id) == m_items.end()) {
-            SVCERR << "ById::release: unknown item id " << id << endl;
-            throw std::logic_error("unknown item id in release");
+        std::shared_ptr<WithId> item;
+        {
+            Shard &shard = shardFor(id);
+            QWriteLocker locker(&shard.lock);
+            auto itr = shard.items.find(id);
+            if (itr == shard.items.end()) {
+                SVCERR << "ById::release: unknown item id " << id << endl;
+                throw std::logic_error("unknown item id in release");
+            }
+            // Hold on to the item until we're out of the lock, so
+            // that deleting it can't end up back in here
+            item = itr->second;
+            shard.items.erase(itr);
+            // Bump the generation before anyone can see the item gone
+            // from the store, so that a Handle can't go on returning
+            // it after getAs has started returning null
+            ++m_releaseGeneration;
         }
-        m_items.erase(id);
     }
     
     std::shared_ptr<WithId> get(int id) const {
         if (id == IdAlloc::NO_ID) {
             return {}; // this id cannot be added: avoid locking
         }
-        QMutexLocker locker(&m_mutex);
-        const auto &itr = m_items.find(id);
-        if (itr != m_items.end()) {
+        const Shard &shard = shardFor(id);
+        QReadLocker locker(&shard.lock);
+        const auto &itr = shard.items.find(id);
+        if (itr != shard.items.end()) {
             return itr->second;
         } else {
             return {};
         }
     }
 
+    uint64_t getReleaseGeneration() const {
+        return m_releaseGeneration;
+    }
+    
 private:
-    mutable QMutex m_mutex;
-    std::unordered_map<int, std::shared_ptr<WithId>> m_items;
+    // Ids are allocated sequentially, so the low bits spread
+    // neighbouring items evenly across the shards
+    enum { ShardCount = 64 };
+    
+    struct Shard {
+        mutable QReadWriteLock lock;
+        std::unordered_map<int, std::shared_ptr<WithId>> items;
+    };
+
+    Shard &shardFor(int id) {
+        return m_shards[unsigned(id) % ShardCount];
+    }
+    const Shard &shardFor(int id) const {
+        return m_shards[unsigned(id) % ShardCount];
+    }
+    
+    Shard m_shards[ShardCount];
+    std::atomic<uint64_t> m_releaseGeneration;
 };
 
 int
@@ -150,6 +193,12 @@ AnyById::get(int id)
     return impl().get(id);
 }
 
+uint64_t
+AnyById::getReleaseGeneration()
+{
+    return impl().getReleaseGeneration();
+}
+
 AnyById::Impl &
 AnyById::impl()
 {
@@ -20,6 +20,7 @@
 #include <memory>
 #include <iostream>
 #include <climits>
+#include <cstdint>
 #include <stdexcept>
 
 #include <QMutex>
@@ -98,6 +99,19 @@
  *
  * // application wants to be rid of the Thing
  * ThingById::release(thingId);
+ *
+ * Lookups do not serialise on a single lock: the store is sharded by
+ * id, and each shard is read-locked only for the duration of a hash
+ * lookup. Code that looks up the same id repeatedly in a hot loop can
+ * go further and use a Handle, which caches a typed reference and
+ * only returns to the store when something has been released:
+ *
+ * ThingById::Handle<Thing> handle(m_thingId); // one per thread
+ * for (...) {
+ *     auto thing = handle.get();
+ *     if (!thing) return;
+ *     // ...
+ * }
  */
 
 //!!! to do: review how often we are calling getAs<...> when we could
@@ -218,6 +232,53 @@ public:
         return std::dynamic_pointer_cast<Derived>(p);
     }
 
+    /**
+     * Return a number that changes whenever any item is released
+     * from the store. Used by Handle to validate its cache.
+     */
+    static uint64_t getReleaseGeneration();
+
+    /**
+     * A cached, typed reference to the item with a given id. The
+     * first get() looks the item up and casts it as getAs does; later
+     * calls return the same item without consulting the store or
+     * casting again, until something is released from the store. A
+     * Handle returns a null pointer in exactly the circumstances that
+     * getAs would.
+     *
+     * A Handle is not itself thread-safe: each thread that wants one
+     * should have its own.
+     */
+    template <typename Derived>
+    class Handle
+    {
+    public:
+        Handle() :
+            m_id(IdAlloc::NO_ID), m_generation(0), m_cached(false) { }
+        explicit Handle(int id) :
+            m_id(id), m_generation(0), m_cached(false) { }
+
+        std::shared_ptr<Derived> get() const {
+            uint64_t generation = getReleaseGeneration();
+            if (m_cached && generation == m_generation) {
+                if (auto p = m_item.lock()) {
+                    return p;
+                }
+            }
+            auto p = getAs<Derived>(m_id);
+            m_item = p;
+            m_cached = bool(p);
+            m_generation = generation;
+            return p;
+        }
+
+    private:
+        int m_id;
+        mutable uint64_t m_generation;
+        mutable std::weak_ptr<Derived> m_item;
+        mutable bool m_cached;
+    };
+
 private:
     class Impl;
     static Impl &impl();
@@ -253,6 +314,18 @@ public:
     static std::shared_ptr<Item> get(Id id) {
         return getAs<Item>(id);
     }
+
+    /**
+     * A cached, typed reference to an item, for repeated lookups of
+     * the same id. See AnyById::Handle.
+     */
+    template <typename Derived>
+    class Handle : public AnyById::Handle<Derived>
+    {
+    public:
+        Handle() { }
+        explicit Handle(Id id) : AnyById::Handle<Derived>(id.untyped) { }
+    };
     
     /**
      * If the Item type is an XmlExportable, return the export ID of
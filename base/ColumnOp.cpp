@@ -22,46 +22,126 @@
 #include "Debug.h"
 #include "Profiler.h"
 
+#include <bqvec/VectorOps.h>
+
 using namespace std;
 
 namespace sv {
 
+void
+ColumnOp::applyGain(Column &out, const Column &in, double gain)
+{
+    int n = int(in.size());
+    out.resize(n);
+
+    const float *src = in.data();
+    float *dst = out.data();
+
+    if (gain == 1.0) {
+        if (dst != src) breakfastquay::v_copy(dst, src, n);
+        return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        dst[i] = float(src[i] * gain);
+    }
+}
+
+void
+ColumnOp::applyShift(Column &out, const Column &in, float offset)
+{
+    int n = int(in.size());
+    out.resize(n);
+
+    const float *src = in.data();
+    float *dst = out.data();
+
+    if (offset == 0.f) {
+        if (dst != src) breakfastquay::v_copy(dst, src, n);
+        return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        dst[i] = src[i] + offset;
+    }
+}
+
 ColumnOp::Column
 ColumnOp::fftScale(const Column &in, int fftSize)
 {
     return applyGain(in, 2.0 / fftSize);
 }
 
+void
+ColumnOp::fftScale(Column &out, const Column &in, int fftSize)
+{
+    applyGain(out, in, 2.0 / fftSize);
+}
+
 ColumnOp::Column
 ColumnOp::peakPick(const Column &in)
 {
-    Column out(in.size(), 0.f);
+    Column out;
+    peakPick(out, in);
+    return out;
+}
+
+void
+ColumnOp::peakPick(Column &out, const Column &in)
+{
+    // Equivalent to testing isPeak for each bin, but keeping the
+    // previous input value to hand so that in and out may be the
+    // same column
+    
+    int n = int(in.size());
+    out.resize(n);
 
-    for (int i = 0; in_range_for(in, i); ++i) {
-        if (isPeak(in, i)) {
-            out[i] = in[i];
-        }
+    if (n == 0) {
+        return;
     }
+    if (n == 1) {
+        out[0] = in[0];
+        return;
+    }
+
+    float prev = in[0];
+    float cur = in[0];
     
-    return out;
+    out[0] = (in[0] >= in[1] ? cur : 0.f);
+
+    for (int i = 1; i + 1 < n; ++i) {
+        cur = in[i];
+        float next = in[i+1];
+        out[i] = ((cur < next || cur <= prev) ? 0.f : cur);
+        prev = cur;
+    }
+
+    cur = in[n-1];
+    out[n-1] = (cur > prev ? cur : 0.f);
 }
 
-ColumnOp::Column
-ColumnOp::normalize(const Column &in, ColumnNormalization n) {
+void
+ColumnOp::getNormalization(const float *in, int count, double gain,
+                           ColumnNormalization n,
+                           float &shift, float &scale)
+{
+    // Calculate the shift and scale that normalize would apply to the
+    // given values after multiplying them by the given gain
+    
+    shift = 0.f;
+    scale = 1.f;
 
-    if (n == ColumnNormalization::None || in.empty()) {
-        return in;
+    if (n == ColumnNormalization::None || count == 0) {
+        return;
     }
-    
-    float shift = 0.f;
-    float scale = 1.f;
 
     if (n == ColumnNormalization::Range01) {
 
         float min = 0.f;
         float max = 0.f;
         bool have = false;
-        for (auto v: in) {
+        for (int i = 0; i < count; ++i) {
+            float v = (gain == 1.0 ? in[i] : float(in[i] * gain));
             if (v < min || !have) {
                 min = v;
             }
@@ -82,7 +162,8 @@ ColumnOp::normalize(const Column &in, ColumnNormalization n) {
 
         float sum = 0.f;
 
-        for (auto v: in) {
+        for (int i = 0; i < count; ++i) {
+            float v = (gain == 1.0 ? in[i] : float(in[i] * gain));
             sum += fabsf(v);
         }
 
@@ -94,7 +175,8 @@ ColumnOp::normalize(const Column &in, ColumnNormalization n) {
 
         float max = 0.f;
 
-        for (auto v: in) {
+        for (int i = 0; i < count; ++i) {
+            float v = (gain == 1.0 ? in[i] : float(in[i] * gain));
             v = fabsf(v);
             if (v > max) {
                 max = v;
@@ -111,8 +193,29 @@ ColumnOp::normalize(const Column &in, ColumnNormalization n) {
             }
         }
     }
+}
+
+ColumnOp::Column
+ColumnOp::normalize(const Column &in, ColumnNormalization n) {
+
+    if (n == ColumnNormalization::None || in.empty()) {
+        return in;
+    }
 
-    return applyGain(applyShift(in, shift), scale);
+    Column out;
+    normalize(out, in, n);
+    return out;
+}
+
+void
+ColumnOp::normalize(Column &out, const Column &in, ColumnNormalization n) {
+
+    float shift = 0.f;
+    float scale = 1.f;
+    getNormalization(in.data(), int(in.size()), 1.0, n, shift, scale);
+    
+    applyShift(out, in, shift);
+    applyGain(out, out, scale);
 }
 
 ColumnOp::Column
@@ -127,17 +230,18 @@ ColumnOp::distribute(const Column &in,
     return out;
 }
 
-void
-ColumnOp::distribute(Column &out,
-                     const Column &in,
-                     int h,
-                     const std::vector<double> &binfory,
-                     int minbin,
-                     bool interpolate)
+template <typename Value>
+static void
+distributeValues(ColumnOp::Column &out,
+                 int bins,
+                 int h,
+                 const std::vector<double> &binfory,
+                 int minbin,
+                 bool interpolate,
+                 Value value)
 {
-    Profiler profiler("ColumnOp::distribute");
-    
-    int bins = int(in.size());
+    // Value is a function returning the (possibly transformed) input
+    // value for a given bin
 
     if (interpolate) {
         // If the bins are all closer together than the target y
@@ -207,8 +311,8 @@ ColumnOp::distribute(Column &out,
 
             double prop = 1.0 - fabs(sy - syf);
             
-            double v0 = in[mainbin];
-            double v1 = in[other];
+            double v0 = value(mainbin);
+            double v1 = value(other);
                 
             out[y] = float(prop * v0 + (1.0 - prop) * v1);
 
@@ -233,14 +337,67 @@ ColumnOp::distribute(Column &out,
                 
             for (int bin = by0; bin == by0 || bin < by1; ++bin) {
 
-                float value = in[bin];
+                float v = value(bin);
 
-                if (bin == by0 || value > out[y]) {
-                    out[y] = value;
+                if (bin == by0 || v > out[y]) {
+                    out[y] = v;
                 }
             }
         }
     }
 }
+
+void
+ColumnOp::distribute(Column &out,
+                     const Column &in,
+                     int h,
+                     const std::vector<double> &binfory,
+                     int minbin,
+                     bool interpolate)
+{
+    Profiler profiler("ColumnOp::distribute");
+
+    const float *src = in.data();
+    
+    distributeValues(out, int(in.size()), h, binfory, minbin, interpolate,
+                     [src](int bin) { return src[bin]; });
+}
+
+void
+ColumnOp::applyGainNormalizeDistribute(Column &out,
+                                       const Column &in,
+                                       double gain,
+                                       ColumnNormalization n,
+                                       int h,
+                                       const std::vector<double> &binfory,
+                                       int minbin,
+                                       bool interpolate)
+{
+    Profiler profiler("ColumnOp::applyGainNormalizeDistribute");
+
+    float shift = 0.f;
+    float scale = 1.f;
+    getNormalization(in.data(), int(in.size()), gain, n, shift, scale);
+
+    const float *src = in.data();
+    
+    if (gain == 1.0 && shift == 0.f && scale == 1.f) {
+        distributeValues(out, int(in.size()), h, binfory, minbin, interpolate,
+                         [src](int bin) { return src[bin]; });
+        return;
+    }
+
+    // Apply the gain, shift and scale in the same order and at the
+    // same precision as applyGain and normalize would
+    
+    distributeValues(out, int(in.size()), h, binfory, minbin, interpolate,
+                     [src, gain, shift, scale](int bin) {
+                         float v = src[bin];
+                         if (gain != 1.0) v = float(v * gain);
+                         if (shift != 0.f) v = v + shift;
+                         if (scale != 1.f) v = float(v * double(scale));
+                         return v;
+                     });
+}
 } // end namespace sv
 
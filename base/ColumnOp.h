@@ -48,6 +48,12 @@ enum class ColumnNormalization {
 /**
  * Class containing static functions for simple operations on data
  * columns, for use by display layers.
+ *
+ * Most operations come in two forms: one that returns a new column,
+ * and one that writes into a caller-supplied output column, which is
+ * resized as necessary and may be the same object as the input. The
+ * latter avoids allocating a new column on every call, when the
+ * caller reuses its output column from one call to the next.
  */
 class ColumnOp
 {
@@ -63,27 +69,44 @@ public:
     static Column applyGain(const Column &in, double gain) {
         if (gain == 1.0) return in;
         Column out;
-        out.reserve(in.size());
-        for (auto v: in) out.push_back(float(v * gain));
+        applyGain(out, in, gain);
         return out;
     }
 
+    /**
+     * Scale the given column using the given gain multiplier, writing
+     * the result to out. The in and out columns may be the same.
+     */
+    static void applyGain(Column &out, const Column &in, double gain);
+
     /**
      * Shift the values in the given column by the given offset.
      */
     static Column applyShift(const Column &in, float offset) {
         if (offset == 0.f) return in;
         Column out;
-        out.reserve(in.size());
-        for (auto v: in) out.push_back(v + offset);
+        applyShift(out, in, offset);
         return out;
     }
 
+    /**
+     * Shift the values in the given column by the given offset,
+     * writing the result to out. The in and out columns may be the
+     * same.
+     */
+    static void applyShift(Column &out, const Column &in, float offset);
+
     /**
      * Scale an FFT output downward by half the FFT size.
      */
     static Column fftScale(const Column &in, int fftSize);
 
+    /**
+     * Scale an FFT output downward by half the FFT size, writing the
+     * result to out. The in and out columns may be the same.
+     */
+    static void fftScale(Column &out, const Column &in, int fftSize);
+
     /**
      * Determine whether an index points to a local peak.
      */
@@ -112,6 +135,13 @@ public:
      */
     static Column peakPick(const Column &in);
 
+    /**
+     * Write to out a column containing only the local peak values of
+     * the input column (all others zero). The in and out columns may
+     * be the same.
+     */
+    static void peakPick(Column &out, const Column &in);
+
     /**
      * Return a column normalized from the input column according to
      * the given normalization scheme.
@@ -121,6 +151,15 @@ public:
      * the column elements, should any of them be negative.
      */
     static Column normalize(const Column &in, ColumnNormalization n);
+
+    /**
+     * Write to out a column normalized from the input column
+     * according to the given normalization scheme, as for the
+     * returning form of normalize. The in and out columns may be the
+     * same.
+     */
+    static void normalize(Column &out, const Column &in,
+                          ColumnNormalization n);
     
     /**
      * Distribute the given column into a target vector of a different
@@ -154,6 +193,32 @@ public:
                            int minbin,
                            bool interpolate);
 
+    /**
+     * Apply gain and normalization to the given column and distribute
+     * the result into a target column of length (at least) h, with
+     * the same result as
+     *
+     *   distribute(out, normalize(applyGain(in, gain), n),
+     *              h, binfory, minbin, interpolate)
+     *
+     * but without making any intermediate columns. The normalization
+     * is calculated in one pass over the input, and the gain and
+     * normalization are then applied to each bin as it is read during
+     * distribution. The in and out columns must not be the same.
+     */
+    static void applyGainNormalizeDistribute(Column &out,
+                                             const Column &in,
+                                             double gain,
+                                             ColumnNormalization n,
+                                             int h,
+                                             const std::vector<double> &binfory,
+                                             int minbin,
+                                             bool interpolate);
+
+private:
+    static void getNormalization(const float *in, int count, double gain,
+                                 ColumnNormalization n,
+                                 float &shift, float &scale);
 };
 
 } // end namespace sv
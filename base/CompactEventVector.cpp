@@ -0,0 +1,384 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "CompactEventVector.h"
+
+#include <algorithm>
+
+namespace sv {
+
+template <typename T>
+static void
+insertInto(std::vector<T> &column, size_t n, size_t i, T value)
+{
+    // An unallocated column holds only default values, and need not
+    // be allocated to hold another
+    if (column.empty()) {
+        if (value == T()) return;
+        column.resize(n, T());
+    }
+    column.insert(column.begin() + i, value);
+}
+
+template <typename T>
+static void
+eraseFrom(std::vector<T> &column, size_t i)
+{
+    if (!column.empty()) {
+        column.erase(column.begin() + i);
+    }
+}
+
+template <typename T, typename F>
+static void
+mergeInto(std::vector<T> &column, bool optional, size_t n,
+          const std::vector<size_t> &positions,
+          const EventVector &sorted, F get)
+{
+    if (optional && column.empty()) {
+        bool needed = false;
+        for (const auto &e: sorted) {
+            if (get(e) != T()) {
+                needed = true;
+                break;
+            }
+        }
+        if (!needed) return;
+    }
+
+    std::vector<T> merged;
+    merged.reserve(n + sorted.size());
+
+    size_t i = 0;
+    for (size_t j = 0; j < sorted.size(); ++j) {
+        while (merged.size() < positions[j]) {
+            merged.push_back(column.empty() ? T() : column[i]);
+            ++i;
+        }
+        merged.push_back(get(sorted[j]));
+    }
+    for (; i < n; ++i) {
+        merged.push_back(column.empty() ? T() : column[i]);
+    }
+
+    column.swap(merged);
+}
+
+template <typename T>
+static size_t
+bytesFor(const std::vector<T> &column)
+{
+    return column.capacity() * sizeof(T);
+}
+
+CompactEventVector::CompactEventVector() :
+    m_unusedStrings(0)
+{
+    m_strings.push_back(QString());
+    m_stringRefs.push_back(0);
+}
+
+void
+CompactEventVector::swap(CompactEventVector &other)
+{
+    m_frames.swap(other.m_frames);
+    m_flags.swap(other.m_flags);
+    m_durations.swap(other.m_durations);
+    m_referenceFrames.swap(other.m_referenceFrames);
+    m_values.swap(other.m_values);
+    m_levels.swap(other.m_levels);
+    m_labels.swap(other.m_labels);
+    m_uris.swap(other.m_uris);
+    m_strings.swap(other.m_strings);
+    m_stringRefs.swap(other.m_stringRefs);
+    std::swap(m_unusedStrings, other.m_unusedStrings);
+    m_stringIndex.swap(other.m_stringIndex);
+}
+
+Event
+CompactEventVector::at(size_t i) const
+{
+    Event e(m_frames[i]);
+    uint8_t flags = m_flags[i];
+    e.m_haveValue = ((flags & HaveValue) != 0);
+    e.m_haveLevel = ((flags & HaveLevel) != 0);
+    e.m_haveDuration = ((flags & HaveDuration) != 0);
+    e.m_haveReferenceFrame = ((flags & HaveReferenceFrame) != 0);
+    if (!m_values.empty()) e.m_value = m_values[i];
+    if (!m_levels.empty()) e.m_level = m_levels[i];
+    if (!m_durations.empty()) e.m_duration = m_durations[i];
+    if (!m_referenceFrames.empty()) e.m_referenceFrame = m_referenceFrames[i];
+    if (!m_labels.empty()) e.m_label = m_strings[m_labels[i]];
+    if (!m_uris.empty()) e.m_uri = m_strings[m_uris[i]];
+    return e;
+}
+
+bool
+CompactEventVector::equals(size_t i, const Event &e) const
+{
+    if (m_frames[i] != e.m_frame) return false;
+    return at(i) == e;
+}
+
+bool
+CompactEventVector::sortsBefore(size_t i, const Event &e) const
+{
+    // The frame decides most comparisons without materialising
+    if (m_frames[i] != e.m_frame) return m_frames[i] < e.m_frame;
+    return at(i) < e;
+}
+
+bool
+CompactEventVector::sortsAfter(size_t i, const Event &e) const
+{
+    if (m_frames[i] != e.m_frame) return m_frames[i] > e.m_frame;
+    return e < at(i);
+}
+
+size_t
+CompactEventVector::lowerBound(const Event &e) const
+{
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sortsBefore(mid, e)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int32_t
+CompactEventVector::intern(const QString &s)
+{
+    if (s.isEmpty()) return 0;
+    auto itr = m_stringIndex.constFind(s);
+    if (itr != m_stringIndex.constEnd()) return *itr;
+    int32_t index = int32_t(m_strings.size());
+    m_strings.push_back(s);
+    m_stringRefs.push_back(0);
+    m_stringIndex.insert(s, index);
+    ++m_unusedStrings; // until ref() is called for it
+    return index;
+}
+
+void
+CompactEventVector::ref(int32_t index)
+{
+    if (index == 0) return;
+    if (m_stringRefs[index]++ == 0) --m_unusedStrings;
+}
+
+void
+CompactEventVector::unref(int32_t index)
+{
+    if (index == 0) return;
+    if (--m_stringRefs[index] == 0) ++m_unusedStrings;
+}
+
+void
+CompactEventVector::recountStrings()
+{
+    std::fill(m_stringRefs.begin(), m_stringRefs.end(), 0);
+    for (auto index: m_labels) ++m_stringRefs[index];
+    for (auto index: m_uris) ++m_stringRefs[index];
+    m_stringRefs[0] = 0;
+    m_unusedStrings = size_t
+        (std::count(m_stringRefs.begin() + 1, m_stringRefs.end(), 0));
+}
+
+void
+CompactEventVector::compactStrings()
+{
+    std::vector<int32_t> remap(m_strings.size(), 0);
+    std::vector<QString> strings { QString() };
+    std::vector<int32_t> refs { 0 };
+    QHash<QString, int32_t> stringIndex;
+
+    for (size_t i = 1; i < m_strings.size(); ++i) {
+        if (m_stringRefs[i] == 0) continue;
+        int32_t index = int32_t(strings.size());
+        remap[i] = index;
+        strings.push_back(m_strings[i]);
+        refs.push_back(m_stringRefs[i]);
+        stringIndex.insert(m_strings[i], index);
+    }
+
+    for (auto &index: m_labels) index = remap[index];
+    for (auto &index: m_uris) index = remap[index];
+
+    m_strings.swap(strings);
+    m_stringRefs.swap(refs);
+    m_stringIndex.swap(stringIndex);
+    m_unusedStrings = 0;
+}
+
+uint8_t
+CompactEventVector::flagsFor(const Event &e)
+{
+    return uint8_t((e.m_haveValue ? HaveValue : 0) |
+                   (e.m_haveLevel ? HaveLevel : 0) |
+                   (e.m_haveDuration ? HaveDuration : 0) |
+                   (e.m_haveReferenceFrame ? HaveReferenceFrame : 0));
+}
+
+void
+CompactEventVector::insert(size_t i, const Event &e)
+{
+    size_t n = size();
+    m_frames.insert(m_frames.begin() + i, e.m_frame);
+    m_flags.insert(m_flags.begin() + i, flagsFor(e));
+    insertInto(m_durations, n, i, e.m_duration);
+    insertInto(m_referenceFrames, n, i, e.m_referenceFrame);
+    insertInto(m_values, n, i, e.m_value);
+    insertInto(m_levels, n, i, e.m_level);
+
+    int32_t label = intern(e.m_label);
+    int32_t uri = intern(e.m_uri);
+    ref(label);
+    ref(uri);
+    insertInto(m_labels, n, i, label);
+    insertInto(m_uris, n, i, uri);
+}
+
+void
+CompactEventVector::erase(size_t i)
+{
+    if (!m_labels.empty()) unref(m_labels[i]);
+    if (!m_uris.empty()) unref(m_uris[i]);
+
+    m_frames.erase(m_frames.begin() + i);
+    m_flags.erase(m_flags.begin() + i);
+    eraseFrom(m_durations, i);
+    eraseFrom(m_referenceFrames, i);
+    eraseFrom(m_values, i);
+    eraseFrom(m_levels, i);
+    eraseFrom(m_labels, i);
+    eraseFrom(m_uris, i);
+
+    // Compacting is linear in the size of the vector, but happens
+    // only after as many erasures as there are strings left in use
+    if (m_unusedStrings > m_strings.size() - 1 - m_unusedStrings) {
+        compactStrings();
+    }
+}
+
+void
+CompactEventVector::assign(const EventVector &sorted)
+{
+    clear();
+    std::vector<size_t> positions(sorted.size());
+    for (size_t j = 0; j < sorted.size(); ++j) {
+        positions[j] = j;
+    }
+    mergeColumns(0, positions, sorted);
+}
+
+void
+CompactEventVector::merge(const EventVector &sorted)
+{
+    size_t n = size();
+    if (n == 0) {
+        assign(sorted);
+        return;
+    }
+
+    // Find where each added event lands in the merged vector, placing
+    // existing events before equal added ones as std::merge would
+    std::vector<size_t> positions(sorted.size());
+    size_t i = 0;
+    for (size_t j = 0; j < sorted.size(); ++j) {
+        while (i < n && !sortsAfter(i, sorted[j])) {
+            ++i;
+        }
+        positions[j] = i + j;
+    }
+
+    mergeColumns(n, positions, sorted);
+}
+
+void
+CompactEventVector::mergeColumns(size_t n,
+                                 const std::vector<size_t> &positions,
+                                 const EventVector &sorted)
+{
+    mergeInto(m_frames, false, n, positions, sorted,
+              [](const Event &e) { return e.m_frame; });
+    mergeInto(m_flags, false, n, positions, sorted,
+              [](const Event &e) { return flagsFor(e); });
+    mergeInto(m_durations, true, n, positions, sorted,
+              [](const Event &e) { return e.m_duration; });
+    mergeInto(m_referenceFrames, true, n, positions, sorted,
+              [](const Event &e) { return e.m_referenceFrame; });
+    mergeInto(m_values, true, n, positions, sorted,
+              [](const Event &e) { return e.m_value; });
+    mergeInto(m_levels, true, n, positions, sorted,
+              [](const Event &e) { return e.m_level; });
+    mergeInto(m_labels, true, n, positions, sorted,
+              [this](const Event &e) { return intern(e.m_label); });
+    mergeInto(m_uris, true, n, positions, sorted,
+              [this](const Event &e) { return intern(e.m_uri); });
+
+    // Strings may be interned more than once per event above, so
+    // count their references afresh
+    recountStrings();
+}
+
+void
+CompactEventVector::clear()
+{
+    // Release the columns and string table, rather than just
+    // emptying them
+    *this = CompactEventVector();
+}
+
+EventVector
+CompactEventVector::toVector() const
+{
+    EventVector v;
+    v.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        v.push_back(at(i));
+    }
+    return v;
+}
+
+bool
+CompactEventVector::operator==(const CompactEventVector &other) const
+{
+    if (m_frames != other.m_frames) return false;
+    for (size_t i = 0; i < size(); ++i) {
+        if (at(i) != other.at(i)) return false;
+    }
+    return true;
+}
+
+size_t
+CompactEventVector::getByteSize() const
+{
+    size_t bytes =
+        bytesFor(m_frames) + bytesFor(m_flags) +
+        bytesFor(m_durations) + bytesFor(m_referenceFrames) +
+        bytesFor(m_values) + bytesFor(m_levels) +
+        bytesFor(m_labels) + bytesFor(m_uris) +
+        bytesFor(m_strings) + bytesFor(m_stringRefs);
+    for (const auto &s: m_strings) {
+        bytes += size_t(s.capacity()) * sizeof(QChar);
+    }
+    return bytes;
+}
+
+} // end namespace sv
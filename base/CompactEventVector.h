@@ -0,0 +1,173 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_COMPACT_EVENT_VECTOR_H
+#define SV_COMPACT_EVENT_VECTOR_H
+
+#include "Event.h"
+
+#include <QString>
+#include <QHash>
+
+#include <vector>
+#include <cstdint>
+
+namespace sv {
+
+/**
+ * A sorted sequence of events held in columns rather than as Event
+ * objects, used by EventSeries to store its events compactly.
+ *
+ * Each property has its own column. The frame and a byte of flags
+ * are always stored; the other columns are only allocated once an
+ * event with a non-default value for that property is added, so that
+ * for example a series of unlabelled point events costs nine bytes
+ * per event. Labels and URIs are interned: each column entry is an
+ * index into a table of distinct strings, and events returned from
+ * the vector share the string data in that table. Table entries are
+ * reference-counted, and the table is compacted when the entries no
+ * longer referred to outnumber those that are.
+ *
+ * Events are materialised on request by at(). The caller is
+ * responsible for keeping the events in the standard event ordering,
+ * which lowerBound() and insert() assume.
+ *
+ * CompactEventVector is not thread-safe.
+ */
+class CompactEventVector
+{
+public:
+    CompactEventVector();
+
+    CompactEventVector(const CompactEventVector &) =default;
+    CompactEventVector &operator=(const CompactEventVector &) =default;
+
+    // Moving swaps, so that the moved-from vector remains usable
+    CompactEventVector(CompactEventVector &&other) : CompactEventVector() {
+        swap(other);
+    }
+    CompactEventVector &operator=(CompactEventVector &&other) {
+        swap(other);
+        return *this;
+    }
+
+    void swap(CompactEventVector &other);
+
+    size_t size() const { return m_frames.size(); }
+    bool empty() const { return m_frames.empty(); }
+
+    /**
+     * Return the event at index i.
+     */
+    Event at(size_t i) const;
+
+    sv_frame_t getFrame(size_t i) const {
+        return m_frames[i];
+    }
+    bool hasDuration(size_t i) const {
+        return (m_flags[i] & HaveDuration) != 0;
+    }
+    sv_frame_t getDuration(size_t i) const {
+        return m_durations.empty() ? 0 : m_durations[i];
+    }
+
+    /**
+     * Return true if the event at index i is equal to e.
+     */
+    bool equals(size_t i, const Event &e) const;
+
+    /**
+     * Return the index of the first event that does not sort before
+     * e, or size() if there is none.
+     */
+    size_t lowerBound(const Event &e) const;
+
+    /**
+     * Insert e before index i.
+     */
+    void insert(size_t i, const Event &e);
+
+    /**
+     * Remove the event at index i.
+     */
+    void erase(size_t i);
+
+    /**
+     * Replace the contents with the given events, which must already
+     * be sorted.
+     */
+    void assign(const EventVector &sorted);
+
+    /**
+     * Merge the given events, which must already be sorted, into the
+     * vector. Existing events sort before equal added ones. This
+     * takes time linear in the combined size.
+     */
+    void merge(const EventVector &sorted);
+
+    void clear();
+
+    EventVector toVector() const;
+
+    bool operator==(const CompactEventVector &other) const;
+
+    /**
+     * Return the approximate number of bytes allocated for the
+     * columns and string table.
+     */
+    size_t getByteSize() const;
+
+private:
+    enum : uint8_t {
+        HaveValue = 1,
+        HaveLevel = 2,
+        HaveDuration = 4,
+        HaveReferenceFrame = 8
+    };
+
+    std::vector<sv_frame_t> m_frames;
+    std::vector<uint8_t> m_flags;
+
+    // These are empty until a non-default value is stored, and then
+    // have the same size as m_frames
+    std::vector<sv_frame_t> m_durations;
+    std::vector<sv_frame_t> m_referenceFrames;
+    std::vector<float> m_values;
+    std::vector<float> m_levels;
+    std::vector<int32_t> m_labels;
+    std::vector<int32_t> m_uris;
+
+    // Index 0 is always the empty string, which is not counted
+    std::vector<QString> m_strings;
+    std::vector<int32_t> m_stringRefs;
+    size_t m_unusedStrings;
+    QHash<QString, int32_t> m_stringIndex;
+
+    int32_t intern(const QString &s);
+    void ref(int32_t index);
+    void unref(int32_t index);
+    void recountStrings();
+    void compactStrings();
+    static uint8_t flagsFor(const Event &e);
+
+    void mergeColumns(size_t n, const std::vector<size_t> &positions,
+                      const EventVector &sorted);
+
+    bool sortsBefore(size_t i, const Event &e) const;
+    bool sortsAfter(size_t i, const Event &e) const;
+};
+
+} // end namespace sv
+
+#endif
@@ -459,6 +459,8 @@ public:
     }
     
 private:
+    friend class CompactEventVector;
+
     // The order of fields here is chosen to minimise overall size of struct.
     // We potentially store very many of these objects.
     // If you change something, check what difference it makes to packing.
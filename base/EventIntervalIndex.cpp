@@ -0,0 +1,258 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventIntervalIndex.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <climits>
+#include <stdexcept>
+
+namespace sv {
+
+void
+EventIntervalIndex::add(size_t row, sv_frame_t frame, sv_frame_t duration)
+{
+    insert(m_root, new Node(row, frame, duration, nextPriority()));
+}
+
+void
+EventIntervalIndex::build(const std::vector<Entry> &entries)
+{
+    clear();
+
+    if (entries.empty()) {
+        return;
+    }
+    if (entries.size() > size_t(INT_MAX)) {
+        throw std::logic_error("too many events");
+    }
+
+    m_root = buildBalanced(entries, 0, int(entries.size()));
+
+    // A treap needs each node's priority to be no lower than those
+    // of its children. Draw the usual random priorities and hand them
+    // out from the highest, one level of the tree at a time, so that
+    // later additions find the tree as they would have made it.
+
+    std::vector<uint32_t> priorities(entries.size());
+    for (auto &p: priorities) {
+        p = nextPriority();
+    }
+    std::sort(priorities.begin(), priorities.end(), std::greater<uint32_t>());
+
+    std::vector<Node *> level { m_root }, next;
+    size_t ix = 0;
+    while (!level.empty()) {
+        next.clear();
+        for (Node *n: level) {
+            n->priority = priorities[ix++];
+            if (n->left) next.push_back(n->left);
+            if (n->right) next.push_back(n->right);
+        }
+        level.swap(next);
+    }
+}
+
+EventIntervalIndex::Node *
+EventIntervalIndex::buildBalanced(const std::vector<Entry> &entries,
+                                  int i0, int i1)
+{
+    if (i0 >= i1) {
+        return nullptr;
+    }
+    int mid = i0 + (i1 - i0) / 2;
+    const Entry &e = entries[mid];
+    Node *n = new Node(e.row, e.frame, e.duration, 0);
+    n->left = buildBalanced(entries, i0, mid);
+    n->right = buildBalanced(entries, mid + 1, i1);
+    update(n);
+    return n;
+}
+
+bool
+EventIntervalIndex::remove(size_t row)
+{
+    return erase(m_root, row);
+}
+
+void
+EventIntervalIndex::shiftRows(size_t from, ptrdiff_t delta)
+{
+    Node *less = nullptr, *rest = nullptr;
+    split(m_root, from, less, rest);
+    applyShift(rest, delta);
+    m_root = merge(less, rest);
+}
+
+void
+EventIntervalIndex::update(Node *n)
+{
+    if (!n) return;
+    n->maxEnd = n->frame + n->duration;
+    if (n->left) n->maxEnd = std::max(n->maxEnd, n->left->maxEnd);
+    if (n->right) n->maxEnd = std::max(n->maxEnd, n->right->maxEnd);
+}
+
+void
+EventIntervalIndex::applyShift(Node *n, ptrdiff_t delta)
+{
+    // A node's own row is always current; the shift is carried for
+    // its subtrees until push is called on it
+    if (!n) return;
+    n->row = size_t(ptrdiff_t(n->row) + delta);
+    n->shift += delta;
+}
+
+void
+EventIntervalIndex::push(Node *n)
+{
+    if (!n || n->shift == 0) return;
+    applyShift(n->left, n->shift);
+    applyShift(n->right, n->shift);
+    n->shift = 0;
+}
+
+void
+EventIntervalIndex::split(Node *t, size_t row, Node *&less, Node *&rest)
+{
+    // Divide t into the events with rows less than row and the rest
+    if (!t) {
+        less = rest = nullptr;
+        return;
+    }
+    push(t);
+    if (t->row < row) {
+        split(t->right, row, t->right, rest);
+        less = t;
+        update(less);
+    } else {
+        split(t->left, row, less, t->left);
+        rest = t;
+        update(rest);
+    }
+}
+
+EventIntervalIndex::Node *
+EventIntervalIndex::merge(Node *less, Node *rest)
+{
+    // Every row in less must be less than every row in rest
+    if (!less) return rest;
+    if (!rest) return less;
+    if (less->priority > rest->priority) {
+        push(less);
+        less->right = merge(less->right, rest);
+        update(less);
+        return less;
+    } else {
+        push(rest);
+        rest->left = merge(less, rest->left);
+        update(rest);
+        return rest;
+    }
+}
+
+void
+EventIntervalIndex::insert(Node *&t, Node *n)
+{
+    if (!t) {
+        t = n;
+        return;
+    }
+    push(t);
+    if (n->priority > t->priority) {
+        split(t, n->row, n->left, n->right);
+        t = n;
+    } else if (n->row < t->row) {
+        insert(t->left, n);
+    } else {
+        insert(t->right, n);
+    }
+    update(t);
+}
+
+bool
+EventIntervalIndex::erase(Node *&t, size_t row)
+{
+    if (!t) {
+        return false;
+    }
+    push(t);
+    bool erased = true;
+    if (row < t->row) {
+        erased = erase(t->left, row);
+    } else if (t->row < row) {
+        erased = erase(t->right, row);
+    } else {
+        Node *old = t;
+        t = merge(t->left, t->right);
+        delete old;
+    }
+    if (erased) {
+        update(t);
+    }
+    return erased;
+}
+
+void
+EventIntervalIndex::findOverlapping(const Node *t, ptrdiff_t shift,
+                                    sv_frame_t start, sv_frame_t end,
+                                    std::vector<size_t> &rows)
+{
+    // Nothing in a subtree can overlap if it all ends by start; and
+    // nothing to the right of an event starting at or after end can
+    // overlap either, as it starts no earlier. The shift is the sum
+    // of those not yet pushed down from the ancestors of t.
+    
+    if (!t || t->maxEnd <= start) {
+        return;
+    }
+
+    ptrdiff_t childShift = shift + t->shift;
+    
+    findOverlapping(t->left, childShift, start, end, rows);
+
+    if (t->frame >= end) {
+        return;
+    }
+    if (t->frame + t->duration > start) {
+        rows.push_back(size_t(ptrdiff_t(t->row) + shift));
+    }
+
+    findOverlapping(t->right, childShift, start, end, rows);
+}
+
+EventIntervalIndex::Node *
+EventIntervalIndex::clone(const Node *t)
+{
+    if (!t) return nullptr;
+    Node *n = new Node(t->row, t->frame, t->duration, t->priority);
+    n->maxEnd = t->maxEnd;
+    n->shift = t->shift;
+    n->left = clone(t->left);
+    n->right = clone(t->right);
+    return n;
+}
+
+void
+EventIntervalIndex::destroy(Node *t)
+{
+    if (!t) return;
+    destroy(t->left);
+    destroy(t->right);
+    delete t;
+}
+
+} // end namespace sv
@@ -0,0 +1,183 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_EVENT_INTERVAL_INDEX_H
+#define SV_EVENT_INTERVAL_INDEX_H
+
+#include "BaseTypes.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace sv {
+
+/**
+ * An interval tree of the events with duration in a sorted event
+ * vector, used by EventSeries to find the events active at a frame
+ * or within a span of frames.
+ *
+ * The tree holds only the start frame, duration and row (index in
+ * the vector) of each event; the caller looks the events themselves
+ * up in the vector by row. It is a treap ordered by row, and so by
+ * the standard event ordering, in which each node also records the
+ * latest end frame found in its subtree. As rows move when events
+ * are inserted into or removed from the vector, the caller must tell
+ * the index about every such change with shiftRows; this is done
+ * lazily, one subtree at a time. Adding or removing an event, or
+ * shifting rows, takes O(log n) expected time, and a query takes
+ * O(log n + k) for k results, returned in row order.
+ *
+ * Each distinct event is held only once, at the row of its first
+ * instance in the vector: the index does not count duplicates, which
+ * is left to the caller.
+ *
+ * EventIntervalIndex is not thread-safe.
+ */
+class EventIntervalIndex
+{
+public:
+    EventIntervalIndex() : m_root(nullptr), m_seed(0x9e3779b9u) { }
+    ~EventIntervalIndex() { destroy(m_root); }
+
+    EventIntervalIndex(const EventIntervalIndex &other) :
+        m_root(clone(other.m_root)), m_seed(other.m_seed) { }
+
+    EventIntervalIndex &operator=(const EventIntervalIndex &other) {
+        if (this != &other) {
+            destroy(m_root);
+            m_root = clone(other.m_root);
+            m_seed = other.m_seed;
+        }
+        return *this;
+    }
+
+    // Moving swaps, as with CompactEventVector, so that the rows in
+    // a moved-from index still match the moved-from vector
+    EventIntervalIndex &operator=(EventIntervalIndex &&other) {
+        std::swap(m_root, other.m_root);
+        std::swap(m_seed, other.m_seed);
+        return *this;
+    }
+
+    struct Entry {
+        size_t row;
+        sv_frame_t frame;
+        sv_frame_t duration;
+    };
+    
+    /**
+     * Add the event with duration at the given row, which must not
+     * already be in the index. Rows at or after it should already
+     * have been shifted to make room, if necessary.
+     */
+    void add(size_t row, sv_frame_t frame, sv_frame_t duration);
+
+    /**
+     * Replace the contents of the index with the given entries,
+     * which must be distinct and sorted by row. This takes
+     * O(n log n) time but is far faster than adding them
+     * individually, as it builds a balanced tree directly.
+     */
+    void build(const std::vector<Entry> &entries);
+
+    /**
+     * Remove the event at the given row. Return false if it was not
+     * found. Later rows are not shifted.
+     */
+    bool remove(size_t row);
+
+    /**
+     * Add delta to the row of every event whose row is at least
+     * from, following an insertion (delta 1) or removal (delta -1)
+     * in the vector.
+     */
+    void shiftRows(size_t from, ptrdiff_t delta);
+
+    void clear() {
+        destroy(m_root);
+        m_root = nullptr;
+    }
+    
+    bool isEmpty() const {
+        return !m_root;
+    }
+    
+    /**
+     * Return the latest end frame (start plus duration) of any event
+     * in the index, or 0 if it is empty.
+     */
+    sv_frame_t getEndFrame() const {
+        return m_root ? m_root->maxEnd : 0;
+    }
+
+    /**
+     * Append to the given vector the row of every event whose start
+     * frame is less than end and whose end frame is greater than
+     * start, in row order.
+     */
+    void findOverlapping(sv_frame_t start, sv_frame_t end,
+                         std::vector<size_t> &rows) const {
+        if (end > start) {
+            findOverlapping(m_root, 0, start, end, rows);
+        }
+    }
+
+private:
+    struct Node {
+        Node(size_t r, sv_frame_t f, sv_frame_t d, uint32_t p) :
+            row(r), frame(f), duration(d), maxEnd(f + d), shift(0),
+            priority(p), left(nullptr), right(nullptr) { }
+        size_t row;
+        sv_frame_t frame;
+        sv_frame_t duration;
+        sv_frame_t maxEnd;
+        ptrdiff_t shift; // yet to be added to the rows of both subtrees
+        uint32_t priority;
+        Node *left;
+        Node *right;
+    };
+
+    Node *m_root;
+    uint32_t m_seed;
+
+    uint32_t nextPriority() {
+        // xorshift32: a fixed sequence keeps the tree shape, and so
+        // the cost of each operation, reproducible between runs
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return m_seed;
+    }
+
+    static Node *buildBalanced(const std::vector<Entry> &entries,
+                               int i0, int i1);
+    static void update(Node *n);
+    static void applyShift(Node *n, ptrdiff_t delta);
+    static void push(Node *n);
+    static void split(Node *t, size_t row, Node *&less, Node *&rest);
+    static Node *merge(Node *less, Node *rest);
+    static void insert(Node *&t, Node *n);
+    static bool erase(Node *&t, size_t row);
+    static void findOverlapping(const Node *t, ptrdiff_t shift,
+                                sv_frame_t start, sv_frame_t end,
+                                std::vector<size_t> &rows);
+    static Node *clone(const Node *t);
+    static void destroy(Node *t);
+};
+
+} // end namespace sv
+
+#endif
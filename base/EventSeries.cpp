@@ -16,6 +16,8 @@
 
 #include <QMutexLocker>
 
+#include <algorithm>
+
 namespace sv {
 
 using std::vector;
@@ -28,7 +30,7 @@ EventSeries::EventSeries(const EventSeries &other) :
 
 EventSeries::EventSeries(const EventSeries &other, const QMutexLocker<QMutex> &) :
     m_events(other.m_events),
-    m_seams(other.m_seams),
+    m_intervals(other.m_intervals),
     m_finalDurationlessEventFrame(other.m_finalDurationlessEventFrame)
 {
 }
@@ -38,7 +40,7 @@ EventSeries::operator=(const EventSeries &other)
 {
     QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
     m_events = other.m_events;
-    m_seams = other.m_seams;
+    m_intervals = other.m_intervals;
     m_finalDurationlessEventFrame = other.m_finalDurationlessEventFrame;
     return *this;
 }
@@ -48,7 +50,7 @@ EventSeries::operator=(EventSeries &&other)
 {
     QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
     m_events = std::move(other.m_events);
-    m_seams = std::move(other.m_seams);
+    m_intervals = std::move(other.m_intervals);
     m_finalDurationlessEventFrame = std::move(other.m_finalDurationlessEventFrame);
     return *this;
 }
@@ -64,9 +66,7 @@ EventSeries
 EventSeries::fromEvents(const EventVector &v)
 {
     EventSeries s;
-    for (const auto &e: v) {
-        s.add(e);
-    }
+    s.addAll(v);
     return s;
 }
 
@@ -91,46 +91,93 @@ void
 EventSeries::add(const Event &p)
 {
     QMutexLocker locker(&m_mutex);
+    addLocked(p);
+}
+
+void
+EventSeries::addAll(const EventVector &ee)
+{
+    if (ee.empty()) {
+        return;
+    }
+    
+    EventVector sorted(ee);
+    std::sort(sorted.begin(), sorted.end());
+
+    QMutexLocker locker(&m_mutex);
+
+    // Merging and rebuilding is linear in the size of the whole
+    // series, so isn't worth it for a handful of events
+    if (sorted.size() < m_events.size() / 16) {
+        for (const auto &e: sorted) {
+            addLocked(e);
+        }
+        return;
+    }
+
+    m_events.merge(sorted);
+
+    rebuildFromEvents();
+    
+#ifdef DEBUG_EVENT_SERIES
+    std::cerr << "after addAll:" << std::endl;
+    dumpEvents();
+#endif
+}
 
+void
+EventSeries::rebuildFromEvents()
+{
+    // Index the first instance of each distinct event with duration.
+    // Equal events are adjacent, so an event need only be compared
+    // with the one before it
+    std::vector<EventIntervalIndex::Entry> distinct;
+    m_finalDurationlessEventFrame = 0;
+
+    for (size_t i = 0; i < m_events.size(); ++i) {
+        if (!m_events.hasDuration(i)) {
+            m_finalDurationlessEventFrame = m_events.getFrame(i);
+        } else if (i == 0 ||
+                   m_events.getFrame(i) != m_events.getFrame(i - 1) ||
+                   !m_events.equals(i, m_events.at(i - 1))) {
+            distinct.push_back({ i, m_events.getFrame(i),
+                                 m_events.getDuration(i) });
+        }
+    }
+
+    m_intervals.build(distinct);
+}
+
+void
+EventSeries::addLocked(const Event &p)
+{
     bool isUnique = true;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr != m_events.end() && *pitr == p) {
+    size_t index = m_events.lowerBound(p);
+    if (index < m_events.size() && m_events.equals(index, p)) {
         isUnique = false;
     }
-    m_events.insert(pitr, p);
+    m_events.insert(index, p);
 
     if (!p.hasDuration() && p.getFrame() > m_finalDurationlessEventFrame) {
         m_finalDurationlessEventFrame = p.getFrame();
     }
     
-    if (p.hasDuration() && isUnique) {
-
-        const sv_frame_t frame = p.getFrame();
-        const sv_frame_t endFrame = p.getFrame() + p.getDuration();
-
-        createSeam(frame);
-        createSeam(endFrame);
-
-        // These calls must both succeed after calling createSeam above
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
-
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                SVCERR << "ERROR: EventSeries::add: "
-                       << "reached end of seam map"
-                       << endl;
-                break;
-            }
-            i->second.push_back(p);
+    // The index refers to the first instance of each event, by row.
+    // A new instance of an existing event takes the place of the
+    // first, so only the rows after it move
+    if (isUnique) {
+        m_intervals.shiftRows(index, 1);
+        if (p.hasDuration()) {
+            m_intervals.add(index, p.getFrame(), p.getDuration());
         }
+    } else {
+        m_intervals.shiftRows(index + 1, 1);
     }
 
 #ifdef DEBUG_EVENT_SERIES
     std::cerr << "after add:" << std::endl;
     dumpEvents();
-    dumpSeams();
 #endif
 }
 
@@ -140,110 +187,45 @@ EventSeries::remove(const Event &p)
     QMutexLocker locker(&m_mutex);
 
     // If we are removing the last (unique) example of an event,
-    // then we also need to remove it from the seam map. If this
+    // then we also need to remove it from the interval index. If this
     // is only one of multiple identical events, then we don't.
     bool isUnique = true;
         
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr == m_events.end() || *pitr != p) {
+    size_t index = m_events.lowerBound(p);
+    if (index == m_events.size() || !m_events.equals(index, p)) {
         // we don't know this event
         return;
-    } else {
-        auto nitr = pitr;
-        ++nitr;
-        if (nitr != m_events.end() && *nitr == p) {
-            isUnique = false;
-        }
+    } else if (index + 1 < m_events.size() &&
+               m_events.equals(index + 1, p)) {
+        isUnique = false;
     }
 
-    m_events.erase(pitr);
+    m_events.erase(index);
 
     if (!p.hasDuration() && isUnique &&
         p.getFrame() == m_finalDurationlessEventFrame) {
         m_finalDurationlessEventFrame = 0;
-        for (auto ritr = m_events.rbegin(); ritr != m_events.rend(); ++ritr) {
-            if (!ritr->hasDuration()) {
-                m_finalDurationlessEventFrame = ritr->getFrame();
+        for (size_t i = m_events.size(); i > 0; --i) {
+            if (!m_events.hasDuration(i - 1)) {
+                m_finalDurationlessEventFrame = m_events.getFrame(i - 1);
                 break;
             }
         }
     }
     
+    // If another instance remains, it now has the row the removed
+    // one had, so only the rows after it move
     if (p.hasDuration() && isUnique) {
-            
-        const sv_frame_t frame = p.getFrame();
-        const sv_frame_t endFrame = p.getFrame() + p.getDuration();
-
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
-
-#ifdef DEBUG_EVENT_SERIES
-        // This should be impossible if we found p in m_events above
-        if (i0 == m_seams.end() || i1 == m_seams.end()) {
-            SVCERR << "ERROR: EventSeries::remove: either frame " << frame
-                   << " or endFrame " << endFrame
-                   << " for event not found in seam map: event is "
-                   << p.toXmlString() << endl;
-        }
-#endif
-
-        // Remove any and all instances of p from the seam map; we
-        // are only supposed to get here if we are removing the
-        // last instance of p from the series anyway
-            
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                // This can happen only if we have a negative
-                // duration, which Event forbids
-                throw std::logic_error("unexpectedly reached end of map");
-            }
-            for (size_t j = 0; j < i->second.size(); ) {
-                if (i->second[j] == p) {
-                    i->second.erase(i->second.begin() + j);
-                } else {
-                    ++j;
-                }
-            }
-        }
-
-        // Tidy up by removing any entries that are now identical
-        // to their predecessors
-            
-        std::vector<sv_frame_t> redundant;
-
-        auto pitr = m_seams.end();
-        if (i0 != m_seams.begin()) {
-            pitr = i0;
-            --pitr;
-        }
-
-        for (auto i = i0; i != m_seams.end(); ++i) {
-            if (pitr != m_seams.end() &&
-                seamsEqual(i->second, pitr->second)) {
-                redundant.push_back(i->first);
-            }
-            pitr = i;
-            if (i == i1) {
-                break;
-            }
-        }
-
-        for (sv_frame_t f: redundant) {
-            m_seams.erase(f);
-        }
-
-        // And remove any empty seams from the start of the map
-            
-        while (m_seams.begin() != m_seams.end() &&
-               m_seams.begin()->second.empty()) {
-            m_seams.erase(m_seams.begin());
+        if (!m_intervals.remove(index)) {
+            SVCERR << "ERROR: EventSeries::remove: event not found in "
+                   << "interval index: event is " << p.toXmlString() << endl;
         }
     }
+    m_intervals.shiftRows(index + 1, -1);
 
 #ifdef DEBUG_EVENT_SERIES
     std::cerr << "after remove:" << std::endl;
     dumpEvents();
-    dumpSeams();
 #endif
 }
 
@@ -251,7 +233,8 @@ bool
 EventSeries::contains(const Event &p) const
 {
     QMutexLocker locker(&m_mutex);
-    return binary_search(m_events.begin(), m_events.end(), p);
+    size_t index = m_events.lowerBound(p);
+    return index < m_events.size() && m_events.equals(index, p);
 }
 
 void
@@ -259,7 +242,7 @@ EventSeries::clear()
 {
     QMutexLocker locker(&m_mutex);
     m_events.clear();
-    m_seams.clear();
+    m_intervals.clear();
     m_finalDurationlessEventFrame = 0;
 }
 
@@ -268,7 +251,7 @@ EventSeries::getStartFrame() const
 {
     QMutexLocker locker(&m_mutex);
     if (m_events.empty()) return 0;
-    return m_events.begin()->getFrame();
+    return m_events.getFrame(0);
 }
 
 sv_frame_t
@@ -282,11 +265,11 @@ EventSeries::getEndFrame() const
     
     latest = m_finalDurationlessEventFrame;
 
-    if (m_seams.empty()) return latest;
+    if (m_intervals.isEmpty()) return latest;
     
-    sv_frame_t lastSeam = m_seams.rbegin()->first;
-    if (lastSeam > latest) {
-        latest = lastSeam;
+    sv_frame_t lastEnd = m_intervals.getEndFrame();
+    if (lastEnd > latest) {
+        latest = lastEnd;
     }
 
     return latest;
@@ -305,37 +288,30 @@ EventSeries::getEventsSpanning(sv_frame_t frame,
         
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        if (!pitr->hasDuration()) {
-            span.push_back(*pitr);
+    for (size_t i = m_events.lowerBound(Event(start));
+         i < m_events.size() && m_events.getFrame(i) < end; ++i) {
+        if (!m_events.hasDuration(i)) {
+            span.push_back(m_events.at(i));
         }
-        ++pitr;
     }
 
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the interval index. A
+    // range of zero duration overlaps nothing, but has always
+    // returned the events that cover its frame without starting at
+    // it, as described in the header
 
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(start);
-    if (sitr == m_seams.end() || sitr->first > start) {
-        if (sitr != m_seams.begin()) {
-            --sitr;
-        }                
-    }
-    while (sitr != m_seams.end() && sitr->first < end) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            span.push_back(p);
-            ++pitr;
-        }
+    vector<size_t> found;
+    if (duration == 0) {
+        m_intervals.findOverlapping(start, start + 1, found);
+        found.erase(std::remove_if(found.begin(), found.end(),
+                                   [&](size_t row) {
+                                       return m_events.getFrame(row) == start;
+                                   }),
+                    found.end());
+    } else {
+        m_intervals.findOverlapping(start, end, found);
     }
+    appendAllInstances(found, span);
             
     return span;
 }
@@ -357,36 +333,31 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     // The core operation is very simple, it's just overspill that
     // complicates it.
 
-    Events::const_iterator reference = 
-        lower_bound(m_events.begin(), m_events.end(), Event(start));
+    const size_t reference = m_events.lowerBound(Event(start));
 
-    Events::const_iterator first = reference;
+    size_t first = reference;
     for (int i = 0; i < overspill; ++i) {
-        if (first == m_events.begin()) break;
+        if (first == 0) break;
         --first;
     }
-    for (int i = 0; i < overspill; ++i) {
-        if (first == reference) break;
-        span.push_back(*first);
-        ++first;
+    for (; first < reference; ++first) {
+        span.push_back(m_events.at(first));
     }
 
-    Events::const_iterator pitr = reference;
-    Events::const_iterator last = reference;
+    size_t last = reference;
 
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        if (!pitr->hasDuration() ||
-            (pitr->getFrame() + pitr->getDuration() <= end)) {
-            span.push_back(*pitr);
-            last = pitr;
-            ++last;
+    for (size_t i = reference;
+         i < m_events.size() && m_events.getFrame(i) < end; ++i) {
+        if (!m_events.hasDuration(i) ||
+            (m_events.getFrame(i) + m_events.getDuration(i) <= end)) {
+            span.push_back(m_events.at(i));
+            last = i + 1;
         }
-        ++pitr;
     }
 
     for (int i = 0; i < overspill; ++i) {
-        if (last == m_events.end()) break;
-        span.push_back(*last);
+        if (last == m_events.size()) break;
+        span.push_back(m_events.at(last));
         ++last;
     }
     
@@ -408,11 +379,9 @@ EventSeries::getEventsStartingWithin(sv_frame_t frame,
     // earlier than the start of the given range, we can do this
     // entirely from m_events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        span.push_back(*pitr);
-        ++pitr;
+    for (size_t i = m_events.lowerBound(Event(start));
+         i < m_events.size() && m_events.getFrame(i) < end; ++i) {
+        span.push_back(m_events.at(i));
     }
             
     return span;
@@ -427,47 +396,42 @@ EventSeries::getEventsCovering(sv_frame_t frame) const
 
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(frame));
-    while (pitr != m_events.end() && pitr->getFrame() == frame) {
-        if (!pitr->hasDuration()) {
-            cover.push_back(*pitr);
+    for (size_t i = m_events.lowerBound(Event(frame));
+         i < m_events.size() && m_events.getFrame(i) == frame; ++i) {
+        if (!m_events.hasDuration(i)) {
+            cover.push_back(m_events.at(i));
         }
-        ++pitr;
     }
         
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the interval index
         
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(frame);
-    if (sitr == m_seams.end() || sitr->first > frame) {
-        if (sitr != m_seams.begin()) {
-            --sitr;
-        }                
-    }
-    if (sitr != m_seams.end() && sitr->first <= frame) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            cover.push_back(p);
-            ++pitr;
-        }
-    }
+    vector<size_t> found;
+    m_intervals.findOverlapping(frame, frame + 1, found);
+    appendAllInstances(found, cover);
         
     return cover;
 }
 
+void
+EventSeries::appendAllInstances(const vector<size_t> &rows,
+                                EventVector &out) const
+{
+    for (size_t row: rows) {
+        Event p = m_events.at(row);
+        out.push_back(p);
+        for (size_t i = row + 1;
+             i < m_events.size() && m_events.equals(i, p); ++i) {
+            out.push_back(p);
+        }
+    }
+}
+
 EventVector
 EventSeries::getAllEvents() const
 {
     QMutexLocker locker(&m_mutex);
 
-    return m_events;
+    return m_events.toVector();
 }
 
 bool
@@ -475,15 +439,14 @@ EventSeries::getEventPreceding(const Event &e, Event &preceding) const
 {
     QMutexLocker locker(&m_mutex);
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    size_t index = m_events.lowerBound(e);
+    if (index == m_events.size() || !m_events.equals(index, e)) {
         return false;
     }
-    if (pitr == m_events.begin()) {
+    if (index == 0) {
         return false;
     }
-    --pitr;
-    preceding = *pitr;
+    preceding = m_events.at(index - 1);
     return true;
 }
 
@@ -492,17 +455,17 @@ EventSeries::getEventFollowing(const Event &e, Event &following) const
 {
     QMutexLocker locker(&m_mutex);
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    size_t index = m_events.lowerBound(e);
+    if (index == m_events.size() || !m_events.equals(index, e)) {
         return false;
     }
-    while (*pitr == e) {
-        ++pitr;
-        if (pitr == m_events.end()) {
+    while (m_events.equals(index, e)) {
+        ++index;
+        if (index == m_events.size()) {
             return false;
         }
     }
-    following = *pitr;
+    following = m_events.at(index);
     return true;
 }
 
@@ -514,31 +477,30 @@ EventSeries::getNearestEventMatching(sv_frame_t startSearchAt,
 {
     QMutexLocker locker(&m_mutex);
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(startSearchAt));
+    size_t index = m_events.lowerBound(Event(startSearchAt));
 
     while (true) {
 
         if (direction == Backward) {
-            if (pitr == m_events.begin()) {
+            if (index == 0) {
                 break;
             } else {
-                --pitr;
+                --index;
             }
         } else {
-            if (pitr == m_events.end()) {
+            if (index == m_events.size()) {
                 break;
             }
         }
 
-        const Event &e = *pitr;
+        Event e = m_events.at(index);
         if (predicate(e)) {
             found = e;
             return true;
         }
 
         if (direction == Forward) {
-            ++pitr;
+            ++index;
         }
     }
 
@@ -549,20 +511,19 @@ Event
 EventSeries::getEventByIndex(int index) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_events, index)) {
+    if (index < 0 || size_t(index) >= m_events.size()) {
         throw std::logic_error("index out of range");
     }
-    return m_events[index];
+    return m_events.at(index);
 }
 
 int
 EventSeries::getIndexForEvent(const Event &e) const
 {
     QMutexLocker locker(&m_mutex);
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    auto d = distance(m_events.begin(), pitr);
-    if (d < 0 || d > INT_MAX) return 0;
-    return int(d);
+    size_t index = m_events.lowerBound(e);
+    if (index > INT_MAX) return 0;
+    return int(index);
 }
 
 void
@@ -576,8 +537,8 @@ EventSeries::toXml(QTextStream &out,
         .arg(getExportId())
         .arg(extraAttributes);
     
-    for (const auto &p: m_events) {
-        p.toXml(out, indent + "  ", "", {});
+    for (size_t i = 0; i < m_events.size(); ++i) {
+        m_events.at(i).toXml(out, indent + "  ", "", {});
     }
     
     out << indent << "</dataset>\n";
@@ -595,8 +556,8 @@ EventSeries::toXml(QTextStream &out,
         .arg(getExportId())
         .arg(extraAttributes);
     
-    for (const auto &p: m_events) {
-        p.toXml(out, indent + "  ", "", options);
+    for (size_t i = 0; i < m_events.size(); ++i) {
+        m_events.at(i).toXml(out, indent + "  ", "", options);
     }
     
     out << indent << "</dataset>\n";
@@ -609,7 +570,7 @@ EventSeries::getStringExportHeaders(DataExportOptions opts,
     if (m_events.empty()) {
         return {};
     } else {
-        return m_events.begin()->getStringExportHeaders(opts, nopts);
+        return m_events.at(0).getStringExportHeaders(opts, nopts);
     }
 }
 
@@ -627,22 +588,22 @@ EventSeries::toStringExportRows(DataExportOptions options,
 
     const sv_frame_t end = startFrame + duration;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(startFrame));
+    size_t index = m_events.lowerBound(Event(startFrame));
             
     if (!(options & DataExportFillGaps)) {
         
-        while (pitr != m_events.end() && pitr->getFrame() < end) {
-            rows.push_back(pitr->toStringExportRow(options, sampleRate));
-            ++pitr;
+        while (index < m_events.size() && m_events.getFrame(index) < end) {
+            rows.push_back(m_events.at(index).toStringExportRow
+                           (options, sampleRate));
+            ++index;
         }
 
     } else {
         
         // find frame time of first point in range (if any)
         sv_frame_t first = startFrame;
-        if (pitr != m_events.end()) {
-            first = pitr->getFrame();
+        if (index < m_events.size()) {
+            first = m_events.getFrame(index);
         }
 
         // project back to first frame time in range according to
@@ -656,11 +617,11 @@ EventSeries::toStringExportRows(DataExportOptions options,
         // now progress, either writing the next point (if within
         // distance) or a default fill point
         while (f < end) {
-            if (pitr != m_events.end() && pitr->getFrame() <= f) {
-                rows.push_back(pitr->toStringExportRow
+            if (index < m_events.size() && m_events.getFrame(index) <= f) {
+                rows.push_back(m_events.at(index).toStringExportRow
                                (options & ~DataExportFillGaps,
                                 sampleRate));
-                ++pitr;
+                ++index;
             } else {
                 rows.push_back(fillEvent.withFrame(f).toStringExportRow
                                (options & ~DataExportFillGaps,
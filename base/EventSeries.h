@@ -16,6 +16,8 @@
 #define SV_EVENT_SERIES_H
 
 #include "Event.h"
+#include "CompactEventVector.h"
+#include "EventIntervalIndex.h"
 #include "XmlExportable.h"
 
 #include <set>
@@ -34,17 +36,14 @@ namespace sv {
  * and supporting the ability to query which events are active at a
  * given frame or within a span of frames.
  *
- * To that end, in addition to the series of events, it stores a
- * series of "seams", which are frame positions at which the set of
- * simultaneous events changes (i.e. an event of non-zero duration
- * starts or ends) associated with a set of the events that are active
- * at or from that position. These are updated when an event is added
- * or removed.
- *
- * This class is highly optimised for inserting events in increasing
- * order of start frame. Inserting (or deleting) events in the middle
- * does work, and should be acceptable in interactive use, but it is
- * very slow in bulk.
+ * To that end, in addition to the series of events, it stores an
+ * interval tree of the events that have duration, which is updated
+ * when an event is added or removed. Updating the tree takes
+ * logarithmic time wherever in the series the event falls, so events
+ * may be added or removed in any order. The events themselves are
+ * held in a contiguous vector, though, so a single add or remove
+ * still takes linear time overall, dominated by moving the events
+ * that follow it; use addAll to add many events at once.
  *
  * EventSeries is thread-safe.
  */
@@ -61,10 +60,25 @@ public:
     
     bool operator==(const EventSeries &other) const;
 
+    /**
+     * Return a series containing the given events, which need not be
+     * in any particular order. See addAll.
+     */
     static EventSeries fromEvents(const EventVector &ee);
     
     void clear();
     void add(const Event &e);
+
+    /**
+     * Add all of the given events, which need not be in any
+     * particular order. The events are sorted once and merged into
+     * the series, and the interval index is rebuilt in a single pass,
+     * which is much faster than adding them one at a time when there
+     * are many of them. A small number of events relative to the size
+     * of the series are simply added individually.
+     */
+    void addAll(const EventVector &ee);
+    
     void remove(const Event &e);
     bool contains(const Event &e) const;
     bool isEmpty() const;
@@ -257,122 +271,68 @@ private:
      * The vector is used in preference to a multiset or map<Event,
      * int> in order to allow indexing by "row number" as well as by
      * properties such as frame.
+     *
+     * The events are held column-wise with interned labels, rather
+     * than as Event objects, as series of many millions of events
+     * (beats or onsets across a long recording) are common.
      * 
      * Because events are immutable, we do not have to worry about the
      * order changing once an event is inserted - we only add or
      * delete them.
      */
-    typedef std::vector<Event> Events;
-    Events m_events;
+    CompactEventVector m_events;
     
     /**
-     * The FrameEventMap maps from frame number to a set of events. In
-     * the seam map this is used to represent the events that are
-     * active at that frame, either because they begin at that frame
-     * or because they are continuing from an earlier frame. There is
-     * an entry here for each frame at which an event starts or ends,
-     * with the event appearing in all entries from its start time
-     * onward and disappearing again at its end frame.
-     *
-     * Only events with duration appear in this map; point events
-     * appear only in m_events. Note that unlike m_events, we only
-     * store one instance of each event here, even if we hold many -
-     * we refer back to m_events when we need to know how many
-     * identical copies of a given event we have.
+     * The rows in m_events of the events with duration, indexed by
+     * the span of frames they cover. Point events appear only in
+     * m_events. Note that we only index the first instance of each
+     * event here, even if we hold many - we refer back to m_events
+     * for the events themselves and to find how many identical
+     * copies of a given event we have.
      */
-    typedef std::map<sv_frame_t, std::vector<Event>> FrameEventMap;
-    FrameEventMap m_seams;
+    EventIntervalIndex m_intervals;
 
     /**
      * The frame of the last durationless event we have in the series.
      * This is to support a fast-ish getEndFrame(): we can easily keep
      * this up-to-date when events are added or removed, and we can
      * easily find the end frame of the last with-duration event from
-     * the seam map, but it's not so easy to continuously update an
-     * overall end frame or to find the last frame of all events
+     * the interval index, but it's not so easy to continuously update
+     * an overall end frame or to find the last frame of all events
      * without this.
      */
     sv_frame_t m_finalDurationlessEventFrame;
     
-    /** 
-     * Create a seam at the given frame, copying from the prior seam
-     * if there is one. If a seam already exists at the given frame,
-     * leave it untouched.
+    /**
+     * Add a single event.
      *
      * Call with m_mutex locked.
      */
-    void createSeam(sv_frame_t frame) {
-        auto itr = m_seams.lower_bound(frame);
-        if (itr == m_seams.end() || itr->first > frame) {
-            if (itr != m_seams.begin()) {
-                --itr;
-            }
-        }
-        if (itr == m_seams.end()) {
-            m_seams[frame] = {};
-        } else if (itr->first < frame) {
-            m_seams[frame] = itr->second;
-        } else if (itr->first > frame) { // itr must be begin()
-            m_seams[frame] = {};
-        }
-    }
+    void addLocked(const Event &e);
 
-    /** 
-     * Return true if the two seam map entries contain the same set of
-     * events.
+    /**
+     * Recalculate m_intervals and m_finalDurationlessEventFrame from
+     * m_events.
      *
-     * Precondition: no duplicates, i.e. no event appears more than
-     * once in s1 or more than once in s2.
+     * Call with m_mutex locked.
+     */
+    void rebuildFromEvents();
+    
+    /**
+     * Append to the given vector every instance in m_events of each
+     * of the events at the given rows, which are those of the first
+     * instances as recorded in m_intervals.
      *
      * Call with m_mutex locked.
      */
-    bool seamsEqual(const std::vector<Event> &s1,
-                    const std::vector<Event> &s2) const {
-        
-        if (s1.size() != s2.size()) {
-            return false;
-        }
-
-#ifdef DEBUG_EVENT_SERIES
-        for (int i = 0; in_range_for(s1, i); ++i) {
-            for (int j = i + 1; in_range_for(s1, j); ++j) {
-                if (s1[i] == s1[j] || s2[i] == s2[j]) {
-                    throw std::runtime_error
-                        ("debug error: duplicate event in s1 or s2");
-                }
-            }
-        }
-#endif
-
-        std::set<Event> ee;
-        for (const auto &e: s1) {
-            ee.insert(e);
-        }
-        for (const auto &e: s2) {
-            if (ee.find(e) == ee.end()) {
-                return false;
-            }
-        }
-        return true;
-    }
+    void appendAllInstances(const std::vector<size_t> &rows,
+                            EventVector &out) const;
 
 #ifdef DEBUG_EVENT_SERIES
     void dumpEvents() const {
         std::cerr << "EVENTS (" << m_events.size() << ") [" << std::endl;
-        for (const auto &i: m_events) {
-            std::cerr << "  " << i.toXmlString();
-        }
-        std::cerr << "]" << std::endl;
-    }
-    
-    void dumpSeams() const {
-        std::cerr << "SEAMS (" << m_seams.size() << ") [" << std::endl;
-        for (const auto &s: m_seams) {
-            std::cerr << "  " << s.first << " -> {" << std::endl;
-            for (const auto &p: s.second) {
-                std::cerr << p.toXmlString("    ");
-            }
-            std::cerr << "  }" << std::endl;
+        for (size_t i = 0; i < m_events.size(); ++i) {
+            std::cerr << "  " << m_events.at(i).toXmlString();
         }
         std::cerr << "]" << std::endl;
     }
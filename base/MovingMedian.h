@@ -23,6 +23,10 @@
 #include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <deque>
+#include <iterator>
+#include <set>
+#include <vector>
 
 namespace sv {
 
@@ -37,24 +41,52 @@ namespace sv {
  * value at the start of the second half when sorted, e.g. for size 4,
  * the element at index 2 (zero-based) in the sorted window.
  *
+ * Small windows are kept in a sorted array, which costs time
+ * proportional to the window size on each push but is very fast in
+ * practice for short windows. Windows larger than IndexedThreshold
+ * are instead split into two ordered multisets, holding the values
+ * below and at-or-above the requested percentile, so that each push
+ * costs time logarithmic in the window size. The switch between the
+ * two is made automatically on construction and resize, and gives
+ * identical results.
+ *
  * Not thread-safe.
  */
 template <typename T>
 class MovingMedian
 {
 public:
+    /**
+     * Window size above which the logarithmic-time representation is
+     * used. Below about this size, the sorted array is faster despite
+     * its linear cost, as the multisets spread their values through
+     * memory. A window is only returned to the sorted array once it
+     * shrinks below half this size, so that a window whose size
+     * wanders around the threshold is not repeatedly converted.
+     */
+    enum { IndexedThreshold = 2048 };
+    
     MovingMedian(int size, double percentile = 50.f) :
         m_size(size),
-        m_percentile(percentile) {
+        m_percentile(percentile),
+        m_frame(nullptr),
+        m_sorted(nullptr),
+        m_indexed(false) {
         if (size < 1) throw std::logic_error("size must be >= 1");
-        m_frame = breakfastquay::allocate_and_zero<T>(size);
-	m_sorted = breakfastquay::allocate_and_zero<T>(size);
         calculateIndex();
+        if (size > IndexedThreshold) {
+            m_indexed = true;
+            m_window.resize(size, T());
+            rebuildIndex(std::vector<T>(size, T()));
+        } else {
+            m_frame = breakfastquay::allocate_and_zero<T>(size);
+            m_sorted = breakfastquay::allocate_and_zero<T>(size);
+        }
     }
 
     ~MovingMedian() { 
-        breakfastquay::deallocate(m_frame);
-        breakfastquay::deallocate(m_sorted);
+        if (m_frame) breakfastquay::deallocate(m_frame);
+        if (m_sorted) breakfastquay::deallocate(m_sorted);
     }
 
     MovingMedian(const MovingMedian &) =delete;
@@ -63,6 +95,7 @@ public:
     void setPercentile(double p) {
         m_percentile = p;
         calculateIndex();
+        if (m_indexed) rebalance();
     }
 
     void push(T value) {
@@ -70,6 +103,13 @@ public:
             std::cerr << "WARNING: MovingMedian: NaN encountered" << std::endl;
             value = T();
         }
+        if (m_indexed) {
+            T oldest = m_window.front();
+            m_window.pop_front();
+            m_window.push_back(value);
+            replaceIndexed(oldest, value);
+            return;
+        }
 	drop(m_frame[0]);
         breakfastquay::v_move(m_frame, m_frame+1, m_size-1);
 	m_frame[m_size-1] = value;
@@ -77,6 +117,9 @@ public:
     }
 
     T get() const {
+        if (m_indexed) {
+            return *m_low.rbegin();
+        }
 	return m_sorted[m_index];
     }
 
@@ -85,12 +128,27 @@ public:
     }
 
     void reset() {
+        if (m_indexed) {
+            std::fill(m_window.begin(), m_window.end(), T());
+            rebuildIndex(std::vector<T>(m_size, T()));
+            return;
+        }
         breakfastquay::v_zero(m_frame, m_size);
         breakfastquay::v_zero(m_sorted, m_size);
     }
 
     void resize(int target) {
         if (target == m_size) return;
+        if (target < 1) throw std::logic_error("size must be >= 1");
+        if (!m_indexed && target > IndexedThreshold) {
+            toIndexed();
+        } else if (m_indexed && target < IndexedThreshold / 2) {
+            toSorted();
+        }
+        if (m_indexed) {
+            resizeIndexed(target);
+            return;
+        }
         int diff = std::abs(target - m_size);
         if (target > m_size) { // grow
             // we don't want to change the median, so fill spaces with it
@@ -116,16 +174,27 @@ public:
     }
 
     void checkIntegrity() const {
-        check();
+        if (m_indexed) checkIndexed();
+        else check();
     }
 
 private:
     int m_size;
     double m_percentile;
     int m_index;
+
+    // Sorted-array representation: the window in arrival order, and
+    // the same values sorted
     T *m_frame;
     T *m_sorted;
 
+    // Indexed representation: the window in arrival order, the
+    // lowest m_index+1 values, and the rest
+    bool m_indexed;
+    std::deque<T> m_window;
+    std::multiset<T> m_low;
+    std::multiset<T> m_high;
+
     void calculateIndex() {
         m_index = int((m_size * m_percentile) / 100.f);
         if (m_index >= m_size) m_index = m_size-1;
@@ -172,6 +241,135 @@ private:
         sorted[size-1] = T();
     }
 
+    void rebuildIndex(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        m_low.clear();
+        m_high.clear();
+        int n = int(values.size());
+        for (int i = 0; i < n; ++i) {
+            if (i <= m_index) m_low.insert(m_low.end(), values[i]);
+            else m_high.insert(m_high.end(), values[i]);
+        }
+    }
+
+    void insertIndexed(T value) {
+        // Keep every value in m_low no greater than any in m_high
+        if (m_high.empty() || value <= *m_high.begin()) {
+            m_low.insert(value);
+        } else {
+            m_high.insert(value);
+        }
+    }
+
+    void eraseIndexed(T value) {
+        std::multiset<T> &from =
+            (!m_low.empty() && value <= *m_low.rbegin()) ? m_low : m_high;
+        auto itr = from.find(value);
+        if (itr == from.end()) {
+            throw std::logic_error
+                ("MovingMedian::drop: value being dropped is not in window");
+        }
+        from.erase(itr);
+    }
+    
+    void replaceIndexed(T oldest, T value) {
+        eraseIndexed(oldest);
+        insertIndexed(value);
+        rebalance();
+    }
+
+    void rebalance() {
+        size_t wanted = size_t(m_index) + 1;
+        while (m_low.size() > wanted) {
+            auto itr = std::prev(m_low.end());
+            m_high.insert(m_high.begin(), *itr);
+            m_low.erase(itr);
+        }
+        while (m_low.size() < wanted && !m_high.empty()) {
+            auto itr = m_high.begin();
+            m_low.insert(m_low.end(), *itr);
+            m_high.erase(itr);
+        }
+    }
+
+    void resizeIndexed(int target) {
+        if (target > m_size) {
+            // as in the sorted case, fill spaces with the median
+            T fillValue = get();
+            for (int i = m_size; i < target; ++i) {
+                m_window.push_front(fillValue);
+                m_low.insert(fillValue);
+            }
+        } else {
+            for (int i = target; i < m_size; ++i) {
+                T oldest = m_window.front();
+                m_window.pop_front();
+                eraseIndexed(oldest);
+            }
+        }
+        m_size = target;
+        calculateIndex();
+        rebalance();
+    }
+    
+    void toIndexed() {
+        m_window.assign(m_frame, m_frame + m_size);
+        rebuildIndex(std::vector<T>(m_sorted, m_sorted + m_size));
+        breakfastquay::deallocate(m_frame);
+        breakfastquay::deallocate(m_sorted);
+        m_frame = nullptr;
+        m_sorted = nullptr;
+        m_indexed = true;
+    }
+
+    void toSorted() {
+        m_frame = breakfastquay::allocate<T>(m_size);
+        m_sorted = breakfastquay::allocate<T>(m_size);
+        std::copy(m_window.begin(), m_window.end(), m_frame);
+        T *ptr = std::copy(m_low.begin(), m_low.end(), m_sorted);
+        std::copy(m_high.begin(), m_high.end(), ptr);
+        m_window.clear();
+        m_low.clear();
+        m_high.clear();
+        m_indexed = false;
+    }
+
+    void checkIndexed() const {
+        bool good = true;
+        if (int(m_window.size()) != m_size ||
+            int(m_low.size() + m_high.size()) != m_size) {
+            std::cerr << "ERROR: MovingMedian::checkIntegrity: "
+                      << "window has " << m_window.size()
+                      << " elements and index has " << m_low.size()
+                      << " + " << m_high.size() << ", expected "
+                      << m_size << std::endl;
+            good = false;
+        } else if (int(m_low.size()) != m_index + 1) {
+            std::cerr << "ERROR: MovingMedian::checkIntegrity: "
+                      << "lower set has " << m_low.size()
+                      << " elements, expected " << m_index + 1 << std::endl;
+            good = false;
+        } else if (!m_high.empty() && *m_high.begin() < *m_low.rbegin()) {
+            std::cerr << "ERROR: MovingMedian::checkIntegrity: "
+                      << "lower and upper sets overlap" << std::endl;
+            good = false;
+        } else {
+            std::vector<T> windowSorted(m_window.begin(), m_window.end());
+            std::sort(windowSorted.begin(), windowSorted.end());
+            std::vector<T> indexSorted(m_low.begin(), m_low.end());
+            indexSorted.insert(indexSorted.end(), m_high.begin(), m_high.end());
+            if (windowSorted != indexSorted) {
+                std::cerr << "ERROR: MovingMedian::checkIntegrity: "
+                          << "window and index contain different elements"
+                          << std::endl;
+                good = false;
+            }
+        }
+        if (!good) {
+            throw std::logic_error("MovingMedian failed integrity check");
+        }
+    }
+    
     void check() const {
         bool good = true;
         for (int i = 1; i < m_size; ++i) {
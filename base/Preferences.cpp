@@ -53,6 +53,8 @@ Preferences::Preferences() :
     m_gapless(true),
     m_normaliseAudio(false),
     m_finerTimeStretch(true),
+    m_keepSummaryFiles(true),
+    m_cacheFFTColumns(false),
     m_viewFontSize(10),
     m_backgroundMode(BackgroundFromTheme),
     m_timeToTextMode(TimeToTextMs),
@@ -76,6 +78,8 @@ Preferences::Preferences() :
     m_gapless = settings.value("gapless", true).toBool();
     m_normaliseAudio = settings.value("normalise-audio", false).toBool();
     m_finerTimeStretch = settings.value("finer-timestretch", true).toBool();
+    m_keepSummaryFiles = settings.value("keep-summary-files", true).toBool();
+    m_cacheFFTColumns = settings.value("cache-fft-columns", false).toBool();
     m_backgroundMode = BackgroundMode
         (settings.value("background-mode", int(BackgroundFromTheme)).toInt());
     m_timeToTextMode = TimeToTextMode
@@ -110,6 +114,8 @@ Preferences::getProperties() const
     props.push_back("Use Gapless Mode");
     props.push_back("Normalise Audio");
     props.push_back("Use Finer Time Stretch");
+    props.push_back("Keep Summary Files");
+    props.push_back("Cache FFT Columns");
     props.push_back("Fixed Sample Rate");
     props.push_back("Temporary Directory Root");
     props.push_back("Background Mode");
@@ -145,6 +151,12 @@ Preferences::getPropertyLabel(const PropertyName &name) const
     if (name == "Use Finer Time Stretch") {
         return tr("Use fine-quality time stretcher");
     }
+    if (name == "Keep Summary Files") {
+        return tr("Keep waveform summaries for faster reloading");
+    }
+    if (name == "Cache FFT Columns") {
+        return tr("Cache spectral analysis results on disc");
+    }
     if (name == "Omit Temporaries from Recent Files") {
         return tr("Omit temporaries from Recent Files menu");
     }
@@ -208,6 +220,12 @@ Preferences::getPropertyType(const PropertyName &name) const
     if (name == "Use Finer Time Stretch") {
         return ToggleProperty;
     }
+    if (name == "Keep Summary Files") {
+        return ToggleProperty;
+    }
+    if (name == "Cache FFT Columns") {
+        return ToggleProperty;
+    }
     if (name == "Omit Temporaries from Recent Files") {
         return ToggleProperty;
     }
@@ -325,6 +343,16 @@ Preferences::getPropertyRangeAndValue(const PropertyName &name,
         return m_showSplash ? 1 : 0;
     }
 
+    if (name == "Keep Summary Files") {
+        if (deflt) *deflt = 1;
+        return m_keepSummaryFiles ? 1 : 0;
+    }
+
+    if (name == "Cache FFT Columns") {
+        if (deflt) *deflt = 0;
+        return m_cacheFFTColumns ? 1 : 0;
+    }
+
     return 0;
 }
 
@@ -432,6 +460,10 @@ Preferences::setProperty(const PropertyName &name, int value)
         setViewFontSize(value);
     } else if (name == "Show Splash Screen") {
         setShowSplash(value ? true : false);
+    } else if (name == "Keep Summary Files") {
+        setKeepSummaryFiles(value ? true : false);
+    } else if (name == "Cache FFT Columns") {
+        setCacheFFTColumns(value ? true : false);
     }
 }
 
@@ -611,6 +643,32 @@ Preferences::setFinerTimeStretch(bool finer)
     }
 }
 
+void
+Preferences::setKeepSummaryFiles(bool keep)
+{
+    if (m_keepSummaryFiles != keep) {
+        m_keepSummaryFiles = keep;
+        QSettings settings;
+        settings.beginGroup("Preferences");
+        settings.setValue("keep-summary-files", keep);
+        settings.endGroup();
+        emit propertyChanged("Keep Summary Files");
+    }
+}
+
+void
+Preferences::setCacheFFTColumns(bool cache)
+{
+    if (m_cacheFFTColumns != cache) {
+        m_cacheFFTColumns = cache;
+        QSettings settings;
+        settings.beginGroup("Preferences");
+        settings.setValue("cache-fft-columns", cache);
+        settings.endGroup();
+        emit propertyChanged("Cache FFT Columns");
+    }
+}
+
 void
 Preferences::setBackgroundMode(BackgroundMode mode)
 {
@@ -79,6 +79,12 @@ public:
 
     /// True if we should use higher-quality time stretcher where available
     bool getFinerTimeStretch() const { return m_finerTimeStretch; }
+
+    /// True if waveform summaries of audio files should be saved for reuse when the same file is loaded again
+    bool getKeepSummaryFiles() const { return m_keepSummaryFiles; }
+
+    /// True if FFT models should keep the columns they calculate in a disc cache, to avoid recalculating them when revisited
+    bool getCacheFFTColumns() const { return m_cacheFFTColumns; }
     
     enum BackgroundMode {
         BackgroundFromTheme,
@@ -126,6 +132,8 @@ public slots:
     void setUseGaplessMode(bool);
     void setNormaliseAudio(bool);
     void setFinerTimeStretch(bool);
+    void setKeepSummaryFiles(bool);
+    void setCacheFFTColumns(bool);
     void setBackgroundMode(BackgroundMode mode);
     void setTimeToTextMode(TimeToTextMode mode);
     void setTimeToTextModeUnsaved(TimeToTextMode mode);
@@ -166,6 +174,8 @@ private:
     bool m_gapless;
     bool m_normaliseAudio;
     bool m_finerTimeStretch;
+    bool m_keepSummaryFiles;
+    bool m_cacheFFTColumns;
     int m_viewFontSize;
     BackgroundMode m_backgroundMode;
     TimeToTextMode m_timeToTextMode;
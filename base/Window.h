@@ -79,6 +79,17 @@ public:
         breakfastquay::v_multiply(dst, src, m_cache, m_size);
     }
 
+    /**
+     * Apply count values of the window, starting at index offset
+     * within it, to count values from src, writing them to dst. For
+     * source data that is not contiguous, e.g. in a ring buffer.
+     */
+    template <typename T0, typename T1>
+    inline void cut(const T0 *const BQ_R__ src, T1 *dst,
+                    int offset, int count) const {
+        breakfastquay::v_multiply(dst, src, m_cache + offset, count);
+    }
+
     T getArea() const { return m_area; }
     T getValue(int i) const { return m_cache[i]; }
 
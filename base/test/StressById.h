@@ -0,0 +1,126 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef STRESS_BY_ID_H
+#define STRESS_BY_ID_H
+
+#include "../ById.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sv;
+
+struct StressItem : public WithTypedId<StressItem> {
+    using WithTypedId<StressItem>::getId;
+};
+struct StressDerived : public StressItem {
+    int value() const { return 1; }
+};
+
+typedef TypedById<StressItem, StressItem::Id> StressItemById;
+
+class StressById : public QObject
+{
+    Q_OBJECT
+
+private:
+    enum { Lookups = 1000000 };
+    
+    void report(int threads, QString sort, qint64 ns) {
+        QString message = QString("Time for %1 x %2 %3 lookups = ")
+            .arg(threads).arg(int(Lookups)).arg(sort);
+        cerr << "                 " << message;
+        for (int i = 0; i < 50 - message.size(); ++i) cerr << " ";
+        cerr << double(ns) / 1.0e6 << "ms ("
+             << double(ns) / double(int(Lookups)) << "ns per lookup per thread)"
+             << std::endl;
+    }
+
+    // Each thread looks up one of a small number of ids over and
+    // over again, as FFTModel calculators do with their source model
+    template <typename F>
+    void run(int threads, QString sort, F lookup) {
+
+        vector<shared_ptr<StressDerived>> items;
+        vector<StressItem::Id> ids;
+        for (int i = 0; i < 4; ++i) {
+            items.push_back(make_shared<StressDerived>());
+            ids.push_back(StressItemById::add(items[i]));
+        }
+
+        vector<int> totals(threads, 0);
+        
+        QElapsedTimer timer;
+        timer.start();
+
+        vector<std::thread> tt;
+        for (int t = 0; t < threads; ++t) {
+            tt.push_back(std::thread([&, t]() {
+                                         totals[t] = lookup(ids[t % 4]);
+                                     }));
+        }
+        for (auto &t: tt) {
+            t.join();
+        }
+
+        report(threads, sort, timer.nsecsElapsed());
+
+        for (int t = 0; t < threads; ++t) {
+            QCOMPARE(totals[t], int(Lookups));
+        }
+        for (auto id: ids) {
+            StressItemById::release(id);
+        }
+    }
+
+    void getAs_n(int threads) {
+        run(threads, "getAs", [](StressItem::Id id) {
+                int total = 0;
+                for (int i = 0; i < Lookups; ++i) {
+                    auto p = StressItemById::getAs<StressDerived>(id);
+                    if (p) total += p->value();
+                }
+                return total;
+            });
+    }
+    
+    void handle_n(int threads) {
+        run(threads, "handle", [](StressItem::Id id) {
+                int total = 0;
+                StressItemById::Handle<StressDerived> handle(id);
+                for (int i = 0; i < Lookups; ++i) {
+                    auto p = handle.get();
+                    if (p) total += p->value();
+                }
+                return total;
+            });
+    }
+
+private slots:
+    void getAs_1() { getAs_n(1); }
+    void getAs_4() { getAs_n(4); }
+    void getAs_8() { getAs_n(8); }
+    void handle_1() { handle_n(1); }
+    void handle_4() { handle_n(4); }
+    void handle_8() { handle_n(8); }
+};
+
+#endif
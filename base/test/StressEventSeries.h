@@ -21,6 +21,7 @@
 #include <QtTest>
 
 #include <iostream>
+#include <utility>
 
 using namespace std;
 using namespace sv;
@@ -72,6 +73,61 @@ private:
         report(n, "longish", start, end);
     }
 
+    void unordered_n(int n) {
+        // Events with duration added in random order and then
+        // removed in random order, as when pasting or undoing a
+        // large selection of overlapping notes
+        EventVector ee;
+        for (int i = 0; i < n; ++i) {
+            float value = float(rand()) / float(RAND_MAX);
+            ee.push_back(Event(rand(), value, 1 + rand() / 1000,
+                               QString("event %1").arg(i)));
+        }
+        clock_t start = clock();
+        EventSeries s;
+        for (const Event &e: ee) {
+            s.add(e);
+        }
+        QCOMPARE(s.count(), n);
+        clock_t end = clock();
+        report(n, "unordered add", start, end);
+
+        start = clock();
+        int found = 0;
+        for (int i = 0; i < 1000; ++i) {
+            found += int(s.getEventsCovering(rand()).size());
+            found += int(s.getEventsSpanning(rand(), 10000).size());
+        }
+        end = clock();
+        report(n, "x 2000 query", start, end);
+        QVERIFY(found >= 0);
+        
+        for (int i = n - 1; i > 0; --i) {
+            std::swap(ee[i], ee[rand() % (i + 1)]);
+        }
+        start = clock();
+        for (const Event &e: ee) {
+            s.remove(e);
+        }
+        QCOMPARE(s.count(), 0);
+        end = clock();
+        report(n, "unordered remove", start, end);
+    }
+
+    void bulk_n(int n) {
+        EventVector ee;
+        for (int i = 0; i < n; ++i) {
+            float value = float(rand()) / float(RAND_MAX);
+            ee.push_back(Event(rand(), value, 1 + rand() / 1000,
+                               QString("event %1").arg(i)));
+        }
+        clock_t start = clock();
+        EventSeries s = EventSeries::fromEvents(ee);
+        QCOMPARE(s.count(), n);
+        clock_t end = clock();
+        report(n, "bulk", start, end);
+    }
+
 private slots:
     void short_3() { short_n(1000); }
     void short_4() { short_n(10000); }
@@ -80,6 +136,12 @@ private slots:
     void longish_3() { longish_n(1000); }
     void longish_4() { longish_n(10000); }
     void longish_5() { longish_n(100000); }
+    void unordered_3() { unordered_n(1000); }
+    void unordered_4() { unordered_n(10000); }
+    void unordered_5() { unordered_n(100000); }
+    void bulk_4() { bulk_n(10000); }
+    void bulk_5() { bulk_n(100000); }
+    void bulk_6() { bulk_n(1000000); }
 };
 
 #endif
@@ -0,0 +1,67 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef STRESS_MOVING_MEDIAN_H
+#define STRESS_MOVING_MEDIAN_H
+
+#include "../MovingMedian.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace sv;
+
+class StressMovingMedian : public QObject
+{
+    Q_OBJECT
+
+private:
+    void run(int size) {
+        std::mt19937 rng(0);
+        vector<float> input(100000);
+        for (auto &v: input) v = float(rng() % 100000);
+        MovingMedian<float> mm(size);
+        float sum = 0.f;
+        QElapsedTimer timer;
+        timer.start();
+        for (auto v: input) {
+            mm.push(v);
+            sum += mm.get();
+        }
+        qint64 ns = timer.nsecsElapsed();
+        QVERIFY(sum > 0.f);
+        cerr << "                 Window size " << size << ": "
+             << double(ns) / double(input.size()) << "ns per push"
+             << endl;
+    }
+
+private slots:
+    // Time per push for a range of window sizes, such as
+    // FFTModel::getPeaks uses for pitch-adaptive peak picking
+    void push_16() { run(16); }
+    void push_256() { run(256); }
+    void push_1024() { run(1024); }
+    void push_2048() { run(2048); }
+    void push_4096() { run(4096); }
+    void push_8192() { run(8192); }
+    void push_20000() { run(20000); }
+};
+
+#endif
@@ -207,5 +207,69 @@ private slots:
         }
         AById::release(a);
     }
+
+    void handleSimple() {
+        auto a = std::make_shared<A>();
+        auto aid = AById::add(a);
+
+        AById::Handle<A> handle(aid);
+        auto aa = handle.get();
+        QVERIFY(!!aa);
+        QCOMPARE(aa.get(), a.get());
+        aa = handle.get();
+        QCOMPARE(aa.get(), a.get());
+        aa = {};
+
+        // We still hold a, but the handle must not return it once it
+        // has been released from the store
+        AById::release(aid);
+        QVERIFY(!handle.get());
+    }
+
+    void handleEmpty() {
+        AById::Handle<A> handle;
+        QVERIFY(!handle.get());
+    }
+
+    void handleLateAdd() {
+        auto a = std::make_shared<A>();
+        AById::Handle<A> handle(a->getId());
+        QVERIFY(!handle.get());
+        AById::add(a);
+        QCOMPARE(handle.get().get(), a.get());
+        AById::release(a);
+        QVERIFY(!handle.get());
+    }
+
+    void handleDowncast() {
+        auto b1 = std::make_shared<B1>();
+        AById::add(b1);
+
+        AById::Handle<B1> h1(b1->getId());
+        QCOMPARE(h1.get().get(), b1.get());
+        QCOMPARE(h1.get().get(), b1.get());
+
+        AById::Handle<B2> h2(b1->getId());
+        QVERIFY(!h2.get());
+        QVERIFY(!h2.get());
+
+        AById::release(b1);
+    }
+
+    void handleOtherRelease() {
+        // Releasing an unrelated item invalidates the handle's cache,
+        // but it must still find its own item again
+        auto a = std::make_shared<A>();
+        auto b1 = std::make_shared<B1>();
+        AById::add(a);
+        AById::add(b1);
+
+        AById::Handle<A> handle(a->getId());
+        QCOMPARE(handle.get().get(), a.get());
+        AById::release(b1);
+        QCOMPARE(handle.get().get(), a.get());
+        AById::release(a);
+        QVERIFY(!handle.get());
+    }
 };
 
@@ -286,6 +286,59 @@ private slots:
         report(actual);
         QCOMPARE(actual, expected);
     }
+
+    void inPlace() {
+        Column c { 1, 2, 3, -4, 5, 6 };
+        Column out;
+        C::applyGain(out, c, 1.5);
+        QCOMPARE(out, C::applyGain(c, 1.5));
+        C::applyShift(out, out, 2.f);
+        QCOMPARE(out, C::applyShift(C::applyGain(c, 1.5), 2.f));
+        C::fftScale(out, c, 8);
+        QCOMPARE(out, C::fftScale(c, 8));
+        out = c;
+        C::normalize(out, out, ColumnNormalization::Range01);
+        QCOMPARE(out, C::normalize(c, ColumnNormalization::Range01));
+        out = Column({ 0.4f, -0.5f, -0.3f, -0.6f, 0.1f, -0.3f });
+        C::peakPick(out, out);
+        QCOMPARE(out, Column({ 0.4f, 0.0f, -0.3f, 0.0f, 0.1f, 0.0f }));
+        C::peakPick(out, Column());
+        QCOMPARE(out, Column());
+    }
+
+    void applyGainNormalizeDistribute() {
+        // The fused form must give exactly the same result as the
+        // separate operations, for every normalization and for both
+        // growing and shrinking mappings
+        Column in { 4, -1, 2, 3, 5, -6, 0.5f, 7 };
+        vector<BinMapping> mappings {
+            { 0.0, 0.5, 1.0, 1.5, 2.0, 2.5, 3.0, 4.5, 6.0, 7.0 },
+            { 0.0, 2.0, 4.0, 6.0 },
+            { 1.0, 3.0, 4.0, 4.5 }
+        };
+        vector<ColumnNormalization> norms {
+            ColumnNormalization::None, ColumnNormalization::Max1,
+            ColumnNormalization::Sum1, ColumnNormalization::Range01,
+            ColumnNormalization::Hybrid
+        };
+        for (const auto &binfory: mappings) {
+            int h = int(binfory.size());
+            for (auto n: norms) {
+                for (double gain: { 1.0, 0.3, -2.0 }) {
+                    for (bool interpolate: { false, true }) {
+                        Column expected = C::distribute
+                            (C::normalize(C::applyGain(in, gain), n),
+                             h, binfory, 0, interpolate);
+                        Column actual(h, 0.f);
+                        C::applyGainNormalizeDistribute
+                            (actual, in, gain, n, h, binfory, 0, interpolate);
+                        report(actual);
+                        QCOMPARE(actual, expected);
+                    }
+                }
+            }
+        }
+    }
 };
     
 #endif
@@ -21,6 +21,7 @@
 #include <QtTest>
 
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 using namespace sv;
@@ -323,6 +324,27 @@ private slots:
         QCOMPARE(s.getEventsCovering(130), EventVector());
     }
     
+    void eventsWithDurationSpanZeroDuration() {
+
+        // A zero-duration span returns the events that cover its
+        // frame without starting at it
+        EventSeries s;
+        Event a(10, 1.0f, 20, QString("a"));
+        Event b(15, 1.2f, 5, QString("b"));
+        Event c(15, QString("c"));
+        s.add(a);
+        s.add(b);
+        s.add(c);
+        QCOMPARE(s.getEventsSpanning(9, 0), EventVector());
+        QCOMPARE(s.getEventsSpanning(10, 0), EventVector());
+        QCOMPARE(s.getEventsSpanning(11, 0), EventVector({ a }));
+        QCOMPARE(s.getEventsSpanning(15, 0), EventVector({ a }));
+        QCOMPARE(s.getEventsSpanning(16, 0), EventVector({ a, b }));
+        QCOMPARE(s.getEventsSpanning(20, 0), EventVector({ a }));
+        QCOMPARE(s.getEventsSpanning(29, 0), EventVector({ a }));
+        QCOMPARE(s.getEventsSpanning(30, 0), EventVector());
+    }
+    
     void disjointEventsWithDurationSpan() {
 
         EventSeries s;
@@ -602,6 +624,253 @@ private slots:
         QCOMPARE(s.getEndFrame(), sv_frame_t(0));
     }
 
+    void addAll() {
+
+        // Bulk-loaded series, whether from empty or into an existing
+        // series, should be indistinguishable from those built by
+        // adding one event at a time
+        
+        srand(7);
+
+        EventVector ee;
+        for (int i = 0; i < 400; ++i) {
+            if (i % 3 == 0) {
+                ee.push_back(Event(rand() % 1000, float(rand() % 4),
+                                   QString()));
+            } else {
+                ee.push_back(Event(rand() % 1000, float(rand() % 4),
+                                   1 + rand() % 100, QString()));
+            }
+            if (i % 10 == 0) {
+                ee.push_back(ee.back());
+            }
+        }
+
+        EventSeries single;
+        for (const auto &e: ee) {
+            single.add(e);
+        }
+
+        EventSeries bulk = EventSeries::fromEvents(ee);
+
+        EventSeries merged;
+        EventVector first(ee.begin(), ee.begin() + 150);
+        EventVector second(ee.begin() + 150, ee.end());
+        merged.addAll(first);
+        merged.addAll(second);
+
+        for (const EventSeries *s: { &bulk, &merged }) {
+            QCOMPARE(s->getAllEvents(), single.getAllEvents());
+            QCOMPARE(s->getEndFrame(), single.getEndFrame());
+            for (sv_frame_t f = 0; f < 1100; f += 23) {
+                QCOMPARE(s->getEventsCovering(f), single.getEventsCovering(f));
+                QCOMPARE(s->getEventsSpanning(f, 40),
+                         single.getEventsSpanning(f, 40));
+            }
+        }
+
+        // and should go on to behave the same under edits
+        for (int i = 0; i < 100; ++i) {
+            Event e = ee[rand() % ee.size()];
+            single.remove(e);
+            bulk.remove(e);
+            Event added(rand() % 1000, 1.f, 1 + rand() % 100, QString());
+            single.add(added);
+            bulk.add(added);
+        }
+        QCOMPARE(bulk.getAllEvents(), single.getAllEvents());
+        QCOMPARE(bulk.getEndFrame(), single.getEndFrame());
+        for (sv_frame_t f = 0; f < 1100; f += 23) {
+            QCOMPARE(bulk.getEventsSpanning(f, 40),
+                     single.getEventsSpanning(f, 40));
+        }
+    }
+    
+    void mixedProperties() {
+
+        // Properties that only some events have (and that are stored
+        // only once one event has them) must survive adding, merging
+        // and removing around events that lack them
+
+        EventSeries s;
+        Event plain(10);
+        s.add(plain);
+        s.add(Event(20));
+
+        Event labelled = Event(15, QString("beat"));
+        Event labelled2 = Event(25, QString("beat"));
+        Event full = Event(12, 2.f, 8, 0.5f, QString("note"))
+            .withReferenceFrame(40)
+            .withURI("http://example.com/note");
+        s.add(labelled);
+        s.addAll({ full, labelled2, Event(5, QString("other")) });
+
+        EventVector expected {
+            Event(5, QString("other")), plain, full, labelled,
+            Event(20), labelled2
+        };
+        QCOMPARE(s.getAllEvents(), expected);
+        QCOMPARE(s.getEventsCovering(14), EventVector({ full }));
+        QCOMPARE(s.getEventsCovering(14)[0].getURI(),
+                 QString("http://example.com/note"));
+        QCOMPARE(s.getEventsCovering(14)[0].getReferenceFrame(),
+                 sv_frame_t(40));
+
+        s.remove(full);
+        s.remove(labelled);
+        QCOMPARE(s.getAllEvents(), EventVector({ Event(5, QString("other")),
+                        plain, Event(20), labelled2 }));
+        QCOMPARE(s.getEventByIndex(3).getLabel(), QString("beat"));
+
+        EventSeries copy(s);
+        QVERIFY(copy == s);
+        copy.clear();
+        copy.add(labelled);
+        QCOMPARE(copy.getAllEvents(), EventVector({ labelled }));
+    }
+
+    void internedStrings() {
+
+        // Labels and URIs of removed events must be released from
+        // the string table, so repeatedly adding and removing events
+        // with new labels should not keep growing it
+
+        CompactEventVector v;
+        Event kept = Event(0, QString("kept")).withURI("http://example.com/");
+        v.insert(0, kept);
+
+        size_t bytes = 0;
+        for (int cycle = 0; cycle < 10; ++cycle) {
+            for (int i = 0; i < 1000; ++i) {
+                v.insert(v.size(), Event(i + 1, QString("label %1 %2")
+                                         .arg(cycle).arg(i)));
+            }
+            QCOMPARE(v.at(500).getLabel(),
+                     QString("label %1 %2").arg(cycle).arg(499));
+            while (v.size() > 1) {
+                v.erase(v.size() - 1);
+            }
+            QCOMPARE(v.at(0), kept);
+            if (cycle == 0) {
+                bytes = v.getByteSize();
+            } else {
+                QCOMPARE(v.getByteSize(), bytes);
+            }
+        }
+
+        // A released string can be interned again
+        Event again(5, QString("label 0 0"));
+        v.insert(1, again);
+        v.merge({ Event(6, QString("kept")), Event(7, QString("new")) });
+        QCOMPARE(v.toVector(), EventVector({ kept, again,
+                        Event(6, QString("kept")), Event(7, QString("new")) }));
+        v.erase(0);
+        v.erase(0);
+        QCOMPARE(v.toVector(), EventVector({ Event(6, QString("kept")),
+                        Event(7, QString("new")) }));
+    }
+
+    void randomAddRemove() {
+
+        // Add and remove overlapping events, with some duplicates, in
+        // no particular order, and compare the results of queries
+        // against a simple scan of the events we expect to have
+
+        srand(42);
+        
+        EventSeries s;
+        EventVector expected;
+
+        auto check = [&]() {
+            std::sort(expected.begin(), expected.end());
+            QCOMPARE(s.getAllEvents(), expected);
+            sv_frame_t end = 0;
+            for (const auto &e: expected) {
+                end = std::max(end, e.getFrame() + e.getDuration());
+            }
+            QCOMPARE(s.getEndFrame(), end);
+            for (sv_frame_t f = 0; f < 1100; f += 37) {
+                EventVector covering, spanning;
+                for (const auto &e: expected) {
+                    if (!e.hasDuration()) {
+                        if (e.getFrame() == f) covering.push_back(e);
+                        if (e.getFrame() >= f && e.getFrame() < f + 50) {
+                            spanning.push_back(e);
+                        }
+                    }
+                }
+                for (const auto &e: expected) {
+                    if (e.hasDuration()) {
+                        sv_frame_t e0 = e.getFrame();
+                        sv_frame_t e1 = e0 + e.getDuration();
+                        if (e0 <= f && e1 > f) covering.push_back(e);
+                        if (e0 < f + 50 && e1 > f) spanning.push_back(e);
+                    }
+                }
+                QCOMPARE(s.getEventsCovering(f), covering);
+                QCOMPARE(s.getEventsSpanning(f, 50), spanning);
+            }
+        };
+
+        for (int i = 0; i < 300; ++i) {
+            Event e(rand() % 1000, float(rand() % 4), rand() % 100,
+                    QString());
+            int copies = (rand() % 10 == 0 ? 2 : 1);
+            for (int j = 0; j < copies; ++j) {
+                s.add(e);
+                expected.push_back(e);
+            }
+        }
+        check();
+
+        for (int i = 0; i < 200; ++i) {
+            int ix = rand() % int(expected.size());
+            s.remove(expected[ix]);
+            expected.erase(expected.begin() + ix);
+        }
+        check();
+    }
+
+    void pointEventsMoveIndexedRows() {
+
+        // Events with duration are found through their rows in the
+        // series, which move as other events are added and removed
+        // before them
+
+        EventSeries s;
+        Event a(100, 1.0f, 50, QString("a"));
+        Event b(120, 2.0f, 10, QString("b"));
+        s.add(a);
+        s.add(b);
+        QCOMPARE(s.getEventsCovering(125), EventVector({ a, b }));
+
+        Event p(10, QString("p"));
+        Event q(110, QString("q"));
+        s.add(p);
+        s.add(q);
+        s.add(p);
+        QCOMPARE(s.getEventsCovering(125), EventVector({ a, b }));
+
+        s.add(a);
+        QCOMPARE(s.getEventsCovering(125), EventVector({ a, a, b }));
+        QCOMPARE(s.getEventsSpanning(115, 10), EventVector({ a, a, b }));
+
+        s.remove(p);
+        s.remove(a);
+        QCOMPARE(s.getEventsCovering(125), EventVector({ a, b }));
+
+        s.remove(p);
+        s.remove(q);
+        s.remove(a);
+        QCOMPARE(s.getEventsCovering(125), EventVector({ b }));
+        QCOMPARE(s.getEventsCovering(105), EventVector());
+
+        s.add(Event(5, QString("r")));
+        QCOMPARE(s.getEventsCovering(125), EventVector({ b }));
+        QCOMPARE(s.getEventsSpanning(0, 200),
+                 EventVector({ Event(5, QString("r")), b }));
+    }
+
     void preceding() {
         
         EventSeries s;
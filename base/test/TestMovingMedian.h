@@ -22,6 +22,7 @@
 #include <QDir>
 
 #include <iostream>
+#include <random>
 
 using namespace std;
 using namespace sv;
@@ -70,6 +71,55 @@ class TestMovingMedian : public QObject
         checkExpected<T>(output, expected);
     }
 
+    template <typename T>
+    T reference(const vector<T> &window, double percentile) {
+        vector<T> sorted(window);
+        sort(sorted.begin(), sorted.end());
+        int n = int(sorted.size());
+        int index = int((n * percentile) / 100.f);
+        if (index >= n) index = n-1;
+        if (index < 0) index = 0;
+        return sorted[index];
+    }
+
+    // Push random values through a window whose size and percentile
+    // change from time to time, comparing against a brute-force
+    // median of the same window
+    void testRandom(int minSize, int maxSize) {
+        std::mt19937 rng(minSize);
+        int size = minSize;
+        double percentile = 50.0;
+        MovingMedian<float> mm(size, percentile);
+        vector<float> window(size, 0.f);
+        for (int i = 0; i < 4000; ++i) {
+            if (i % 97 == 0) {
+                int target = minSize + int(rng() % (maxSize - minSize + 1));
+                float fill = mm.get();
+                if (target > size) {
+                    window.insert(window.begin(), target - size, fill);
+                } else {
+                    window.erase(window.begin(),
+                                 window.begin() + (size - target));
+                }
+                mm.resize(target);
+                size = target;
+            }
+            if (i % 331 == 0) {
+                percentile = double(rng() % 101);
+                mm.setPercentile(percentile);
+            }
+            float value = float(rng() % 1000);
+            mm.push(value);
+            window.erase(window.begin());
+            window.push_back(value);
+            QCOMPARE(mm.get(), reference(window, percentile));
+            if (i % 500 == 0) {
+                mm.checkIntegrity();
+            }
+        }
+        mm.checkIntegrity();
+    }
+
 private slots:
 
     void empty() {
@@ -166,6 +216,20 @@ private slots:
         mm.checkIntegrity();
         checkExpected<double>(output, expected);
     }
+
+    void randomSmall() {
+        testRandom(1, 100);
+    }
+
+    void randomLarge() {
+        int threshold = MovingMedian<float>::IndexedThreshold;
+        testRandom(threshold + 1, threshold * 3);
+    }
+
+    void randomAcrossThreshold() {
+        int threshold = MovingMedian<float>::IndexedThreshold;
+        testRandom(threshold / 4, threshold * 2);
+    }
 };
 
 #endif
@@ -10,7 +10,9 @@ TEST_HEADERS = \
 	     TestScaleTickIntervals.h \
 	     TestStringBits.h \
 	     TestVampRealTime.h \
-	     StressEventSeries.h
+	     StressEventSeries.h \
+	     StressById.h \
+	     StressMovingMedian.h
 	     
 TEST_SOURCES += \
 	     svcore-base-test.cpp
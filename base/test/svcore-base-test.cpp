@@ -23,6 +23,8 @@
 #include "TestById.h"
 #include "TestEventSeries.h"
 #include "StressEventSeries.h"
+#include "StressById.h"
+#include "StressMovingMedian.h"
 
 #include "system/Init.h"
 
@@ -104,6 +106,16 @@ int main(int argc, char *argv[])
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        StressById t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+    {
+        StressMovingMedian t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
 #endif
 
     (void)good;
@@ -210,6 +210,9 @@ CSVFileReader::load() const
     WritableWaveFileModel *modelW = nullptr;
     Model *model = nullptr;
 
+    // Events for the sparse models, added all at once when we're done
+    EventVector events;
+
     QTextStream in(m_device);
 
     unsigned int warnings = 0, warnLimit = 10;
@@ -479,23 +482,23 @@ CSVFileReader::load() const
             if (modelType == CSVFormat::OneDimensionalModel) {
             
                 Event point(frameNo, label);
-                model1->add(point);
+                events.push_back(point);
 
             } else if (modelType == CSVFormat::TwoDimensionalModel) {
 
                 Event point(frameNo, value, label);
-                model2->add(point);
+                events.push_back(point);
 
             } else if (modelType == CSVFormat::TwoDimensionalModelWithDuration) {
 
                 Event region(frameNo, value, duration, label);
-                model2a->add(region);
+                events.push_back(region);
 
             } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndPitch) {
 
                 float level = ((value >= 0.f && value <= 1.f) ? value : 1.f);
                 Event note(frameNo, pitch, duration, level, label);
-                model2b->add(note);
+                events.push_back(note);
 
             } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndExtent) {
 
@@ -507,7 +510,7 @@ CSVFileReader::load() const
                     level = otherValue - value;
                 }
                 Event box(frameNo, value, duration, level, label);
-                model2c->add(box);
+                events.push_back(box);
 
             } else if (modelType == CSVFormat::ThreeDimensionalModel) {
 
@@ -610,6 +613,13 @@ CSVFileReader::load() const
         }
     }
 
+    if (model1) model1->addAll(events);
+    else if (model2) model2->addAll(events);
+    else if (model2a) model2a->addAll(events);
+    else if (model2b) model2b->addAll(events);
+    else if (model2c) model2c->addAll(events);
+    events.clear();
+
     if (!haveAnyValue) {
         if (model2a) {
             // assign values for regions based on label frequency; we
@@ -949,6 +949,9 @@ MIDIFileReader::loadTrack(unsigned int trackToLoad,
 
     bool sharpKey = true;
 
+    // Notes are added to the model all at once when we're done
+    EventVector notes;
+    
     for (MIDITrack::const_iterator i = track.begin(); i != track.end(); ++i) {
 
         RealTime rt;
@@ -1035,7 +1038,7 @@ MIDIFileReader::loadTrack(unsigned int trackToLoad,
 
 //                    SVDEBUG << "Adding note " << startFrame << "," << (endFrame-startFrame) << " : " << int((*i)->getPitch()) << endl;
 
-                    model->add(note);
+                    notes.push_back(note);
                     break;
                 }
 
@@ -1061,6 +1064,8 @@ MIDIFileReader::loadTrack(unsigned int trackToLoad,
         ++count;
     }
 
+    model->addAll(notes);
+    
     return model;
 }
 
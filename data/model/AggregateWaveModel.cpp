@@ -14,8 +14,10 @@
 */
 
 #include "AggregateWaveModel.h"
+#include "RangeSummaryBuilder.h"
 
 #include <iostream>
+#include <cmath>
 
 #include <QTextStream>
 
@@ -29,7 +31,14 @@ PowerOfSqrtTwoZoomConstraint
 AggregateWaveModel::m_zoomConstraint;
 
 AggregateWaveModel::AggregateWaveModel(ChannelSpecList channelSpecs) :
-    m_components(channelSpecs)
+    m_components(channelSpecs),
+    m_cache(std::make_shared<RangeCache>()),
+    m_fillThread(nullptr),
+    m_fillRequested(false),
+    m_refillFrom(-1),
+    m_refillRequested(false),
+    m_exiting(false),
+    m_fillExtent(0)
 {
     sv_samplerate_t overallRate = 0;
 
@@ -68,12 +77,63 @@ AggregateWaveModel::AggregateWaveModel(ChannelSpecList channelSpecs) :
                 this, SLOT(componentModelChangedWithin(ModelId, sv_frame_t, sv_frame_t)));
         connect(model.get(), SIGNAL(completionChanged(ModelId)),
                 this, SLOT(componentModelCompletionChanged(ModelId)));
+        connect(model.get(), SIGNAL(ready(ModelId)),
+                this, SLOT(componentModelReady(ModelId)));
+    }
+
+    if (m_components.size() > 1) {
+        m_ownChannels.push_back(-1);
+    }
+    for (int channel = 0; in_range_for(m_components, channel); ++channel) {
+        if (m_components[channel].channel < 0) {
+            m_ownChannels.push_back(channel);
+        }
+    }
+
+    if (!m_ownChannels.empty()) {
+        m_fillThread = new RangeCacheFillThread(*this);
+        m_fillThread->start();
+        requestFill(-1);
     }
 }
 
 AggregateWaveModel::~AggregateWaveModel()
 {
     SVDEBUG << "AggregateWaveModel::~AggregateWaveModel" << endl;
+
+    if (m_fillThread) {
+        {
+            QMutexLocker locker(&m_fillMutex);
+            m_exiting = true;
+            m_fillCondition.wakeAll();
+        }
+        m_fillThread->wait();
+        delete m_fillThread;
+    }
+}
+
+std::shared_ptr<AggregateWaveModel::RangeCache>
+AggregateWaveModel::getCache() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    return m_cache;
+}
+
+void
+AggregateWaveModel::requestFill(sv_frame_t refillFrom)
+{
+    // Never waits for the fill thread, which only holds the mutex
+    // while it takes the request
+    
+    if (!m_fillThread) return;
+    
+    QMutexLocker locker(&m_fillMutex);
+    if (refillFrom >= 0 && (m_refillFrom < 0 || refillFrom < m_refillFrom)) {
+        m_refillFrom = refillFrom;
+        m_refillRequested = true;
+    }
+    m_fillRequested = true;
+    m_fillCondition.wakeAll();
 }
 
 bool
@@ -203,25 +263,228 @@ AggregateWaveModel::getMultiChannelData(int fromchannel, int tochannel,
     return result;
 }
 
+int
+AggregateWaveModel::getCacheBlockSize(int cacheType)
+{
+    int base = (1 << m_zoomConstraint.getMinCachePower());
+    if (cacheType == 0) return base;
+    return int(base * sqrt(2.) + 0.01);
+}
+
+int
+AggregateWaveModel::getOwnChannelIndex(int channel) const
+{
+    if (channel == -1 && m_components.size() == 1) {
+        channel = 0;
+    }
+    for (int i = 0; in_range_for(m_ownChannels, i); ++i) {
+        if (m_ownChannels[i] == channel) return i;
+    }
+    return -1;
+}
+
 int
 AggregateWaveModel::getSummaryBlockSize(int desired) const
 {
-    //!!! complete
-    return desired;
+    int cacheType = 0;
+    int power = m_zoomConstraint.getMinCachePower();
+    int roundedBlockSize = m_zoomConstraint.getNearestBlockSize
+        (desired, cacheType, power, ZoomConstraint::RoundDown);
+
+    if (cacheType != 0 && cacheType != 1) {
+        // We will be reading directly, so can satisfy any blocksize
+        // requirement
+        return desired;
+    } else {
+        return roundedBlockSize;
+    }
 }
         
 void
-AggregateWaveModel::getSummaries(int, sv_frame_t, sv_frame_t,
-                                 RangeBlock &, int &) const
+AggregateWaveModel::getSummaries(int channel, sv_frame_t start, sv_frame_t count,
+                                 RangeBlock &ranges, int &blockSize) const
 {
-    //!!! complete
+    ranges.clear();
+
+    if (channel == -1 && m_components.size() == 1) {
+        channel = 0;
+    }
+    if (channel != -1 && !in_range_for(m_components, channel)) {
+        return;
+    }
+
+    int ownIndex = getOwnChannelIndex(channel);
+
+    if (ownIndex < 0) {
+        // A single channel of a component model, which can
+        // summarise it for us
+        const auto &spec = m_components[channel];
+        auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+            (spec.model);
+        if (model) {
+            model->getSummaries(spec.channel, start, count, ranges, blockSize);
+        }
+        return;
+    }
+
+    if (start < 0) {
+        if (count <= -start) return;
+        count += start;
+        start = 0;
+    }
+
+    int cacheType = 0;
+    int power = m_zoomConstraint.getMinCachePower();
+    int roundedBlockSize = m_zoomConstraint.getNearestBlockSize
+        (blockSize, cacheType, power, ZoomConstraint::RoundDown);
+
+    if (cacheType != 0 && cacheType != 1) {
+        getSummariesDirect(channel, start, count, blockSize, ranges);
+        return;
+    }
+
+    blockSize = roundedBlockSize;
+    ranges.reserve((count / blockSize) + 1);
+
+    auto ref = getCache();
+    const RangeSummaryPyramid &cache = ref->pyramids[cacheType];
+    int channels = int(m_ownChannels.size());
+    
+    sv_frame_t cacheBlock = getCacheBlockSize(cacheType);
+    sv_frame_t div = blockSize / cacheBlock;
+    sv_frame_t startIndex = start / cacheBlock;
+    sv_frame_t endIndex = (start + count) / cacheBlock;
+
+    sv_frame_t i = startIndex;
+    for (; i <= endIndex; i += div) {
+        Range range;
+        sv_frame_t want = std::min(div, endIndex + 1 - i);
+        if (cache.summarise(channels, ownIndex, i, i + want, range) < want) {
+            break;
+        }
+        ranges.push_back(range);
+    }
+
+    // Anything we haven't summarised yet must be read directly
+    sv_frame_t from = i * cacheBlock;
+    sv_frame_t to = std::min(start + count, getFrameCount());
+    if (i <= endIndex && from < to) {
+        getSummariesDirect(channel, from, to - from, blockSize, ranges);
+    }
+}
+
+void
+AggregateWaveModel::getSummariesDirect(int channel,
+                                       sv_frame_t start, sv_frame_t count,
+                                       int blockSize, RangeBlock &ranges) const
+{
+    if (blockSize <= 0) return;
+    
+    floatvec_t data = getData(channel, start, count);
+    sv_frame_t n = sv_frame_t(data.size());
+
+    for (sv_frame_t i = 0; i < n; i += blockSize) {
+        int here = int(std::min(sv_frame_t(blockSize), n - i));
+        float min, max, abssum;
+        RangeSummaryBuilder::summarise(data.data() + i, here, min, max, abssum);
+        ranges.push_back(Range(min, max, abssum / float(here)));
+    }
+}
+
+AggregateWaveModel::Range
+AggregateWaveModel::getSummary(int channel, sv_frame_t start, sv_frame_t count) const
+{
+    if (channel == -1 && m_components.size() == 1) {
+        channel = 0;
+    }
+    if (channel != -1 && !in_range_for(m_components, channel)) {
+        return Range();
+    }
+
+    int ownIndex = getOwnChannelIndex(channel);
+
+    if (ownIndex < 0) {
+        const auto &spec = m_components[channel];
+        auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+            (spec.model);
+        if (!model) return Range();
+        return model->getSummary(spec.channel, start, count);
+    }
+
+    if (start < 0) {
+        if (count <= -start) return Range();
+        count += start;
+        start = 0;
+    }
+
+    // Weights below are by frame count, so don't let them include
+    // frames beyond the end
+    sv_frame_t frameCount = getFrameCount();
+    if (start >= frameCount) return Range();
+    if (count > frameCount - start) count = frameCount - start;
+
+    // Take the whole base blocks within the range from the cache,
+    // and read the ends, and anything not yet summarised, directly
+
+    int channels = int(m_ownChannels.size());
+    sv_frame_t cacheBlock = getCacheBlockSize(0);
+    sv_frame_t i0 = (start + cacheBlock - 1) / cacheBlock;
+    sv_frame_t i1 = (start + count) / cacheBlock;
+
+    if (i1 <= i0) {
+        return getSummaryDirect(channel, start, count);
+    }
+
+    Range cached;
+    sv_frame_t got = getCache()->pyramids[0].summarise
+        (channels, ownIndex, i0, i1, cached);
+
+    Range parts[3] = {
+        getSummaryDirect(channel, start, i0 * cacheBlock - start),
+        cached,
+        getSummaryDirect(channel, (i0 + got) * cacheBlock,
+                         start + count - (i0 + got) * cacheBlock)
+    };
+    sv_frame_t weights[3] = {
+        i0 * cacheBlock - start,
+        got * cacheBlock,
+        start + count - (i0 + got) * cacheBlock
+    };
+
+    Range range;
+    float total = 0.f;
+    sv_frame_t frames = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (weights[i] <= 0) continue;
+        if (frames == 0 || parts[i].min() < range.min()) {
+            range.setMin(parts[i].min());
+        }
+        if (frames == 0 || parts[i].max() > range.max()) {
+            range.setMax(parts[i].max());
+        }
+        total += parts[i].absmean() * float(weights[i]);
+        frames += weights[i];
+    }
+    if (frames > 0) {
+        range.setAbsmean(total / float(frames));
+    }
+    return range;
 }
 
 AggregateWaveModel::Range
-AggregateWaveModel::getSummary(int, sv_frame_t, sv_frame_t) const
+AggregateWaveModel::getSummaryDirect(int channel,
+                                     sv_frame_t start, sv_frame_t count) const
 {
-    //!!! complete
-    return Range();
+    Range range;
+    if (count <= 0) return range;
+
+    floatvec_t data = getData(channel, start, count);
+    if (data.empty()) return range;
+
+    float min, max, abssum;
+    RangeSummaryBuilder::summarise(data.data(), int(data.size()),
+                                   min, max, abssum);
+    return Range(min, max, abssum / float(data.size()));
 }
         
 int
@@ -239,12 +502,16 @@ AggregateWaveModel::getComponent(int c) const
 void
 AggregateWaveModel::componentModelChanged(ModelId)
 {
+    // With no range to go on, assume the component has grown: wave
+    // models don't rewrite audio they have already made available
+    requestFill(-1);
     emit modelChanged(getId());
 }
 
 void
 AggregateWaveModel::componentModelChangedWithin(ModelId, sv_frame_t start, sv_frame_t end)
 {
+    requestFill(start < m_fillExtent ? start : -1);
     emit modelChangedWithin(getId(), start, end);
 }
 
@@ -254,6 +521,174 @@ AggregateWaveModel::componentModelCompletionChanged(ModelId)
     emit completionChanged(getId());
 }
 
+void
+AggregateWaveModel::componentModelReady(ModelId)
+{
+    requestFill(-1);
+}
+
+void
+AggregateWaveModel::cacheFilled()
+{
+    emit modelChanged(getId());
+}
+
+void
+AggregateWaveModel::RangeCacheFillThread::run()
+{
+    int channels = int(m_model.m_ownChannels.size());
+    int blockSizes[2] = { getCacheBlockSize(0), getCacheBlockSize(1) };
+
+    auto builder = std::make_unique<RangeSummaryBuilder>(channels, blockSizes);
+    auto cache = m_model.getCache();
+    sv_frame_t extent = 0;
+    
+    while (true) {
+
+        sv_frame_t refillFrom = -1;
+        {
+            QMutexLocker locker(&m_model.m_fillMutex);
+            while (!m_model.m_fillRequested && !m_model.m_exiting) {
+                m_model.m_fillCondition.wait(&m_model.m_fillMutex);
+            }
+            if (m_model.m_exiting) return;
+            m_model.m_fillRequested = false;
+            m_model.m_refillRequested = false;
+            std::swap(refillFrom, m_model.m_refillFrom);
+        }
+
+        if (refillFrom >= 0 && refillFrom < extent) {
+            // Readers may be using the old cache, so we can't cut it
+            // back in place
+            extent = refillFrom - (refillFrom % (sv_frame_t(blockSizes[0]) *
+                                                 blockSizes[1]));
+            cache = cutBack(*cache, extent);
+            {
+                QMutexLocker locker(&m_model.m_cacheMutex);
+                m_model.m_cache = cache;
+            }
+            builder = std::make_unique<RangeSummaryBuilder>
+                (channels, blockSizes);
+            m_model.m_fillExtent = extent;
+        }
+
+        // Wait for the components to finish loading: we can't
+        // summarise them any faster than they are decoded anyway
+        if (!m_model.isReady(nullptr)) {
+            continue;
+        }
+
+        if (fill(*builder, *cache, extent)) {
+            // Signal the change from the model's own thread, not ours
+            QMetaObject::invokeMethod(&m_model, "cacheFilled",
+                                      Qt::QueuedConnection);
+        }
+    }
+}
+
+bool
+AggregateWaveModel::RangeCacheFillThread::fill(RangeSummaryBuilder &builder,
+                                               RangeCache &cache,
+                                               sv_frame_t &extent)
+{
+    // Summarise from extent for as far as the components can give us
+    // audio, returning true if anything was added to the cache
+
+    const ChannelSpecList &components = m_model.m_components;
+    const std::vector<int> &own = m_model.m_ownChannels;
+    int channels = int(own.size());
+    
+    const sv_frame_t readBlockSize = 32768;
+    sv_frame_t frameCount = m_model.getFrameCount();
+    std::vector<floatvec_t> data(components.size());
+    floatvec_t interleaved;
+    RangeSummaryLevel filled[2];
+    bool added = false;
+
+    SVDEBUG << "AggregateWaveModel(" << m_model.getId() << ")::RangeCacheFillThread: summarising " << channels << " channel(s) from " << extent << " to " << frameCount << endl;
+    
+    while (extent < frameCount) {
+
+        if (m_model.m_exiting || m_model.m_refillRequested) break;
+
+        sv_frame_t n = std::min(readBlockSize, frameCount - extent);
+
+        // A component that is still being written may report more
+        // frames than it can yet return: stop wherever one comes up
+        // short of its own end, and carry on from there when it next
+        // changes
+        bool available = true;
+        for (int c = 0; in_range_for(components, c); ++c) {
+            data[c].clear();
+            auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+                (components[c].model);
+            if (!model) continue;
+            data[c] = model->getData(components[c].channel, extent, n);
+            sv_frame_t expected = std::min
+                (n, model->getEndFrame() - model->getStartFrame() - extent);
+            if (sv_frame_t(data[c].size()) < expected) {
+                n = sv_frame_t(data[c].size());
+                available = false;
+            }
+        }
+        if (n <= 0) break;
+
+        // Mix as getData does, so that the summaries agree with it
+        interleaved.assign(n * channels, 0.f);
+        for (int i = 0; i < channels; ++i) {
+            for (int c = 0; in_range_for(components, c); ++c) {
+                if (own[i] != -1 && own[i] != c) continue;
+                sv_frame_t got = std::min(n, sv_frame_t(data[c].size()));
+                for (sv_frame_t j = 0; j < got; ++j) {
+                    interleaved[j * channels + i] += data[c][j];
+                }
+            }
+        }
+
+        builder.process(interleaved.data(), n, filled[0], filled[1]);
+
+        for (int cacheType = 0; cacheType < 2; ++cacheType) {
+            if (filled[cacheType].size() > 0) added = true;
+            cache.pyramids[cacheType].append(filled[cacheType], channels);
+            filled[cacheType].clear();
+        }
+
+        extent += n;
+        m_model.m_fillExtent = extent;
+
+        if (!available) break;
+    }
+
+    SVDEBUG << "AggregateWaveModel(" << m_model.getId() << ")::RangeCacheFillThread: summarised to " << extent << endl;
+
+    return added;
+}
+
+std::shared_ptr<AggregateWaveModel::RangeCache>
+AggregateWaveModel::RangeCacheFillThread::cutBack(const RangeCache &cache,
+                                                  sv_frame_t frame) const
+{
+    // Return a copy of the cache holding only the blocks that end at
+    // or before the given frame. The levels above the base level are
+    // rebuilt from it by the pyramid
+
+    int channels = int(m_model.m_ownChannels.size());
+    auto cut = std::make_shared<RangeCache>();
+    
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        const RangeSummaryLevel &from = cache.pyramids[cacheType].getLevel(0);
+        sv_frame_t keep = std::min
+            (from.size(), (frame / getCacheBlockSize(cacheType)) * channels);
+        RangeSummaryLevel level;
+        for (sv_frame_t i = 0; i < keep; ++i) {
+            level.append(from.at(i));
+        }
+        cut->pyramids[cacheType].append(level, channels);
+    }
+
+    return cut;
+}
+
 void
 AggregateWaveModel::toXml(QTextStream &out,
                           QString indent,
@@ -17,12 +17,21 @@
 #define SV_AGGREGATE_WAVE_MODEL_H
 
 #include "RangeSummarisableTimeValueModel.h"
+#include "RangeSummaryPyramid.h"
 #include "PowerOfSqrtTwoZoomConstraint.h"
 
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
 #include <vector>
+#include <atomic>
+#include <memory>
 
 namespace sv {
 
+class RangeSummaryBuilder;
+
 class AggregateWaveModel : public RangeSummarisableTimeValueModel
 {
     Q_OBJECT
@@ -89,10 +98,82 @@ protected slots:
     void componentModelChanged(ModelId);
     void componentModelChangedWithin(ModelId, sv_frame_t, sv_frame_t);
     void componentModelCompletionChanged(ModelId);
+    void componentModelReady(ModelId);
+    void cacheFilled();
 
 protected:
+    struct RangeCache {
+        RangeSummaryPyramid pyramids[2];
+    };
+    
+    class RangeCacheFillThread : public QThread
+    {
+    public:
+        RangeCacheFillThread(AggregateWaveModel &model) : m_model(model) { }
+        void run() override;
+
+    protected:
+        AggregateWaveModel &m_model;
+
+        bool fill(RangeSummaryBuilder &builder, RangeCache &cache,
+                  sv_frame_t &extent);
+        std::shared_ptr<RangeCache> cutBack(const RangeCache &cache,
+                                            sv_frame_t frame) const;
+    };
+
     ChannelSpecList m_components;
     static PowerOfSqrtTwoZoomConstraint m_zoomConstraint;
+
+    /**
+     * Channels whose summaries can't be taken from a component model
+     * and that we therefore summarise ourselves: the mixdown
+     * (channel -1) of more than one component, and any component
+     * that is itself a mixdown of its model's channels.
+     */
+    std::vector<int> m_ownChannels;
+
+    /**
+     * Summary pyramids for m_ownChannels, interleaved in that order,
+     * at the same base block sizes as ReadOnlyWaveFileModel. They
+     * hold whole blocks only; any part-filled block at the end is
+     * read directly.
+     *
+     * m_fillThread extends the pyramids whenever a component changes
+     * once the components are ready, picking up from where it last
+     * stopped, so a component that is still being written is
+     * summarised as it grows. If a component changes within audio
+     * already summarised, the fill thread replaces the cache with a
+     * copy cut back to before the change and continues from there.
+     * Readers therefore take a reference under m_cacheMutex, and then
+     * read the pyramids without locking.
+     */
+    std::shared_ptr<RangeCache> m_cache;
+    mutable QMutex m_cacheMutex;
+    RangeCacheFillThread *m_fillThread;
+
+    /**
+     * Requests to m_fillThread. m_fillRequested and m_refillFrom (the
+     * earliest changed frame that had already been summarised, or -1)
+     * are guarded by m_fillMutex. m_refillRequested lets the thread
+     * abandon a fill that a refill will supersede.
+     */
+    QMutex m_fillMutex;
+    QWaitCondition m_fillCondition;
+    bool m_fillRequested;
+    sv_frame_t m_refillFrom;
+    std::atomic<bool> m_refillRequested;
+    std::atomic<bool> m_exiting;
+    std::atomic<sv_frame_t> m_fillExtent;
+
+    std::shared_ptr<RangeCache> getCache() const;
+    void requestFill(sv_frame_t refillFrom);
+
+    int getOwnChannelIndex(int channel) const;
+    static int getCacheBlockSize(int cacheType);
+    void getSummariesDirect(int channel, sv_frame_t start, sv_frame_t count,
+                            int blockSize, RangeBlock &ranges) const;
+    Range getSummaryDirect(int channel, sv_frame_t start,
+                           sv_frame_t count) const;
 };
 
 } // end namespace sv
@@ -17,6 +17,8 @@
 
 #include "SparseTimeValueModel.h"
 
+#include <algorithm>
+
 //#define DEBUG_ALIGNMENT_MODEL 1
 
 namespace sv {
@@ -179,17 +181,9 @@ AlignmentModel::toReference(sv_frame_t frame) const
 #ifdef DEBUG_ALIGNMENT_MODEL
     SVCERR << "AlignmentModel::toReference(" << frame << ")" << endl;
 #endif
-    if (!m_path) {
-        if (m_pathSource.isNone()) {
-            return frame;
-        }
-        constructPath();
-    }
-    if (!m_path) {
-        return frame;
-    }
-
-    return performAlignment(*m_path, frame);
+    sv_frame_t result = frame;
+    toReference(&frame, &result, 1);
+    return result;
 }
 
 sv_frame_t
@@ -198,17 +192,49 @@ AlignmentModel::fromReference(sv_frame_t frame) const
 #ifdef DEBUG_ALIGNMENT_MODEL
     SVCERR << "AlignmentModel::fromReference(" << frame << ")" << endl;
 #endif
-    if (!m_reversePath) {
-        if (m_pathSource.isNone()) {
-            return frame;
-        }
+    sv_frame_t result = frame;
+    fromReference(&frame, &result, 1);
+    return result;
+}
+
+void
+AlignmentModel::toReference(const sv_frame_t *frames,
+                            sv_frame_t *out, int n) const
+{
+    if (!m_path && !m_pathSource.isNone()) {
+        constructPath();
         constructReversePath();
     }
-    if (!m_reversePath) {
-        return frame;
+    if (!m_path) {
+        std::copy(frames, frames + n, out);
+        return;
     }
 
-    return performAlignment(*m_reversePath, frame);
+    performAlignment(m_path->getFrames(), m_path->getMapFrames(),
+                     frames, out, n);
+}
+
+void
+AlignmentModel::fromReference(const sv_frame_t *frames,
+                              sv_frame_t *out, int n) const
+{
+    if (!m_path && !m_pathSource.isNone()) {
+        constructPath();
+        constructReversePath();
+    }
+    if (!m_path) {
+        std::copy(frames, frames + n, out);
+        return;
+    }
+
+    if (m_reversePath) {
+        performAlignment(m_reversePath->getFrames(),
+                         m_reversePath->getMapFrames(),
+                         frames, out, n);
+    } else {
+        performAlignment(m_path->getMapFrames(), m_path->getFrames(),
+                         frames, out, n);
+    }
 }
 
 void
@@ -280,6 +306,7 @@ AlignmentModel::constructPath() const
     m_path->clear();
 
     EventVector points = pathSourceModel->getAllEvents();
+    m_path->reserve(int(points.size()));
 
     for (const auto &p: points) {
         sv_frame_t frame = p.getFrame();
@@ -289,116 +316,161 @@ AlignmentModel::constructPath() const
     }
 
 #ifdef DEBUG_ALIGNMENT_MODEL
-    SVCERR << "AlignmentModel::constructPath: " << m_path->getPointCount() << " points, at least " << (2 * m_path->getPointCount() * (3 * sizeof(void *) + sizeof(int) + sizeof(PathPoint))) << " bytes" << endl;
+    SVCERR << "AlignmentModel::constructPath: " << m_path->getPointCount() << " points, " << (m_path->getPointCount() * sizeof(PathPoint)) << " bytes" << endl;
 #endif
 }
 
 void
 AlignmentModel::constructReversePath() const
 {
-    if (!m_reversePath) {
-        if (!m_path) {
+    if (!m_path) {
+        if (!m_reversePath) {
             SVCERR << "ERROR: AlignmentModel::constructReversePath: "
-                      << "No forward path available" << endl;
-            return;
+                   << "No forward path available" << endl;
         }
+        return;
+    }
+
+    if (m_path->hasOrderedMapFrames()) {
+        // The forward path with frames and mapframes exchanged is
+        // already in order, so we can use that instead
+        m_reversePath.reset();
+#ifdef DEBUG_ALIGNMENT_MODEL
+        SVCERR << "AlignmentModel::constructReversePath: using forward path" << endl;
+#endif
+        return;
+    }
+    
+    if (!m_reversePath) {
         m_reversePath.reset(new Path
                             (m_path->getSampleRate(),
                              m_path->getResolution()));
-    } else {
-        if (!m_path) return;
     }
         
     m_reversePath->clear();
 
-    Path::Points points = m_path->getPoints();
-        
-    for (auto p: points) {
-        sv_frame_t frame = p.frame;
-        sv_frame_t rframe = p.mapframe;
-        m_reversePath->add(PathPoint(rframe, frame));
+    const auto &frames = m_path->getFrames();
+    const auto &mapframes = m_path->getMapFrames();
+
+    std::vector<PathPoint> points;
+    points.reserve(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        points.push_back(PathPoint(mapframes[i], frames[i]));
+    }
+    std::sort(points.begin(), points.end());
+
+    m_reversePath->reserve(int(points.size()));
+    for (const auto &p: points) {
+        m_reversePath->add(p);
     }
 
 #ifdef DEBUG_ALIGNMENT_MODEL
-    SVCERR << "AlignmentModel::constructReversePath: " << m_reversePath->getPointCount() << " points, at least " << (2 * m_reversePath->getPointCount() * (3 * sizeof(void *) + sizeof(int) + sizeof(PathPoint))) << " bytes" << endl;
+    SVCERR << "AlignmentModel::constructReversePath: " << m_reversePath->getPointCount() << " points, " << (m_reversePath->getPointCount() * sizeof(PathPoint)) << " bytes" << endl;
 #endif
 }
 
-sv_frame_t
-AlignmentModel::performAlignment(const Path &path, sv_frame_t frame) const
+void
+AlignmentModel::performAlignment(const std::vector<sv_frame_t> &from,
+                                 const std::vector<sv_frame_t> &to,
+                                 const sv_frame_t *frames,
+                                 sv_frame_t *out, int n) const
 {
     // The path consists of a series of points, each with frame equal
     // to the frame on the source model (aligned model) and mapframe
     // equal to the frame on the target model (reference model).  Both
-    // should be monotonically increasing.
+    // should be monotonically increasing. Here from and to are the
+    // arrays of frames and mapframes, or the other way around when
+    // mapping from the reference.
 
-    const Path::Points &points = path.getPoints();
+    const size_t count = from.size();
 
-    if (points.empty()) {
+    if (count == 0) {
 #ifdef DEBUG_ALIGNMENT_MODEL
         SVCERR << "AlignmentModel::align: No points" << endl;
 #endif
-        return frame;
+        std::copy(frames, frames + n, out);
+        return;
     }        
 
-#ifdef DEBUG_ALIGNMENT_MODEL
-    SVCERR << "AlignmentModel::align: frame " << frame << " requested" << endl;
-#endif
+    // For each frame we want the first point that does not sort
+    // before the point (frame, frame). This can only move forward as
+    // the frame increases, so when the frames are ascending we step
+    // forward from the last one, falling back to a binary search if
+    // the frame goes backwards or the step would be a long one
 
-    PathPoint point(frame);
-    Path::Points::const_iterator i = points.lower_bound(point);
-    if (i == points.end()) {
-#ifdef DEBUG_ALIGNMENT_MODEL
-        SVCERR << "Note: i == points.end()" << endl;
-#endif
-        --i;
-    }
-    while (i != points.begin() && i->frame > frame) {
-        --i;
-    }
+    auto sortsBefore = [&](size_t i, sv_frame_t frame) {
+        return from[i] < frame || (from[i] == frame && to[i] < frame);
+    };
 
-    sv_frame_t foundFrame = i->frame;
-    sv_frame_t foundMapFrame = i->mapframe;
+    const int maxSteps = 8;
+    size_t index = 0;
+    
+    for (int k = 0; k < n; ++k) {
 
-    sv_frame_t followingFrame = foundFrame;
-    sv_frame_t followingMapFrame = foundMapFrame;
+        sv_frame_t frame = frames[k];
 
-    if (++i != points.end()) {
 #ifdef DEBUG_ALIGNMENT_MODEL
-        SVCERR << "another point available" << endl;
+        SVCERR << "AlignmentModel::align: frame " << frame << " requested" << endl;
 #endif
-        followingFrame = i->frame;
-        followingMapFrame = i->mapframe;
-    } else {
-#ifdef DEBUG_ALIGNMENT_MODEL
-        SVCERR << "no other point available" << endl;
-#endif
-    }        
+
+        if (k == 0 || frame < frames[k-1]) {
+            index = Path::lowerBound(from, to, frame, frame);
+        } else {
+            int steps = 0;
+            while (index < count && sortsBefore(index, frame)) {
+                if (++steps > maxSteps) {
+                    index = Path::lowerBound(from, to, frame, frame);
+                    break;
+                }
+                ++index;
+            }
+        }
+
+        size_t i = index;
+        if (i == count) {
+            --i;
+        }
+        while (i > 0 && from[i] > frame) {
+            --i;
+        }
+
+        sv_frame_t foundFrame = from[i];
+        sv_frame_t foundMapFrame = to[i];
+
+        sv_frame_t followingFrame = foundFrame;
+        sv_frame_t followingMapFrame = foundMapFrame;
+
+        if (i + 1 < count) {
+            followingFrame = from[i + 1];
+            followingMapFrame = to[i + 1];
+        }
 
 #ifdef DEBUG_ALIGNMENT_MODEL
-    SVCERR << "foundFrame = " << foundFrame << ", foundMapFrame = " << foundMapFrame
-         << ", followingFrame = " << followingFrame << ", followingMapFrame = "
-         << followingMapFrame << endl;
+        SVCERR << "foundFrame = " << foundFrame << ", foundMapFrame = " << foundMapFrame
+               << ", followingFrame = " << followingFrame << ", followingMapFrame = "
+               << followingMapFrame << endl;
 #endif
     
-    if (foundMapFrame < 0) {
-        return 0;
-    }
+        if (foundMapFrame < 0) {
+            out[k] = 0;
+            continue;
+        }
 
-    sv_frame_t resultFrame = foundMapFrame;
+        sv_frame_t resultFrame = foundMapFrame;
 
-    if (followingFrame != foundFrame && frame > foundFrame) {
-        double interp =
-            double(frame - foundFrame) /
-            double(followingFrame - foundFrame);
-        resultFrame += lrint(double(followingMapFrame - foundMapFrame) * interp);
-    }
+        if (followingFrame != foundFrame && frame > foundFrame) {
+            double interp =
+                double(frame - foundFrame) /
+                double(followingFrame - foundFrame);
+            resultFrame += lrint(double(followingMapFrame - foundMapFrame) * interp);
+        }
 
 #ifdef DEBUG_ALIGNMENT_MODEL
-    SVCERR << "AlignmentModel::align: resultFrame = " << resultFrame << endl;
+        SVCERR << "AlignmentModel::align: resultFrame = " << resultFrame << endl;
 #endif
 
-    return resultFrame;
+        out[k] = resultFrame;
+    }
 }
 
 void
@@ -63,6 +63,22 @@ public:
     sv_frame_t toReference(sv_frame_t frame) const;
     sv_frame_t fromReference(sv_frame_t frame) const;
 
+    /**
+     * Map each of the n frames in the given array to the reference
+     * model, writing the results to out. If the frames are in
+     * ascending order, they are mapped in a single pass through the
+     * path, taking amortised constant time per frame. Frames in any
+     * other order are also mapped correctly, but more slowly.
+     */
+    void toReference(const sv_frame_t *frames, sv_frame_t *out, int n) const;
+
+    /**
+     * Map each of the n frames in the given array from the reference
+     * model, writing the results to out. As toReference(), this is
+     * fastest if the frames are in ascending order.
+     */
+    void fromReference(const sv_frame_t *frames, sv_frame_t *out, int n) const;
+
     void setPathFrom(ModelId pathSource); // a SparseTimeValueModel
     void setPath(const Path &path);
 
@@ -106,6 +122,10 @@ protected:
                           // handle on only while it's still being generated
 
     mutable std::unique_ptr<Path> m_path;
+
+    // Only needed if the forward path's mapframes are out of order:
+    // otherwise we map from the reference using the forward path's
+    // arrays with their roles exchanged
     mutable std::unique_ptr<Path> m_reversePath;
     bool m_pathBegun;
     bool m_pathComplete;
@@ -116,7 +136,10 @@ protected:
     void constructPath() const;
     void constructReversePath() const;
 
-    sv_frame_t performAlignment(const Path &path, sv_frame_t frame) const;
+    void performAlignment(const std::vector<sv_frame_t> &from,
+                          const std::vector<sv_frame_t> &to,
+                          const sv_frame_t *frames,
+                          sv_frame_t *out, int n) const;
 };
 
 } // end namespace sv
@@ -79,6 +79,7 @@ public:
     }
 
     virtual ~BoxModel() {
+        m_notifier.detach();
     }
 
     QString getTypeName() const override { return tr("Box"); }
@@ -198,6 +199,39 @@ public:
         }
     }
     
+    void addAll(const EventVector &ee) override {
+
+        if (ee.empty()) return;
+        
+        bool allChange = false;
+        sv_frame_t f0 = ee[0].getFrame(), f1 = f0;
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_events.addAll(ee);
+
+            for (const auto &e: ee) {
+                float v0 = e.getValue();
+                float v1 = v0 + fabsf(e.getLevel());
+                if (!m_haveExtents || v0 < m_valueMinimum) {
+                    m_valueMinimum = v0; allChange = true;
+                }
+                if (!m_haveExtents || v1 > m_valueMaximum) {
+                    m_valueMaximum = v1; allChange = true;
+                }
+                m_haveExtents = true;
+                f0 = std::min(f0, e.getFrame());
+                f1 = std::max(f1, e.getFrame() + e.getDuration());
+            }
+        }
+        
+        m_notifier.update(f0, f1 - f0 + m_resolution);
+
+        if (allChange) {
+            emit modelChanged(getId());
+        }
+    }
+    
     void remove(Event e) override {
         {
             QMutexLocker locker(&m_mutex);
@@ -0,0 +1,232 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "CompressedColumnStore.h"
+
+#include "base/Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sv {
+
+static inline uint32_t
+bitsOf(float f)
+{
+    uint32_t w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+}
+
+static inline float
+floatOf(uint32_t w)
+{
+    float f;
+    memcpy(&f, &w, sizeof(f));
+    return f;
+}
+
+CompressedColumnStore::CompressedColumnStore() :
+    m_width(0),
+    m_useCount(0)
+{
+}
+
+const CompressedColumnStore::Column &
+CompressedColumnStore::at(int index) const
+{
+    if (index < 0 || index >= m_width) {
+        return m_empty;
+    }
+    return fetch(index / BlockColumns).columns[index % BlockColumns];
+}
+
+void
+CompressedColumnStore::set(int index, const Column &values)
+{
+    if (index < 0) {
+        return;
+    }
+
+    int block = index / BlockColumns;
+    if (block >= int(m_blocks.size())) {
+        m_blocks.resize(block + 1);
+    }
+
+    DecodedBlock &decoded = fetch(block);
+    decoded.columns[index % BlockColumns] = values;
+    decoded.dirty = true;
+
+    // The encoded form is out of date now, and will be replaced when
+    // the block is evicted
+    m_blocks[block] = QByteArray();
+
+    if (index >= m_width) {
+        m_width = index + 1;
+    }
+}
+
+void
+CompressedColumnStore::clear()
+{
+    m_width = 0;
+    m_blocks.clear();
+    m_decoded.clear();
+}
+
+size_t
+CompressedColumnStore::getByteSize() const
+{
+    size_t bytes = 0;
+    for (const auto &b: m_blocks) {
+        bytes += size_t(b.size());
+    }
+    for (const auto &d: m_decoded) {
+        for (const auto &c: d.columns) {
+            bytes += c.capacity() * sizeof(float);
+        }
+    }
+    return bytes;
+}
+
+CompressedColumnStore::DecodedBlock &
+CompressedColumnStore::fetch(int block) const
+{
+    for (auto &d: m_decoded) {
+        if (d.block == block) {
+            d.lastUsed = ++m_useCount;
+            return d;
+        }
+    }
+
+    if (int(m_decoded.size()) >= MaxDecodedBlocks) {
+        auto lru = std::min_element
+            (m_decoded.begin(), m_decoded.end(),
+             [](const DecodedBlock &a, const DecodedBlock &b) {
+                 return a.lastUsed < b.lastUsed;
+             });
+        if (lru->dirty) {
+            m_blocks[lru->block] = encode(lru->columns);
+        }
+        m_decoded.erase(lru);
+    }
+
+    DecodedBlock d;
+    d.block = block;
+    if (block < int(m_blocks.size())) {
+        d.columns = decode(m_blocks[block]);
+    } else {
+        d.columns = std::vector<Column>(BlockColumns);
+    }
+    d.dirty = false;
+    d.lastUsed = ++m_useCount;
+
+    m_decoded.push_back(std::move(d));
+    return m_decoded.back();
+}
+
+QByteArray
+CompressedColumnStore::encode(const std::vector<Column> &columns)
+{
+    Profiler profiler("CompressedColumnStore::encode");
+
+    size_t total = 0;
+    for (const auto &c: columns) {
+        total += c.size();
+    }
+    if (total == 0) {
+        return {};
+    }
+
+    // The raw layout is the length of each column, followed by the
+    // lowest byte of every value, then the next byte of every value,
+    // and so on
+
+    QByteArray raw(int(BlockColumns * sizeof(uint32_t) +
+                       total * sizeof(uint32_t)), '\0');
+    char *lengths = raw.data();
+    unsigned char *bytes = reinterpret_cast<unsigned char *>
+        (raw.data() + BlockColumns * sizeof(uint32_t));
+
+    size_t k = 0;
+    const Column *prev = nullptr;
+
+    for (int i = 0; i < BlockColumns; ++i) {
+        const Column &c = columns[i];
+        uint32_t length = uint32_t(c.size());
+        memcpy(lengths + i * sizeof(uint32_t), &length, sizeof(length));
+        for (size_t j = 0; j < c.size(); ++j, ++k) {
+            uint32_t w = bitsOf(c[j]);
+            if (prev && j < prev->size()) {
+                w ^= bitsOf((*prev)[j]);
+            }
+            bytes[k] = (unsigned char)(w & 0xff);
+            bytes[k + total] = (unsigned char)((w >> 8) & 0xff);
+            bytes[k + total * 2] = (unsigned char)((w >> 16) & 0xff);
+            bytes[k + total * 3] = (unsigned char)((w >> 24) & 0xff);
+        }
+        prev = &c;
+    }
+
+    return qCompress(raw, 1);
+}
+
+std::vector<CompressedColumnStore::Column>
+CompressedColumnStore::decode(const QByteArray &encoded)
+{
+    std::vector<Column> columns(BlockColumns);
+
+    if (encoded.isEmpty()) {
+        return columns;
+    }
+
+    Profiler profiler("CompressedColumnStore::decode");
+
+    QByteArray raw = qUncompress(encoded);
+
+    const char *lengths = raw.constData();
+    size_t total = 0;
+    for (int i = 0; i < BlockColumns; ++i) {
+        uint32_t length;
+        memcpy(&length, lengths + i * sizeof(uint32_t), sizeof(length));
+        columns[i].resize(length);
+        total += length;
+    }
+
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>
+        (raw.constData() + BlockColumns * sizeof(uint32_t));
+
+    size_t k = 0;
+    const Column *prev = nullptr;
+
+    for (int i = 0; i < BlockColumns; ++i) {
+        Column &c = columns[i];
+        for (size_t j = 0; j < c.size(); ++j, ++k) {
+            uint32_t w =
+                uint32_t(bytes[k]) |
+                (uint32_t(bytes[k + total]) << 8) |
+                (uint32_t(bytes[k + total * 2]) << 16) |
+                (uint32_t(bytes[k + total * 3]) << 24);
+            if (prev && j < prev->size()) {
+                w ^= bitsOf((*prev)[j]);
+            }
+            c[j] = floatOf(w);
+        }
+        prev = &c;
+    }
+
+    return columns;
+}
+
+} // end namespace sv
@@ -0,0 +1,120 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_COMPRESSED_COLUMN_STORE_H
+#define SV_COMPRESSED_COLUMN_STORE_H
+
+#include <QByteArray>
+
+#include <vector>
+#include <cstdint>
+
+namespace sv {
+
+/**
+ * A store for the columns of a dense 3d model, holding them
+ * compressed in fixed-size blocks of columns.
+ *
+ * Compression is lossless. Each value is XORed with the value in the
+ * same bin of the previous column, which for the smoothly varying
+ * data typical of spectral features leaves mostly zero high-order
+ * bits. The bytes of the results are then grouped by significance
+ * and the block is compressed with zlib at its fastest setting.
+ *
+ * A small number of blocks are held decoded, and replaced least
+ * recently used first, so that reading or writing columns near one
+ * another (as when rendering a view, or filling the model from a
+ * transform) only decodes or encodes each block once. Columns may be
+ * set in any order and any number of times.
+ *
+ * Columns may have any length. A column that has never been set is
+ * empty.
+ *
+ * CompressedColumnStore is not thread-safe, even for reading, as
+ * reading updates the decoded blocks: the caller must serialise all
+ * access.
+ */
+class CompressedColumnStore
+{
+public:
+    typedef std::vector<float> Column;
+
+    CompressedColumnStore();
+
+    /**
+     * Return the number of columns, that is, one more than the index
+     * of the last column set.
+     */
+    int size() const { return m_width; }
+
+    /**
+     * Return the column at the given index, or an empty column if it
+     * is beyond the end.
+     */
+    Column get(int index) const {
+        return at(index);
+    }
+
+    /**
+     * Return a reference to the column at the given index, or to an
+     * empty column if it is beyond the end. The reference is valid
+     * only until the next call to any other method.
+     */
+    const Column &at(int index) const;
+
+    void set(int index, const Column &values);
+
+    void clear();
+
+    /**
+     * Return the approximate number of bytes used, both compressed
+     * and decoded.
+     */
+    size_t getByteSize() const;
+
+private:
+    CompressedColumnStore(const CompressedColumnStore &) =delete;
+    CompressedColumnStore &operator=(const CompressedColumnStore &) =delete;
+
+    enum { BlockColumns = 64, MaxDecodedBlocks = 8 };
+
+    struct DecodedBlock {
+        int block;
+        std::vector<Column> columns;
+        bool dirty;
+        uint64_t lastUsed;
+    };
+
+    int m_width;
+
+    // Encoded blocks, one per BlockColumns columns. An empty array
+    // means either that no column in the block has any values, or
+    // that the block has been modified since it was last encoded and
+    // is held decoded
+    mutable std::vector<QByteArray> m_blocks;
+
+    mutable std::vector<DecodedBlock> m_decoded;
+    mutable uint64_t m_useCount;
+
+    Column m_empty;
+
+    DecodedBlock &fetch(int block) const;
+
+    static QByteArray encode(const std::vector<Column> &columns);
+    static std::vector<Column> decode(const QByteArray &encoded);
+};
+
+} // end namespace sv
+
+#endif
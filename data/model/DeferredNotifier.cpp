@@ -0,0 +1,175 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "DeferredNotifier.h"
+#include "NotificationScheduler.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+namespace sv {
+
+DeferredNotifier::DeferredNotifier(Model *m, ModelId id, Mode mode) :
+    m_model(m),
+    m_modelId(id),
+    m_mode(mode),
+    m_scheduled(false),
+    m_token(std::make_shared<NotificationScheduler::Token>(this))
+{
+}
+
+DeferredNotifier::~DeferredNotifier()
+{
+}
+
+void
+DeferredNotifier::detach()
+{
+    QMutexLocker locker(&m_token->mutex);
+    m_token->notifier = nullptr;
+}
+
+void
+DeferredNotifier::update(sv_frame_t frame, sv_frame_t duration)
+{
+    NotificationScheduler *scheduler = NotificationScheduler::getInstance();
+    
+    bool notifyNow = false;
+    bool scheduleLater = false;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        addInterval(m_pending, frame, frame + duration);
+
+        if (m_mode == NOTIFY_ALWAYS) {
+            int interval = scheduler->getMinimumInterval();
+            if (interval == 0 ||
+                !m_sinceNotified.isValid() ||
+                m_sinceNotified.elapsed() >= interval) {
+                notifyNow = true;
+            } else if (!m_scheduled) {
+                m_scheduled = true;
+                scheduleLater = true;
+            }
+        }
+    }
+
+    if (notifyNow) {
+        notify();
+    } else if (m_mode == NOTIFY_ALWAYS) {
+        // Rate-limited: this change will go out with a later one
+        scheduler->countSuppressed(1);
+        if (scheduleLater) {
+            scheduler->schedule(m_token);
+        }
+    }
+}
+
+bool
+DeferredNotifier::hasPendingNotifications() const
+{
+    QMutexLocker locker(&m_mutex);
+    return !m_pending.empty();
+}
+
+void
+DeferredNotifier::makeDeferredNotifications()
+{
+    notify();
+}
+
+void
+DeferredNotifier::notify()
+{
+    Intervals intervals;
+    takePending(intervals);
+    emitChanges(m_model, m_modelId, intervals);
+}
+
+void
+DeferredNotifier::takePending(Intervals &intervals)
+{
+    QMutexLocker locker(&m_mutex);
+    intervals.swap(m_pending);
+    m_sinceNotified.start();
+    m_scheduled = false;
+}
+
+void
+DeferredNotifier::unschedule()
+{
+    QMutexLocker locker(&m_mutex);
+    m_scheduled = false;
+}
+
+void
+DeferredNotifier::emitChanges(Model *model, ModelId modelId,
+                              const Intervals &intervals)
+{
+    if (intervals.empty()) {
+        return;
+    }
+    
+    for (const auto &i: intervals) {
+        model->modelChangedWithin(modelId, i.first, i.second);
+    }
+    model->modelChanged(modelId);
+
+    NotificationScheduler::getInstance()->countSent(int(intervals.size()) + 1);
+}
+
+void
+DeferredNotifier::addInterval(Intervals &intervals,
+                              sv_frame_t start, sv_frame_t end)
+{
+    if (end < start) {
+        std::swap(start, end);
+    }
+
+    // Intervals are kept sorted and disjoint. Absorb every interval
+    // that overlaps or touches the new one, then insert the result
+
+    auto itr = std::lower_bound
+        (intervals.begin(), intervals.end(), start,
+         [](const std::pair<sv_frame_t, sv_frame_t> &i, sv_frame_t f) {
+             return i.second < f;
+         });
+
+    auto last = itr;
+    while (last != intervals.end() && last->first <= end) {
+        start = std::min(start, last->first);
+        end = std::max(end, last->second);
+        ++last;
+    }
+
+    itr = intervals.erase(itr, last);
+    intervals.insert(itr, { start, end });
+
+    if (intervals.size() > MaxIntervals) {
+        // Merge the two neighbours separated by the smallest gap
+        size_t best = 0;
+        for (size_t i = 1; i + 1 < intervals.size(); ++i) {
+            if (intervals[i+1].first - intervals[i].second <
+                intervals[best+1].first - intervals[best].second) {
+                best = i;
+            }
+        }
+        intervals[best].second = intervals[best+1].second;
+        intervals.erase(intervals.begin() + best + 1);
+    }
+}
+
+} // end namespace sv
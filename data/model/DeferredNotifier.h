@@ -16,14 +16,39 @@
 #define SV_DEFERRED_NOTIFIER_H
 
 #include "Model.h"
-
-#include "base/Extents.h"
+#include "NotificationScheduler.h"
 
 #include <QMutex>
-#include <QMutexLocker>
+#include <QElapsedTimer>
+
+#include <vector>
+#include <utility>
+#include <memory>
 
 namespace sv {
 
+/**
+ * Helper for a model to notify changes to its content, either as they
+ * happen (NOTIFY_ALWAYS) or only when the model asks for it, for
+ * example on a completion update (NOTIFY_DEFERRED).
+ *
+ * Changes not yet notified are held as a small set of frame
+ * intervals, merging intervals that overlap or touch and, once there
+ * are MaxIntervals of them, merging the closest pair. A notification
+ * emits modelChangedWithin for each interval and then a single
+ * modelChanged.
+ *
+ * In NOTIFY_ALWAYS mode, changes are notified no more often than the
+ * shared NotificationScheduler allows, with changes that arrive in
+ * between being held and notified together later.
+ *
+ * The owning model must call detach() at the top of its destructor,
+ * so that the scheduler does not later take changes from a notifier
+ * whose model is being destroyed. The scheduler only flushes changes
+ * for a model it can find in ModelById, holding a reference to it
+ * while it notifies; changes to a model that has not been added are
+ * held until the model next notifies by itself.
+ */
 class DeferredNotifier
 {
 public:
@@ -32,8 +57,8 @@ public:
         NOTIFY_DEFERRED
     };
     
-    DeferredNotifier(Model *m, ModelId id, Mode mode) :
-        m_model(m), m_modelId(id), m_mode(mode) { }
+    DeferredNotifier(Model *m, ModelId id, Mode mode);
+    ~DeferredNotifier();
 
     Mode getMode() const {
         return m_mode;
@@ -41,42 +66,55 @@ public:
     void switchMode(Mode newMode) {
         m_mode = newMode;
     }
-    
-    void update(sv_frame_t frame, sv_frame_t duration) {
-        if (m_mode == NOTIFY_ALWAYS) {
-            m_model->modelChangedWithin(m_modelId, frame, frame + duration);
-            m_model->modelChanged(m_modelId);
-        } else {
-            QMutexLocker locker(&m_mutex);
-            m_extents.sample(frame);
-            m_extents.sample(frame + duration);
-        }
-    }
-    
-    void makeDeferredNotifications() {
-        bool shouldEmit = false;
-        sv_frame_t from, to;
-        {   QMutexLocker locker(&m_mutex);
-            if (m_extents.isSet()) {
-                shouldEmit = true;
-                from = m_extents.getMin();
-                to = m_extents.getMax();
-            }
-        }
-        if (shouldEmit) {
-            m_model->modelChangedWithin(m_modelId, from, to);
-            m_model->modelChanged(m_modelId);
-            QMutexLocker locker(&m_mutex);
-            m_extents.reset();
-        }
-    }
+
+    /**
+     * Record a change to the given span of frames, and notify it if
+     * the mode and rate limit allow.
+     */
+    void update(sv_frame_t frame, sv_frame_t duration);
+
+    /**
+     * Return true if there are changes that have not been notified.
+     */
+    bool hasPendingNotifications() const;
+
+    /**
+     * Notify any changes that have not been notified yet.
+     */
+    void makeDeferredNotifications();
+
+    /**
+     * Stop the shared scheduler from notifying any changes on behalf
+     * of this notifier. If the scheduler is taking our pending
+     * changes, wait for it to finish doing so.
+     */
+    void detach();
 
 private:
+    DeferredNotifier(const DeferredNotifier &) =delete;
+    DeferredNotifier &operator=(const DeferredNotifier &) =delete;
+
+    friend class NotificationScheduler;
+    
+    void notify();
+
+    typedef std::vector<std::pair<sv_frame_t, sv_frame_t>> Intervals;
+    void takePending(Intervals &intervals);
+    void unschedule();
+    static void emitChanges(Model *model, ModelId modelId,
+                            const Intervals &intervals);
+    enum { MaxIntervals = 8 };
+    static void addInterval(Intervals &intervals,
+                            sv_frame_t start, sv_frame_t end);
+    
     Model *m_model;
     ModelId m_modelId;
     Mode m_mode;
-    QMutex m_mutex;
-    Extents<sv_frame_t> m_extents;
+    mutable QMutex m_mutex;
+    Intervals m_pending;
+    QElapsedTimer m_sinceNotified;
+    bool m_scheduled;
+    std::shared_ptr<NotificationScheduler::Token> m_token;
 };
 
 } // end namespace sv
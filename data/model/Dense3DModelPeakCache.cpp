@@ -19,13 +19,47 @@
 
 #include "base/HitCount.h"
 
+#include <QThread>
+
+#include <algorithm>
+
 namespace sv {
 
+class Dense3DModelPeakCache::FillThread : public QThread
+{
+public:
+    FillThread(Dense3DModelPeakCache &cache) :
+        m_cache(cache)
+    { }
+
+    void run() override {
+        int level = 0, column = 0;
+        while (m_cache.takeFillWork(level, column)) {
+            Column c;
+            bool complete = false;
+            if (!m_cache.haveColumn(level, column, c, complete)) {
+                m_cache.fillColumn(level, column, c);
+            }
+        }
+    }
+
+private:
+    Dense3DModelPeakCache &m_cache;
+};
+
 Dense3DModelPeakCache::Dense3DModelPeakCache(ModelId sourceId,
-                                             int columnsPerPeak) :
+                                             int columnsPerPeak,
+                                             int levels) :
     m_source(sourceId),
     m_columnsPerPeak(columnsPerPeak),
-    m_finalColumnIncomplete(false)
+    m_levelCount(std::max(1, levels)),
+    m_levels(m_levelCount),
+    m_generation(0),
+    m_fillThread(nullptr),
+    m_fillLevel(0),
+    m_fillNext(0),
+    m_fillEnd(0),
+    m_fillExiting(false)
 {
     auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
     if (!source) {
@@ -40,22 +74,29 @@ Dense3DModelPeakCache::Dense3DModelPeakCache(ModelId sourceId,
 
 Dense3DModelPeakCache::~Dense3DModelPeakCache()
 {
+    if (m_fillThread) {
+        {
+            QMutexLocker locker(&m_fillMutex);
+            m_fillExiting = true;
+            m_fillCondition.wakeAll();
+        }
+        m_fillThread->wait();
+        delete m_fillThread;
+    }
 }
 
 Dense3DModelPeakCache::Column
 Dense3DModelPeakCache::getColumn(int column) const
 {
     Profiler profiler("Dense3DModelPeakCache::getColumn");
-    if (!haveColumn(column)) fillColumn(column);
-    return m_cache.at(column);
+    return getPeakColumn(0, column);
 }
 
 Dense3DModelPeakCache::Column
 Dense3DModelPeakCache::getColumn(int column, int minbin, int nbins) const
 {
     Profiler profiler("Dense3DModelPeakCache::getColumn (subset)");
-    if (!haveColumn(column)) fillColumn(column);
-    const Column &c = m_cache.at(column);
+    Column c = getPeakColumn(0, column);
     return Column(c.data() + minbin, c.data() + minbin + nbins);
 }
 
@@ -63,8 +104,22 @@ float
 Dense3DModelPeakCache::getValueAt(int column, int n) const
 {
     Profiler profiler("Dense3DModelPeakCache::getValueAt");
-    if (!haveColumn(column)) fillColumn(column);
-    return m_cache.at(column).at(n);
+    return getPeakColumn(0, column).at(n);
+}
+
+Dense3DModelPeakCache::Column
+Dense3DModelPeakCache::getPeakColumn(int level, int column) const
+{
+    if (level < 0 || level >= m_levelCount || column < 0) {
+        return {};
+    }
+    
+    Column c;
+    bool complete = false;
+    if (!haveColumn(level, column, c, complete)) {
+        fillColumn(level, column, c);
+    }
+    return c;
 }
 
 QString
@@ -75,23 +130,78 @@ Dense3DModelPeakCache::getValueUnit() const
     else return "";
 }
 
+void
+Dense3DModelPeakCache::prefetch(int level, int col0, int col1)
+{
+    if (level < 0 || level >= m_levelCount || col1 < col0) {
+        return;
+    }
+
+    int end = std::min(col1 + 1 + (col1 - col0 + 1), getWidth(level));
+    
+    QMutexLocker locker(&m_fillMutex);
+
+    m_fillLevel = level;
+    m_fillNext = std::max(col0, 0);
+    m_fillEnd = end;
+
+    if (!m_fillThread) {
+        m_fillThread = new FillThread(*this);
+        m_fillThread->start();
+    }
+
+    m_fillCondition.wakeAll();
+}
+
+bool
+Dense3DModelPeakCache::takeFillWork(int &level, int &column)
+{
+    QMutexLocker locker(&m_fillMutex);
+
+    while (!m_fillExiting && m_fillNext >= m_fillEnd) {
+        m_fillCondition.wait(&m_fillMutex);
+    }
+
+    if (m_fillExiting) {
+        return false;
+    }
+
+    level = m_fillLevel;
+    column = m_fillNext++;
+    return true;
+}
+
 void
 Dense3DModelPeakCache::sourceModelChanged(ModelId)
 {
-    if (m_finalColumnIncomplete && m_coverage.size() > 0) {
-        // The last peak came from an incomplete read, which may since
-        // have been filled, so reset it
-        m_coverage[m_coverage.size()-1] = false;
-        m_finalColumnIncomplete = false;
+    QMutexLocker locker(&m_mutex);
+
+    // Peaks that came from an incomplete read may since have been
+    // filled, so reset them
+    for (auto &level: m_levels) {
+        for (int column: level.incomplete) {
+            level.coverage[column] = false;
+        }
+        level.incomplete.clear();
     }
+
+    ++m_generation;
 }
 
 bool
-Dense3DModelPeakCache::haveColumn(int column) const
+Dense3DModelPeakCache::haveColumn(int level, int column,
+                                  Column &c, bool &complete) const
 {
     static HitCount count("Dense3DModelPeakCache");
-    if (in_range_for(m_coverage, column) && m_coverage[column]) {
+
+    QMutexLocker locker(&m_mutex);
+    
+    const Level &l = m_levels[level];
+    if (in_range_for(l.coverage, column) && l.coverage[column]) {
         count.hit();
+        c = l.cache[column];
+        complete = (std::find(l.incomplete.begin(), l.incomplete.end(),
+                              column) == l.incomplete.end());
         return true;
     } else {
         count.miss();
@@ -99,55 +209,108 @@ Dense3DModelPeakCache::haveColumn(int column) const
     }
 }
 
-void
-Dense3DModelPeakCache::fillColumn(int column) const
+bool
+Dense3DModelPeakCache::fillColumn(int level, int column, Column &peak) const
 {
+    // Called without the mutex held, so that readers of other
+    // columns are not held up while this one is calculated. Two
+    // threads may occasionally calculate the same column at once,
+    // which is harmless, as both will get the same result.
+    
     Profiler profiler("Dense3DModelPeakCache::fillColumn");
 
-    if (!in_range_for(m_coverage, column)) {
-        if (m_finalColumnIncomplete && m_coverage.size() > 0) {
-            // The last peak may have come from an incomplete read, which
-            // may since have been filled, so reset it
-            m_coverage[m_coverage.size()-1] = false;
-            m_finalColumnIncomplete = false;
-        }
-        m_coverage.resize(column + 1, false);
-        m_cache.resize(column + 1, {});
-    }
-    
-    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
-    if (!source) {
-        return;
-    }
-    
-    int sourceWidth = source->getWidth();
-    int sourceColumn = column * m_columnsPerPeak;
-    if (sourceColumn >= sourceWidth) {
-        return;
+    int generation = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        generation = m_generation;
     }
 
-    Column peak = source->getColumn(sourceColumn);
-    int n = int(peak.size());
-    
-    for (int i = 1; i < m_columnsPerPeak; ++i) {
+    peak = {};
+    bool complete = true;
+
+    if (level > 0) {
 
-        ++sourceColumn;
+        // Build from the two columns of the next finer level
+
+        Column second;
+        bool firstComplete = false, secondComplete = false;
+        
+        if (!haveColumn(level - 1, column * 2, peak, firstComplete)) {
+            firstComplete = fillColumn(level - 1, column * 2, peak);
+        }
+        if (peak.empty()) {
+            return false;
+        }
+        if (!haveColumn(level - 1, column * 2 + 1, second, secondComplete)) {
+            secondComplete = fillColumn(level - 1, column * 2 + 1, second);
+        }
+
+        int m = std::min(int(peak.size()), int(second.size()));
+        for (int j = 0; j < m; ++j) {
+            peak[j] = std::max(second[j], peak[j]);
+        }
+
+        complete = firstComplete && secondComplete;
+        
+    } else {
+
+        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        if (!source) {
+            return false;
+        }
+    
+        int sourceWidth = source->getWidth();
+        int sourceColumn = column * m_columnsPerPeak;
         if (sourceColumn >= sourceWidth) {
-            m_finalColumnIncomplete = true;
-            break;
+            return false;
         }
+
+        peak = source->getColumn(sourceColumn);
+        int n = int(peak.size());
+    
+        for (int i = 1; i < m_columnsPerPeak; ++i) {
+
+            ++sourceColumn;
+            if (sourceColumn >= sourceWidth) {
+                complete = false;
+                break;
+            }
         
-        Column here = source->getColumn(sourceColumn);
-        int m = std::min(n, int(here.size()));
-        for (int j = 0; j < m; ++j) {
-            peak[j] = std::max(here[j], peak[j]);
+            Column here = source->getColumn(sourceColumn);
+            int m = std::min(n, int(here.size()));
+            for (int j = 0; j < m; ++j) {
+                peak[j] = std::max(here[j], peak[j]);
+            }
         }
     }
 
-    m_cache[column] = peak;
-    m_coverage[column] = true;
+    QMutexLocker locker(&m_mutex);
+
+    if (!complete && generation != m_generation) {
+        // The source has changed since we read from it, so this
+        // column is already out of date
+        return false;
+    }
+
+    Level &l = m_levels[level];
+    
+    if (!in_range_for(l.coverage, column)) {
+        l.coverage.resize(column + 1, false);
+        l.cache.resize(column + 1, {});
+    }
+
+    l.cache[column] = peak;
+    l.coverage[column] = true;
+
+    auto itr = std::find(l.incomplete.begin(), l.incomplete.end(), column);
+    if (!complete && itr == l.incomplete.end()) {
+        l.incomplete.push_back(column);
+    } else if (complete && itr != l.incomplete.end()) {
+        l.incomplete.erase(itr);
+    }
+    
+    return complete;
 }
 
 
 } // end namespace sv
-
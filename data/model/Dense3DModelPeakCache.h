@@ -19,6 +19,9 @@
 #include "DenseThreeDimensionalModel.h"
 #include "EditableDenseThreeDimensionalModel.h"
 
+#include <QMutex>
+#include <QWaitCondition>
+
 namespace sv {
 
 /**
@@ -28,15 +31,30 @@ namespace sv {
  * the source. Each column is populated from the source model when
  * first requested, and is returned from cache on subsequent requests.
  *
- * Dense3DModelPeakCache is not thread-safe.
+ * The cache may hold more than one level of reduction. Level 0 has
+ * getColumnsPerPeak() source columns per peak, and is the level
+ * presented through the DenseThreeDimensionalModel API; each further
+ * level has twice as many source columns per peak as the one before
+ * it, and is built from pairs of columns at that level rather than
+ * from the source. Columns at any level may also be filled ahead of
+ * time on a background thread: see prefetch().
+ *
+ * Dense3DModelPeakCache is thread-safe, provided the source model is.
  */
 class Dense3DModelPeakCache : public DenseThreeDimensionalModel
 {
     Q_OBJECT
 
 public:
-    Dense3DModelPeakCache(ModelId source, // a DenseThreeDimensionalModel
-                          int columnsPerPeak);
+    /**
+     * Construct a peak cache for the given source, which must be a
+     * DenseThreeDimensionalModel, with the given number of source
+     * columns per peak at level 0 and the given number of levels in
+     * total.
+     */
+    Dense3DModelPeakCache(ModelId source,
+                          int columnsPerPeak,
+                          int levels = 1);
     ~Dense3DModelPeakCache();
 
     bool isOK() const override {
@@ -67,15 +85,35 @@ public:
     virtual int getColumnsPerPeak() const {
         return m_columnsPerPeak;
     }
-    
+
     int getWidth() const override {
+        return getWidth(0);
+    }
+
+    int getLevelCount() const {
+        return m_levelCount;
+    }
+
+    /**
+     * Return the number of source columns per peak at the given
+     * level, that is, getColumnsPerPeak() * 2^level.
+     */
+    int getColumnsPerPeak(int level) const {
+        return m_columnsPerPeak << level;
+    }
+
+    /**
+     * Return the number of peak columns at the given level.
+     */
+    int getWidth(int level) const {
         auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
         if (!source) return 0;
         int sourceWidth = source->getWidth();
-        if ((sourceWidth % m_columnsPerPeak) == 0) {
-            return sourceWidth / m_columnsPerPeak;
+        int cpp = getColumnsPerPeak(level);
+        if ((sourceWidth % cpp) == 0) {
+            return sourceWidth / cpp;
         } else {
-            return sourceWidth / m_columnsPerPeak + 1;
+            return sourceWidth / cpp + 1;
         }
     }
 
@@ -112,6 +150,23 @@ public:
     
     float getValueAt(int col, int n) const override;
 
+    /**
+     * Retrieve the peaks column at column number col of the given
+     * level. This will consist of the peak values in the underlying
+     * model from columns (col * getColumnsPerPeak(level)) to ((col+1)
+     * * getColumnsPerPeak(level) - 1) inclusive.
+     */
+    Column getPeakColumn(int level, int col) const;
+
+    /**
+     * Ask the background fill thread to fill the columns from col0 to
+     * col1 inclusive at the given level (for example those visible
+     * in a view), followed by as many again after col1, in
+     * anticipation of the view scrolling on. This replaces any
+     * previous request. Returns immediately.
+     */
+    void prefetch(int level, int col0, int col1);
+
     QString getValueUnit() const override;
 
     QString getBinName(int n) const override {
@@ -147,14 +202,35 @@ protected slots:
 private:
     ModelId m_source;
     int m_columnsPerPeak;
-
-    mutable std::vector<Column> m_cache;
-    mutable std::vector<bool> m_coverage; // bool for space efficiency
-                                          // (vector of bool is a bitmap)
-    mutable bool m_finalColumnIncomplete;
-
-    bool haveColumn(int column) const;
-    void fillColumn(int column) const;
+    int m_levelCount;
+
+    struct Level {
+        std::vector<Column> cache;
+        std::vector<bool> coverage; // bool for space efficiency
+                                    // (vector of bool is a bitmap)
+        // Columns that were read while the end of the source range
+        // they cover was not yet available, and that must be read
+        // again if the source changes
+        std::vector<int> incomplete;
+    };
+
+    mutable QMutex m_mutex; // for m_levels
+    mutable std::vector<Level> m_levels;
+    int m_generation; // incremented when the source changes
+
+    class FillThread;
+    FillThread *m_fillThread;
+    QMutex m_fillMutex;
+    QWaitCondition m_fillCondition;
+    int m_fillLevel;
+    int m_fillNext;
+    int m_fillEnd;
+    bool m_fillExiting;
+
+    bool takeFillWork(int &level, int &column);
+
+    bool haveColumn(int level, int column, Column &c, bool &complete) const;
+    bool fillColumn(int level, int column, Column &c) const;
 };
 
 
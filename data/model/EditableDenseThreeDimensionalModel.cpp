@@ -43,13 +43,20 @@ EditableDenseThreeDimensionalModel::EditableDenseThreeDimensionalModel(sv_sample
     m_minimum(0.0),
     m_maximum(0.0),
     m_haveExtents(false),
-    m_notifyOnAdd(notifyOnAdd),
-    m_sinceLastNotifyMin(-1),
-    m_sinceLastNotifyMax(-1),
+    m_notifier(this,
+               getId(),
+               notifyOnAdd ?
+               DeferredNotifier::NOTIFY_ALWAYS :
+               DeferredNotifier::NOTIFY_DEFERRED),
     m_completion(100)
 {
 }    
 
+EditableDenseThreeDimensionalModel::~EditableDenseThreeDimensionalModel()
+{
+    m_notifier.detach();
+}
+
 bool
 EditableDenseThreeDimensionalModel::isOK() const
 {
@@ -84,7 +91,7 @@ EditableDenseThreeDimensionalModel::setStartFrame(sv_frame_t f)
 sv_frame_t
 EditableDenseThreeDimensionalModel::getTrueEndFrame() const
 {
-    return m_resolution * m_data.size() + (m_resolution - 1);
+    return sv_frame_t(m_resolution) * m_data.size() + (m_resolution - 1);
 }
 
 int
@@ -102,7 +109,7 @@ EditableDenseThreeDimensionalModel::setResolution(int sz)
 int
 EditableDenseThreeDimensionalModel::getWidth() const
 {
-    return int(m_data.size());
+    return m_data.size();
 }
 
 int
@@ -145,10 +152,10 @@ EditableDenseThreeDimensionalModel::Column
 EditableDenseThreeDimensionalModel::getColumn(int index) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_data, index)) {
+    if (index < 0 || index >= m_data.size()) {
         return {};
     }
-    Column c = m_data.at(index);
+    Column c = m_data.get(index);
     if (int(c.size()) == m_yBinCount) {
         return c;
     } else {
@@ -162,7 +169,7 @@ EditableDenseThreeDimensionalModel::Column
 EditableDenseThreeDimensionalModel::getColumn(int index, int minbin, int nbins) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_data, index)) {
+    if (index < 0 || index >= m_data.size()) {
         return {};
     }
     const Column &c = m_data.at(index);
@@ -182,7 +189,7 @@ float
 EditableDenseThreeDimensionalModel::getValueAt(int index, int n) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_data, index)) {
+    if (index < 0 || index >= m_data.size()) {
         return m_minimum;
     }
     const Column &c = m_data.at(index);
@@ -215,10 +222,6 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
     {
         QMutexLocker locker(&m_mutex);
 
-        while (index >= int(m_data.size())) {
-            m_data.push_back(Column());
-        }
-
         for (int i = 0; in_range_for(values, i); ++i) {
             float value = values[i];
             if (std::isnan(value) || std::isinf(value)) {
@@ -235,34 +238,13 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
             m_haveExtents = true;
         }
 
-        m_data[index] = values;
-
-        if (allChange) {
-            m_sinceLastNotifyMin = -1;
-            m_sinceLastNotifyMax = -1;
-        } else {
-            if (m_sinceLastNotifyMin == -1 ||
-                windowStart < m_sinceLastNotifyMin) {
-                m_sinceLastNotifyMin = windowStart;
-            }
-            if (m_sinceLastNotifyMax == -1 ||
-                windowStart > m_sinceLastNotifyMax) {
-                m_sinceLastNotifyMax = windowStart;
-            }
-        }
+        m_data.set(index, values);
     }
 
-    if (m_notifyOnAdd) {
-        if (allChange) {
-            emit modelChanged(getId());
-        } else {
-            emit modelChangedWithin(getId(),
-                                    windowStart, windowStart + m_resolution);
-        }
+    if (allChange) {
+        emit modelChanged(getId());
     } else {
-        if (allChange) {
-            emit modelChanged(getId());
-        }
+        m_notifier.update(windowStart, m_resolution);
     }
 }
 
@@ -329,7 +311,7 @@ EditableDenseThreeDimensionalModel::shouldUseLogValueScale() const
     
     for (int i = 0; i < 10; ++i) {
         int index = i * 10;
-        if (in_range_for(m_data, index)) {
+        if (index < m_data.size()) {
             const Column &c = m_data.at(index);
             while (c.size() > sample.size()) {
                 sample.push_back(0.0);
@@ -358,19 +340,15 @@ EditableDenseThreeDimensionalModel::setCompletion(int completion, bool update)
 
         if (completion == 100) {
 
-            m_notifyOnAdd = true; // henceforth
+            // henceforth:
+            m_notifier.switchMode(DeferredNotifier::NOTIFY_ALWAYS);
             emit modelChanged(getId());
             emit ready(getId());
 
-        } else if (!m_notifyOnAdd) {
+        } else if (m_notifier.getMode() == DeferredNotifier::NOTIFY_DEFERRED) {
 
-            if (update &&
-                m_sinceLastNotifyMin >= 0 &&
-                m_sinceLastNotifyMax >= 0) {
-                emit modelChangedWithin(getId(),
-                                        m_sinceLastNotifyMin,
-                                        m_sinceLastNotifyMax + m_resolution);
-                m_sinceLastNotifyMin = m_sinceLastNotifyMax = -1;
+            if (update && m_notifier.hasPendingNotifications()) {
+                m_notifier.makeDeferredNotifications();
             } else {
                 emit completionChanged(getId());
             }
@@ -407,12 +385,13 @@ EditableDenseThreeDimensionalModel::toStringExportRows(DataExportOptions,
 
     QVector<QVector<QString>> rows;
 
-    for (int i = 0; in_range_for(m_data, i); ++i) {
+    for (int i = 0; i < m_data.size(); ++i) {
         sv_frame_t fr = m_startFrame + i * m_resolution;
         if (fr >= startFrame && fr < startFrame + duration) {
             QVector<QString> row;
-            for (int j = 0; in_range_for(m_data.at(i), j); ++j) {
-                row.push_back(QString("%1").arg(m_data.at(i).at(j)));
+            const Column &c = m_data.at(i);
+            for (int j = 0; in_range_for(c, j); ++j) {
+                row.push_back(QString("%1").arg(c.at(j)));
             }
             rows.push_back(row);
         }
@@ -458,8 +437,10 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
         }
     }
 
-    for (int i = 0; in_range_for(m_data, i); ++i) {
-        Column c = getColumn(i);
+    for (int i = 0; i < m_data.size(); ++i) {
+        // Not getColumn(), as we already hold the mutex
+        Column c = m_data.get(i);
+        c.resize(m_yBinCount, 0.f);
         out << indent + "  ";
         out << QString("<row n=\"%1\">").arg(i);
         for (int j = 0; in_range_for(c, j); ++j) {
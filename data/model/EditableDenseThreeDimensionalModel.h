@@ -17,6 +17,8 @@
 #define SV_EDITABLE_DENSE_THREE_DIMENSIONAL_MODEL_H
 
 #include "DenseThreeDimensionalModel.h"
+#include "DeferredNotifier.h"
+#include "CompressedColumnStore.h"
 
 #include <QMutex>
 
@@ -34,6 +36,8 @@ public:
                                        int height,
                                        bool notifyOnAdd = true);
 
+    virtual ~EditableDenseThreeDimensionalModel();
+
     bool isOK() const override;
     bool isReady(int *completion = 0) const override;
     void setCompletion(int completion, bool update = true);
@@ -205,8 +209,7 @@ public:
                        QString extraAttributes = "") const override;
 
 protected:
-    typedef std::vector<Column> ValueMatrix;
-    ValueMatrix m_data;
+    CompressedColumnStore m_data;
     QString m_unit;
 
     std::vector<QString> m_binNames;
@@ -220,9 +223,7 @@ protected:
     float m_minimum;
     float m_maximum;
     bool m_haveExtents;
-    bool m_notifyOnAdd;
-    sv_frame_t m_sinceLastNotifyMin;
-    sv_frame_t m_sinceLastNotifyMax;
+    DeferredNotifier m_notifier;
     int m_completion;
 
     mutable QMutex m_mutex;
@@ -31,6 +31,19 @@ public:
     virtual ~EventEditable() { }
     virtual void add(Event e) = 0;
     virtual void remove(Event e) = 0;
+
+    /**
+     * Add all of the given events, which need not be in any
+     * particular order. Models that can do this more efficiently
+     * than by adding the events one at a time (typically by using
+     * EventSeries::addAll) override it; loaders should use it when
+     * they have many events to add.
+     */
+    virtual void addAll(const EventVector &ee) {
+        for (const auto &e: ee) {
+            add(e);
+        }
+    }
 };
 
 class WithEditable
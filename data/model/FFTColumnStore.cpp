@@ -0,0 +1,233 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FFTColumnStore.h"
+
+#include "base/TempDirectory.h"
+#include "base/Exceptions.h"
+#include "base/Debug.h"
+#include "base/BaseTypes.h"
+
+#include <bqvec/VectorOps.h>
+#include <bqvec/VectorOpsComplex.h>
+
+#include <QDir>
+
+#include <algorithm>
+
+//#define DEBUG_FFT_COLUMN_STORE 1
+
+namespace sv {
+
+// Aim for tiles of about 4MB, so that mapping is infrequent but the
+// file does not grow in excessively large steps
+static const qint64 targetTileBytes = 4 * 1024 * 1024;
+
+static int
+tileColumnsFor(int floatsPerColumn)
+{
+    qint64 columnBytes = qint64(floatsPerColumn) * sizeof(float);
+    return int(std::max(qint64(16), targetTileBytes / columnBytes));
+}
+
+FFTColumnStore::FFTColumnStore(Format format, int height, qint64 maxBytes) :
+    m_format(format),
+    m_height(height),
+    m_floatsPerColumn(format == ComplexFormat ? height * 2 : height),
+    m_tileColumns(tileColumnsFor(m_floatsPerColumn)),
+    m_tileBytes(qint64(m_tileColumns) * m_floatsPerColumn * sizeof(float)),
+    m_maxTiles(maxBytes > 0 ? int(maxBytes / m_tileBytes) : -1),
+    m_columnCount(0)
+{
+    QDir dir(TempDirectory::getInstance()->getPath());
+    m_fileName = dir.filePath(QString("fft_%1.dat").arg((intptr_t)this));
+    m_file.setFileName(m_fileName);
+
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        SVCERR << "ERROR: FFTColumnStore: Failed to open backing file \""
+               << m_fileName << "\": " << m_file.errorString() << endl;
+        throw FileOperationFailed(m_fileName, "open");
+    }
+
+    SVDEBUG << "FFTColumnStore: created store with format "
+            << (format == ComplexFormat ? "complex" : "magnitude")
+            << ", height " << height << ", " << m_tileColumns
+            << " columns per tile, in file \"" << m_fileName << "\"" << endl;
+}
+
+FFTColumnStore::~FFTColumnStore()
+{
+    for (auto &t: m_tiles) {
+        if (t && t->data) {
+            m_file.unmap(reinterpret_cast<uchar *>(t->data));
+        }
+    }
+    m_file.close();
+    if (!QFile::remove(m_fileName)) {
+        SVDEBUG << "WARNING: FFTColumnStore::~FFTColumnStore: Failed to "
+                << "delete backing file \"" << m_fileName << "\"" << endl;
+    }
+}
+
+size_t
+FFTColumnStore::getSizeEstimateKB(Format format, int height, int width)
+{
+    size_t floatsPerColumn = (format == ComplexFormat ? height * 2 : height);
+    return (size_t(width) * floatsPerColumn * sizeof(float)) / 1024;
+}
+
+FFTColumnStore::Tile *
+FFTColumnStore::getTile(int tileIndex, bool create)
+{
+    // Called with m_mutex held
+
+    if (tileIndex < 0) return nullptr;
+
+    if (!in_range_for(m_tiles, tileIndex)) {
+        if (!create) return nullptr;
+        m_tiles.resize(tileIndex + 1);
+    }
+
+    if (m_tiles[tileIndex] || !create) {
+        return m_tiles[tileIndex].get();
+    }
+
+    if (m_maxTiles >= 0 && tileIndex >= m_maxTiles) {
+#ifdef DEBUG_FFT_COLUMN_STORE
+        SVDEBUG << "FFTColumnStore: Not mapping tile " << tileIndex
+                << ", as the store is limited to " << m_maxTiles
+                << " tile(s)" << endl;
+#endif
+        return nullptr;
+    }
+
+    qint64 offset = qint64(tileIndex) * m_tileBytes;
+    if (m_file.size() < offset + m_tileBytes) {
+        if (!m_file.resize(offset + m_tileBytes)) {
+            SVCERR << "ERROR: FFTColumnStore: Failed to extend backing file \""
+                   << m_fileName << "\" to " << offset + m_tileBytes
+                   << " bytes: " << m_file.errorString() << endl;
+            return nullptr;
+        }
+    }
+
+    uchar *mapped = m_file.map(offset, m_tileBytes);
+    if (!mapped) {
+        SVCERR << "ERROR: FFTColumnStore: Failed to map tile " << tileIndex
+               << " of backing file \"" << m_fileName << "\": "
+               << m_file.errorString() << endl;
+        return nullptr;
+    }
+
+#ifdef DEBUG_FFT_COLUMN_STORE
+    SVDEBUG << "FFTColumnStore: mapped tile " << tileIndex << " at offset "
+            << offset << endl;
+#endif
+
+    auto tile = std::make_unique<Tile>();
+    tile->data = reinterpret_cast<float *>(mapped);
+    tile->state.reset(new std::atomic<int>[m_tileColumns]);
+    for (int i = 0; i < m_tileColumns; ++i) {
+        tile->state[i] = ColumnAbsent;
+    }
+
+    m_tiles[tileIndex] = std::move(tile);
+    return m_tiles[tileIndex].get();
+}
+
+const float *
+FFTColumnStore::getColumnData(int x) const
+{
+    if (x < 0) return nullptr;
+
+    const Tile *tile = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        int tileIndex = x / m_tileColumns;
+        if (!in_range_for(m_tiles, tileIndex)) return nullptr;
+        tile = m_tiles[tileIndex].get();
+    }
+
+    // Tiles are never unmapped or replaced until the store is
+    // destroyed, so it's safe to use one outside the mutex
+
+    if (!tile) return nullptr;
+    int index = x % m_tileColumns;
+    if (tile->state[index].load(std::memory_order_acquire) != ColumnPresent) {
+        return nullptr;
+    }
+    return tile->data + qint64(index) * m_floatsPerColumn;
+}
+
+bool
+FFTColumnStore::haveColumn(int x) const
+{
+    return getColumnData(x) != nullptr;
+}
+
+bool
+FFTColumnStore::setColumn(int x, const float *values)
+{
+    if (x < 0) return false;
+
+    Tile *tile = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        tile = getTile(x / m_tileColumns, true);
+    }
+    if (!tile) return false;
+
+    int index = x % m_tileColumns;
+    int expected = ColumnAbsent;
+    if (!tile->state[index].compare_exchange_strong
+        (expected, ColumnWriting, std::memory_order_acq_rel)) {
+        return true;
+    }
+
+    breakfastquay::v_copy(tile->data + qint64(index) * m_floatsPerColumn,
+                          values, m_floatsPerColumn);
+
+    tile->state[index].store(ColumnPresent, std::memory_order_release);
+    ++m_columnCount;
+    return true;
+}
+
+bool
+FFTColumnStore::getMagnitudes(int x, float *values, int minbin, int count) const
+{
+    const float *data = getColumnData(x);
+    if (!data) return false;
+
+    if (m_format == ComplexFormat) {
+        breakfastquay::v_cartesian_interleaved_to_magnitudes
+            (values, data + minbin * 2, count);
+    } else {
+        breakfastquay::v_copy(values, data + minbin, count);
+    }
+    return true;
+}
+
+bool
+FFTColumnStore::getComplex(int x, float *values, int minbin, int count) const
+{
+    if (m_format != ComplexFormat) return false;
+
+    const float *data = getColumnData(x);
+    if (!data) return false;
+
+    breakfastquay::v_copy(values, data + minbin * 2, count * 2);
+    return true;
+}
+
+} // end namespace sv
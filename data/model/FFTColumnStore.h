@@ -0,0 +1,140 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_FFT_COLUMN_STORE_H
+#define SV_FFT_COLUMN_STORE_H
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+
+#include <vector>
+#include <atomic>
+#include <memory>
+
+namespace sv {
+
+/**
+ * A write-once store for FFT output columns of fixed height, held in
+ * a memory-mapped file in the TempDirectory. The store is divided
+ * into tiles of a fixed number of columns, each of which is mapped
+ * when the first column in it is written, so the store grows with
+ * the model it caches and the file is never larger than the span of
+ * columns actually calculated.
+ *
+ * Columns may be stored either as magnitudes only (one float per
+ * bin) or as complex values (an interleaved real/imaginary pair of
+ * floats per bin).
+ *
+ * The store may be read and written from any number of threads at
+ * once. Each column is claimed by the first thread to write it, and
+ * becomes visible to readers only once it has been completely
+ * written.
+ */
+class FFTColumnStore
+{
+public:
+    enum Format {
+        MagnitudeFormat,
+        ComplexFormat
+    };
+
+    /**
+     * Create a store of the given format for columns of the given
+     * height. If maxBytes is non-zero, the backing file will not be
+     * extended to more than that many bytes, and columns that do not
+     * fit will not be stored. Throws FileOperationFailed or
+     * DirectoryCreationFailed if the backing file cannot be created.
+     */
+    FFTColumnStore(Format format, int height, qint64 maxBytes = 0);
+    ~FFTColumnStore();
+
+    Format getFormat() const { return m_format; }
+    int getHeight() const { return m_height; }
+
+    /**
+     * Return true if the given column has been written.
+     */
+    bool haveColumn(int x) const;
+
+    /**
+     * Return the number of columns that have been written.
+     */
+    int getColumnCount() const { return m_columnCount; }
+
+    /**
+     * Write a column. The values array must contain getHeight()
+     * floats in MagnitudeFormat or 2 * getHeight() interleaved floats
+     * in ComplexFormat. Return false if the column could not be
+     * written, e.g. because a tile could not be mapped. Writing a
+     * column that is already present, or is being written by another
+     * thread, has no effect.
+     */
+    bool setColumn(int x, const float *values);
+
+    /**
+     * Retrieve the magnitudes of count bins starting at minbin from
+     * the given column, converting from complex values if necessary.
+     * Return false if the column is not present.
+     */
+    bool getMagnitudes(int x, float *values, int minbin, int count) const;
+
+    /**
+     * Retrieve count interleaved complex values starting at minbin
+     * from the given column. Return false if the column is not
+     * present or the store is in MagnitudeFormat.
+     */
+    bool getComplex(int x, float *values, int minbin, int count) const;
+
+    /**
+     * Return the approximate size in kilobytes of a store of the
+     * given format holding the given number of columns.
+     */
+    static size_t getSizeEstimateKB(Format format, int height, int width);
+
+private:
+    FFTColumnStore(const FFTColumnStore &) =delete;
+    FFTColumnStore &operator=(const FFTColumnStore &) =delete;
+
+    enum ColumnState {
+        ColumnAbsent = 0,
+        ColumnWriting = 1,
+        ColumnPresent = 2
+    };
+    
+    struct Tile {
+        float *data;
+        std::unique_ptr<std::atomic<int>[]> state;
+    };
+
+    const Format m_format;
+    const int m_height;
+    const int m_floatsPerColumn;
+    const int m_tileColumns;
+    const qint64 m_tileBytes;
+    const int m_maxTiles; // or -1 for no limit
+
+    QString m_fileName;
+    QFile m_file;
+    std::vector<std::unique_ptr<Tile>> m_tiles;
+    std::atomic<int> m_columnCount;
+    mutable QMutex m_mutex;
+
+    const float *getColumnData(int x) const;
+    Tile *getTile(int tileIndex, bool create);
+};
+
+} // end namespace sv
+
+#endif
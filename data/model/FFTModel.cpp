@@ -21,9 +21,15 @@
 #include "base/HitCount.h"
 #include "base/Debug.h"
 #include "base/MovingMedian.h"
+#include "base/StorageAdviser.h"
+#include "base/Preferences.h"
+#include "base/Exceptions.h"
 
+#include "bqvec/VectorOps.h"
 #include "bqvec/VectorOpsComplex.h"
 
+#include <QThread>
+
 #include <algorithm>
 
 #include <cassert>
@@ -37,13 +43,226 @@ namespace sv {
 
 static HitCount inSmallCache("FFTModel: Small FFT cache");
 static HitCount inSourceCache("FFTModel: Source data cache");
+static HitCount inColumnStore("FFTModel: Persistent column store");
+
+class FFTModel::ColumnCalculator
+{
+public:
+    ColumnCalculator(const FFTModel &model) :
+        m_model(model),
+        m_sourceModel(model.m_model),
+        m_windowSize(model.m_windowSize),
+        m_fftSize(model.m_fftSize),
+        m_precision(model.m_precision),
+        m_fft(model.m_fftSize),
+        m_floatSamples(nullptr),
+        m_doubleSamples(nullptr),
+        m_doubleOut(nullptr),
+        m_readAhead(std::max(model.m_windowSize,
+                             std::min(model.m_windowIncrement * 32, 65536))),
+        m_capacity(model.m_windowSize + m_readAhead),
+        m_source(breakfastquay::allocate_and_zero<float>(m_capacity)),
+        m_start(0),
+        m_end(0),
+        m_generation(-1) {
+        if (m_precision == SinglePrecision) {
+            m_floatWindower.reset
+                (new Window<float>(model.m_windowType, m_windowSize));
+            m_floatSamples = breakfastquay::allocate_and_zero<float>(m_fftSize);
+            m_fft.initFloat();
+        } else {
+            m_doubleWindower.reset
+                (new Window<double>(model.m_windowType, m_windowSize));
+            m_doubleSamples = breakfastquay::allocate_and_zero<double>(m_fftSize);
+            m_doubleOut = breakfastquay::allocate_and_zero<double>
+                ((m_fftSize / 2 + 1) * 2);
+            m_fft.initDouble();
+        }
+    }
+
+    ~ColumnCalculator() {
+        breakfastquay::deallocate(m_floatSamples);
+        breakfastquay::deallocate(m_doubleSamples);
+        breakfastquay::deallocate(m_doubleOut);
+        breakfastquay::deallocate(m_source);
+    }
+
+    /**
+     * Window and transform the source samples for the given column,
+     * zero-padding either side to the FFT size, and write
+     * fftSize/2+1 interleaved complex values to out. The samples are
+     * windowed directly from the source window, in two parts if the
+     * column wraps around the end of it.
+     */
+    void calculate(int column, float *out) {
+
+        auto range = m_model.getSourceSampleRange(column);
+        int ix = prepareSource(range.first, range.second);
+        int n0 = std::min(m_windowSize, m_capacity - ix);
+        int n1 = m_windowSize - n0;
+        int off = (m_fftSize - m_windowSize) / 2;
+        
+        if (m_precision == SinglePrecision) {
+            breakfastquay::v_zero(m_floatSamples, m_fftSize);
+            m_floatWindower->cut(m_source + ix, m_floatSamples + off, 0, n0);
+            if (n1 > 0) {
+                m_floatWindower->cut(m_source, m_floatSamples + off + n0,
+                                     n0, n1);
+            }
+            breakfastquay::v_fftshift(m_floatSamples, m_fftSize);
+            m_fft.forwardInterleaved(m_floatSamples, out);
+        } else {
+            breakfastquay::v_zero(m_doubleSamples, m_fftSize);
+            breakfastquay::v_convert(m_doubleSamples + off, m_source + ix, n0);
+            if (n1 > 0) {
+                breakfastquay::v_convert(m_doubleSamples + off + n0,
+                                         m_source, n1);
+            }
+            m_doubleWindower->cut(m_doubleSamples + off);
+            breakfastquay::v_fftshift(m_doubleSamples, m_fftSize);
+            m_fft.forwardInterleaved(m_doubleSamples, m_doubleOut);
+            breakfastquay::v_convert(out, m_doubleOut, (m_fftSize / 2 + 1) * 2);
+        }
+    }
+
+private:
+    ColumnCalculator(const ColumnCalculator &) =delete;
+    ColumnCalculator &operator=(const ColumnCalculator &) =delete;
+
+    /**
+     * Ensure the source window contains the frames from "from" to
+     * "to", and return the index in m_source of the first of them.
+     *
+     * The source window is a ring buffer of m_capacity frames,
+     * holding source frames m_start to m_end, with frame f found at
+     * index f modulo m_capacity. When reading consecutive columns
+     * we read ahead by m_readAhead frames at a time and each source
+     * frame is copied into the window exactly once. For a column
+     * that doesn't follow on from the last one we start again and
+     * read only what that column needs.
+     */
+    int prepareSource(sv_frame_t from, sv_frame_t to) {
+
+        int generation = m_model.m_sourceGeneration;
+        
+        if (generation != m_generation || from < m_start || from > m_end) {
+            inSourceCache.miss();
+            m_generation = generation;
+            m_start = m_end = from;
+            readSource(to);
+        } else if (to > m_end) {
+            inSourceCache.partial();
+            readSource(std::min(to + m_readAhead, from + m_capacity));
+        } else {
+            inSourceCache.hit();
+        }
+
+        if (m_end - m_start > m_capacity) {
+            m_start = m_end - m_capacity;
+        }
+
+#ifdef DEBUG_FFT_MODEL
+        SVDEBUG << "FFTModel::ColumnCalculator::prepareSource(" << from << ","
+                << to << "): window now holds (" << m_start << "," << m_end
+                << ")" << endl;
+#endif
+        
+        return ringIndex(from);
+    }
+
+    void readSource(sv_frame_t to) {
+
+        Profiler profiler("FFTModel::ColumnCalculator::readSource");
+
+        // frames before the start of the source are silent
+        if (m_end < 0) {
+            append(nullptr, std::min(to, sv_frame_t(0)) - m_end);
+        }
+
+        if (m_end < to) {
+            floatvec_t data;
+            if (auto model = m_sourceModel.get()) {
+                data = m_model.getSourceSamples(*model, m_end, to - m_end);
+            }
+            append(data.data(), std::min(sv_frame_t(data.size()), to - m_end));
+            // and so are frames after the end
+            append(nullptr, to - m_end);
+        }
+    }
+
+    void append(const float *data, sv_frame_t count) {
+        while (count > 0) {
+            int ix = ringIndex(m_end);
+            int n = int(std::min(count, sv_frame_t(m_capacity - ix)));
+            if (data) {
+                breakfastquay::v_copy(m_source + ix, data, n);
+                data += n;
+            } else {
+                breakfastquay::v_zero(m_source + ix, n);
+            }
+            m_end += n;
+            count -= n;
+        }
+    }
+
+    int ringIndex(sv_frame_t frame) const {
+        return int(((frame % m_capacity) + m_capacity) % m_capacity);
+    }
+    
+    const FFTModel &m_model;
+    ModelById::Handle<DenseTimeValueModel> m_sourceModel;
+    int m_windowSize;
+    int m_fftSize;
+    Precision m_precision;
+    std::unique_ptr<Window<float>> m_floatWindower;
+    std::unique_ptr<Window<double>> m_doubleWindower;
+    breakfastquay::FFT m_fft;
+    float *m_floatSamples;
+    double *m_doubleSamples;
+    double *m_doubleOut;
+
+    int m_readAhead;
+    int m_capacity;
+    float *m_source;
+    sv_frame_t m_start;
+    sv_frame_t m_end;
+    int m_generation;
+};
+
+class FFTModel::PrecomputeThread : public QThread
+{
+public:
+    PrecomputeThread(FFTModel &model, int index, FFTColumnStore *store) :
+        m_model(model),
+        m_index(index),
+        m_store(store),
+        m_calculator(model)
+    { }
+
+    void run() override {
+        int x0 = 0, count = 0;
+        while (!m_model.m_precomputeExiting &&
+               m_model.takePrecomputeWork(m_index, x0, count)) {
+            m_model.calculateIntoStore(m_calculator, m_store, x0, count);
+            m_model.precomputeProgressed();
+        }
+        m_model.precomputeWorkerExited();
+    }
+
+private:
+    FFTModel &m_model;
+    int m_index;
+    FFTColumnStore *m_store;
+    ColumnCalculator m_calculator;
+};
 
 FFTModel::FFTModel(ModelId modelId,
                    int channel,
                    WindowType windowType,
                    int windowSize,
                    int windowIncrement,
-                   int fftSize) :
+                   int fftSize,
+                   Precision precision) :
     m_model(modelId),
     m_sampleRate(0),
     m_channel(channel),
@@ -51,12 +270,28 @@ FFTModel::FFTModel(ModelId modelId,
     m_windowSize(windowSize),
     m_windowIncrement(windowIncrement),
     m_fftSize(fftSize),
-    m_windower(windowType, windowSize),
-    m_fft(fftSize),
+    m_precision(precision),
     m_maximumFrequency(0.0),
-    m_cacheWriteIndex(0),
-    m_cacheSize(3)
+    m_sourceGeneration(0),
+    m_cacheSize(3),
+    m_columnStoreEnabled(Preferences::getInstance()->getCacheFFTColumns()),
+    m_columnStoreFailed(false),
+    m_columnStorePtr(nullptr),
+    m_columnStoreKB(0),
+    m_columnStoreLimitKB(0),
+    m_precomputeThreadCount(0),
+    m_precomputeRunning(0),
+    m_precomputePending(false),
+    m_precomputeExiting(false),
+    m_precomputeCompletion(0),
+    m_precomputeReadyEmitted(false),
+    m_priorityNext(0),
+    m_priorityEnd(0)
 {
+    for (int i = 0; i < CalculatorPoolSize; ++i) {
+        m_calculatorPool[i] = nullptr;
+    }
+    
     clearCaches();
     
     if (m_windowSize > m_fftSize) {
@@ -65,8 +300,6 @@ FFTModel::FFTModel(ModelId modelId,
         throw invalid_argument("FFTModel window size may not exceed FFT size");
     }
 
-    m_fft.initFloat();
-
     auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
     if (model) {
         m_sampleRate = model->getSampleRate();
@@ -76,6 +309,8 @@ FFTModel::FFTModel(ModelId modelId,
                 this, SIGNAL(modelChanged(ModelId)));
         connect(model.get(), SIGNAL(modelChangedWithin(ModelId, sv_frame_t, sv_frame_t)),
                 this, SIGNAL(modelChangedWithin(ModelId, sv_frame_t, sv_frame_t)));
+        connect(model.get(), SIGNAL(ready(ModelId)),
+                this, SLOT(sourceModelReady(ModelId)));
     } else {
         m_error = QString("Model #%1 is not available").arg(m_model.untyped);
     }
@@ -83,17 +318,64 @@ FFTModel::FFTModel(ModelId modelId,
 
 FFTModel::~FFTModel()
 {
+    stopPrecompute();
+    discardColumnStore();
+
+    for (int i = 0; i < CalculatorPoolSize; ++i) {
+        delete m_calculatorPool[i].exchange(nullptr);
+    }
 }
 
 void
 FFTModel::clearCaches()
 {
-    m_cached.clear();
-    while (m_cached.size() < m_cacheSize) {
-        m_cached.push_back({ -1, doublecomplexvec_t(m_fftSize / 2 + 1) });
+    for (int i = 0; i < CacheShardCount; ++i) {
+        CacheShard &shard = m_cacheShards[i];
+        QMutexLocker locker(&shard.mutex);
+        shard.cached.clear();
+        shard.cached.resize(m_cacheSize, { -1, {} });
+        shard.writeIndex = 0;
     }
-    m_cacheWriteIndex = 0;
-    m_savedData.range = { 0, 0 };
+}
+
+FFTModel::ColumnCalculator *
+FFTModel::acquireCalculator() const
+{
+    for (int i = 0; i < CalculatorPoolSize; ++i) {
+        ColumnCalculator *calculator = m_calculatorPool[i].exchange(nullptr);
+        if (calculator) {
+            return calculator;
+        }
+    }
+    return new ColumnCalculator(*this);
+}
+
+void
+FFTModel::releaseCalculator(ColumnCalculator *calculator) const
+{
+    for (int i = 0; i < CalculatorPoolSize; ++i) {
+        ColumnCalculator *expected = nullptr;
+        if (m_calculatorPool[i].compare_exchange_strong(expected, calculator)) {
+            return;
+        }
+    }
+    // Pool is full, which can only happen if more than
+    // CalculatorPoolSize threads were calculating at once
+    delete calculator;
+}
+
+QString
+FFTModel::getError() const
+{
+    QMutexLocker locker(&m_errorMutex);
+    return m_error;
+}
+
+void
+FFTModel::setError(QString error) const
+{
+    QMutexLocker locker(&m_errorMutex);
+    m_error = error;
 }
 
 bool
@@ -101,11 +383,11 @@ FFTModel::isOK() const
 {
     auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
     if (!model) {
-        m_error = QString("Model #%1 is not available").arg(m_model.untyped);
+        setError(QString("Model #%1 is not available").arg(m_model.untyped));
         return false;
     }
     if (!model->isOK()) {
-        m_error = QString("Model #%1 is not OK").arg(m_model.untyped);
+        setError(QString("Model #%1 is not OK").arg(m_model.untyped));
         return false;
     }
     return true;
@@ -117,9 +399,17 @@ FFTModel::getCompletion() const
     int c = 100;
     auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
     if (model) {
-        if (model->isReady(&c)) return 100;
+        if (!model->isReady(&c)) return c;
+    }
+    // May be called from any thread, so we can't look at
+    // m_precomputeThreads, which belongs to the model's own thread
+    if (m_precomputePending) {
+        return 0;
     }
-    return c;
+    if (m_precomputeRunning > 0) {
+        return m_precomputeCompletion;
+    }
+    return 100;
 }
 
 void
@@ -129,6 +419,411 @@ FFTModel::setMaximumFrequency(double freq)
     clearCaches();
 }
 
+void
+FFTModel::setColumnStoreEnabled(bool enabled)
+{
+    if (enabled == m_columnStoreEnabled) return;
+    m_columnStoreEnabled = enabled;
+    if (!enabled) {
+        stopPrecompute();
+        discardColumnStore();
+    }
+}
+
+void
+FFTModel::setColumnStoreLimit(size_t maxKB)
+{
+    if (maxKB == m_columnStoreLimitKB) return;
+    stopPrecompute();
+    discardColumnStore();
+    m_columnStoreLimitKB = maxKB;
+}
+
+void
+FFTModel::discardColumnStore()
+{
+    QMutexLocker locker(&m_columnStoreMutex);
+    m_columnStorePtr = nullptr;
+    if (m_columnStore) {
+        m_columnStore.reset();
+        StorageAdviser::notifyDoneAllocation
+            (StorageAdviser::DiscAllocation, m_columnStoreKB);
+        m_columnStoreKB = 0;
+    }
+    m_columnStoreFailed = false;
+}
+
+FFTColumnStore *
+FFTModel::getColumnStore() const
+{
+    if (!m_columnStoreEnabled || m_columnStoreFailed) {
+        return nullptr;
+    }
+    if (FFTColumnStore *store = m_columnStorePtr.load()) {
+        return store;
+    }
+
+    QMutexLocker locker(&m_columnStoreMutex);
+    if (m_columnStore) { // created by another thread while we waited
+        return m_columnStore.get();
+    }
+
+    // Columns calculated before the source is complete may have been
+    // zero-padded at the end, so we don't start storing until it is
+    
+    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    if (!model || !model->isReady()) {
+        return nullptr;
+    }
+
+    // The store always covers the full FFT height, so that changing
+    // the maximum frequency doesn't invalidate it
+    int height = m_fftSize / 2 + 1;
+    int width = getWidth();
+
+    size_t minKB = FFTColumnStore::getSizeEstimateKB
+        (FFTColumnStore::MagnitudeFormat, height, width);
+    size_t maxKB = FFTColumnStore::getSizeEstimateKB
+        (FFTColumnStore::ComplexFormat, height, width);
+
+    try {
+        StorageAdviser::Recommendation rec =
+            StorageAdviser::recommend
+            (StorageAdviser::Criteria(StorageAdviser::FrequentLookupLikely |
+                                      StorageAdviser::LongRetentionLikely),
+             minKB, maxKB);
+
+        FFTColumnStore::Format format =
+            ((rec & StorageAdviser::ConserveSpace) ?
+             FFTColumnStore::MagnitudeFormat :
+             FFTColumnStore::ComplexFormat);
+
+        // The source model may have become ready before our queued
+        // sourceModelReady() has run, so a calculator could still be
+        // holding zero-padded samples from the current generation.
+        // Start a new one before publishing the store: every caller
+        // obtains the store before calculating, so any column that
+        // reaches it is calculated from freshly read source samples
+        ++m_sourceGeneration;
+
+        m_columnStore = std::make_unique<FFTColumnStore>
+            (format, height, qint64(m_columnStoreLimitKB) * 1024);
+        m_columnStoreKB = (format == FFTColumnStore::MagnitudeFormat ?
+                           minKB : maxKB);
+        if (m_columnStoreLimitKB > 0) {
+            m_columnStoreKB = std::min(m_columnStoreKB,
+                                       size_t(m_columnStoreLimitKB));
+        }
+        StorageAdviser::notifyPlannedAllocation
+            (StorageAdviser::DiscAllocation, m_columnStoreKB);
+        m_columnStorePtr = m_columnStore.get();
+
+    } catch (const std::exception &e) {
+        SVCERR << "WARNING: FFTModel::getColumnStore: Failed to create column store, continuing without one: " << e.what() << endl;
+        m_columnStoreFailed = true;
+        return nullptr;
+    }
+
+    return m_columnStore.get();
+}
+
+void
+FFTModel::storeColumn(FFTColumnStore *store, int n,
+                      const floatcomplexvec_t &col) const
+{
+    if (!store || store->haveColumn(n)) return;
+    if (n < 0 || n >= getWidth()) return;
+
+    int height = store->getHeight();
+    if (int(col.size()) < height) return;
+
+    const float *values = reinterpret_cast<const float *>(col.data());
+    
+    if (store->getFormat() == FFTColumnStore::ComplexFormat) {
+        store->setColumn(n, values);
+    } else {
+        floatvec_t mags(height);
+        breakfastquay::v_cartesian_interleaved_to_magnitudes
+            (mags.data(), values, height);
+        store->setColumn(n, mags.data());
+    }
+}
+
+void
+FFTModel::startPrecompute(int threads)
+{
+    if (!m_precomputeThreads.empty()) {
+        if (m_precomputeRunning > 0) return;
+        // The workers of a previous precompute have all exited, but
+        // our queued precomputeWorkersExited() has not yet run
+        joinPrecomputeThreads();
+    }
+    
+    if (threads <= 0) {
+        threads = QThread::idealThreadCount();
+        if (threads <= 0) threads = 1;
+    }
+    m_precomputeThreadCount = threads;
+
+    setColumnStoreEnabled(true);
+
+    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    if (!model || !model->isReady()) {
+        SVDEBUG << "FFTModel::startPrecompute: Source model not ready yet, "
+                << "deferring until it is" << endl;
+        m_precomputePending = true;
+        return;
+    }
+    m_precomputePending = false;
+    
+    FFTColumnStore *store = getColumnStore();
+    if (!store) {
+        SVCERR << "WARNING: FFTModel::startPrecompute: No column store "
+               << "available, not precomputing" << endl;
+        return;
+    }
+
+    int width = getWidth();
+    
+    SVDEBUG << "FFTModel::startPrecompute: Starting " << threads
+            << " thread(s) for " << width << " columns" << endl;
+
+    m_precomputeExiting = false;
+    m_precomputeCompletion = 0;
+    m_precomputeRanges.clear();
+    
+    for (int i = 0; i < threads; ++i) {
+        auto range = std::make_unique<PrecomputeRange>();
+        range->next = int((sv_frame_t(width) * i) / threads);
+        range->end = int((sv_frame_t(width) * (i + 1)) / threads);
+        m_precomputeRanges.push_back(std::move(range));
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        m_precomputeThreads.push_back(new PrecomputeThread(*this, i, store));
+    }
+    m_precomputeRunning = threads;
+    for (auto t: m_precomputeThreads) {
+        t->start();
+    }
+}
+
+void
+FFTModel::stopPrecompute()
+{
+    m_precomputePending = false;
+    
+    if (m_precomputeThreads.empty()) return;
+
+    m_precomputeExiting = true;
+    joinPrecomputeThreads();
+    m_precomputeRunning = 0;
+}
+
+void
+FFTModel::joinPrecomputeThreads()
+{
+    for (auto t: m_precomputeThreads) {
+        t->wait();
+        delete t;
+    }
+    m_precomputeThreads.clear();
+    m_precomputeRanges.clear();
+}
+
+void
+FFTModel::sourceModelReady(ModelId)
+{
+    // Any source samples read while the model was still loading may
+    // have been zero padding
+    ++m_sourceGeneration;
+    clearCaches();
+    
+    if (m_precomputePending) {
+        startPrecompute(m_precomputeThreadCount);
+    }
+}
+
+void
+FFTModel::setPrecomputePriority(int x0, int x1)
+{
+    // Columns beyond the width would be calculated only to be
+    // dropped by storeColumn
+    int width = getWidth();
+    x0 = std::max(0, std::min(x0, width - 1));
+    x1 = std::max(0, std::min(x1, width - 1));
+    
+    QMutexLocker locker(&m_priorityMutex);
+    m_priorityNext = x0;
+    m_priorityEnd = (width > 0 ? std::max(x0, x1 + 1) : 0);
+}
+
+bool
+FFTModel::takePrecomputeWork(int worker, int &x0, int &count)
+{
+    // Hand out work in chunks small enough to keep the priority
+    // region responsive, but large enough that each chunk reads a
+    // reasonable span of source audio at once
+    const int chunk = 16;
+
+    {
+        QMutexLocker locker(&m_priorityMutex);
+        if (m_priorityNext < m_priorityEnd) {
+            x0 = m_priorityNext;
+            count = std::min(chunk, m_priorityEnd - m_priorityNext);
+            m_priorityNext += count;
+            return true;
+        }
+    }
+
+    PrecomputeRange &own = *m_precomputeRanges[worker];
+
+    {
+        QMutexLocker locker(&own.mutex);
+        if (own.next < own.end) {
+            x0 = own.next;
+            count = std::min(chunk, own.end - own.next);
+            own.next += count;
+            return true;
+        }
+    }
+
+    // Our own range is exhausted: take the second half of whatever
+    // remains in the largest range belonging to another worker
+    
+    while (true) {
+
+        int victim = -1;
+        int mostRemaining = 0;
+
+        for (int i = 0; in_range_for(m_precomputeRanges, i); ++i) {
+            if (i == worker) continue;
+            PrecomputeRange &r = *m_precomputeRanges[i];
+            QMutexLocker locker(&r.mutex);
+            if (r.end - r.next > mostRemaining) {
+                mostRemaining = r.end - r.next;
+                victim = i;
+            }
+        }
+
+        if (victim < 0) {
+            return false;
+        }
+
+        int from = 0, to = 0;
+        {
+            PrecomputeRange &r = *m_precomputeRanges[victim];
+            QMutexLocker locker(&r.mutex);
+            int remaining = r.end - r.next;
+            if (remaining <= 0) {
+                continue; // someone else got there first
+            }
+            if (remaining <= chunk) {
+                from = r.next;
+                to = r.end;
+                r.next = r.end;
+            } else {
+                from = r.next + remaining / 2;
+                to = r.end;
+                r.end = from;
+            }
+        }
+
+        QMutexLocker locker(&own.mutex);
+        own.next = from;
+        own.end = to;
+        x0 = own.next;
+        count = std::min(chunk, own.end - own.next);
+        own.next += count;
+        return true;
+    }
+}
+
+void
+FFTModel::calculateIntoStore(ColumnCalculator &calculator,
+                             FFTColumnStore *store, int x0, int count) const
+{
+    bool haveAll = true;
+    for (int i = 0; i < count; ++i) {
+        if (!store->haveColumn(x0 + i)) {
+            haveAll = false;
+            break;
+        }
+    }
+    if (haveAll) return;
+
+    floatcomplexvec_t col(m_fftSize / 2 + 1);
+    
+    for (int i = 0; i < count; ++i) {
+        if (store->haveColumn(x0 + i)) continue;
+        calculator.calculate(x0 + i, reinterpret_cast<float *>(col.data()));
+        storeColumn(store, x0 + i, col);
+    }
+}
+
+void
+FFTModel::precomputeProgressed()
+{
+    // Called from the worker threads
+    
+    FFTColumnStore *store = m_columnStorePtr.load();
+    int width = getWidth();
+    if (width <= 0 || !store) return;
+
+    int completion = int((sv_frame_t(store->getColumnCount()) * 100) / width);
+    if (completion > 100) completion = 100;
+
+    int previous = m_precomputeCompletion.exchange(completion);
+    if (completion != previous) {
+        emit completionChanged(getId());
+        if (completion == 100 && !m_precomputeReadyEmitted.exchange(true)) {
+            // Emit ready() from our own thread, not the worker's
+            QMetaObject::invokeMethod(this, "precomputeFinished",
+                                      Qt::QueuedConnection);
+        }
+    }
+}
+
+void
+FFTModel::precomputeWorkerExited()
+{
+    // Called from each worker thread as it exits. Once the last one
+    // has gone, every column has been either stored or found to be
+    // unstorable, for example because a tile could not be mapped.
+    // Those will be calculated on demand instead, so we're as ready
+    // as we will ever be
+    
+    if (--m_precomputeRunning > 0 || m_precomputeExiting) return;
+
+    if (m_precomputeCompletion.exchange(100) != 100) {
+        emit completionChanged(getId());
+    }
+    if (!m_precomputeReadyEmitted.exchange(true)) {
+        QMetaObject::invokeMethod(this, "precomputeFinished",
+                                  Qt::QueuedConnection);
+    }
+
+    // The thread objects belong to our own thread, so they must be
+    // joined and deleted there
+    QMetaObject::invokeMethod(this, "precomputeWorkersExited",
+                              Qt::QueuedConnection);
+}
+
+void
+FFTModel::precomputeFinished()
+{
+    emit ready(getId());
+}
+
+void
+FFTModel::precomputeWorkersExited()
+{
+    // The precompute may have been stopped, or stopped and restarted,
+    // since this was queued: only join workers that have all exited
+    if (m_precomputeRunning > 0) return;
+    joinPrecomputeThreads();
+}
+
 int
 FFTModel::getWidth() const
 {
@@ -167,12 +862,18 @@ FFTModel::Column
 FFTModel::getColumn(int x) const
 {
     Profiler profiler("FFTModel::getColumn");
-    auto cplx = getFFTColumn(x);
-    Column col;
-    col.reserve(cplx.size());
-    for (auto c: cplx) {
-        col.push_back(abs(c));
+    if (FFTColumnStore *store = getColumnStore()) {
+        Column col(getHeight());
+        if (store->getMagnitudes(x, col.data(), 0, int(col.size()))) {
+            inColumnStore.hit();
+            return col;
+        }
     }
+    auto cplx = getFFTColumn(x);
+    Column col(cplx->size());
+    breakfastquay::v_cartesian_interleaved_to_magnitudes
+        (col.data(), reinterpret_cast<const float *>(cplx->data()),
+         int(col.size()));
     return col;
 }
 
@@ -180,12 +881,18 @@ FFTModel::Column
 FFTModel::getColumn(int x, int minbin, int nbins) const
 {
     Profiler profiler("FFTModel::getColumn (subset)");
-    auto cplx = getFFTColumn(x);
-    Column col;
-    col.reserve(nbins);
-    for (int i = 0; i < nbins; ++i) {
-        col.push_back(abs(cplx[minbin + i]));
+    if (FFTColumnStore *store = getColumnStore()) {
+        Column col(nbins);
+        if (store->getMagnitudes(x, col.data(), minbin, nbins)) {
+            inColumnStore.hit();
+            return col;
+        }
     }
+    auto cplx = getFFTColumn(x);
+    Column col(nbins);
+    breakfastquay::v_cartesian_interleaved_to_magnitudes
+        (col.data(), reinterpret_cast<const float *>(cplx->data()) + minbin * 2,
+         nbins);
     return col;
 }
 
@@ -195,8 +902,8 @@ FFTModel::getPhases(int x) const
     Profiler profiler("FFTModel::getPhases");
     auto cplx = getFFTColumn(x);
     Column col;
-    col.reserve(cplx.size());
-    for (auto c: cplx) {
+    col.reserve(cplx->size());
+    for (auto c: *cplx) {
         col.push_back(arg(c));
     }
     return col;
@@ -208,8 +915,15 @@ FFTModel::getMagnitudeAt(int x, int y) const
     if (x < 0 || x >= getWidth() || y < 0 || y >= getHeight()) {
         return 0.f;
     }
+    if (FFTColumnStore *store = getColumnStore()) {
+        float value = 0.f;
+        if (store->getMagnitudes(x, &value, y, 1)) {
+            inColumnStore.hit();
+            return value;
+        }
+    }
     auto col = getFFTColumn(x);
-    return abs(col[y]);
+    return abs((*col)[y]);
 }
 
 float
@@ -228,7 +942,7 @@ float
 FFTModel::getPhaseAt(int x, int y) const
 {
     if (x < 0 || x >= getWidth() || y < 0 || y >= getHeight()) return 0.f;
-    return arg(getFFTColumn(x)[y]);
+    return arg((*getFFTColumn(x))[y]);
 }
 
 void
@@ -240,8 +954,8 @@ FFTModel::getValuesAt(int x, int y, float &re, float &im) const
         return;
     }
     auto col = getFFTColumn(x);
-    re = col[y].real();
-    im = col[y].imag();
+    re = (*col)[y].real();
+    im = (*col)[y].imag();
 }
 
 bool
@@ -250,10 +964,16 @@ FFTModel::getMagnitudesAt(int x, float *values, int minbin, int count) const
     if (count == 0) {
         count = getHeight() - minbin;
     }
-    auto col = getFFTColumn(x);
-    for (int i = 0; i < count; ++i) {
-        values[i] = abs(col[minbin + i]);
+    if (FFTColumnStore *store = getColumnStore()) {
+        if (store->getMagnitudes(x, values, minbin, count)) {
+            inColumnStore.hit();
+            return true;
+        }
     }
+    auto col = getFFTColumn(x);
+    breakfastquay::v_cartesian_interleaved_to_magnitudes
+        (values, reinterpret_cast<const float *>(col->data()) + minbin * 2,
+         count);
     return true;
 }
 
@@ -263,7 +983,7 @@ FFTModel::getPhasesAt(int x, float *values, int minbin, int count) const
     if (count == 0) count = getHeight();
     auto col = getFFTColumn(x);
     for (int i = 0; i < count; ++i) {
-        values[i] = arg(col[minbin + i]);
+        values[i] = arg((*col)[minbin + i]);
     }
     return true;
 }
@@ -274,213 +994,224 @@ FFTModel::getValuesAt(int x, float *reals, float *imags, int minbin, int count)
     if (count == 0) count = getHeight();
     auto col = getFFTColumn(x);
     for (int i = 0; i < count; ++i) {
-        reals[i] = col[minbin + i].real();
+        reals[i] = (*col)[minbin + i].real();
     }
     for (int i = 0; i < count; ++i) {
-        imags[i] = col[minbin + i].imag();
+        imags[i] = (*col)[minbin + i].imag();
     }
     return true;
 }
 
-floatvec_t
-FFTModel::getSourceSamples(int column) const
+bool
+FFTModel::getColumns(int x0, int count, float *const *out,
+                     int minbin, int nbins) const
 {
-    // m_fftSize may be greater than m_windowSize, but not the reverse
-
-#ifdef DEBUG_FFT_MODEL
-    SVDEBUG << "getSourceSamples(" << column << ")" << endl;
-#endif
-    
-    auto range = getSourceSampleRange(column);
-    auto data = getSourceData(range);
+    return getColumnsAs(MagnitudeOutput, x0, count, out, nullptr,
+                        minbin, nbins);
+}
 
-    int off = (m_fftSize - m_windowSize) / 2;
+bool
+FFTModel::getPolarColumns(int x0, int count,
+                          float *const *magnitudes, float *const *phases,
+                          int minbin, int nbins) const
+{
+    return getColumnsAs(PolarOutput, x0, count, magnitudes, phases,
+                        minbin, nbins);
+}
 
-    if (off == 0) {
-        return data;
-    } else {
-        vector<float> pad(off, 0.f);
-        floatvec_t padded;
-        padded.reserve(m_fftSize);
-        padded.insert(padded.end(), pad.begin(), pad.end());
-        padded.insert(padded.end(), data.begin(), data.end());
-        padded.insert(padded.end(), pad.begin(), pad.end());
-        return padded;
-    }
+bool
+FFTModel::getCartesianColumns(int x0, int count,
+                              float *const *reals, float *const *imaginaries,
+                              int minbin, int nbins) const
+{
+    return getColumnsAs(CartesianOutput, x0, count, reals, imaginaries,
+                        minbin, nbins);
 }
 
-floatvec_t
-FFTModel::getSourceData(pair<sv_frame_t, sv_frame_t> range) const
+bool
+FFTModel::getColumnsAs(ColumnOutput output, int x0, int count,
+                       float *const *out0, float *const *out1,
+                       int minbin, int nbins) const
 {
-#ifdef DEBUG_FFT_MODEL
-    SVDEBUG << "getSourceData(" << range.first << "," << range.second
-            << "): saved range is (" << m_savedData.range.first
-            << "," << m_savedData.range.second << ")" << endl;
-#endif
+    Profiler profiler("FFTModel::getColumnsAs");
 
-    if (m_savedData.range == range) {
-        inSourceCache.hit();
-#ifdef DEBUG_FFT_MODEL
-        SVDEBUG << "getSourceData(" << range.first << "," << range.second
-                << "): source cache hit" << endl;
-#endif
-        return m_savedData.data;
+    if (count <= 0) return true;
+    if (nbins == 0) nbins = getHeight() - minbin;
+
+    // If we only want magnitudes and they are all in the column
+    // store already, there is no need to read any source data
+
+    FFTColumnStore *store = getColumnStore();
+    if (store && output == MagnitudeOutput) {
+        bool haveAll = true;
+        for (int i = 0; i < count; ++i) {
+            if (!store->haveColumn(x0 + i)) {
+                haveAll = false;
+                break;
+            }
+        }
+        if (haveAll) {
+            for (int i = 0; i < count; ++i) {
+                store->getMagnitudes(x0 + i, out0[i], minbin, nbins);
+            }
+            inColumnStore.hit();
+            return true;
+        }
     }
 
-    Profiler profiler("FFTModel::getSourceData (cache miss)");
-    
-    if (range.first < m_savedData.range.second &&
-        range.first >= m_savedData.range.first &&
-        range.second > m_savedData.range.second) {
+    if (!ModelById::getAs<DenseTimeValueModel>(m_model)) {
+        return false;
+    }
 
-        inSourceCache.partial();
+    int hs1 = m_fftSize / 2 + 1;
 
-#ifdef DEBUG_FFT_MODEL
-        SVDEBUG << "getSourceData(" << range.first << "," << range.second
-                << "): source cache partial hit" << endl;
-#endif
-        
-        sv_frame_t discard = range.first - m_savedData.range.first;
+    floatcomplexvec_t col(hs1);
+    const float *bins = reinterpret_cast<const float *>(col.data()) + minbin * 2;
 
-        floatvec_t data;
-        data.reserve(range.second - range.first);
+    ColumnCalculator *calculator = acquireCalculator();
+    
+    for (int i = 0; i < count; ++i) {
 
-        data.insert(data.end(),
-                    m_savedData.data.begin() + discard,
-                    m_savedData.data.end());
+        calculator->calculate(x0 + i, reinterpret_cast<float *>(col.data()));
 
-        floatvec_t rest = getSourceDataUncached
-            ({ m_savedData.range.second, range.second });
+        storeColumn(store, x0 + i, col);
 
-        data.insert(data.end(), rest.begin(), rest.end());
-        
-        m_savedData = { range, data };
-        return data;
+        switch (output) {
 
-    } else {
+        case MagnitudeOutput:
+            breakfastquay::v_cartesian_interleaved_to_magnitudes
+                (out0[i], bins, nbins);
+            break;
 
-        inSourceCache.miss();
+        case PolarOutput:
+            breakfastquay::v_cartesian_interleaved_to_polar
+                (out0[i], out1[i], bins, nbins);
+            break;
 
-#ifdef DEBUG_FFT_MODEL
-        SVDEBUG << "getSourceData(" << range.first << "," << range.second
-                << "): source cache miss" << endl;
-#endif
-        
-        auto data = getSourceDataUncached(range);
-        m_savedData = { range, data };
-        return data;
+        case CartesianOutput:
+            for (int j = 0; j < nbins; ++j) {
+                out0[i][j] = bins[j * 2];
+                out1[i][j] = bins[j * 2 + 1];
+            }
+            break;
+        }
     }
+
+    releaseCalculator(calculator);
+
+    return true;
 }
 
 floatvec_t
-FFTModel::getSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
+FFTModel::getSourceSamples(const DenseTimeValueModel &model,
+                           sv_frame_t start, sv_frame_t count) const
 {
-    Profiler profiler("FFTModel::getSourceDataUncached");
-
-    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
-    if (!model) return {};
-    
-    decltype(range.first) pfx = 0;
-    if (range.first < 0) {
-        pfx = -range.first;
-        range = { 0, range.second };
-    }
+    Profiler profiler("FFTModel::getSourceSamples");
 
-    auto data = model->getData(m_channel,
-                               range.first,
-                               range.second - range.first);
+    auto data = model.getData(m_channel, start, count);
 
 #ifdef DEBUG_FFT_MODEL
     if (data.empty()) {
-        SVDEBUG << "NOTE: empty source data for range (" << range.first << ","
-                << range.second << ") (model end frame "
-                << model->getEndFrame() << ")" << endl;
+        SVDEBUG << "NOTE: empty source data for range (" << start << ","
+                << start + count << ") (model end frame "
+                << model.getEndFrame() << ")" << endl;
     }
 #endif
     
-    // don't return a partial frame
-    data.resize(range.second - range.first, 0.f);
-
-    if (pfx > 0) {
-        vector<float> pad(pfx, 0.f);
-        data.insert(data.begin(), pad.begin(), pad.end());
-    }
-    
     if (m_channel == -1) {
-        int channels = model->getChannelCount();
-        if (channels > 1) {
-            int n = int(data.size());
-            float factor = 1.f / float(channels);
+        int channels = model.getChannelCount();
+        if (channels > 1 && !data.empty()) {
             // use mean instead of sum for fft model input
-            for (int i = 0; i < n; ++i) {
-                data[i] *= factor;
-            }
+            breakfastquay::v_scale(data.data(), 1.f / float(channels),
+                                   int(data.size()));
         }
     }
     
     return data;
 }
 
-const doublecomplexvec_t &
+FFTModel::FFTColumnPtr
 FFTModel::getFFTColumn(int n) const
 {
-    // The small cache (i.e. the m_cached deque) is for cases where
-    // values are looked up individually, and for e.g. peak-frequency
-    // spectrograms where values from two consecutive columns are
-    // needed at once. This cache gets essentially no hits when
-    // scrolling through a magnitude spectrogram, but 95%+ hits with a
-    // peak-frequency spectrogram or spectrum.
-    for (const auto &incache : m_cached) {
-        if (incache.n == n) {
-            inSmallCache.hit();
-            return incache.col;
+    // The small cache is for cases where values are looked up
+    // individually, and for e.g. peak-frequency spectrograms where
+    // values from two consecutive columns are needed at once. This
+    // cache gets essentially no hits when scrolling through a
+    // magnitude spectrogram, but 95%+ hits with a peak-frequency
+    // spectrogram or spectrum. It is sharded by column number so that
+    // threads reading different columns don't contend, and holds
+    // shared pointers so that a column can't be overwritten while a
+    // caller is still using it.
+
+    CacheShard &shard =
+        m_cacheShards[((n % CacheShardCount) + CacheShardCount)
+                      % CacheShardCount];
+    {
+        QMutexLocker locker(&shard.mutex);
+        for (const auto &incache : shard.cached) {
+            if (incache.n == n && incache.col) {
+                inSmallCache.hit();
+                return incache.col;
+            }
         }
     }
     inSmallCache.miss();
 
-    Profiler profiler("FFTModel::getFFTColumn (cache miss)");
+    int height = getHeight();
     
-    auto fsamples = getSourceSamples(n);
-
-    // Ensure that windowing and FFT happen in double precision
-    vector<double> samples;
-    samples.reserve(fsamples.size());
-    for (int i = 0; in_range_for(fsamples, i); ++i) {
-        samples.push_back(fsamples[i]);
+    auto col = std::make_shared<floatcomplexvec_t>(m_fftSize / 2 + 1);
+    bool found = false;
+
+    FFTColumnStore *store = getColumnStore();
+    if (store && store->getFormat() == FFTColumnStore::ComplexFormat) {
+        if (store->getComplex(n, reinterpret_cast<float *>(col->data()),
+                              0, height)) {
+            inColumnStore.hit();
+            found = true;
+        }
     }
     
-    m_windower.cut(samples.data() + (m_fftSize - m_windowSize) / 2);
-    breakfastquay::v_fftshift(samples.data(), m_fftSize);
+    if (!found) {
+
+        if (store) {
+            inColumnStore.miss();
+        }
 
-    doublecomplexvec_t &col = m_cached[m_cacheWriteIndex].col;
+        Profiler profiler("FFTModel::getFFTColumn (cache miss)");
 
-    // expand to large enough for fft destination, if truncated previously
-    col.resize(m_fftSize / 2 + 1);
+        // m_fftSize may be greater than m_windowSize, but not the
+        // reverse; the calculator takes care of any zero padding
 
-    m_fft.forwardInterleaved(samples.data(),
-                             reinterpret_cast<double *>(col.data()));
+        ColumnCalculator *calculator = acquireCalculator();
+        calculator->calculate(n, reinterpret_cast<float *>(col->data()));
 
-    // keep only the number of elements we need - so that we can
-    // return a const ref without having to resize on a cache hit
-    col.resize(getHeight());
+        releaseCalculator(calculator);
+        
+        storeColumn(store, n, *col);
+    }
+
+    // keep only the number of elements we need
+    col->resize(height);
 
 #ifdef DEBUG_FFT_MODEL
     {
-        vector<double> mags(getHeight(), 0.0);
+        vector<float> mags(height, 0.f);
         breakfastquay::v_cartesian_interleaved_to_magnitudes
-            ((double *)mags.data(),
-             (const double *)col.data(),
-             getHeight());
+            (mags.data(),
+             (const float *)col->data(),
+             height);
         SVDEBUG << "FFTModel::getFFTColumn(" << n << "): fft size " << m_fftSize
-                << ", height " << getHeight() << ", mag range "
+                << ", height " << height << ", mag range "
                 << breakfastquay::v_min(mags.data(), mags.size()) << " to "
                 << breakfastquay::v_max(mags.data(), mags.size()) << endl;
     }
 #endif
-    
-    m_cached[m_cacheWriteIndex].n = n;
 
-    m_cacheWriteIndex = (m_cacheWriteIndex + 1) % m_cacheSize;
+    {
+        QMutexLocker locker(&shard.mutex);
+        shard.cached[shard.writeIndex] = { n, col };
+        shard.writeIndex = (shard.writeIndex + 1) % m_cacheSize;
+    }
 
     return col;
 }
@@ -18,15 +18,20 @@
 
 #include "DenseThreeDimensionalModel.h"
 #include "DenseTimeValueModel.h"
+#include "FFTColumnStore.h"
 
 #include "base/Window.h"
 
 #include <bqfft/FFT.h>
 #include <bqvec/Allocators.h>
 
+#include <QMutex>
+
 #include <set>
 #include <vector>
 #include <complex>
+#include <memory>
+#include <atomic>
 
 namespace sv {
 
@@ -34,15 +39,26 @@ namespace sv {
  * An implementation of DenseThreeDimensionalModel that makes FFT data
  * derived from a DenseTimeValueModel available as a generic data
  * grid.
+ *
+ * The const retrieval functions may be called from any number of
+ * threads at once. Each calculation borrows an FFT plan and scratch
+ * buffers from a small lock-free pool, and recently calculated
+ * columns are cached in shards indexed by column number, so readers
+ * of different columns do not contend with one another. The
+ * non-const configuration functions (setMaximumFrequency,
+ * setColumnStoreEnabled, startPrecompute etc) must not be called
+ * while other threads are reading.
  */
 class FFTModel : public DenseThreeDimensionalModel
 {
     Q_OBJECT
 
-    //!!! threading requirements?
-    //!!! doubles? since we're not caching much
-
 public:
+    enum Precision {
+        SinglePrecision,    /// Window and transform in float
+        DoublePrecision     /// Window and transform in double
+    };
+    
     /**
      * Construct an FFT model derived from the given
      * DenseTimeValueModel, with the given window parameters and FFT
@@ -51,13 +67,20 @@ public:
      * If the model has multiple channels use only the given channel,
      * unless the channel is -1 in which case merge all available
      * channels.
+     *
+     * The precision determines the type used for windowing and the
+     * FFT itself. Results are always returned, and cached, in single
+     * precision; DoublePrecision is only worth the extra cost where
+     * the accuracy of the phase matters, as for
+     * estimateStableFrequency with large FFT sizes.
      */
     FFTModel(ModelId model, // a DenseTimeValueModel
              int channel,
              WindowType windowType,
              int windowSize,
              int windowIncrement,
-             int fftSize);
+             int fftSize,
+             Precision precision = SinglePrecision);
     ~FFTModel();
 
     // DenseThreeDimensionalModel and Model methods:
@@ -117,17 +140,74 @@ public:
 
     // FFTModel methods:
     //
-    QString getError() const { return m_error; }
+    QString getError() const;
 
     int getChannel() const { return m_channel; }
     WindowType getWindowType() const { return m_windowType; }
     int getWindowSize() const { return m_windowSize; }
     int getWindowIncrement() const { return m_windowIncrement; }
     int getFFTSize() const { return m_fftSize; }
+    Precision getPrecision() const { return m_precision; }
 
     void setMaximumFrequency(double freq);
     double getMaximumFrequency() const { return m_maximumFrequency; }
 
+    /**
+     * Enable or disable the persistent column store. When enabled,
+     * each column calculated once the source model is ready is also
+     * written to an FFTColumnStore, so that revisiting it later costs
+     * a page fault rather than another FFT. StorageAdviser decides
+     * whether the store holds complex values or magnitudes only. If
+     * the store cannot be created, the model continues to work
+     * without it. The store is disabled on construction unless the
+     * "Cache FFT Columns" preference, which is off by default, is set.
+     * Its size is limited only by setColumnStoreLimit.
+     */
+    void setColumnStoreEnabled(bool enabled);
+    bool isColumnStoreEnabled() const { return m_columnStoreEnabled; }
+
+    /**
+     * Limit the disc space used by the column store to about the
+     * given number of kilobytes. Columns that do not fit are not
+     * stored, but are calculated whenever they are requested as they
+     * would be with no store. Zero, the default, means no limit. Any
+     * existing store is discarded, and any precompute stopped.
+     */
+    void setColumnStoreLimit(size_t maxKB);
+    size_t getColumnStoreLimit() const { return m_columnStoreLimitKB; }
+
+    /**
+     * Start calculating every column in the background, on a pool of
+     * worker threads each with its own FFT, writing the results to
+     * the column store (which is enabled if it was not already). If
+     * threads is zero, one thread per available core is used. If the
+     * source model is not yet ready, the calculation starts when it
+     * becomes ready. Workers that run out of columns take over half
+     * of the remaining range of the busiest other worker, and
+     * getCompletion() reports progress until every column is done.
+     * The model emits ready() once, from its own thread, when the
+     * first complete calculation finishes. Columns that could not be
+     * stored are left to be calculated on demand, and do not hold up
+     * completion. Once every worker has exited, the precompute may be
+     * started again, for example after the column store has been
+     * discarded.
+     */
+    void startPrecompute(int threads = 0);
+
+    /**
+     * Stop any background calculation started with startPrecompute,
+     * waiting for the worker threads to exit. Columns already
+     * calculated remain available in the column store.
+     */
+    void stopPrecompute();
+
+    /**
+     * Ask the background workers to calculate the columns from x0 to
+     * x1 inclusive (for example the visible region of a view) before
+     * any others. The range is clamped to the width of the model.
+     */
+    void setPrecomputePriority(int x0, int x1);
+
 //!!! review which of these are ever actually called
     
     float getMagnitudeAt(int x, int y) const;
@@ -139,10 +219,41 @@ public:
     bool getPhasesAt(int x, float *values, int minbin = 0, int count = 0) const;
     bool getValuesAt(int x, float *reals, float *imaginaries, int minbin = 0, int count = 0) const;
 
+    /**
+     * Retrieve the magnitudes of nbins bins starting at minbin, for
+     * each of count consecutive columns starting at column x0. The
+     * values for column x0 + i are written to out[i], which must have
+     * room for nbins floats. If nbins is zero, getHeight() - minbin
+     * is used.
+     *
+     * The source audio for the whole span of columns is read at once,
+     * and the columns are then windowed and transformed back to back
+     * without further allocation, so this is much cheaper than
+     * retrieving the same columns individually. Return false if the
+     * source model is not available.
+     */
+    bool getColumns(int x0, int count, float *const *out,
+                    int minbin = 0, int nbins = 0) const;
+
+    /**
+     * As getColumns, but retrieving magnitudes and phases.
+     */
+    bool getPolarColumns(int x0, int count,
+                         float *const *magnitudes, float *const *phases,
+                         int minbin = 0, int nbins = 0) const;
+
+    /**
+     * As getColumns, but retrieving real and imaginary components.
+     */
+    bool getCartesianColumns(int x0, int count,
+                             float *const *reals, float *const *imaginaries,
+                             int minbin = 0, int nbins = 0) const;
+
     /**
      * Calculate an estimated frequency for a stable signal in this
      * bin, using phase unwrapping.  This will be completely wrong if
-     * the signal is not stable here.
+     * the signal is not stable here. Models constructed with
+     * DoublePrecision give more reliable estimates at large FFT sizes.
      */
     virtual bool estimateStableFrequency(int x, int y, double &frequency);
 
@@ -171,6 +282,11 @@ public:
 
     QString getTypeName() const override { return tr("FFT"); }
 
+private slots:
+    void sourceModelReady(ModelId);
+    void precomputeFinished();
+    void precomputeWorkersExited();
+
 private:
     FFTModel(const FFTModel &) =delete;
     FFTModel &operator=(const FFTModel &) =delete;
@@ -183,10 +299,11 @@ private:
     int m_windowSize;
     int m_windowIncrement;
     int m_fftSize;
-    Window<double> m_windower;
-    mutable breakfastquay::FFT m_fft;
+    Precision m_precision;
     double m_maximumFrequency;
     mutable QString m_error;
+    mutable QMutex m_errorMutex;
+    void setError(QString error) const;
     
     int getPeakPickWindowSize(PeakPickType type, sv_samplerate_t sampleRate,
                               int bin, double &dist) const;
@@ -200,25 +317,92 @@ private:
         return { startFrame, endFrame };
     }
 
-    const doublecomplexvec_t &getFFTColumn(int column) const;
-    floatvec_t getSourceSamples(int column) const;
-    floatvec_t getSourceData(std::pair<sv_frame_t, sv_frame_t>) const;
-    floatvec_t getSourceDataUncached(std::pair<sv_frame_t, sv_frame_t>) const;
-
-    struct SavedSourceData {
-        std::pair<sv_frame_t, sv_frame_t> range;
-        floatvec_t data;
+    /**
+     * FFT plan, window, scratch buffer and source window needed
+     * to calculate a column. A calculator may be used by only one
+     * thread at a time: foreground readers borrow one from the pool
+     * with acquireCalculator() and return it with
+     * releaseCalculator(), creating a new one if none is free.
+     */
+    class ColumnCalculator;
+    enum { CalculatorPoolSize = 16 };
+    mutable std::atomic<ColumnCalculator *> m_calculatorPool[CalculatorPoolSize];
+    ColumnCalculator *acquireCalculator() const;
+    void releaseCalculator(ColumnCalculator *) const;
+
+    typedef std::shared_ptr<const floatcomplexvec_t> FFTColumnPtr;
+    FFTColumnPtr getFFTColumn(int column) const;
+
+    enum ColumnOutput {
+        MagnitudeOutput,
+        PolarOutput,
+        CartesianOutput
     };
-    mutable SavedSourceData m_savedData;
+    bool getColumnsAs(ColumnOutput output, int x0, int count,
+                      float *const *out0, float *const *out1,
+                      int minbin, int nbins) const;
+    floatvec_t getSourceSamples(const DenseTimeValueModel &model,
+                                sv_frame_t start, sv_frame_t count) const;
+
+    /**
+     * Incremented when the source model's audio may have changed
+     * under us (i.e. when it becomes ready, and again when the column
+     * store is created), so that calculators know to discard the
+     * source samples they hold.
+     */
+    mutable std::atomic<int> m_sourceGeneration;
 
     struct SavedColumn {
         int n;
-        doublecomplexvec_t col;
+        FFTColumnPtr col;
+    };
+    struct CacheShard {
+        QMutex mutex;
+        std::vector<SavedColumn> cached;
+        size_t writeIndex;
     };
-    mutable std::vector<SavedColumn> m_cached;
-    mutable size_t m_cacheWriteIndex;
+    enum { CacheShardCount = 8 };
+    mutable CacheShard m_cacheShards[CacheShardCount];
     size_t m_cacheSize;
 
+    std::atomic<bool> m_columnStoreEnabled;
+    mutable std::atomic<bool> m_columnStoreFailed;
+    mutable std::unique_ptr<FFTColumnStore> m_columnStore;
+    mutable std::atomic<FFTColumnStore *> m_columnStorePtr;
+    mutable QMutex m_columnStoreMutex;
+    mutable size_t m_columnStoreKB;
+    std::atomic<size_t> m_columnStoreLimitKB;
+
+    FFTColumnStore *getColumnStore() const;
+    void storeColumn(FFTColumnStore *store, int n,
+                     const floatcomplexvec_t &col) const;
+    void discardColumnStore();
+
+    class PrecomputeThread;
+    struct PrecomputeRange {
+        QMutex mutex;
+        int next;
+        int end;
+    };
+    std::vector<PrecomputeThread *> m_precomputeThreads;
+    std::vector<std::unique_ptr<PrecomputeRange>> m_precomputeRanges;
+    int m_precomputeThreadCount;
+    std::atomic<int> m_precomputeRunning; // for getCompletion
+    std::atomic<bool> m_precomputePending;
+    std::atomic<bool> m_precomputeExiting;
+    std::atomic<int> m_precomputeCompletion;
+    std::atomic<bool> m_precomputeReadyEmitted;
+    QMutex m_priorityMutex;
+    int m_priorityNext;
+    int m_priorityEnd;
+
+    bool takePrecomputeWork(int worker, int &x0, int &count);
+    void calculateIntoStore(ColumnCalculator &calculator,
+                            FFTColumnStore *store, int x0, int count) const;
+    void precomputeProgressed();
+    void precomputeWorkerExited();
+    void joinPrecomputeThreads();
+    
     void clearCaches();
 };
 
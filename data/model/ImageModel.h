@@ -57,6 +57,10 @@ public:
         m_completion(100) {
     }
 
+    virtual ~ImageModel() {
+        m_notifier.detach();
+    }
+
     QString getTypeName() const override { return tr("Image"); }
     bool isSparse() const override { return true; }
     bool isOK() const override { return true; }
@@ -19,6 +19,7 @@
 #include <QTextStream>
 
 #include <iostream>
+#include <algorithm>
 
 //#define DEBUG_COMPLETION 1
 
@@ -88,6 +89,23 @@ Model::getAlignmentReference() const
 
 sv_frame_t
 Model::alignToReference(sv_frame_t frame) const
+{
+    sv_frame_t refFrame = frame;
+    alignToReference(&frame, &refFrame, 1);
+    return refFrame;
+}
+
+sv_frame_t
+Model::alignFromReference(sv_frame_t refFrame) const
+{
+    sv_frame_t frame = refFrame;
+    alignFromReference(&refFrame, &frame, 1);
+    return frame;
+}
+
+void
+Model::alignToReference(const sv_frame_t *frames,
+                        sv_frame_t *out, int n) const
 {
     ModelId alignmentModelId, sourceModelId;
     {
@@ -101,21 +119,27 @@ Model::alignToReference(sv_frame_t frame) const
     if (!alignmentModel) {
         auto sourceModel = ModelById::get(sourceModelId);
         if (sourceModel) {
-            return sourceModel->alignToReference(frame);
+            sourceModel->alignToReference(frames, out, n);
+            return;
         }
-        return frame;
+        std::copy(frames, frames + n, out);
+        return;
     }
     
-    sv_frame_t refFrame = alignmentModel->toReference(frame);
+    alignmentModel->toReference(frames, out, n);
+
     auto refModel = ModelById::get(alignmentModel->getReferenceModel());
-    if (refModel && refFrame > refModel->getEndFrame()) {
-        refFrame = refModel->getEndFrame();
+    if (refModel) {
+        sv_frame_t end = refModel->getEndFrame();
+        for (int i = 0; i < n; ++i) {
+            out[i] = std::min(out[i], end);
+        }
     }
-    return refFrame;
 }
 
-sv_frame_t
-Model::alignFromReference(sv_frame_t refFrame) const
+void
+Model::alignFromReference(const sv_frame_t *refFrames,
+                          sv_frame_t *out, int n) const
 {
     ModelId alignmentModelId, sourceModelId;
     {
@@ -129,14 +153,19 @@ Model::alignFromReference(sv_frame_t refFrame) const
     if (!alignmentModel) {
         auto sourceModel = ModelById::get(sourceModelId);
         if (sourceModel) {
-            return sourceModel->alignFromReference(refFrame);
+            sourceModel->alignFromReference(refFrames, out, n);
+            return;
         }
-        return refFrame;
+        std::copy(refFrames, refFrames + n, out);
+        return;
     }
     
-    sv_frame_t frame = alignmentModel->fromReference(refFrame);
-    if (frame > getEndFrame()) frame = getEndFrame();
-    return frame;
+    alignmentModel->fromReference(refFrames, out, n);
+
+    sv_frame_t end = getEndFrame();
+    for (int i = 0; i < n; ++i) {
+        out[i] = std::min(out[i], end);
+    }
 }
 
 int
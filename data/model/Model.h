@@ -251,6 +251,25 @@ public:
      */
     virtual sv_frame_t alignFromReference(sv_frame_t referenceFrame) const;
 
+    /**
+     * Map each of the n frames in the given array to the reference
+     * model, as alignToReference() would, writing the results to
+     * out. The alignment model is looked up only once for the whole
+     * array, and frames in ascending order are mapped in a single
+     * pass through the alignment path.
+     */
+    virtual void alignToReference(const sv_frame_t *frames,
+                                  sv_frame_t *out, int n) const;
+
+    /**
+     * Map each of the n reference model frames in the given array to
+     * this model, as alignFromReference() would, writing the results
+     * to out. As with the array form of alignToReference(), this is
+     * fastest if the frames are in ascending order.
+     */
+    virtual void alignFromReference(const sv_frame_t *referenceFrames,
+                                    sv_frame_t *out, int n) const;
+
     /**
      * Return the completion percentage for the alignment model: 100
      * if there is no alignment model or it has been entirely
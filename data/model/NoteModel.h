@@ -94,6 +94,7 @@ public:
     }
 
     virtual ~NoteModel() {
+        m_notifier.detach();
         PlayParameterRepository::getInstance()->removePlayable
             (getId().untyped);
     }
@@ -230,6 +231,37 @@ public:
         }
     }
     
+    void addAll(const EventVector &ee) override {
+
+        if (ee.empty()) return;
+        
+        bool allChange = false;
+        sv_frame_t f0 = ee[0].getFrame(), f1 = f0;
+           
+        m_events.addAll(ee);
+
+        for (const auto &e: ee) {
+            float v = e.getValue();
+            if (!std::isnan(v) && !std::isinf(v)) {
+                if (!m_haveExtents || v < m_valueMinimum) {
+                    m_valueMinimum = v; allChange = true;
+                }
+                if (!m_haveExtents || v > m_valueMaximum) {
+                    m_valueMaximum = v; allChange = true;
+                }
+                m_haveExtents = true;
+            }
+            f0 = std::min(f0, e.getFrame());
+            f1 = std::max(f1, e.getFrame() + e.getDuration());
+        }
+        
+        m_notifier.update(f0, f1 - f0 + m_resolution);
+
+        if (allChange) {
+            emit modelChanged(getId());
+        }
+    }
+    
     void remove(Event e) override {
         m_events.remove(e);
         emit modelChangedWithin(getId(),
@@ -0,0 +1,149 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "NotificationScheduler.h"
+#include "DeferredNotifier.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QTimer>
+
+#include <algorithm>
+#include <mutex>
+
+namespace sv {
+
+NotificationScheduler *
+NotificationScheduler::m_instance = nullptr;
+
+NotificationScheduler *
+NotificationScheduler::getInstance()
+{
+    static std::once_flag f;
+    std::call_once(f, [&]() { m_instance = new NotificationScheduler(); });
+    return m_instance;
+}
+
+NotificationScheduler::NotificationScheduler() :
+    m_flushScheduled(false),
+    m_maximumRate(30),
+    m_sent(0),
+    m_suppressed(0)
+{
+    // We may be created first from a worker thread, but our timers
+    // must run in the main thread
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+NotificationScheduler::~NotificationScheduler()
+{
+}
+
+void
+NotificationScheduler::setMaximumRate(int notificationsPerSecond)
+{
+    m_maximumRate = std::max(0, notificationsPerSecond);
+}
+
+int
+NotificationScheduler::getMaximumRate() const
+{
+    return m_maximumRate;
+}
+
+int
+NotificationScheduler::getMinimumInterval() const
+{
+    int rate = m_maximumRate;
+    if (rate <= 0 || !QCoreApplication::instance()) {
+        return 0;
+    }
+    return std::max(1, 1000 / rate);
+}
+
+void
+NotificationScheduler::resetCounters()
+{
+    m_sent = 0;
+    m_suppressed = 0;
+}
+
+void
+NotificationScheduler::schedule(std::shared_ptr<Token> token)
+{
+    // The notifier only schedules itself when it is not already
+    // scheduled, so there are no duplicates in m_pending
+    QMutexLocker locker(&m_mutex);
+    m_pending.push_back(token);
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        // The timer must be started from our own thread
+        QMetaObject::invokeMethod(this, "startFlushTimer",
+                                  Qt::QueuedConnection);
+    }
+}
+
+void
+NotificationScheduler::startFlushTimer()
+{
+    QTimer::singleShot(std::max(1, getMinimumInterval()),
+                       this, SLOT(flushPending()));
+}
+
+void
+NotificationScheduler::flushPending()
+{
+    // No mutex is held while notifying, as a slot connected to the
+    // signals emitted might wait for a thread that is itself waiting
+    // to schedule a notification, or to release the model. The
+    // token's mutex is held only while taking the pending changes
+    // from the notifier, and a reference to its model: once we let
+    // go of the mutex, only that reference stops the model being
+    // destroyed while we emit its signals.
+
+    std::vector<std::shared_ptr<Token>> flushing;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_flushScheduled = false;
+        flushing.swap(m_pending);
+    }
+
+    for (const auto &token : flushing) {
+        // Declared outside the lock, as it may be the last reference
+        // to the model, whose destructor takes the lock
+        std::shared_ptr<Model> model;
+        ModelId modelId;
+        DeferredNotifier::Intervals intervals;
+        {
+            QMutexLocker locker(&token->mutex);
+            if (!token->notifier) {
+                continue;
+            }
+            modelId = token->notifier->m_modelId;
+            model = ModelById::get(modelId);
+            if (!model) {
+                // Not (or no longer) in the store: leave the changes
+                // pending, to be notified with the model's next one
+                token->notifier->unschedule();
+                continue;
+            }
+            token->notifier->takePending(intervals);
+        }
+        DeferredNotifier::emitChanges(model.get(), modelId, intervals);
+    }
+}
+
+} // end namespace sv
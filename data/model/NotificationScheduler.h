@@ -0,0 +1,131 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_NOTIFICATION_SCHEDULER_H
+#define SV_NOTIFICATION_SCHEDULER_H
+
+#include <QObject>
+#include <QMutex>
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace sv {
+
+class DeferredNotifier;
+
+/**
+ * Shared scheduler for the change notifications that models make
+ * through DeferredNotifier.
+ *
+ * A model notifying in NOTIFY_ALWAYS mode may notify straight away
+ * only if it has not done so within the minimum interval set here.
+ * Changes arriving faster than that are coalesced by the model's
+ * DeferredNotifier and flushed by the scheduler once the interval
+ * has passed, from the thread the scheduler lives in (the main
+ * thread). This stops a transform that adds thousands of features a
+ * second from flooding the event queue with queued repaint signals.
+ *
+ * Rate limiting needs a running event loop, so it is only applied
+ * when a QCoreApplication exists. Otherwise every change is notified
+ * straight away, as it would be with no limit set.
+ *
+ * The scheduler also counts the change signals sent, and the changes
+ * that were coalesced into another notification rather than being
+ * notified individually.
+ */
+class NotificationScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static NotificationScheduler *getInstance();
+
+    virtual ~NotificationScheduler();
+
+    /**
+     * Set the maximum number of notifications per second made on
+     * behalf of any one model. Zero means no limit. The default is
+     * 30.
+     */
+    void setMaximumRate(int notificationsPerSecond);
+    int getMaximumRate() const;
+
+    /**
+     * Return the minimum interval in milliseconds between
+     * notifications for a single model, or zero if notifications are
+     * not currently being rate-limited.
+     */
+    int getMinimumInterval() const;
+
+    /**
+     * Return the number of modelChanged and modelChangedWithin
+     * signals sent through DeferredNotifiers.
+     */
+    int64_t getSignalsSent() const { return m_sent; }
+
+    /**
+     * Return the number of changes that were coalesced into a later
+     * notification instead of being notified when they happened.
+     */
+    int64_t getSignalsSuppressed() const { return m_suppressed; }
+
+    void resetCounters();
+
+    /**
+     * A reference to a DeferredNotifier that is shared between it and
+     * the scheduler. DeferredNotifier::detach() clears the pointer,
+     * so the scheduler can find out whether the notifier still exists
+     * when it comes to flush it. The mutex is held while the
+     * scheduler takes the notifier's pending changes, but not while
+     * it emits them.
+     */
+    struct Token {
+        Token(DeferredNotifier *n) : notifier(n) { }
+        QMutex mutex;
+        DeferredNotifier *notifier;
+    };
+
+    /**
+     * Arrange for the pending changes of the notifier referred to by
+     * the given token to be notified once the minimum interval has
+     * passed. Called by DeferredNotifier.
+     */
+    void schedule(std::shared_ptr<Token> token);
+
+    void countSent(int n) { m_sent += n; }
+    void countSuppressed(int n) { m_suppressed += n; }
+
+protected slots:
+    void startFlushTimer();
+    void flushPending();
+
+private:
+    NotificationScheduler();
+
+    static NotificationScheduler *m_instance;
+
+    QMutex m_mutex;
+    std::vector<std::shared_ptr<Token>> m_pending;
+    bool m_flushScheduled;
+    std::atomic<int> m_maximumRate;
+    std::atomic<int64_t> m_sent;
+    std::atomic<int64_t> m_suppressed;
+};
+
+} // end namespace sv
+
+#endif
@@ -21,7 +21,10 @@
 
 #include <QStringList>
 #include <QTextStream>
-#include <set>
+
+#include <vector>
+#include <algorithm>
+#include <limits>
 
 namespace sv {
 
@@ -60,6 +63,15 @@ struct PathPoint
     }
 };
 
+/**
+ * A set of distinct PathPoints, ordered by frame and then by mapframe.
+ *
+ * The points are held as two parallel arrays, of frames and of
+ * mapframes, so that a path can be searched without chasing nodes
+ * and its points can be walked in step with a sorted sequence of
+ * frames. Adding points in order appends to the arrays, which is the
+ * usual case when building a path.
+ */
 class Path : public XmlExportable
 {
 public:
@@ -70,29 +82,98 @@ public:
     Path(const Path &) =default;
     Path &operator=(const Path &) =default;
 
-    typedef std::set<PathPoint> Points;
-
     sv_samplerate_t getSampleRate() const { return m_sampleRate; }
     int getResolution() const { return m_resolution; }
 
     int getPointCount() const {
-        return int(m_points.size());
+        return int(m_frames.size());
     }
 
-    const Points &getPoints() const {
-        return m_points;
+    /**
+     * Return the point at the given index, which must be at least 0
+     * and less than getPointCount(). Points are indexed in order.
+     * Code that walks the points in bulk may prefer getFrames() and
+     * getMapFrames().
+     */
+    PathPoint getPoint(int index) const {
+        return PathPoint(m_frames.at(index), m_mapframes.at(index));
     }
 
+    /**
+     * Return the frames of the points, in order.
+     */
+    const std::vector<sv_frame_t> &getFrames() const {
+        return m_frames;
+    }
+
+    /**
+     * Return the mapframes of the points, in the same order as
+     * getFrames().
+     */
+    const std::vector<sv_frame_t> &getMapFrames() const {
+        return m_mapframes;
+    }
+
+    /**
+     * Return true if the mapframes never decrease from one point to
+     * the next, in which case the arrays with frames and mapframes
+     * exchanged are themselves ordered and describe the reverse path.
+     */
+    bool hasOrderedMapFrames() const {
+        return std::is_sorted(m_mapframes.begin(), m_mapframes.end());
+    }
+
+    void reserve(int n) {
+        m_frames.reserve(n);
+        m_mapframes.reserve(n);
+    }
+    
     void add(PathPoint p) {
-        m_points.insert(p);
+        size_t n = m_frames.size();
+        if (n == 0 ||
+            m_frames[n-1] < p.frame ||
+            (m_frames[n-1] == p.frame && m_mapframes[n-1] < p.mapframe)) {
+            m_frames.push_back(p.frame);
+            m_mapframes.push_back(p.mapframe);
+            return;
+        }
+        size_t i = lowerBound(m_frames, m_mapframes, p.frame, p.mapframe);
+        if (i < n && m_frames[i] == p.frame && m_mapframes[i] == p.mapframe) {
+            return;
+        }
+        m_frames.insert(m_frames.begin() + i, p.frame);
+        m_mapframes.insert(m_mapframes.begin() + i, p.mapframe);
     }
     
     void remove(PathPoint p) {
-        m_points.erase(p);
+        size_t i = lowerBound(m_frames, m_mapframes, p.frame, p.mapframe);
+        if (i < m_frames.size() &&
+            m_frames[i] == p.frame && m_mapframes[i] == p.mapframe) {
+            m_frames.erase(m_frames.begin() + i);
+            m_mapframes.erase(m_mapframes.begin() + i);
+        }
     }
 
     void clear() {
-        m_points.clear();
+        m_frames.clear();
+        m_mapframes.clear();
+    }
+
+    /**
+     * Return the index of the first point in the given parallel
+     * arrays, which must be ordered by frame and then by mapframe,
+     * that does not sort before the point (frame, mapframe).
+     */
+    static size_t lowerBound(const std::vector<sv_frame_t> &frames,
+                             const std::vector<sv_frame_t> &mapframes,
+                             sv_frame_t frame, sv_frame_t mapframe) {
+        auto begin = std::lower_bound(frames.begin(), frames.end(), frame);
+        auto end = std::upper_bound(begin, frames.end(), frame);
+        size_t i0 = size_t(begin - frames.begin());
+        size_t i1 = size_t(end - frames.begin());
+        return size_t(std::lower_bound(mapframes.begin() + i0,
+                                       mapframes.begin() + i1,
+                                       mapframe) - mapframes.begin());
     }
 
     /**
@@ -110,9 +191,9 @@ public:
 
         sv_frame_t start = 0;
         sv_frame_t end = 0;
-        if (!m_points.empty()) {
-            start = m_points.begin()->frame;
-            end = m_points.rbegin()->frame + m_resolution;
+        if (!m_frames.empty()) {
+            start = m_frames.front();
+            end = m_frames.back() + m_resolution;
         }
         
         // Our dataset doesn't have its own export ID, we just use
@@ -137,8 +218,8 @@ public:
         out << indent << QString("<dataset id=\"%1\" dimensions=\"2\">\n")
             .arg(getExportId());
         
-        for (PathPoint p: m_points) {
-            p.toXml(out, indent + "  ", "");
+        for (size_t i = 0; i < m_frames.size(); ++i) {
+            PathPoint(m_frames[i], m_mapframes[i]).toXml(out, indent + "  ", "");
         }
 
         out << indent << "</dataset>\n";
@@ -150,13 +231,14 @@ public:
                                   sv_frame_t duration) const {
 
         QString s;
-        for (PathPoint p: m_points) {
-            if (p.frame < startFrame) continue;
-            if (p.frame >= startFrame + duration) break;
+        for (size_t i = lowerBound(m_frames, m_mapframes, startFrame,
+                                   std::numeric_limits<sv_frame_t>::min());
+             i < m_frames.size(); ++i) {
+            if (m_frames[i] >= startFrame + duration) break;
             s += QString("%1%2%3\n")
-                .arg(p.frame)
+                .arg(m_frames[i])
                 .arg(delimiter)
-                .arg(p.mapframe);
+                .arg(m_mapframes[i]);
         }
 
         return s;
@@ -165,7 +247,8 @@ public:
 protected:
     sv_samplerate_t m_sampleRate;
     int m_resolution;
-    Points m_points;
+    std::vector<sv_frame_t> m_frames;
+    std::vector<sv_frame_t> m_mapframes;
 };
 
 
@@ -0,0 +1,156 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "RangeSummaryBuilder.h"
+
+#include <bqvec/VectorOps.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace sv {
+
+RangeSummaryBuilder::RangeSummaryBuilder(int channels,
+                                         const int blockSizes[2]) :
+    m_channels(channels),
+    m_blockSizes { blockSizes[0], blockSizes[1] },
+    m_counts { 0, 0 }
+{
+    for (int type = 0; type < 2; ++type) {
+        m_partials[type].resize(channels, { 0.f, 0.f, 0.f });
+    }
+    if (channels > 1) {
+        m_buffers.resize(channels);
+        m_bufferPtrs.resize(channels, nullptr);
+    }
+}
+
+void
+RangeSummaryBuilder::summarise(const float *samples, int n,
+                               float &min, float &max, float &abssum)
+{
+    // Independent accumulators for each lane, so that the compiler
+    // can keep them in vector registers without reordering any
+    // individual sum
+
+    enum { Lanes = 8 };
+
+    float mins[Lanes], maxes[Lanes], sums[Lanes];
+    for (int j = 0; j < Lanes; ++j) {
+        mins[j] = samples[0];
+        maxes[j] = samples[0];
+        sums[j] = 0.f;
+    }
+
+    int i = 0;
+    for (; i + Lanes <= n; i += Lanes) {
+        for (int j = 0; j < Lanes; ++j) {
+            float s = samples[i + j];
+            mins[j] = (s < mins[j] ? s : mins[j]);
+            maxes[j] = (s > maxes[j] ? s : maxes[j]);
+            sums[j] += fabsf(s);
+        }
+    }
+    for (; i < n; ++i) {
+        float s = samples[i];
+        mins[0] = (s < mins[0] ? s : mins[0]);
+        maxes[0] = (s > maxes[0] ? s : maxes[0]);
+        sums[0] += fabsf(s);
+    }
+
+    min = mins[0];
+    max = maxes[0];
+    abssum = sums[0];
+    for (int j = 1; j < Lanes; ++j) {
+        min = std::min(min, mins[j]);
+        max = std::max(max, maxes[j]);
+        abssum += sums[j];
+    }
+}
+
+void
+RangeSummaryBuilder::process(const float *interleaved, sv_frame_t frames,
+                             RangeSummaryLevel &out0, RangeSummaryLevel &out1)
+{
+    if (frames <= 0 || m_channels <= 0) return;
+
+    if (m_channels > 1) {
+        for (int ch = 0; ch < m_channels; ++ch) {
+            if (sv_frame_t(m_buffers[ch].size()) < frames) {
+                m_buffers[ch].resize(frames);
+            }
+            m_bufferPtrs[ch] = m_buffers[ch].data();
+        }
+        breakfastquay::v_deinterleave
+            (m_bufferPtrs.data(), interleaved, m_channels, int(frames));
+    }
+
+    RangeSummaryLevel *outs[2] = { &out0, &out1 };
+
+    for (int type = 0; type < 2; ++type) {
+
+        sv_frame_t i = 0;
+
+        while (i < frames) {
+
+            int n = int(std::min(frames - i,
+                                 sv_frame_t(m_blockSizes[type] -
+                                            m_counts[type])));
+
+            for (int ch = 0; ch < m_channels; ++ch) {
+
+                const float *samples =
+                    (m_channels > 1 ? m_buffers[ch].data() : interleaved) + i;
+
+                float min, max, abssum;
+                summarise(samples, n, min, max, abssum);
+
+                Partial &p = m_partials[type][ch];
+                if (m_counts[type] == 0) {
+                    p = { min, max, abssum };
+                } else {
+                    p.min = std::min(p.min, min);
+                    p.max = std::max(p.max, max);
+                    p.abssum += abssum;
+                }
+            }
+
+            m_counts[type] += n;
+            i += n;
+
+            if (m_counts[type] == m_blockSizes[type]) {
+                complete(type, *outs[type]);
+            }
+        }
+    }
+}
+
+void
+RangeSummaryBuilder::finish(RangeSummaryLevel &out0, RangeSummaryLevel &out1)
+{
+    if (m_counts[0] > 0) complete(0, out0);
+    if (m_counts[1] > 0) complete(1, out1);
+}
+
+void
+RangeSummaryBuilder::complete(int type, RangeSummaryLevel &out)
+{
+    for (int ch = 0; ch < m_channels; ++ch) {
+        const Partial &p = m_partials[type][ch];
+        out.append(Range(p.min, p.max, p.abssum / float(m_counts[type])));
+    }
+    m_counts[type] = 0;
+}
+
+} // end namespace sv
@@ -0,0 +1,85 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_RANGE_SUMMARY_BUILDER_H
+#define SV_RANGE_SUMMARY_BUILDER_H
+
+#include "RangeSummaryLevel.h"
+
+#include "base/BaseTypes.h"
+
+#include <vector>
+
+namespace sv {
+
+/**
+ * Summarise interleaved audio into ranges at the two base block
+ * sizes of a waveform summary pyramid, as used by
+ * ReadOnlyWaveFileModel. Audio is fed in with process() in blocks of
+ * any length; each range is appended to the output level for its
+ * block size as soon as it is complete, interleaved by channel.
+ *
+ * A builder is not thread-safe, but separate builders may be used
+ * for separate parts of a file at once, so long as every part but
+ * the last starts and ends on a boundary of both block sizes.
+ */
+class RangeSummaryBuilder
+{
+public:
+    typedef RangeSummarisableTimeValueModel::Range Range;
+
+    RangeSummaryBuilder(int channels, const int blockSizes[2]);
+
+    /**
+     * Summarise the given number of frames of interleaved audio,
+     * appending completed ranges at the first block size to out0
+     * and at the second to out1.
+     */
+    void process(const float *interleaved, sv_frame_t frames,
+                 RangeSummaryLevel &out0, RangeSummaryLevel &out1);
+
+    /**
+     * Append ranges for any partially completed blocks, as at the
+     * end of the audio.
+     */
+    void finish(RangeSummaryLevel &out0, RangeSummaryLevel &out1);
+
+    /**
+     * Calculate the minimum, maximum and sum of absolute values of n
+     * samples (n > 0). Written so as to vectorise without needing
+     * reassociation of floating-point arithmetic.
+     */
+    static void summarise(const float *samples, int n,
+                          float &min, float &max, float &abssum);
+
+private:
+    struct Partial {
+        float min;
+        float max;
+        float abssum;
+    };
+
+    int m_channels;
+    int m_blockSizes[2];
+    int m_counts[2];
+    std::vector<Partial> m_partials[2];
+    std::vector<floatvec_t> m_buffers;
+    std::vector<float *> m_bufferPtrs;
+
+    void complete(int type, RangeSummaryLevel &out);
+};
+
+} // end namespace sv
+
+#endif
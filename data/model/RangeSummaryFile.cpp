@@ -0,0 +1,382 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "RangeSummaryFile.h"
+
+#include "base/TempDirectory.h"
+#include "base/Exceptions.h"
+#include "base/Profiler.h"
+#include "base/Debug.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cstring>
+
+namespace sv {
+
+// The file begins with this magic, followed by HeaderWords 64-bit
+// header values, then one 64-bit range count for each level of each
+// pyramid, then the UTF-8 key padded to a multiple of 8 bytes, then
+// the float data for each level in turn
+
+static const char fileMagic[8] = { 'S', 'V', 'R', 'N', 'G', 'S', 'U', 'M' };
+static const qint64 fileVersion = 1;
+static const qint64 maxLevels = 64;
+
+// Files not used for this long are removed regardless of size limit
+static const int maxUnusedDays = 60;
+
+static QMutex settingsMutex;
+static qint64 maxTotalSize = qint64(1) << 30;
+static QString directoryOverride;
+
+enum {
+    HeaderVersion,
+    HeaderChannels,
+    HeaderFrameCount,
+    HeaderBaseBlock0,
+    HeaderBaseBlock1,
+    HeaderLevels0,
+    HeaderLevels1,
+    HeaderKeyBytes,
+    HeaderWords
+};
+
+static qint64
+padded(qint64 bytes)
+{
+    return ((bytes + 7) / 8) * 8;
+}
+
+void
+RangeSummaryFile::setMaximumTotalSize(qint64 bytes)
+{
+    QMutexLocker locker(&settingsMutex);
+    maxTotalSize = bytes;
+}
+
+void
+RangeSummaryFile::setDirectory(QString directory)
+{
+    QMutexLocker locker(&settingsMutex);
+    directoryOverride = directory;
+}
+
+QString
+RangeSummaryFile::getFilenameFor(QString key)
+{
+    QString summaryDir;
+    {
+        QMutexLocker locker(&settingsMutex);
+        summaryDir = directoryOverride;
+    }
+
+    if (summaryDir == "") {
+
+        QDir dir = TempDirectory::getInstance()->getContainingPath();
+
+        QString summaryDirName("summaries");
+
+        QFileInfo fi(dir.filePath(summaryDirName));
+
+        if ((fi.exists() && !fi.isDir()) ||
+            (!fi.exists() && !dir.mkdir(summaryDirName))) {
+            throw DirectoryCreationFailed(fi.filePath());
+        }
+
+        summaryDir = fi.filePath();
+    }
+
+    QString filename =
+        QString::fromLatin1
+        (QCryptographicHash::hash(key.toUtf8(),
+                                  QCryptographicHash::Sha1).toHex());
+
+    return QDir(summaryDir).filePath(filename + ".summary");
+}
+
+void
+RangeSummaryFile::removeStaleFiles(QString keep)
+{
+    qint64 limit;
+    {
+        QMutexLocker locker(&settingsMutex);
+        limit = maxTotalSize;
+    }
+
+    // The modification time of a summary file is updated whenever it
+    // is used, so sorting by it gives least recently used first
+
+    QFileInfo keepInfo(keep);
+    QDir dir(keepInfo.absolutePath());
+    QFileInfoList files = dir.entryInfoList
+        ({ "*.summary" }, QDir::Files, QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    for (const auto &f : files) {
+        total += f.size();
+    }
+
+    QDateTime cutoff = QDateTime::currentDateTime().addDays(-maxUnusedDays);
+
+    for (const auto &f : files) {
+        if (total <= limit && f.lastModified() >= cutoff) {
+            break;
+        }
+        if (f.fileName() == keepInfo.fileName()) {
+            continue;
+        }
+        if (QFile::remove(f.filePath())) {
+            SVDEBUG << "RangeSummaryFile: Removed stale summary file \""
+                    << f.filePath() << "\"" << endl;
+            total -= f.size();
+        }
+    }
+}
+
+RangeSummaryFile::RangeSummaryFile(QString key) :
+    m_mapped(nullptr),
+    m_ok(false),
+    m_channels(0),
+    m_frameCount(0),
+    m_baseBlockSizes { 0, 0 }
+{
+    Profiler profiler("RangeSummaryFile::RangeSummaryFile");
+
+    QString path;
+    try {
+        path = getFilenameFor(key);
+    } catch (const std::exception &e) {
+        SVDEBUG << "RangeSummaryFile: No summary directory available: "
+                << e.what() << endl;
+        return;
+    }
+
+    m_file.setFileName(path);
+    if (!m_file.exists()) {
+        return;
+    }
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        SVDEBUG << "RangeSummaryFile: Failed to open summary file \""
+                << path << "\": " << m_file.errorString() << endl;
+        return;
+    }
+
+    qint64 size = m_file.size();
+    qint64 offset = sizeof(fileMagic) + HeaderWords * sizeof(qint64);
+    if (size < offset) {
+        SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                << "\" is too short" << endl;
+        return;
+    }
+
+    m_mapped = m_file.map(0, size);
+    if (!m_mapped) {
+        SVDEBUG << "RangeSummaryFile: Failed to map summary file \""
+                << path << "\": " << m_file.errorString() << endl;
+        return;
+    }
+
+    if (memcmp(m_mapped, fileMagic, sizeof(fileMagic))) {
+        SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                << "\" has wrong magic" << endl;
+        return;
+    }
+
+    const qint64 *header =
+        reinterpret_cast<const qint64 *>(m_mapped + sizeof(fileMagic));
+
+    if (header[HeaderVersion] != fileVersion) {
+        SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                << "\" has version " << header[HeaderVersion]
+                << ", expected " << fileVersion << endl;
+        return;
+    }
+
+    qint64 levelCounts[2] = { header[HeaderLevels0], header[HeaderLevels1] };
+    qint64 keyBytes = header[HeaderKeyBytes];
+
+    if (header[HeaderChannels] <= 0 ||
+        header[HeaderFrameCount] < 0 ||
+        levelCounts[0] < 0 || levelCounts[0] > maxLevels ||
+        levelCounts[1] < 0 || levelCounts[1] > maxLevels ||
+        keyBytes < 0 || keyBytes > size) {
+        SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                << "\" has invalid header" << endl;
+        return;
+    }
+
+    const qint64 *counts = reinterpret_cast<const qint64 *>(m_mapped + offset);
+    offset += (levelCounts[0] + levelCounts[1]) * sizeof(qint64);
+
+    if (offset + padded(keyBytes) > size) {
+        SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                << "\" is truncated" << endl;
+        return;
+    }
+
+    QByteArray storedKey(reinterpret_cast<const char *>(m_mapped + offset),
+                         int(keyBytes));
+    if (storedKey != key.toUtf8()) {
+        SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                << "\" is for a different key" << endl;
+        return;
+    }
+    offset += padded(keyBytes);
+
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        for (qint64 level = 0; level < levelCounts[cacheType]; ++level) {
+            qint64 count = *counts++;
+            qint64 rangeBytes = RangeSummaryLevel::ValuesPerRange
+                * sizeof(float);
+            // Compare before multiplying, as a corrupt count could
+            // overflow the byte count
+            if (count < 0 || offset > size ||
+                count > (size - offset) / rangeBytes) {
+                SVDEBUG << "RangeSummaryFile: Summary file \"" << path
+                        << "\" is truncated" << endl;
+                m_levels[0].clear();
+                m_levels[1].clear();
+                return;
+            }
+            qint64 bytes = count * rangeBytes;
+            m_levels[cacheType].push_back
+                ({ reinterpret_cast<const float *>(m_mapped + offset), count });
+            offset += padded(bytes);
+        }
+    }
+
+    m_channels = int(header[HeaderChannels]);
+    m_frameCount = header[HeaderFrameCount];
+    m_baseBlockSizes[0] = int(header[HeaderBaseBlock0]);
+    m_baseBlockSizes[1] = int(header[HeaderBaseBlock1]);
+    m_ok = true;
+
+    // Mark the file as recently used, for removeStaleFiles()
+    m_file.setFileTime(QDateTime::currentDateTime(),
+                       QFileDevice::FileModificationTime);
+
+    SVDEBUG << "RangeSummaryFile: Mapped summary file \"" << path
+            << "\" with " << m_channels << " channels and " << m_frameCount
+            << " frames" << endl;
+}
+
+RangeSummaryFile::~RangeSummaryFile()
+{
+    if (m_mapped) {
+        m_file.unmap(m_mapped);
+    }
+    m_file.close();
+}
+
+int
+RangeSummaryFile::getBaseBlockSize(int cacheType) const
+{
+    if (cacheType < 0 || cacheType > 1) return 0;
+    return m_baseBlockSizes[cacheType];
+}
+
+RangeSummaryFile::LevelData
+RangeSummaryFile::getLevels(int cacheType) const
+{
+    if (!m_ok || cacheType < 0 || cacheType > 1) return {};
+    return m_levels[cacheType];
+}
+
+bool
+RangeSummaryFile::write(QString key,
+                        int channels,
+                        sv_frame_t frameCount,
+                        const int baseBlockSizes[2],
+                        const RangeSummaryPyramid pyramids[2])
+{
+    Profiler profiler("RangeSummaryFile::write");
+
+    QString path;
+    try {
+        path = getFilenameFor(key);
+    } catch (const std::exception &e) {
+        SVDEBUG << "RangeSummaryFile::write: No summary directory available: "
+                << e.what() << endl;
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        SVDEBUG << "RangeSummaryFile::write: Failed to open summary file \""
+                << path << "\": " << file.errorString() << endl;
+        return false;
+    }
+
+    QByteArray keyBytes = key.toUtf8();
+    const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    qint64 header[HeaderWords];
+    header[HeaderVersion] = fileVersion;
+    header[HeaderChannels] = channels;
+    header[HeaderFrameCount] = frameCount;
+    header[HeaderBaseBlock0] = baseBlockSizes[0];
+    header[HeaderBaseBlock1] = baseBlockSizes[1];
+    header[HeaderLevels0] = pyramids[0].getLevelCount();
+    header[HeaderLevels1] = pyramids[1].getLevelCount();
+    header[HeaderKeyBytes] = keyBytes.size();
+
+    file.write(fileMagic, sizeof(fileMagic));
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        for (int level = 0; level < header[HeaderLevels0 + cacheType]; ++level) {
+            qint64 count = pyramids[cacheType].getLevel(level).size();
+            file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        }
+    }
+
+    file.write(keyBytes);
+    file.write(zeros, padded(keyBytes.size()) - keyBytes.size());
+
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        for (int level = 0; level < header[HeaderLevels0 + cacheType]; ++level) {
+            qint64 bytes = 0;
+            pyramids[cacheType].getLevel(level).forEachSpan
+                ([&](const float *data, sv_frame_t count) {
+                     qint64 spanBytes = count *
+                         RangeSummaryLevel::ValuesPerRange * sizeof(float);
+                     file.write(reinterpret_cast<const char *>(data),
+                                spanBytes);
+                     bytes += spanBytes;
+                 });
+            file.write(zeros, padded(bytes) - bytes);
+        }
+    }
+
+    if (!file.commit()) {
+        SVDEBUG << "RangeSummaryFile::write: Failed to write summary file \""
+                << path << "\": " << file.errorString() << endl;
+        return false;
+    }
+
+    SVDEBUG << "RangeSummaryFile::write: Wrote summary file \"" << path
+            << "\"" << endl;
+
+    removeStaleFiles(path);
+    return true;
+}
+
+} // end namespace sv
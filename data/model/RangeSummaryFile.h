@@ -0,0 +1,117 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_RANGE_SUMMARY_FILE_H
+#define SV_RANGE_SUMMARY_FILE_H
+
+#include "RangeSummaryPyramid.h"
+
+#include <QString>
+#include <QFile>
+
+#include <vector>
+#include <utility>
+
+namespace sv {
+
+/**
+ * A persistent copy of the waveform summary pyramids calculated by
+ * ReadOnlyWaveFileModel, kept in a "summaries" subdirectory of the
+ * TempDirectory's containing path so that it survives between runs.
+ *
+ * Each file is identified by a key string, which should encode
+ * everything that the summaries depend on (the audio file's path,
+ * size and modification time, the sample rate conversion and so
+ * on). The file name is derived from a hash of the key, and the key
+ * itself is stored in the file and checked on loading.
+ *
+ * A file that is found is memory-mapped, and the levels returned by
+ * getLevels() point directly into the mapped data, so they must not
+ * be used after the RangeSummaryFile has been destroyed.
+ *
+ * The directory is kept within a total size limit: each write
+ * removes the least recently used files until the rest fit within
+ * it, as well as any file that has not been used for a long time.
+ */
+class RangeSummaryFile
+{
+public:
+    /**
+     * Look for and map the summary file for the given key. Call
+     * isOK() to find out whether a usable one was found.
+     */
+    RangeSummaryFile(QString key);
+    ~RangeSummaryFile();
+
+    bool isOK() const { return m_ok; }
+
+    int getChannelCount() const { return m_channels; }
+    sv_frame_t getFrameCount() const { return m_frameCount; }
+    int getBaseBlockSize(int cacheType) const;
+
+    typedef std::vector<std::pair<const float *, sv_frame_t>> LevelData;
+
+    /**
+     * Return the levels of the pyramid for the given cache type (0
+     * or 1), as a pointer to the mapped range data and a count of
+     * ranges for each level, suitable for passing to
+     * RangeSummaryPyramid::setExternal().
+     */
+    LevelData getLevels(int cacheType) const;
+
+    /**
+     * Write the given pyramids to the summary file for the given
+     * key, replacing any existing file atomically. Return false if
+     * the file could not be written.
+     */
+    static bool write(QString key,
+                      int channels,
+                      sv_frame_t frameCount,
+                      const int baseBlockSizes[2],
+                      const RangeSummaryPyramid pyramids[2]);
+
+    /**
+     * Set the maximum total size in bytes of the summary files
+     * kept. Files beyond this are removed, least recently used
+     * first, whenever a new one is written. The default is 1GB.
+     */
+    static void setMaximumTotalSize(qint64 bytes);
+
+    /**
+     * Use the given directory for summary files instead of the
+     * default one in the TempDirectory's containing path. Pass an
+     * empty string to return to the default. This is intended for
+     * tests.
+     */
+    static void setDirectory(QString directory);
+
+private:
+    RangeSummaryFile(const RangeSummaryFile &) =delete;
+    RangeSummaryFile &operator=(const RangeSummaryFile &) =delete;
+
+    static QString getFilenameFor(QString key);
+    static void removeStaleFiles(QString keep);
+
+    QFile m_file;
+    uchar *m_mapped;
+    bool m_ok;
+    int m_channels;
+    sv_frame_t m_frameCount;
+    int m_baseBlockSizes[2];
+    LevelData m_levels[2];
+};
+
+} // end namespace sv
+
+#endif
@@ -0,0 +1,182 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_RANGE_SUMMARY_LEVEL_H
+#define SV_RANGE_SUMMARY_LEVEL_H
+
+#include "RangeSummarisableTimeValueModel.h"
+
+#include "base/BaseTypes.h"
+
+#include <bqvec/VectorOps.h>
+
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+namespace sv {
+
+/**
+ * One level of a waveform summary pyramid: a sequence of ranges,
+ * each held as three floats (min, max, absmean). A level is either
+ * filled by appending to it, or refers to ranges held elsewhere in
+ * the same layout, such as in a memory-mapped RangeSummaryFile.
+ *
+ * Appended ranges are stored in chunks that double in size, so that
+ * nothing is ever moved once written. The number of ranges is
+ * published atomically after they have been written, so a level may
+ * be read from any number of threads without locking while a single
+ * thread appends to it.
+ */
+class RangeSummaryLevel
+{
+public:
+    typedef RangeSummarisableTimeValueModel::Range Range;
+
+    enum { ValuesPerRange = 3 };
+
+    RangeSummaryLevel() :
+        m_external(nullptr), m_count(0) {
+        std::fill(m_chunks, m_chunks + MaxChunks, nullptr);
+    }
+
+    ~RangeSummaryLevel() {
+        for (int k = 0; k < MaxChunks; ++k) {
+            delete[] m_chunks[k];
+        }
+    }
+
+    /**
+     * Make this level refer to count ranges held in the given
+     * data. The level must be empty, and the data must outlive it.
+     */
+    void setExternal(const float *data, sv_frame_t count) {
+        if (size() > 0) {
+            throw std::logic_error("Summary level is not empty");
+        }
+        m_external = data;
+        m_count.store(count, std::memory_order_release);
+    }
+
+    sv_frame_t size() const {
+        return m_count.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Return range i, which must be less than a value previously
+     * returned by size().
+     */
+    Range at(sv_frame_t i) const {
+        const float *v;
+        if (m_external) {
+            v = m_external + i * ValuesPerRange;
+        } else {
+            int chunk;
+            sv_frame_t offset;
+            locate(i, chunk, offset);
+            v = m_chunks[chunk] + offset * ValuesPerRange;
+        }
+        return Range(v[0], v[1], v[2]);
+    }
+
+    void append(const Range &r) {
+        float v[ValuesPerRange] = { r.min(), r.max(), r.absmean() };
+        appendValues(v, 1);
+    }
+
+    void append(const RangeSummaryLevel &other) {
+        other.forEachSpan([this](const float *data, sv_frame_t count) {
+                              appendValues(data, count);
+                          });
+    }
+
+    /**
+     * Empty the level, keeping any chunks already allocated. Not
+     * for use while any other thread may be reading.
+     */
+    void clear() {
+        m_external = nullptr;
+        m_count.store(0, std::memory_order_release);
+    }
+
+    /**
+     * Call f(data, count) for each contiguous span of the ranges, in
+     * order, where data holds count * ValuesPerRange floats.
+     */
+    template <typename F>
+    void forEachSpan(F f) const {
+        sv_frame_t count = size();
+        if (m_external) {
+            if (count > 0) f(m_external, count);
+            return;
+        }
+        sv_frame_t done = 0;
+        for (int k = 0; done < count; ++k) {
+            sv_frame_t n = std::min(chunkSize(k), count - done);
+            f(static_cast<const float *>(m_chunks[k]), n);
+            done += n;
+        }
+    }
+
+private:
+    RangeSummaryLevel(const RangeSummaryLevel &) =delete;
+    RangeSummaryLevel &operator=(const RangeSummaryLevel &) =delete;
+
+    enum { FirstChunkSize = 1024, MaxChunks = 40 };
+
+    static sv_frame_t chunkSize(int chunk) {
+        return sv_frame_t(FirstChunkSize) << chunk;
+    }
+
+    static void locate(sv_frame_t i, int &chunk, sv_frame_t &offset) {
+        // Chunk k starts at range FirstChunkSize * (2^k - 1)
+        sv_frame_t q = i / FirstChunkSize + 1;
+        chunk = 0;
+        while ((q >> (chunk + 1)) != 0) ++chunk;
+        offset = i - FirstChunkSize * ((sv_frame_t(1) << chunk) - 1);
+    }
+
+    void appendValues(const float *data, sv_frame_t count) {
+        if (m_external) {
+            throw std::logic_error("Cannot append to a read-only summary level");
+        }
+        sv_frame_t n = m_count.load(std::memory_order_relaxed);
+        while (count > 0) {
+            int chunk;
+            sv_frame_t offset;
+            locate(n, chunk, offset);
+            if (chunk >= MaxChunks) {
+                throw std::length_error("Summary level is full");
+            }
+            if (!m_chunks[chunk]) {
+                m_chunks[chunk] = new float[chunkSize(chunk) * ValuesPerRange];
+            }
+            sv_frame_t here = std::min(count, chunkSize(chunk) - offset);
+            breakfastquay::v_copy(m_chunks[chunk] + offset * ValuesPerRange,
+                                  data, int(here * ValuesPerRange));
+            data += here * ValuesPerRange;
+            count -= here;
+            n += here;
+        }
+        m_count.store(n, std::memory_order_release);
+    }
+
+    const float *m_external;
+    float *m_chunks[MaxChunks];
+    std::atomic<sv_frame_t> m_count;
+};
+
+} // end namespace sv
+
+#endif
@@ -0,0 +1,121 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "RangeSummaryPyramid.h"
+
+#include <algorithm>
+
+namespace sv {
+
+void
+RangeSummaryPyramid::append(const RangeSummaryLevel &added, int channels)
+{
+    if (added.size() == 0 || channels <= 0) return;
+
+    m_levels[0].append(added);
+
+    int levelCount = m_levelCount.load(std::memory_order_relaxed);
+
+    for (int level = 0; level < levelCount; ++level) {
+
+        sv_frame_t below = m_levels[level].size() / channels;
+        if (below < 2) break;
+
+        if (level + 1 == levelCount) {
+            if (levelCount == MaxLevels) break;
+            ++levelCount;
+        }
+
+        const RangeSummaryLevel &down = m_levels[level];
+        RangeSummaryLevel &up = m_levels[level + 1];
+
+        for (sv_frame_t i = up.size() / channels; i < below / 2; ++i) {
+            for (int ch = 0; ch < channels; ++ch) {
+                Range a = down.at((i * 2) * channels + ch);
+                Range b = down.at((i * 2 + 1) * channels + ch);
+                up.append(Range(std::min(a.min(), b.min()),
+                                std::max(a.max(), b.max()),
+                                (a.absmean() + b.absmean()) / 2.f));
+            }
+        }
+    }
+
+    // Publish any new level only once it has something in it
+    m_levelCount.store(levelCount, std::memory_order_release);
+}
+
+void
+RangeSummaryPyramid::setExternal(const std::vector<std::pair<const float *,
+                                                             sv_frame_t>> &levels)
+{
+    int n = std::min(int(levels.size()), int(MaxLevels));
+    for (int level = 0; level < n; ++level) {
+        m_levels[level].setExternal(levels[level].first, levels[level].second);
+    }
+    m_levelCount.store(std::max(n, 1), std::memory_order_release);
+}
+
+sv_frame_t
+RangeSummaryPyramid::summarise(int channels, int channel,
+                               sv_frame_t i0, sv_frame_t i1,
+                               Range &range) const
+{
+    int levelCount = getLevelCount();
+
+    float min = 0.f, max = 0.f, total = 0.f;
+    sv_frame_t got = 0;
+
+    while (i0 < i1) {
+
+        int level = 0;
+        while (level + 1 < levelCount) {
+            sv_frame_t span = sv_frame_t(2) << level;
+            if (i0 % span != 0 || i0 + span > i1) break;
+            if ((i0 / span) * channels + channel >=
+                m_levels[level + 1].size()) break;
+            ++level;
+        }
+
+        sv_frame_t index = (i0 >> level) * channels + channel;
+        if (index >= m_levels[level].size()) break;
+
+        Range r = m_levels[level].at(index);
+        if (r.max() > max || got == 0) max = r.max();
+        if (r.min() < min || got == 0) min = r.min();
+
+        sv_frame_t n = sv_frame_t(1) << level;
+        total += r.absmean() * float(n);
+        got += n;
+        i0 += n;
+    }
+
+    if (got > 0) {
+        range = Range(min, max, total / float(got));
+    }
+    return got;
+}
+
+size_t
+RangeSummaryPyramid::getByteSize() const
+{
+    size_t bytes = 0;
+    int levelCount = getLevelCount();
+    for (int level = 0; level < levelCount; ++level) {
+        bytes += size_t(m_levels[level].size()) * sizeof(float) *
+            RangeSummaryLevel::ValuesPerRange;
+    }
+    return bytes;
+}
+
+} // end namespace sv
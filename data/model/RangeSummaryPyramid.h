@@ -0,0 +1,92 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_RANGE_SUMMARY_PYRAMID_H
+#define SV_RANGE_SUMMARY_PYRAMID_H
+
+#include "RangeSummaryLevel.h"
+
+#include <vector>
+#include <utility>
+#include <atomic>
+
+namespace sv {
+
+/**
+ * A pyramid of waveform summary levels. Level 0 holds ranges at a
+ * base block size, interleaved by channel, and each level above
+ * holds ranges of twice the block size of the one below it.
+ *
+ * The pyramid may be read from any number of threads without locking
+ * while a single thread appends to it: levels are never moved, and
+ * both the number of levels and the number of ranges in each are
+ * published atomically.
+ */
+class RangeSummaryPyramid
+{
+public:
+    typedef RangeSummarisableTimeValueModel::Range Range;
+
+    enum { MaxLevels = 48 };
+
+    RangeSummaryPyramid() : m_levelCount(1) { }
+
+    int getLevelCount() const {
+        return m_levelCount.load(std::memory_order_acquire);
+    }
+
+    const RangeSummaryLevel &getLevel(int level) const {
+        return m_levels[level];
+    }
+
+    /**
+     * Append the given base-level ranges, interleaved by channel, and
+     * extend the levels above them. The pyramid must not refer to
+     * external data.
+     */
+    void append(const RangeSummaryLevel &added, int channels);
+
+    /**
+     * Make the pyramid refer to the given external levels, each a
+     * pointer to range data and a count of ranges. The pyramid must
+     * be empty, and the data must outlive it.
+     */
+    void setExternal(const std::vector<std::pair<const float *,
+                                                 sv_frame_t>> &levels);
+
+    /**
+     * Summarise the given channel across base-level entries i0 to i1
+     * (counting in blocks of the base block size, not in ranges),
+     * using at each step the largest aligned entry that lies within
+     * the range and has been filled. A block aligned to its own size
+     * is therefore read from a single entry. Return the number of
+     * base-level entries summarised, which is less than i1 - i0 if
+     * the pyramid has not been filled that far.
+     */
+    sv_frame_t summarise(int channels, int channel,
+                         sv_frame_t i0, sv_frame_t i1, Range &range) const;
+
+    /**
+     * Return the total number of bytes of range data held.
+     */
+    size_t getByteSize() const;
+
+private:
+    RangeSummaryLevel m_levels[MaxLevels];
+    std::atomic<int> m_levelCount;
+};
+
+} // end namespace sv
+
+#endif
@@ -15,6 +15,8 @@
 
 #include "ReadOnlyWaveFileModel.h"
 
+#include "RangeSummaryBuilder.h"
+
 #include "fileio/AudioFileReader.h"
 #include "fileio/AudioFileReaderFactory.h"
 
@@ -22,8 +24,10 @@
 
 #include "base/Preferences.h"
 #include "base/PlayParameterRepository.h"
+#include "base/TempDirectory.h"
 
 #include <QFileInfo>
+#include <QDateTime>
 #include <QTextStream>
 
 #include <iostream>
@@ -39,9 +43,28 @@ using namespace std;
 
 namespace sv {
 
+static bool
+isInTempDirectory(QString canonicalPath)
+{
+    // Files in the temporary directory (recordings, downloads and
+    // the like) won't be seen again after this run, so there is no
+    // point in keeping summaries for them
+    try {
+        QString tempPath =
+            QFileInfo(TempDirectory::getInstance()->getPath())
+            .canonicalFilePath();
+        return tempPath != "" &&
+            canonicalPath.startsWith(tempPath + "/");
+    } catch (const std::exception &) {
+        return false;
+    }
+}
+
 PowerOfSqrtTwoZoomConstraint
 ReadOnlyWaveFileModel::m_zoomConstraint;
 
+static const sv_frame_t readBlockSize = 32768;
+
 ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, sv_samplerate_t targetRate) :
     m_path(source.getLocation()),
     m_reader(nullptr),
@@ -84,6 +107,22 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, sv_samplerate_t
             SVDEBUG << "ReadOnlyWaveFileModel::ReadOnlyWaveFileModel: reader rate: "
                       << m_reader->getSampleRate() << endl;
         }
+
+        // Everything the summaries depend on, for identifying a
+        // summary file saved on a previous load of the same audio
+        QFileInfo fi(source.getLocalFilename());
+        if (m_reader && fi.exists() &&
+            prefs->getKeepSummaryFiles() &&
+            !isInTempDirectory(fi.canonicalFilePath())) {
+            m_summaryKey = QString("%1|%2|%3|%4|%5|%6|%7")
+                .arg(fi.canonicalFilePath())
+                .arg(fi.size())
+                .arg(fi.lastModified().toMSecsSinceEpoch())
+                .arg(targetRate)
+                .arg(m_reader->getSampleRate())
+                .arg(int(params.normalisation))
+                .arg(int(params.gaplessMode));
+        }
     }
 
     if (m_reader) setObjectName(m_reader->getTitle());
@@ -163,8 +202,8 @@ ReadOnlyWaveFileModel::~ReadOnlyWaveFileModel()
 
     SVDEBUG << "ReadOnlyWaveFileModel(" << getId()
             << "): Destructor exiting; we had caches of "
-            << (m_cache[0].size() * sizeof(Range)) << " and "
-            << (m_cache[1].size() * sizeof(Range)) << " bytes" << endl;
+            << m_cache[0].getByteSize() << " and "
+            << m_cache[1].getByteSize() << " bytes" << endl;
 }
 
 bool
@@ -497,9 +536,10 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
 
     } else {
 
-        QMutexLocker locker(&m_mutex);
+        // No locking needed: the cache is appended to atomically and
+        // never moves
     
-        const RangeBlock &cache = m_cache[cacheType];
+        const RangeSummaryPyramid &cache = m_cache[cacheType];
 
         blockSize = roundedBlockSize;
 
@@ -514,35 +554,21 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
         sv_frame_t startIndex = start / cacheBlock;
         sv_frame_t endIndex = (start + count) / cacheBlock;
 
-        float max = 0.0, min = 0.0, total = 0.0;
-        sv_frame_t i = 0, got = 0;
-
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
-        cerr << "blockSize is " << blockSize << ", cacheBlock " << cacheBlock << ", start " << start << ", count " << count << " (frame count " << getFrameCount() << "), power is " << power << ", div is " << div << ", startIndex " << startIndex << ", endIndex " << endIndex << endl;
+        cerr << "blockSize is " << blockSize << ", cacheBlock " << cacheBlock << ", start " << start << ", count " << count << " (frame count " << getFrameCount() << "), power is " << power << ", div is " << div << ", startIndex " << startIndex << ", endIndex " << endIndex << ", levels " << cache.getLevelCount() << endl;
 #endif
 
-        for (i = 0; i <= endIndex - startIndex; ) {
-        
-            sv_frame_t index = (i + startIndex) * channels + channel;
-            if (!in_range_for(cache, index)) break;
-            
-            const Range &range = cache[index];
-            if (range.max() > max || got == 0) max = range.max();
-            if (range.min() < min || got == 0) min = range.min();
-            total += range.absmean();
-            
-            ++i;
-            ++got;
-            
-            if (got == div) {
-                ranges.push_back(Range(min, max, total / float(got)));
-                min = max = total = 0.0f;
-                got = 0;
+        for (sv_frame_t i = startIndex; i <= endIndex; i += div) {
+            Range range;
+            sv_frame_t want = std::min(div, endIndex + 1 - i);
+            sv_frame_t got = cache.summarise(channels, channel,
+                                             i, i + want, range);
+            if (got > 0) {
+                ranges.push_back(range);
+            }
+            if (got < want) {
+                break;
             }
-        }
-                
-        if (got > 0) {
-            ranges.push_back(Range(min, max, total / float(got)));
         }
     }
 
@@ -669,16 +695,84 @@ ReadOnlyWaveFileModel::cacheFilled()
     emit ready(getId());
 }
 
+int
+ReadOnlyWaveFileModel::getCacheBlockSize(int cacheType)
+{
+    int base = (1 << m_zoomConstraint.getMinCachePower());
+    if (cacheType == 0) return base;
+    return int(base * sqrt(2.) + 0.01);
+}
+
+bool
+ReadOnlyWaveFileModel::useSummaryFile(std::unique_ptr<RangeSummaryFile> file)
+{
+    if (file->getChannelCount() != getChannelCount() ||
+        file->getFrameCount() != getFrameCount() ||
+        file->getBaseBlockSize(0) != getCacheBlockSize(0) ||
+        file->getBaseBlockSize(1) != getCacheBlockSize(1)) {
+        SVDEBUG << "ReadOnlyWaveFileModel(" << getId() << "): Summary file "
+                << "does not match audio, ignoring it" << endl;
+        return false;
+    }
+    
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        m_cache[cacheType].setExternal(file->getLevels(cacheType));
+    }
+    m_summaryFile = std::move(file);
+
+    SVDEBUG << "ReadOnlyWaveFileModel(" << getId() << "): Using summaries "
+            << "from summary file" << endl;
+    return true;
+}
+
+void
+ReadOnlyWaveFileModel::writeSummaryFile(int channels) const
+{
+    // The fill is complete and the fill thread is the only writer,
+    // so we can read the caches here without locking
+    
+    if (m_summaryKey == "") return;
+
+    int baseBlockSizes[2] = { getCacheBlockSize(0), getCacheBlockSize(1) };
+    RangeSummaryFile::write(m_summaryKey, channels, getFrameCount(),
+                            baseBlockSizes, m_cache);
+}
+
+void
+ReadOnlyWaveFileModel::appendToCache(RangeSummaryLevel added[2], int channels)
+{
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        m_cache[cacheType].append(added[cacheType], channels);
+        added[cacheType].clear();
+    }
+}
+
+void
+ReadOnlyWaveFileModel::RangeCacheSegmentThread::run()
+{
+    sv_frame_t frame = m_start;
+
+    while (frame < m_end && !m_model.m_exiting) {
+
+        floatvec_t block = m_model.m_reader->getInterleavedFrames
+            (frame, std::min(m_end - frame, readBlockSize));
+
+        sv_frame_t gotBlockSize = block.size() / m_channels;
+        if (gotBlockSize == 0) break;
+
+        m_builder.process(block.data(), gotBlockSize, m_levels[0], m_levels[1]);
+        frame += gotBlockSize;
+    }
+
+    m_builder.finish(m_levels[0], m_levels[1]);
+}
+
 void
 ReadOnlyWaveFileModel::RangeCacheFillThread::run()
 {
-    int cacheBlockSize[2];
-    cacheBlockSize[0] = (1 << m_model.m_zoomConstraint.getMinCachePower());
-    cacheBlockSize[1] = (int((1 << m_model.m_zoomConstraint.getMinCachePower()) *
-                                        sqrt(2.) + 0.01));
+    int cacheBlockSize[2] = { getCacheBlockSize(0), getCacheBlockSize(1) };
     
     sv_frame_t frame = 0;
-    const sv_frame_t readBlockSize = 32768;
     floatvec_t block;
 
     if (!m_model.isOK()) return;
@@ -699,14 +793,69 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
         }
     }
 
-    Range *range = new Range[2 * channels];
-    float *means = new float[2 * channels];
-    int count[2];
-    count[0] = count[1] = 0;
-    for (int i = 0; i < 2 * channels; ++i) {
-        means[i] = 0.f;
+    if (m_model.m_summaryKey != "") {
+        auto file = std::make_unique<RangeSummaryFile>(m_model.m_summaryKey);
+        if (file->isOK()) {
+            // We can't check the summaries against the audio until we
+            // know its length, so wait for any decode to complete
+            while (updating && !m_model.m_exiting) {
+                usleep(100000);
+                updating = m_model.m_reader->isUpdating();
+            }
+            if (m_model.m_exiting) {
+                return;
+            }
+            m_frameCount = m_model.getFrameCount();
+            if (m_model.useSummaryFile(std::move(file))) {
+                m_fillExtent = m_frameCount;
+                return;
+            }
+        }
     }
+    
+    RangeSummaryBuilder builder(channels, cacheBlockSize);
+    RangeSummaryLevel filled[2];
+
+    // If the whole file is available and quick to seek in, share the
+    // work among several threads. We fill the first segment here as
+    // usual, so that it appears progressively, and the others are
+    // appended to the cache in order as we reach them. Segments
+    // start on a boundary of both cache block sizes, so they join up
+    // exactly.
+    
+    std::vector<std::unique_ptr<RangeCacheSegmentThread>> segments;
+    sv_frame_t fillEnd = -1;
 
+    m_frameCount = m_model.getFrameCount();
+    
+    if (!updating && m_model.m_reader->isQuicklySeekable()) {
+
+        int threads = std::min(QThread::idealThreadCount(), 8);
+        sv_frame_t minSegmentSize = readBlockSize * 16;
+        if (threads > 1 && m_frameCount >= minSegmentSize * 2) {
+
+            sv_frame_t alignment =
+                sv_frame_t(cacheBlockSize[0]) * cacheBlockSize[1];
+            sv_frame_t segmentSize =
+                std::max(m_frameCount / threads, minSegmentSize);
+            segmentSize = ((segmentSize + alignment - 1) / alignment)
+                * alignment;
+
+            for (sv_frame_t start = segmentSize; start < m_frameCount;
+                 start += segmentSize) {
+                segments.push_back
+                    (std::make_unique<RangeCacheSegmentThread>
+                     (m_model, channels, cacheBlockSize, start,
+                      std::min(start + segmentSize, m_frameCount)));
+                segments.back()->start();
+            }
+
+            fillEnd = segmentSize;
+            
+            SVDEBUG << "ReadOnlyWaveFileModel(" << m_model.getId() << ")::RangeCacheFillThread: filling in " << segments.size() + 1 << " segments of " << segmentSize << " frames" << endl;
+        }
+    }
+    
     SVDEBUG << "ReadOnlyWaveFileModel(" << m_model.getId() << ")::RangeCacheFillThread: entering loop" << endl;
     
     bool first = true;
@@ -716,61 +865,34 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
         updating = m_model.m_reader->isUpdating();
         m_frameCount = m_model.getFrameCount();
 
-        m_model.m_mutex.lock();
-
-        while (frame < m_frameCount) {
+        sv_frame_t end = m_frameCount;
+        if (fillEnd >= 0 && fillEnd < end) {
+            end = fillEnd;
+        }
 
-            m_model.m_mutex.unlock();
+        while (frame < end) {
 
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
             cout << "ReadOnlyWaveFileModel(" << m_model.objectName() << ")::fill inner loop: frame = " << frame << ", count = " << m_frameCount << ", blocksize " << readBlockSize << endl;
 #endif
 
             if (updating && (frame + readBlockSize > m_frameCount)) {
-                m_model.m_mutex.lock(); // must be locked on exiting loop
                 break;
             }
 
-            block = m_model.m_reader->getInterleavedFrames(frame, readBlockSize);
+            block = m_model.m_reader->getInterleavedFrames
+                (frame, std::min(end - frame, readBlockSize));
 
             sv_frame_t gotBlockSize = block.size() / channels;
-
-            m_model.m_mutex.lock();
-
-            for (sv_frame_t i = 0; i < gotBlockSize; ++i) {
-                
-                for (int ch = 0; ch < channels; ++ch) {
-
-                    sv_frame_t index = channels * i + ch;
-                    float sample = block[index];
-                    
-                    for (int cacheType = 0; cacheType < 2; ++cacheType) {
-                        sv_frame_t rangeIndex = ch * 2 + cacheType;
-                        range[rangeIndex].sample(sample);
-                        means[rangeIndex] += fabsf(sample);
-                    }
-                }
-
-                for (int cacheType = 0; cacheType < 2; ++cacheType) {
-
-                    if (++count[cacheType] == cacheBlockSize[cacheType]) {
-                        
-                        for (int ch = 0; ch < int(channels); ++ch) {
-                            int rangeIndex = ch * 2 + cacheType;
-                            means[rangeIndex] = means[rangeIndex] / float(count[cacheType]);
-                            range[rangeIndex].setAbsmean(means[rangeIndex]);
-                            m_model.m_cache[cacheType].push_back(range[rangeIndex]);
-                            range[rangeIndex] = Range();
-                            means[rangeIndex] = 0.f;
-                        }
-
-                        count[cacheType] = 0;
-                    }
-                }
-                
-                ++frame;
+            if (gotBlockSize == 0) {
+                break;
             }
 
+            builder.process(block.data(), gotBlockSize, filled[0], filled[1]);
+            frame += gotBlockSize;
+
+            m_model.appendToCache(filled, channels);
+
             if (m_model.m_exiting) {
                 SVDEBUG << "ReadOnlyWaveFileModel(" << m_model.getId() << ")::RangeCacheFillThread: exiting from inner loop" << endl;
                 break;
@@ -778,8 +900,6 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
             m_fillExtent = frame;
         }
 
-        m_model.m_mutex.unlock();
-            
         first = false;
         if (m_model.m_exiting) {
             SVDEBUG << "ReadOnlyWaveFileModel(" << m_model.getId() << ")::RangeCacheFillThread: exiting from outer loop" << endl;
@@ -796,34 +916,30 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
 
     if (!m_model.m_exiting) {
 
-        QMutexLocker locker(&m_model.m_mutex);
-
-        for (int cacheType = 0; cacheType < 2; ++cacheType) {
-
-            if (count[cacheType] > 0) {
+        builder.finish(filled[0], filled[1]);
+        m_model.appendToCache(filled, channels);
 
-                for (int ch = 0; ch < int(channels); ++ch) {
-                    int rangeIndex = ch * 2 + cacheType;
-                    means[rangeIndex] = means[rangeIndex] / float(count[cacheType]);
-                    range[rangeIndex].setAbsmean(means[rangeIndex]);
-                    m_model.m_cache[cacheType].push_back(range[rangeIndex]);
-                    range[rangeIndex] = Range();
-                    means[rangeIndex] = 0.f;
-                }
-
-                count[cacheType] = 0;
-            }
+        for (auto &segment : segments) {
+            segment->wait();
+            if (m_model.m_exiting) break;
+            m_model.appendToCache(segment->getLevels(), channels);
+            m_fillExtent = segment->getEnd();
         }
     }
-    
-    delete[] means;
-    delete[] range;
 
+    for (auto &segment : segments) {
+        segment->wait();
+    }
+    
     m_fillExtent = m_frameCount;
 
+    if (!m_model.m_exiting) {
+        m_model.writeSummaryFile(channels);
+    }
+
 #ifdef DEBUG_WAVE_FILE_MODEL        
     for (int cacheType = 0; cacheType < 2; ++cacheType) {
-        SVCERR << "ReadOnlyWaveFileModel(" << m_model.objectName() << "): Cache type " << cacheType << " now contains " << m_model.m_cache[cacheType].size() << " ranges" << endl;
+        SVCERR << "ReadOnlyWaveFileModel(" << m_model.objectName() << "): Cache type " << cacheType << " now has " << m_model.m_cache[cacheType].getLevelCount() << " levels, with " << m_model.m_cache[cacheType].getLevel(0).size() << " ranges at the base level" << endl;
     }
 #endif
 
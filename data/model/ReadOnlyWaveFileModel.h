@@ -25,11 +25,15 @@
 #include "data/fileio/FileSource.h"
 
 #include "RangeSummarisableTimeValueModel.h"
+#include "RangeSummaryPyramid.h"
+#include "RangeSummaryFile.h"
+#include "RangeSummaryBuilder.h"
 #include "PowerOfSqrtTwoZoomConstraint.h"
 
 #include <stdlib.h>
 
 #include <atomic>
+#include <memory>
 
 namespace sv {
 
@@ -136,15 +140,70 @@ protected:
         sv_frame_t m_frameCount;
     };
          
+    class RangeCacheSegmentThread : public QThread
+    {
+    public:
+        RangeCacheSegmentThread(ReadOnlyWaveFileModel &model, int channels,
+                                const int blockSizes[2],
+                                sv_frame_t start, sv_frame_t end) :
+            m_model(model), m_channels(channels),
+            m_builder(channels, blockSizes),
+            m_start(start), m_end(end) { }
+
+        sv_frame_t getEnd() const { return m_end; }
+        RangeSummaryLevel *getLevels() { return m_levels; }
+        void run() override;
+
+    protected:
+        ReadOnlyWaveFileModel &m_model;
+        int m_channels;
+        RangeSummaryBuilder m_builder;
+        RangeSummaryLevel m_levels[2];
+        sv_frame_t m_start;
+        sv_frame_t m_end;
+    };
+    
     void fillCache();
 
+    /**
+     * Append the given base-level ranges to the caches, extending the
+     * levels above them, and clear the given levels. Called only
+     * from the fill thread, which is the sole writer to the caches.
+     */
+    void appendToCache(RangeSummaryLevel added[2], int channels);
+
+    /**
+     * Take the summaries from the given file if it matches the audio,
+     * returning true if it was used. Called from the fill thread.
+     */
+    bool useSummaryFile(std::unique_ptr<RangeSummaryFile> file);
+
+    /**
+     * Save the summaries to the summary file for this audio. Called
+     * from the fill thread once the fill is complete.
+     */
+    void writeSummaryFile(int channels) const;
+
+    static int getCacheBlockSize(int cacheType);
+
     QString m_path;
     AudioFileReader *m_reader;
     bool m_myReader;
 
     sv_frame_t m_startFrame;
 
-    RangeBlock m_cache[2]; // interleaved at two base resolutions
+    QString m_summaryKey; // empty if the summaries should not be saved
+    std::unique_ptr<RangeSummaryFile> m_summaryFile;
+
+    /**
+     * Summary pyramids at two base resolutions (a power of two and
+     * that times the square root of two). Every block size offered by
+     * the zoom constraint corresponds to one level of one of these.
+     * They are written only by the fill thread and are read without
+     * locking. If they were loaded from a summary file, they refer to
+     * m_summaryFile.
+     */
+    RangeSummaryPyramid m_cache[2];
     mutable QMutex m_mutex;
     RangeCacheFillThread *m_fillThread;
     QTimer *m_updateTimer;
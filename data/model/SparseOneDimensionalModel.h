@@ -61,6 +61,7 @@ public:
     }
 
     virtual ~SparseOneDimensionalModel() {
+        m_notifier.detach();
         PlayParameterRepository::getInstance()->removePlayable
             (getId().untyped);
     }
@@ -162,6 +163,29 @@ public:
         m_notifier.update(e.getFrame(), m_resolution);
     }
     
+    void addAll(const EventVector &ee) override {
+
+        if (ee.empty()) return;
+        
+        sv_frame_t f0 = ee[0].getFrame(), f1 = f0;
+
+        EventVector points;
+        points.reserve(ee.size());
+        
+        for (const auto &e: ee) {
+            points.push_back(e.withoutValue().withoutDuration());
+            if (e.getLabel() != "") {
+                m_haveTextLabels = true;
+            }
+            f0 = std::min(f0, e.getFrame());
+            f1 = std::max(f1, e.getFrame());
+        }
+
+        m_events.addAll(points);
+        
+        m_notifier.update(f0, f1 - f0 + m_resolution);
+    }
+    
     void remove(Event e) override {
         m_events.remove(e);
         emit modelChangedWithin(getId(),
@@ -83,6 +83,7 @@ public:
     }
 
     virtual ~SparseTimeValueModel() {
+        m_notifier.detach();
         PlayParameterRepository::getInstance()->removePlayable
             (getId().untyped);
     }
@@ -216,6 +217,44 @@ public:
         }
     }
     
+    void addAll(const EventVector &ee) override {
+
+        if (ee.empty()) return;
+        
+        bool allChange = false;
+        sv_frame_t f0 = ee[0].getFrame(), f1 = f0;
+
+        EventVector points;
+        points.reserve(ee.size());
+        
+        for (const auto &e: ee) {
+            points.push_back(e.withoutDuration()); // can't have duration here
+            if (e.getLabel() != "") {
+                m_haveTextLabels = true;
+            }
+            float v = e.getValue();
+            if (!std::isnan(v) && !std::isinf(v)) {
+                if (!m_haveExtents || v < m_valueMinimum) {
+                    m_valueMinimum = v; allChange = true;
+                }
+                if (!m_haveExtents || v > m_valueMaximum) {
+                    m_valueMaximum = v; allChange = true;
+                }
+                m_haveExtents = true;
+            }
+            f0 = std::min(f0, e.getFrame());
+            f1 = std::max(f1, e.getFrame());
+        }
+
+        m_events.addAll(points);
+        
+        m_notifier.update(f0, f1 - f0 + m_resolution);
+
+        if (allChange) {
+            emit modelChanged(getId());
+        }
+    }
+    
     void remove(Event e) override {
         m_events.remove(e);
         emit modelChangedWithin(getId(),
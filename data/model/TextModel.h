@@ -55,6 +55,10 @@ public:
         m_completion(100) {
     }
 
+    virtual ~TextModel() {
+        m_notifier.detach();
+    }
+
     QString getTypeName() const override { return tr("Text"); }
     bool isSparse() const override { return true; }
     bool isOK() const override { return true; }
@@ -18,90 +18,163 @@
 
 #include "data/model/DenseTimeValueModel.h"
 
+#include <bqvec/Restrict.h>
+
+#include <algorithm>
+
 namespace sv {
 
-floatvec_t
-WaveformOversampler::getOversampledData(const DenseTimeValueModel &source,
-                                        int channel,
-                                        sv_frame_t sourceStartFrame,
-                                        sv_frame_t sourceFrameCount,
-                                        int oversampleBy)
+static float
+dotProduct(const float *const BQ_R__ a, const float *const BQ_R__ b, int n)
 {
-    Profiler profiler("WaveformOversampler::getOversampledData");
-    
-    // Oversampled at a fixed ratio of m_filterRatio
-    floatvec_t fixedRatio = getFixedRatioData(source, channel,
-                                              sourceStartFrame,
-                                              sourceFrameCount);
-    sv_frame_t fixedCount = fixedRatio.size();
-    sv_frame_t targetCount = (fixedCount / m_filterRatio) * oversampleBy;
-
-    // And apply linear interpolation to the desired factor
+    // Independent accumulators for each lane, so that the compiler
+    // can keep them in vector registers
     
-    floatvec_t result(targetCount, 0.f);
+    enum { Lanes = 8 };
+
+    float sums[Lanes];
+    for (int j = 0; j < Lanes; ++j) {
+        sums[j] = 0.f;
+    }
 
-    for (int i = 0; i < targetCount; ++i) {
-        double pos = (double(i) / oversampleBy) * m_filterRatio;
-        double diff = pos - floor(pos);
-        int ix = int(floor(pos));
-        double interpolated = (1.0 - diff) * fixedRatio[ix];
-        if (in_range_for(fixedRatio, ix + 1)) {
-            interpolated += diff * fixedRatio[ix + 1];
+    int i = 0;
+    for (; i + Lanes <= n; i += Lanes) {
+        for (int j = 0; j < Lanes; ++j) {
+            sums[j] += a[i + j] * b[i + j];
         }
-        result[i] = float(interpolated);
     }
 
-    return result;
+    float sum = 0.f;
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    for (int j = 0; j < Lanes; ++j) {
+        sum += sums[j];
+    }
+    return sum;
+}
+
+const WaveformOversampler::Polyphase &
+WaveformOversampler::getPolyphase()
+{
+    static Polyphase polyphase = []() {
+        
+        int ratio = m_filterRatio;
+        int filterLength = int(m_filter.size()); // NB this is known to be odd
+        int filterTail = (filterLength - 1) / 2;
+
+        // Output sample n * ratio + phase takes source frame n - d
+        // through filter tap d * ratio + phase + filterTail, for
+        // every d that puts that tap within the filter
+        
+        Polyphase p;
+        p.lead = filterTail / ratio;
+        p.length = p.lead + (filterTail + ratio - 1) / ratio + 1;
+        p.coefficients = floatvec_t(size_t(ratio) * p.length, 0.f);
+
+        for (int phase = 0; phase < ratio; ++phase) {
+            for (int t = 0; t < p.length; ++t) {
+                int tap = (p.lead - t) * ratio + phase + filterTail;
+                if (tap >= 0 && tap < filterLength) {
+                    p.coefficients[phase * p.length + t] = m_filter[tap];
+                }
+            }
+        }
+
+        return p;
+    }();
+
+    return polyphase;
 }
 
 floatvec_t
-WaveformOversampler::getFixedRatioData(const DenseTimeValueModel &source,
-                                       int channel,
-                                       sv_frame_t sourceStartFrame,
-                                       sv_frame_t sourceFrameCount)
+WaveformOversampler::getOversampledData(const DenseTimeValueModel &source,
+                                        int channel,
+                                        sv_frame_t sourceStartFrame,
+                                        sv_frame_t sourceFrameCount,
+                                        int oversampleBy)
 {
-    Profiler profiler("WaveformOversampler::getFixedRatioData");
-    
+    Profiler profiler("WaveformOversampler::getOversampledData");
+
     sv_frame_t sourceLength = source.getEndFrame();
     
     if (sourceStartFrame + sourceFrameCount > sourceLength) {
         sourceFrameCount = sourceLength - sourceStartFrame;
-        if (sourceFrameCount <= 0) return {};
+    }
+    if (sourceFrameCount <= 0 || oversampleBy <= 0) {
+        return {};
     }
 
-    sv_frame_t targetFrameCount = sourceFrameCount * m_filterRatio;
-    
-    sv_frame_t filterLength = m_filter.size(); // NB this is known to be odd
-    sv_frame_t filterTailOut = (filterLength - 1) / 2;
-    sv_frame_t filterTailIn = filterTailOut / m_filterRatio;
+    const Polyphase &polyphase = getPolyphase();
+    const int ratio = m_filterRatio;
 
-    floatvec_t oversampled(targetFrameCount, 0.f);
+    // Source frames from the first tap of the first output sample to
+    // the last tap of the sample following the last one, zero-padded
+    // where they lie outside the model, so that every dot product
+    // can run without bounds checks
+    
+    sv_frame_t paddedStart = sourceStartFrame - polyphase.lead;
+    sv_frame_t paddedCount = sourceFrameCount + polyphase.length;
+    floatvec_t padded(paddedCount, 0.f);
 
-    sv_frame_t i0 = sourceStartFrame - filterTailIn;
-    if (i0 < 0) {
-        i0 = 0;
-    }
-    sv_frame_t i1 = sourceStartFrame + sourceFrameCount + filterTailIn;
-    if (i1 > sourceLength) {
-        i1 = sourceLength;
+    sv_frame_t i0 = std::max(paddedStart, sv_frame_t(0));
+    sv_frame_t i1 = std::min(paddedStart + paddedCount, sourceLength);
+    if (i1 > i0) {
+        floatvec_t sourceData = source.getData(channel, i0, i1 - i0);
+        sv_frame_t n = std::min(sv_frame_t(sourceData.size()), i1 - i0);
+        std::copy(sourceData.begin(), sourceData.begin() + n,
+                  padded.begin() + (i0 - paddedStart));
     }
+
+    // Sample ix at the fixed ratio of m_filterRatio
+    auto fixedRatioSample = [&](sv_frame_t ix) {
+        return dotProduct(polyphase.coefficients.data() +
+                          (ix % ratio) * polyphase.length,
+                          padded.data() + ix / ratio,
+                          polyphase.length);
+    };
+
+    // And apply linear interpolation to the desired factor,
+    // calculating each fixed-ratio sample only once, and only if it
+    // is needed
+    
+    sv_frame_t targetCount = sourceFrameCount * oversampleBy;
+    floatvec_t result(targetCount, 0.f);
+
+    sv_frame_t lowerIx = -1;
+    float lower = 0.f, upper = 0.f;
+    bool haveUpper = false;
     
-    floatvec_t sourceData = source.getData(channel, i0, i1 - i0);
-
-    for (sv_frame_t i = i0; i < i1; ++i) {
-        float v = sourceData[i - i0];
-        sv_frame_t outOffset =
-            (i - sourceStartFrame) * m_filterRatio - filterTailOut;
-        for (sv_frame_t j = 0; j < filterLength; ++j) {
-            sv_frame_t outIndex = outOffset + j;
-            if (outIndex < 0 || outIndex >= targetFrameCount) {
-                continue;
+    for (sv_frame_t i = 0; i < targetCount; ++i) {
+
+        sv_frame_t ix = (i * ratio) / oversampleBy;
+        sv_frame_t remainder = (i * ratio) % oversampleBy;
+
+        if (ix != lowerIx) {
+            if (ix == lowerIx + 1 && haveUpper) {
+                lower = upper;
+            } else {
+                lower = fixedRatioSample(ix);
             }
-            oversampled[outIndex] += v * m_filter[j];
+            lowerIx = ix;
+            haveUpper = false;
+        }
+
+        if (remainder == 0) {
+            result[i] = lower;
+            continue;
         }
+
+        if (!haveUpper) {
+            upper = fixedRatioSample(ix + 1);
+            haveUpper = true;
+        }
+        
+        double diff = double(remainder) / oversampleBy;
+        result[i] = float((1.0 - diff) * lower + diff * upper);
     }
 
-    return oversampled;
+    return result;
 }
 
 int
@@ -25,7 +25,9 @@ class DenseTimeValueModel;
  *  integer factor, on the assumption that the model represents
  *  audio. Oversampling is carried out using a windowed sinc filter
  *  for a fixed 8x ratio with further linear interpolation to handle
- *  other ratios. The aim is not to provide the "best-sounding"
+ *  other ratios. The filter is applied in polyphase form, computing
+ *  only those 8x samples that the interpolation needs, in the same
+ *  pass. The aim is not to provide the "best-sounding"
  *  interpolation, but to provide accurate and predictable projections
  *  of the theoretical waveform shape for display rendering without
  *  leaving decisions about interpolation up to a resampler library.
@@ -47,10 +49,20 @@ public:
                                          int oversampleBy);
 
 private:
-    static floatvec_t getFixedRatioData(const DenseTimeValueModel &source,
-                                        int channel,
-                                        sv_frame_t sourceStartFrame,
-                                        sv_frame_t sourceFrameCount);
+    /** The filter m_filter split into m_filterRatio phases of equal
+     *  length, each ordered by increasing source frame, so that
+     *  every sample at the fixed ratio is a single contiguous dot
+     *  product of one phase with the source. The first tap of each
+     *  phase applies to the source frame lead frames before the one
+     *  the output sample is aligned with or follows.
+     */
+    struct Polyphase {
+        int length;
+        int lead;
+        floatvec_t coefficients;
+    };
+
+    static const Polyphase &getPolyphase();
     
     static int m_filterRatio;
     static floatvec_t m_filter;
@@ -0,0 +1,368 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_AGGREGATE_WAVE_MODEL_H
+#define TEST_AGGREGATE_WAVE_MODEL_H
+
+#include "../AggregateWaveModel.h"
+#include "../ReadOnlyWaveFileModel.h"
+#include "../PowerOfSqrtTwoZoomConstraint.h"
+
+#include "../../fileio/WavFileWriter.h"
+#include "../../fileio/WavFileReader.h"
+#include "../../fileio/FileSource.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+
+#include <cmath>
+#include <map>
+#include <memory>
+
+using namespace sv;
+
+class TestAggregateWaveModel : public QObject
+{
+    Q_OBJECT
+
+    typedef RangeSummarisableTimeValueModel::Range Range;
+    typedef RangeSummarisableTimeValueModel::RangeBlock RangeBlock;
+
+    // A stereo file and a shorter mono one, so that the mixdown has
+    // a stretch to which only one file contributes
+    enum { StereoFrames = 100003, MonoFrames = 70001 };
+
+    QTemporaryDir *m_dir;
+    QString m_stereoPath;
+    std::unique_ptr<WavFileReader> m_readers[2];
+    ModelId m_stereo;
+    ModelId m_mono;
+    ModelId m_aggregate;
+
+    // Mixes of the component data for the aggregate channels we
+    // summarise ourselves, indexed by aggregate channel + 1
+    std::map<int, floatvec_t> m_mixes;
+
+    QString write(QString name, int channels, sv_frame_t frames) {
+        QString path = m_dir->filePath(name);
+        WavFileWriter writer(path, 44100, channels,
+                             WavFileWriter::WriteToTemporary);
+        if (!writer.isOK()) return {};
+        std::vector<floatvec_t> data(channels, floatvec_t(frames));
+        std::vector<const float *> ptrs;
+        for (int c = 0; c < channels; ++c) {
+            for (sv_frame_t i = 0; i < frames; ++i) {
+                data[c][i] = float
+                    (0.45 * sin(double(i) * 0.0123 * (c + channels)) +
+                     0.3 * cos(double(i) * 0.00071 * (c + 1)));
+            }
+            ptrs.push_back(data[c].data());
+        }
+        if (!writer.writeSamples(ptrs.data(), frames)) return {};
+        if (!writer.close()) return {};
+        return path;
+    }
+
+    ModelId load(QString path, std::unique_ptr<WavFileReader> &reader) {
+        reader.reset(new WavFileReader(FileSource(path)));
+        auto model = std::make_shared<ReadOnlyWaveFileModel>
+            (path, reader.get());
+        return ModelById::add(model);
+    }
+
+    // Sum the data for the given components as the aggregate does,
+    // padding to the longest
+    floatvec_t mix(const AggregateWaveModel::ChannelSpecList &specs) {
+        floatvec_t result(StereoFrames, 0.f);
+        for (const auto &spec : specs) {
+            auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+                (spec.model);
+            auto data = model->getData(spec.channel, 0, StereoFrames);
+            for (size_t i = 0; i < data.size(); ++i) {
+                result[i] += data[i];
+            }
+        }
+        return result;
+    }
+
+    static Range direct(const floatvec_t &data, sv_frame_t f0, sv_frame_t f1) {
+        float min = 0.f, max = 0.f;
+        double abssum = 0.0;
+        for (sv_frame_t i = f0; i < f1; ++i) {
+            float s = data[i];
+            if (i == f0 || s < min) min = s;
+            if (i == f0 || s > max) max = s;
+            abssum += fabs(s);
+        }
+        return Range(min, max, float(abssum / double(f1 - f0)));
+    }
+
+    // As summarised from the pyramid: the extremes of the samples,
+    // and the mean of the absmeans of the base blocks they span
+    static Range pyramid(const floatvec_t &data, sv_frame_t f0, sv_frame_t f1,
+                         sv_frame_t cacheBlock) {
+        sv_frame_t frames = sv_frame_t(data.size());
+        Range whole = direct(data, f0, f1);
+        double total = 0.0;
+        int blocks = 0;
+        for (sv_frame_t b0 = f0; b0 < f1; b0 += cacheBlock) {
+            total += direct(data, b0, std::min(b0 + cacheBlock, frames))
+                .absmean();
+            ++blocks;
+        }
+        return Range(whole.min(), whole.max(), float(total / blocks));
+    }
+
+    static bool close(const Range &a, const Range &b) {
+        return a.min() == b.min() && a.max() == b.max() &&
+            fabsf(a.absmean() - b.absmean()) < 1e-4f;
+    }
+
+    static bool same(const Range &a, const Range &b) {
+        return a.min() == b.min() && a.max() == b.max() &&
+            a.absmean() == b.absmean();
+    }
+
+    struct Span {
+        sv_frame_t start;
+        sv_frame_t count;
+    };
+
+    std::vector<Span> spans() const {
+        return {
+            { 0, StereoFrames },
+            { 1, 999 },
+            { 63, 64 * 7 + 1 },
+            { 89, 91 },
+            { MonoFrames - 1000, 2001 },
+            { 65535, 2 },
+            { 777, 1 },
+            { StereoFrames - 100, 500 },
+            { StereoFrames - 1, 1 }
+        };
+    }
+
+private slots:
+    void initTestCase() {
+        m_dir = new QTemporaryDir;
+        QVERIFY(m_dir->isValid());
+
+        m_stereoPath = write("stereo.wav", 2, StereoFrames);
+        QString monoPath = write("mono.wav", 1, MonoFrames);
+        QVERIFY(m_stereoPath != "");
+        QVERIFY(monoPath != "");
+
+        m_stereo = load(m_stereoPath, m_readers[0]);
+        m_mono = load(monoPath, m_readers[1]);
+
+        auto stereo = ModelById::getAs<ReadOnlyWaveFileModel>(m_stereo);
+        auto mono = ModelById::getAs<ReadOnlyWaveFileModel>(m_mono);
+        QTRY_VERIFY_WITH_TIMEOUT(stereo->isReady() && mono->isReady(), 20000);
+
+        // Let any change notifications from the components go by
+        // before the aggregate connects to them
+        QTest::qWait(200);
+
+        // Channels 0-2 are single channels of components, which the
+        // aggregate passes through; channel 3 is the mixdown of the
+        // stereo file, and channel -1 the mix of everything, which
+        // the aggregate summarises itself
+        AggregateWaveModel::ChannelSpecList specs {
+            { m_stereo, 0 }, { m_stereo, 1 }, { m_mono, 0 }, { m_stereo, -1 }
+        };
+
+        m_mixes[0] = mix(specs);
+        m_mixes[4] = mix({ specs[3] });
+
+        auto aggregate = std::make_shared<AggregateWaveModel>(specs);
+        QSignalSpy spy(aggregate.get(), SIGNAL(modelChanged(ModelId)));
+        m_aggregate = ModelById::add(aggregate);
+
+        // The aggregate reports itself ready once its components are,
+        // and signals a change when its own summaries are filled
+        QVERIFY(aggregate->isReady());
+        QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0, 20000);
+        QCOMPARE(aggregate->getFrameCount(), sv_frame_t(StereoFrames));
+    }
+
+    void cleanupTestCase() {
+        ModelById::release(m_aggregate);
+        ModelById::release(m_stereo);
+        ModelById::release(m_mono);
+        m_readers[0].reset();
+        m_readers[1].reset();
+        delete m_dir;
+        m_dir = nullptr;
+    }
+
+    void directChannels() {
+        // A single channel of a component is summarised by the
+        // component itself, so the results must be identical
+
+        auto aggregate = ModelById::getAs<AggregateWaveModel>(m_aggregate);
+        int requested[] = { 1, 16, 64, 90, 100, 256, 1000, 4096, 65536 };
+
+        for (int c = 0; c < 3; ++c) {
+            auto spec = aggregate->getComponent(c);
+            auto component = ModelById::getAs<RangeSummarisableTimeValueModel>
+                (spec.model);
+            for (int req : requested) {
+                for (const auto &span : spans()) {
+                    int blockSize = req, componentBlockSize = req;
+                    RangeBlock ranges, componentRanges;
+                    aggregate->getSummaries(c, span.start, span.count,
+                                            ranges, blockSize);
+                    component->getSummaries(spec.channel,
+                                            span.start, span.count,
+                                            componentRanges,
+                                            componentBlockSize);
+                    QCOMPARE(blockSize, componentBlockSize);
+                    QCOMPARE(ranges.size(), componentRanges.size());
+                    for (size_t k = 0; k < ranges.size(); ++k) {
+                        QVERIFY(same(ranges[k], componentRanges[k]));
+                    }
+                }
+            }
+        }
+    }
+
+    void mixdownChannels() {
+        // The mixdown channels come from the aggregate's own pyramid,
+        // or directly from the mixed data for block sizes below the
+        // base block size and for the final part-filled block
+
+        auto aggregate = ModelById::getAs<AggregateWaveModel>(m_aggregate);
+
+        PowerOfSqrtTwoZoomConstraint zc;
+        sv_frame_t base = sv_frame_t(1) << zc.getMinCachePower();
+        sv_frame_t sqrtBase = sv_frame_t(double(base) * sqrt(2.) + 0.01);
+
+        int requested[] = { 1, 5, 45, 64, 90, 100, 128, 181, 256, 1000,
+                            1440, 4096, 23170, 65536 };
+
+        for (int channel : { -1, 3 }) {
+
+            const floatvec_t &data = m_mixes[channel + 1];
+            sv_frame_t frames = sv_frame_t(data.size());
+
+            for (int req : requested) {
+                for (const auto &span : spans()) {
+
+                    int blockSize = req;
+                    RangeBlock ranges;
+                    aggregate->getSummaries(channel, span.start, span.count,
+                                            ranges, blockSize);
+
+                    sv_frame_t end = std::min(span.start + span.count, frames);
+                    RangeBlock wanted;
+
+                    if (req < base) {
+                        QCOMPARE(blockSize, req);
+                        for (sv_frame_t f0 = span.start; f0 < end;
+                             f0 += blockSize) {
+                            wanted.push_back
+                                (direct(data, f0,
+                                        std::min(f0 + blockSize, end)));
+                        }
+                    } else {
+                        QCOMPARE(blockSize, aggregate->getSummaryBlockSize(req));
+                        sv_frame_t cacheBlock =
+                            ((blockSize & (blockSize - 1)) == 0) ?
+                            base : sqrtBase;
+                        sv_frame_t div = blockSize / cacheBlock;
+                        // Only whole blocks are summarised
+                        sv_frame_t entries = frames / cacheBlock;
+                        sv_frame_t i = span.start / cacheBlock;
+                        sv_frame_t endIndex =
+                            (span.start + span.count) / cacheBlock;
+                        for (; i <= endIndex; i += div) {
+                            sv_frame_t n = std::min(div, endIndex + 1 - i);
+                            if (i + n > entries) break;
+                            wanted.push_back
+                                (pyramid(data, i * cacheBlock,
+                                         std::min((i + n) * cacheBlock, frames),
+                                         cacheBlock));
+                        }
+                        for (sv_frame_t f0 = i * cacheBlock;
+                             i <= endIndex && f0 < end; f0 += blockSize) {
+                            wanted.push_back
+                                (direct(data, f0,
+                                        std::min(f0 + blockSize, end)));
+                        }
+                    }
+
+                    QCOMPARE(ranges.size(), wanted.size());
+                    for (size_t k = 0; k < ranges.size(); ++k) {
+                        QVERIFY(close(ranges[k], wanted[k]));
+                    }
+                }
+            }
+        }
+    }
+
+    void mixdownSummary() {
+        // getSummary of a mixdown channel covers exactly the span
+        // asked for, or as much of it as lies within the audio, so
+        // its extremes must be exact
+        auto aggregate = ModelById::getAs<AggregateWaveModel>(m_aggregate);
+        for (int channel : { -1, 3 }) {
+            const floatvec_t &data = m_mixes[channel + 1];
+            sv_frame_t frames = sv_frame_t(data.size());
+            for (const auto &span : spans()) {
+                sv_frame_t end = std::min(span.start + span.count, frames);
+                Range got = aggregate->getSummary(channel, span.start,
+                                                  span.count);
+                Range want = direct(data, span.start, end);
+                QCOMPARE(got.min(), want.min());
+                QCOMPARE(got.max(), want.max());
+                QVERIFY(fabsf(got.absmean() - want.absmean()) < 1e-4f);
+            }
+        }
+    }
+
+    void summariesAfterLoading() {
+        // An aggregate made while its component is still loading
+        // starts summarising when the component is ready, and its
+        // summaries then match those of one made afterwards
+        std::unique_ptr<WavFileReader> reader;
+        ModelId stereo = load(m_stereoPath, reader);
+        auto aggregate = std::make_shared<AggregateWaveModel>
+            (AggregateWaveModel::ChannelSpecList { { stereo, -1 } });
+        QSignalSpy spy(aggregate.get(), SIGNAL(modelChanged(ModelId)));
+        ModelId aggregateId = ModelById::add(aggregate);
+
+        QTRY_VERIFY_WITH_TIMEOUT(aggregate->isReady(), 20000);
+        QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0, 20000);
+        QTest::qWait(200);
+
+        const floatvec_t &data = m_mixes[4];
+        for (const auto &span : spans()) {
+            sv_frame_t end = std::min(span.start + span.count,
+                                      sv_frame_t(data.size()));
+            Range got = aggregate->getSummary(0, span.start, span.count);
+            Range want = direct(data, span.start, end);
+            QCOMPARE(got.min(), want.min());
+            QCOMPARE(got.max(), want.max());
+            QVERIFY(fabsf(got.absmean() - want.absmean()) < 1e-4f);
+        }
+
+        ModelById::release(aggregateId);
+        ModelById::release(stereo);
+        reader.reset();
+    }
+};
+
+#endif
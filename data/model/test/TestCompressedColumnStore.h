@@ -0,0 +1,115 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_COMPRESSED_COLUMN_STORE_H
+#define TEST_COMPRESSED_COLUMN_STORE_H
+
+#include "../CompressedColumnStore.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace sv;
+
+class TestCompressedColumnStore : public QObject
+{
+    Q_OBJECT
+
+    typedef CompressedColumnStore::Column Column;
+
+    Column makeColumn(int x, int height) {
+        Column c(height);
+        for (int i = 0; i < height; ++i) {
+            c[i] = float(sin(double(x) * 0.01 + double(i) * 0.3));
+        }
+        return c;
+    }
+
+    bool identical(const Column &a, const Column &b) {
+        // Bitwise, so as to compare NaNs and signed zeros as well
+        if (a.size() != b.size()) return false;
+        return a.empty() ||
+            memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+    }
+
+private slots:
+    void empty() {
+        CompressedColumnStore s;
+        QCOMPARE(s.size(), 0);
+        QVERIFY(s.get(0).empty());
+        QVERIFY(s.get(-1).empty());
+        s.set(10, Column());
+        QCOMPARE(s.size(), 11);
+        QVERIFY(s.get(3).empty());
+    }
+    
+    void sequential() {
+        // Enough columns to evict and re-read many blocks, with some
+        // awkward values among them
+        CompressedColumnStore s;
+        const int width = 2000, height = 48;
+        for (int x = 0; x < width; ++x) {
+            Column c = makeColumn(x, height);
+            if (x % 17 == 0) {
+                c[x % height] = std::numeric_limits<float>::quiet_NaN();
+                c[(x + 1) % height] = -0.f;
+                c[(x + 2) % height] =
+                    std::numeric_limits<float>::infinity();
+            }
+            s.set(x, c);
+        }
+        QCOMPARE(s.size(), width);
+        for (int x = 0; x < width; ++x) {
+            Column c = makeColumn(x, height);
+            if (x % 17 == 0) {
+                c[x % height] = std::numeric_limits<float>::quiet_NaN();
+                c[(x + 1) % height] = -0.f;
+                c[(x + 2) % height] =
+                    std::numeric_limits<float>::infinity();
+            }
+            QVERIFY(identical(s.get(x), c));
+        }
+        QVERIFY(s.getByteSize() < size_t(width) * height * sizeof(float));
+    }
+
+    void randomAccess() {
+        // Columns of varying lengths set in any order and more than
+        // once, with reads in between
+        CompressedColumnStore s;
+        std::vector<Column> expected(1500);
+        srand(13);
+        for (int i = 0; i < 5000; ++i) {
+            int x = rand() % int(expected.size());
+            if (rand() % 3 == 0) {
+                QVERIFY(identical(s.get(x), expected[x]));
+            } else {
+                Column c = makeColumn(rand(), rand() % 40);
+                expected[x] = c;
+                s.set(x, c);
+            }
+        }
+        for (int x = 0; x < int(expected.size()); ++x) {
+            QVERIFY(identical(s.get(x), expected[x]));
+        }
+        s.clear();
+        QCOMPARE(s.size(), 0);
+        QVERIFY(s.get(0).empty());
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_3D_MODEL_PEAK_CACHE_H
+#define TEST_DENSE_3D_MODEL_PEAK_CACHE_H
+
+#include "../Dense3DModelPeakCache.h"
+#include "../EditableDenseThreeDimensionalModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <thread>
+#include <atomic>
+
+using namespace sv;
+
+class TestDense3DModelPeakCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    typedef DenseThreeDimensionalModel::Column Column;
+
+    enum { Height = 10 };
+
+    ModelId makeSource(int width) {
+        auto source = std::make_shared<EditableDenseThreeDimensionalModel>
+            (44100, 512, Height, false);
+        srand(7);
+        for (int x = 0; x < width; ++x) {
+            Column c(Height);
+            for (int y = 0; y < Height; ++y) {
+                c[y] = float(rand() % 1000);
+            }
+            source->setColumn(x, c);
+        }
+        return ModelById::add(source);
+    }
+
+    Column expected(ModelId sourceId, int columnsPerPeak, int column) {
+        auto source = ModelById::getAs<DenseThreeDimensionalModel>(sourceId);
+        Column peak;
+        for (int x = column * columnsPerPeak;
+             x < (column + 1) * columnsPerPeak && x < source->getWidth();
+             ++x) {
+            Column c = source->getColumn(x);
+            if (peak.empty()) {
+                peak = c;
+            } else {
+                for (int y = 0; y < Height; ++y) {
+                    peak[y] = std::max(peak[y], c[y]);
+                }
+            }
+        }
+        return peak;
+    }
+
+private slots:
+    void levels() {
+        ModelId sourceId = makeSource(1000);
+        Dense3DModelPeakCache cache(sourceId, 3, 4);
+        QCOMPARE(cache.getLevelCount(), 4);
+        QCOMPARE(cache.getWidth(), 334);
+        QCOMPARE(cache.getWidth(3), 42);
+        QCOMPARE(cache.getColumnsPerPeak(3), 24);
+        QCOMPARE(cache.getResolution(), 512 * 3);
+        for (int level = 3; level >= 0; --level) {
+            int cpp = cache.getColumnsPerPeak(level);
+            for (int x = 0; x < cache.getWidth(level); ++x) {
+                QCOMPARE(cache.getPeakColumn(level, x),
+                         expected(sourceId, cpp, x));
+            }
+            QVERIFY(cache.getPeakColumn(level, cache.getWidth(level))
+                    .empty());
+        }
+        QCOMPARE(cache.getColumn(5), expected(sourceId, 3, 5));
+        ModelById::release(sourceId);
+    }
+
+    void growingSource() {
+        // A peak read while the end of its range was missing from the
+        // source must be read again once the source has changed
+        auto source = std::make_shared<EditableDenseThreeDimensionalModel>
+            (44100, 512, Height, true);
+        ModelId sourceId = ModelById::add(source);
+        Dense3DModelPeakCache cache(sourceId, 4, 2);
+        source->setColumn(0, Column(Height, 1.f));
+        QCOMPARE(cache.getPeakColumn(1, 0), Column(Height, 1.f));
+        for (int x = 1; x < 6; ++x) {
+            source->setColumn(x, Column(Height, float(x) / 2.5f));
+        }
+        // The change notification may be deferred by rate limiting
+        QTRY_COMPARE(cache.getPeakColumn(1, 0), Column(Height, 2.f));
+        QCOMPARE(cache.getPeakColumn(0, 1), Column(Height, 2.f));
+        ModelById::release(sourceId);
+    }
+
+    void concurrentReaders() {
+        ModelId sourceId = makeSource(2000);
+        std::vector<Column> reference;
+        {
+            Dense3DModelPeakCache cache(sourceId, 2, 5);
+            for (int x = 0; x < cache.getWidth(4); ++x) {
+                reference.push_back(expected(sourceId, 32, x));
+            }
+        }
+        Dense3DModelPeakCache cache(sourceId, 2, 5);
+        cache.prefetch(4, 0, 20);
+        std::atomic<int> mismatches(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.push_back(std::thread([&, t]() {
+                for (int i = 0; i < 200; ++i) {
+                    int level = (i + t) % 5;
+                    int x = (i * 7 + t * 13) % cache.getWidth(level);
+                    Column c = cache.getPeakColumn(level, x);
+                    if (level == 4 && c != reference[x]) {
+                        ++mismatches;
+                    }
+                }
+            }));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        QCOMPARE(int(mismatches), 0);
+        for (int x = 0; x < cache.getWidth(4); ++x) {
+            QCOMPARE(cache.getPeakColumn(4, x), reference[x]);
+        }
+        ModelById::release(sourceId);
+    }
+};
+
+#endif
@@ -16,6 +16,7 @@
 #define TEST_FFT_MODEL_H
 
 #include "../FFTModel.h"
+#include "../FFTColumnStore.h"
 
 #include "MockWaveModel.h"
 
@@ -24,9 +25,11 @@
 #include <QObject>
 #include <QtTest>
 #include <QDir>
+#include <QSignalSpy>
 
 #include <iostream>
 #include <complex>
+#include <thread>
 
 using namespace std;
 using namespace sv;
@@ -269,6 +272,240 @@ private slots:
              { { {}, {}, {}, {}, {} } }, 7);
         releaseMock(mwm);
     }
+
+    void column_store() {
+        // Columns retrieved a second time come from the column store
+        // rather than a fresh FFT, and should be indistinguishable
+        auto mwm = makeMock({ Sine, Cosine }, 64, 8);
+        FFTModel plain(mwm, -1, HanningWindow, 16, 4, 16);
+        FFTModel stored(mwm, -1, HanningWindow, 16, 4, 16);
+        plain.setColumnStoreEnabled(false);
+        stored.setColumnStoreEnabled(true);
+        QVERIFY(stored.isColumnStoreEnabled());
+        int w = plain.getWidth();
+        QCOMPARE(stored.getWidth(), w);
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int x = 0; x < w; ++x) {
+                auto expected = plain.getColumn(x);
+                auto actual = stored.getColumn(x);
+                QCOMPARE(actual.size(), expected.size());
+                for (int i = 0; in_range_for(expected, i); ++i) {
+                    COMPARE_FUZZIER_F(actual[i], expected[i]);
+                }
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void batched_columns() {
+        // Columns retrieved in a batch should match those retrieved
+        // one at a time, including those overlapping either end
+        auto mwm = makeMock({ Sine, Dirac }, 64, 8);
+        for (int ch = 0; ch < 2; ++ch) {
+            FFTModel single(mwm, ch, HanningWindow, 16, 4, 32);
+            FFTModel batched(mwm, ch, HanningWindow, 16, 4, 32);
+            int w = single.getWidth();
+            int h = single.getHeight();
+            int minbin = 1;
+            int nbins = h - 2;
+            vector<vector<float>> mags(w, vector<float>(nbins, 0.f));
+            vector<vector<float>> reals(w, vector<float>(nbins, 0.f));
+            vector<vector<float>> imags(w, vector<float>(nbins, 0.f));
+            vector<float *> magPtrs, realPtrs, imagPtrs;
+            for (int x = 0; x < w; ++x) {
+                magPtrs.push_back(mags[x].data());
+                realPtrs.push_back(reals[x].data());
+                imagPtrs.push_back(imags[x].data());
+            }
+            QVERIFY(batched.getColumns(0, w, magPtrs.data(), minbin, nbins));
+            QVERIFY(batched.getCartesianColumns(0, w, realPtrs.data(),
+                                                imagPtrs.data(), minbin, nbins));
+            vector<float> eReals(h, 0.f), eImags(h, 0.f);
+            for (int x = 0; x < w; ++x) {
+                single.getValuesAt(x, eReals.data(), eImags.data());
+                auto eMags = single.getColumn(x);
+                for (int i = 0; i < nbins; ++i) {
+                    COMPARE_FUZZIER_F(mags[x][i], eMags[minbin + i]);
+                    COMPARE_FUZZIER_F(reals[x][i], eReals[minbin + i]);
+                    COMPARE_FUZZIER_F(imags[x][i], eImags[minbin + i]);
+                }
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void precompute() {
+        auto mwm = makeMock({ Sine, Cosine }, 2000, 8);
+        FFTModel plain(mwm, -1, HanningWindow, 16, 4, 16);
+        FFTModel precomputed(mwm, -1, HanningWindow, 16, 4, 16);
+        precomputed.setPrecomputePriority(200, 300);
+        precomputed.startPrecompute(4);
+        for (int i = 0; i < 1000 && precomputed.getCompletion() < 100; ++i) {
+            QThread::msleep(10);
+        }
+        QCOMPARE(precomputed.getCompletion(), 100);
+        precomputed.stopPrecompute();
+        int w = plain.getWidth();
+        for (int x = 0; x < w; ++x) {
+            auto expected = plain.getColumn(x);
+            auto actual = precomputed.getColumn(x);
+            QCOMPARE(actual.size(), expected.size());
+            for (int i = 0; in_range_for(expected, i); ++i) {
+                COMPARE_FUZZIER_F(actual[i], expected[i]);
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void precompute_store_failure() {
+        // If no column can be stored, the workers run out of work
+        // without the store ever filling up: completion and ready()
+        // must still arrive, and columns are calculated on demand
+        auto mwm = makeMock({ Sine, Cosine }, 2000, 8);
+        FFTModel plain(mwm, -1, HanningWindow, 16, 4, 16);
+        FFTModel precomputed(mwm, -1, HanningWindow, 16, 4, 16);
+        QSignalSpy spy(&precomputed, SIGNAL(ready(ModelId)));
+        precomputed.setColumnStoreLimit(1); // less than one tile
+        precomputed.setPrecomputePriority(-100, 100000);
+        precomputed.startPrecompute(4);
+        QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 10000);
+        QCOMPARE(precomputed.getCompletion(), 100);
+        precomputed.stopPrecompute();
+        QCOMPARE(precomputed.getCompletion(), 100);
+        int w = plain.getWidth();
+        for (int x = 0; x < w; x += 7) {
+            auto expected = plain.getColumn(x);
+            auto actual = precomputed.getColumn(x);
+            QCOMPARE(actual.size(), expected.size());
+            for (int i = 0; in_range_for(expected, i); ++i) {
+                COMPARE_FUZZIER_F(actual[i], expected[i]);
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void precompute_restart() {
+        // Once the workers have exited of their own accord, starting
+        // again must run a new set of workers rather than doing nothing
+        auto mwm = makeMock({ Sine, Cosine }, 2000, 8);
+        FFTModel precomputed(mwm, -1, HanningWindow, 16, 4, 16);
+        QSignalSpy readySpy(&precomputed, SIGNAL(ready(ModelId)));
+        QSignalSpy completionSpy(&precomputed,
+                                 SIGNAL(completionChanged(ModelId)));
+        precomputed.setColumnStoreLimit(1); // so completion is by exit
+        precomputed.startPrecompute(4);
+        QTRY_COMPARE_WITH_TIMEOUT(readySpy.count(), 1, 10000);
+        QCOMPARE(precomputed.getCompletion(), 100);
+        completionSpy.clear();
+        precomputed.startPrecompute(4);
+        QTRY_VERIFY_WITH_TIMEOUT(completionSpy.count() > 0, 10000);
+        QTRY_COMPARE_WITH_TIMEOUT(precomputed.getCompletion(), 100, 10000);
+        QCOMPARE(readySpy.count(), 1);
+        precomputed.stopPrecompute();
+        releaseMock(mwm);
+    }
+
+    void concurrent_readers() {
+        // Several threads reading overlapping sets of columns from a
+        // single model should all see the same results as a single
+        // reader would
+        auto mwm = makeMock({ Sine, Dirac }, 4000, 8);
+        FFTModel reference(mwm, -1, HanningWindow, 32, 8, 32);
+        FFTModel shared(mwm, -1, HanningWindow, 32, 8, 32);
+        int w = reference.getWidth();
+        vector<FFTModel::Column> expected;
+        for (int x = 0; x < w; ++x) {
+            expected.push_back(reference.getColumn(x));
+        }
+        const int nthreads = 6;
+        vector<int> failures(nthreads, 0);
+        vector<std::thread> threads;
+        for (int t = 0; t < nthreads; ++t) {
+            threads.push_back(std::thread([&, t]() {
+                for (int i = 0; i < w; ++i) {
+                    int x = (i * (t + 1)) % w;
+                    auto col = shared.getColumn(x);
+                    if (col.size() != expected[x].size()) {
+                        ++failures[t];
+                        continue;
+                    }
+                    for (int j = 0; in_range_for(col, j); ++j) {
+                        if (fabsf(col[j] - expected[x][j]) > 1e-5f) {
+                            ++failures[t];
+                            break;
+                        }
+                    }
+                }
+            }));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        for (int t = 0; t < nthreads; ++t) {
+            QCOMPARE(failures[t], 0);
+        }
+        releaseMock(mwm);
+    }
+
+    void double_precision() {
+        auto mwm = makeMock({ Sine, Cosine }, 256, 16);
+        FFTModel single(mwm, -1, BlackmanHarrisWindow, 32, 8, 64,
+                        FFTModel::SinglePrecision);
+        FFTModel dbl(mwm, -1, BlackmanHarrisWindow, 32, 8, 64,
+                     FFTModel::DoublePrecision);
+        QCOMPARE(single.getPrecision(), FFTModel::SinglePrecision);
+        QCOMPARE(dbl.getPrecision(), FFTModel::DoublePrecision);
+        int w = single.getWidth();
+        int h = single.getHeight();
+        vector<float> sr(h), si(h), dr(h), di(h);
+        for (int x = 0; x < w; ++x) {
+            single.getValuesAt(x, sr.data(), si.data());
+            dbl.getValuesAt(x, dr.data(), di.data());
+            for (int i = 0; i < h; ++i) {
+                COMPARE_FUZZIER_F(sr[i], dr[i]);
+                COMPARE_FUZZIER_F(si[i], di[i]);
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void access_order() {
+        // Columns should not depend on the order they are read in,
+        // whether following on from one another, going backwards or
+        // skipping about. The window and increment are chosen so
+        // that columns often wrap around the end of the source window
+        auto mwm = makeMock({ Sine, Dirac }, 4000, 8);
+        for (auto precision : { FFTModel::SinglePrecision,
+                                FFTModel::DoublePrecision }) {
+            FFTModel forward(mwm, -1, HanningWindow, 96, 40, 128, precision);
+            FFTModel backward(mwm, -1, HanningWindow, 96, 40, 128, precision);
+            FFTModel strided(mwm, -1, HanningWindow, 96, 40, 128, precision);
+            int w = forward.getWidth();
+            int h = forward.getHeight();
+            vector<vector<float>> fr(w, vector<float>(h)), fi(fr);
+            vector<vector<float>> br(fr), bi(fr), sr(fr), si(fr);
+            for (int x = 0; x < w; ++x) {
+                forward.getValuesAt(x, fr[x].data(), fi[x].data());
+            }
+            for (int x = w; x > 0; ) {
+                --x;
+                backward.getValuesAt(x, br[x].data(), bi[x].data());
+            }
+            for (int i = 0; i < w; ++i) {
+                int x = int((sv_frame_t(i) * 37) % w);
+                strided.getValuesAt(x, sr[x].data(), si[x].data());
+            }
+            for (int x = 0; x < w; ++x) {
+                for (int i = 0; i < h; ++i) {
+                    COMPARE_FUZZIER_F(br[x][i], fr[x][i]);
+                    COMPARE_FUZZIER_F(bi[x][i], fi[x][i]);
+                    COMPARE_FUZZIER_F(sr[x][i], fr[x][i]);
+                    COMPARE_FUZZIER_F(si[x][i], fi[x][i]);
+                }
+            }
+        }
+        releaseMock(mwm);
+    }
     
 };
 
@@ -0,0 +1,155 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_RANGE_SUMMARY_BUILDER_H
+#define TEST_RANGE_SUMMARY_BUILDER_H
+
+#include "../RangeSummaryBuilder.h"
+
+#include "../../../base/BaseTypes.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <cmath>
+
+using namespace sv;
+
+class TestRangeSummaryBuilder : public QObject
+{
+    Q_OBJECT
+
+    floatvec_t makeSource(int channels, int frames) {
+        floatvec_t source(channels * frames);
+        for (int i = 0; i < frames; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                source[i * channels + c] =
+                    float(sin(double(i) * (c + 1) * 0.013) *
+                          cos(double(i) * 0.0007));
+            }
+        }
+        return source;
+    }
+
+    void compareLevels(const RangeSummaryLevel &a, const RangeSummaryLevel &b) {
+        QCOMPARE(a.size(), b.size());
+        for (sv_frame_t i = 0; i < a.size(); ++i) {
+            QCOMPARE(a.at(i).min(), b.at(i).min());
+            QCOMPARE(a.at(i).max(), b.at(i).max());
+            QVERIFY(fabsf(a.at(i).absmean() - b.at(i).absmean()) < 1e-5f);
+        }
+    }
+
+private slots:
+    void summarise() {
+        // Compare the vectorisable kernel with a plain loop, for
+        // lengths either side of a multiple of its lane count
+        floatvec_t source = makeSource(1, 100);
+        for (int n = 1; n <= 100; n += 7) {
+            float min = source[0], max = source[0], abssum = 0.f;
+            for (int i = 0; i < n; ++i) {
+                min = std::min(min, source[i]);
+                max = std::max(max, source[i]);
+                abssum += fabsf(source[i]);
+            }
+            float kmin, kmax, kabssum;
+            RangeSummaryBuilder::summarise(source.data(), n,
+                                           kmin, kmax, kabssum);
+            QCOMPARE(kmin, min);
+            QCOMPARE(kmax, max);
+            QVERIFY(fabsf(kabssum - abssum) < 1e-4f);
+        }
+    }
+
+    void ranges() {
+        // Ranges are interleaved by channel, one per block, with a
+        // final partial block
+        int channels = 2;
+        int frames = 1000;
+        int blockSizes[2] = { 64, 90 };
+        floatvec_t source = makeSource(channels, frames);
+        RangeSummaryBuilder builder(channels, blockSizes);
+        RangeSummaryLevel out[2];
+        builder.process(source.data(), frames, out[0], out[1]);
+        builder.finish(out[0], out[1]);
+        for (int type = 0; type < 2; ++type) {
+            int bs = blockSizes[type];
+            int blocks = (frames + bs - 1) / bs;
+            QCOMPARE(out[type].size(), sv_frame_t(blocks * channels));
+            for (int b = 0; b < blocks; ++b) {
+                for (int c = 0; c < channels; ++c) {
+                    float min = 0.f, max = 0.f, total = 0.f;
+                    int n = 0;
+                    for (int i = b * bs; i < frames && i < (b + 1) * bs; ++i) {
+                        float s = source[i * channels + c];
+                        if (n == 0 || s < min) min = s;
+                        if (n == 0 || s > max) max = s;
+                        total += fabsf(s);
+                        ++n;
+                    }
+                    auto r = out[type].at(b * channels + c);
+                    QCOMPARE(r.min(), min);
+                    QCOMPARE(r.max(), max);
+                    QVERIFY(fabsf(r.absmean() - total / float(n)) < 1e-5f);
+                }
+            }
+        }
+    }
+
+    void blockwise() {
+        // Feeding the audio in arbitrary pieces should make no
+        // difference, and nor should summarising it in segments that
+        // start on a boundary of both block sizes
+        int channels = 3;
+        int frames = 20000;
+        int blockSizes[2] = { 64, 90 };
+        floatvec_t source = makeSource(channels, frames);
+
+        RangeSummaryBuilder whole(channels, blockSizes);
+        RangeSummaryLevel expected[2];
+        whole.process(source.data(), frames, expected[0], expected[1]);
+        whole.finish(expected[0], expected[1]);
+
+        RangeSummaryBuilder pieces(channels, blockSizes);
+        RangeSummaryLevel obtained[2];
+        int frame = 0, piece = 1;
+        while (frame < frames) {
+            int n = std::min(piece, frames - frame);
+            pieces.process(source.data() + frame * channels, n,
+                           obtained[0], obtained[1]);
+            frame += n;
+            piece = (piece * 7) % 1013 + 1;
+        }
+        pieces.finish(obtained[0], obtained[1]);
+        compareLevels(obtained[0], expected[0]);
+        compareLevels(obtained[1], expected[1]);
+
+        int boundary = 64 * 90;
+        RangeSummaryLevel segmented[2];
+        for (int start = 0; start < frames; start += boundary) {
+            int n = std::min(boundary, frames - start);
+            RangeSummaryBuilder segment(channels, blockSizes);
+            RangeSummaryLevel out[2];
+            segment.process(source.data() + start * channels, n,
+                            out[0], out[1]);
+            segment.finish(out[0], out[1]);
+            segmented[0].append(out[0]);
+            segmented[1].append(out[1]);
+        }
+        compareLevels(segmented[0], expected[0]);
+        compareLevels(segmented[1], expected[1]);
+    }
+};
+
+#endif
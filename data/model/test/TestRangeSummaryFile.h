@@ -0,0 +1,230 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_RANGE_SUMMARY_FILE_H
+#define TEST_RANGE_SUMMARY_FILE_H
+
+#include "../RangeSummaryFile.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QDateTime>
+
+#include <cmath>
+#include <limits>
+
+using namespace sv;
+
+class TestRangeSummaryFile : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir *m_dir;
+
+    enum { Channels = 2, Frames = 5000 };
+
+    void fill(RangeSummaryPyramid pyramids[2], float scale) {
+        int blockSizes[2] = { 32, 45 };
+        for (int cacheType = 0; cacheType < 2; ++cacheType) {
+            RangeSummaryLevel level;
+            sv_frame_t blocks = Frames / blockSizes[cacheType] + 1;
+            for (sv_frame_t i = 0; i < blocks; ++i) {
+                for (int c = 0; c < Channels; ++c) {
+                    float v = scale * float(sin(double(i) * (c + 1) * 0.1));
+                    level.append(RangeSummaryLevel::Range
+                                 (-fabsf(v), fabsf(v), fabsf(v) / 2.f));
+                }
+            }
+            pyramids[cacheType].append(level, Channels);
+        }
+    }
+
+    bool write(QString key, float scale) {
+        RangeSummaryPyramid pyramids[2];
+        fill(pyramids, scale);
+        int blockSizes[2] = { 32, 45 };
+        return RangeSummaryFile::write(key, Channels, Frames,
+                                       blockSizes, pyramids);
+    }
+
+    QStringList summaryFiles() {
+        return QDir(m_dir->path()).entryList({ "*.summary" }, QDir::Files);
+    }
+
+    QString onlySummaryFile() {
+        QStringList files = summaryFiles();
+        if (files.size() != 1) return {};
+        return QDir(m_dir->path()).filePath(files[0]);
+    }
+
+    void setUsedAt(QString key, QDateTime when) {
+        // Find the file for the key by elimination, as its name is
+        // not exposed
+        QStringList before = summaryFiles();
+        for (QString f : before) {
+            QFile::rename(QDir(m_dir->path()).filePath(f),
+                          QDir(m_dir->path()).filePath(f + ".aside"));
+        }
+        QVERIFY(write(key, 1.f));
+        QString path = onlySummaryFile();
+        QVERIFY(path != "");
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(when, QFileDevice::FileModificationTime));
+        file.close();
+        for (QString f : before) {
+            QFile::rename(QDir(m_dir->path()).filePath(f + ".aside"),
+                          QDir(m_dir->path()).filePath(f));
+        }
+    }
+
+private slots:
+    void init() {
+        m_dir = new QTemporaryDir;
+        QVERIFY(m_dir->isValid());
+        RangeSummaryFile::setDirectory(m_dir->path());
+    }
+
+    void cleanup() {
+        RangeSummaryFile::setDirectory("");
+        RangeSummaryFile::setMaximumTotalSize(qint64(1) << 30);
+        delete m_dir;
+        m_dir = nullptr;
+    }
+
+    void roundTrip() {
+        RangeSummaryPyramid pyramids[2];
+        fill(pyramids, 0.5f);
+        int blockSizes[2] = { 32, 45 };
+        QVERIFY(RangeSummaryFile::write("round trip", Channels, Frames,
+                                        blockSizes, pyramids));
+
+        RangeSummaryFile file("round trip");
+        QVERIFY(file.isOK());
+        QCOMPARE(file.getChannelCount(), int(Channels));
+        QCOMPARE(file.getFrameCount(), sv_frame_t(Frames));
+
+        for (int cacheType = 0; cacheType < 2; ++cacheType) {
+            QCOMPARE(file.getBaseBlockSize(cacheType), blockSizes[cacheType]);
+            auto levels = file.getLevels(cacheType);
+            QCOMPARE(int(levels.size()), pyramids[cacheType].getLevelCount());
+            for (int i = 0; i < int(levels.size()); ++i) {
+                const RangeSummaryLevel &level =
+                    pyramids[cacheType].getLevel(i);
+                QCOMPARE(levels[i].second, level.size());
+                for (sv_frame_t j = 0; j < level.size(); ++j) {
+                    const float *v = levels[i].first +
+                        j * RangeSummaryLevel::ValuesPerRange;
+                    QCOMPARE(v[0], level.at(j).min());
+                    QCOMPARE(v[1], level.at(j).max());
+                    QCOMPARE(v[2], level.at(j).absmean());
+                }
+            }
+        }
+    }
+
+    void missing() {
+        RangeSummaryFile file("never written");
+        QVERIFY(!file.isOK());
+    }
+
+    void wrongKey() {
+        // Put the file written for one key in the place of the file
+        // for another, and check that it is refused
+        QVERIFY(write("first key", 1.f));
+        QString first = onlySummaryFile();
+        QVERIFY(first != "");
+        QVERIFY(QFile::rename(first, first + ".aside"));
+        QVERIFY(write("second key", 0.5f));
+        QString second = onlySummaryFile();
+        QVERIFY(second != "");
+        QVERIFY(QFile::remove(second));
+        QVERIFY(QFile::rename(first + ".aside", second));
+
+        RangeSummaryFile file("second key");
+        QVERIFY(!file.isOK());
+    }
+
+    void truncated() {
+        QVERIFY(write("truncated", 1.f));
+        QString path = onlySummaryFile();
+        QVERIFY(path != "");
+        qint64 size = QFileInfo(path).size();
+
+        QList<qint64> lengths = { size - 8, size / 2, 80, 71, 8, 0 };
+        for (qint64 length : lengths) {
+            QVERIFY(QFile::resize(path, length));
+            RangeSummaryFile file("truncated");
+            QVERIFY(!file.isOK());
+        }
+    }
+
+    void hugeCount() {
+        // The first level's range count follows the magic and the
+        // eight header words. A count that would overflow when
+        // converted to bytes must be refused rather than mapped
+        QVERIFY(write("huge count", 1.f));
+        QString path = onlySummaryFile();
+        QVERIFY(path != "");
+
+        QList<qint64> counts = {
+            std::numeric_limits<qint64>::max() / 4,
+            std::numeric_limits<qint64>::max() / 12 + 1,
+            std::numeric_limits<qint64>::max(),
+            -1
+        };
+        for (qint64 count : counts) {
+            QFile f(path);
+            QVERIFY(f.open(QIODevice::ReadWrite));
+            QVERIFY(f.seek(72));
+            QCOMPARE(f.write(reinterpret_cast<const char *>(&count),
+                             sizeof(count)), qint64(sizeof(count)));
+            f.close();
+            RangeSummaryFile file("huge count");
+            QVERIFY(!file.isOK());
+        }
+    }
+
+    void eviction() {
+        // Three files, the first used least recently, with room for
+        // only two: writing the third should remove the first
+        QDateTime now = QDateTime::currentDateTime();
+        setUsedAt("oldest", now.addSecs(-7200));
+        setUsedAt("older", now.addSecs(-3600));
+        qint64 each = QFileInfo(QDir(m_dir->path()).filePath
+                                (summaryFiles()[0])).size();
+        RangeSummaryFile::setMaximumTotalSize(each * 2 + each / 2);
+        QVERIFY(write("newest", 1.f));
+
+        QCOMPARE(summaryFiles().size(), 2);
+        QVERIFY(!RangeSummaryFile("oldest").isOK());
+        QVERIFY(RangeSummaryFile("older").isOK());
+        QVERIFY(RangeSummaryFile("newest").isOK());
+    }
+
+    void expiry() {
+        // A file unused for long enough is removed even when there
+        // is plenty of room
+        QDateTime now = QDateTime::currentDateTime();
+        setUsedAt("ancient", now.addDays(-365));
+        QVERIFY(write("recent", 1.f));
+
+        QCOMPARE(summaryFiles().size(), 1);
+        QVERIFY(!RangeSummaryFile("ancient").isOK());
+        QVERIFY(RangeSummaryFile("recent").isOK());
+    }
+};
+
+#endif
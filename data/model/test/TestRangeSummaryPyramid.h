@@ -0,0 +1,222 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_RANGE_SUMMARY_PYRAMID_H
+#define TEST_RANGE_SUMMARY_PYRAMID_H
+
+#include "../RangeSummaryPyramid.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <cmath>
+
+using namespace sv;
+
+class TestRangeSummaryPyramid : public QObject
+{
+    Q_OBJECT
+
+    typedef RangeSummaryLevel::Range Range;
+
+    // Every base-level range has a value that a reader can work out
+    // from its index alone, so that any range not yet fully written
+    // shows up as a mismatch
+    static Range base(sv_frame_t block, int channel) {
+        return Range(-float((block * 7 + channel * 3) % 101) / 100.f,
+                     float((block * 13 + channel * 5) % 97) / 96.f,
+                     float((block * 11 + channel) % 89) / 88.f);
+    }
+
+    static bool same(const Range &a, const Range &b) {
+        return a.min() == b.min() && a.max() == b.max() &&
+            a.absmean() == b.absmean();
+    }
+
+    static bool close(const Range &a, const Range &b) {
+        return a.min() == b.min() && a.max() == b.max() &&
+            fabsf(a.absmean() - b.absmean()) < 1e-4f;
+    }
+
+private slots:
+    void summariseAligned() {
+        // Single-threaded sanity check: a span aligned to a level's
+        // block size reads exactly one entry from that level
+        int channels = 2;
+        RangeSummaryPyramid pyramid;
+        RangeSummaryLevel level;
+        for (sv_frame_t b = 0; b < 64; ++b) {
+            for (int c = 0; c < channels; ++c) {
+                level.append(base(b, c));
+            }
+        }
+        pyramid.append(level, channels);
+        QCOMPARE(pyramid.getLevelCount(), 7);
+        for (int c = 0; c < channels; ++c) {
+            Range r;
+            QCOMPARE(pyramid.summarise(channels, c, 16, 32, r), sv_frame_t(16));
+            QVERIFY(same(r, pyramid.getLevel(4).at(1 * channels + c)));
+        }
+    }
+
+    void concurrentReaders() {
+        // One thread appends to the pyramid in irregular batches,
+        // adding each batch to a mutex-protected reference first,
+        // while several others read from it without locking
+
+        const int channels = 2;
+        const sv_frame_t totalBlocks = 200000;
+        const int readers = 4;
+
+        RangeSummaryPyramid pyramid;
+
+        QMutex referenceMutex;
+        std::vector<Range> reference; // interleaved by channel, like level 0
+
+        std::atomic<bool> writing(true);
+        std::atomic<int> partial(0);   // published ranges with wrong values
+        std::atomic<int> shortfall(0); // summaries of less than was published
+        std::atomic<int> mismatches(0); // summaries differing from reference
+        std::atomic<int> checks(0);
+
+        std::thread writer([&]() {
+            std::mt19937 rng(42);
+            sv_frame_t written = 0;
+            while (written < totalBlocks) {
+                sv_frame_t n = std::min(sv_frame_t(rng() % 3000 + 1),
+                                        totalBlocks - written);
+                RangeSummaryLevel batch;
+                for (sv_frame_t b = written; b < written + n; ++b) {
+                    for (int c = 0; c < channels; ++c) {
+                        batch.append(base(b, c));
+                    }
+                }
+                {
+                    QMutexLocker locker(&referenceMutex);
+                    for (sv_frame_t b = written; b < written + n; ++b) {
+                        for (int c = 0; c < channels; ++c) {
+                            reference.push_back(base(b, c));
+                        }
+                    }
+                }
+                pyramid.append(batch, channels);
+                written += n;
+            }
+            writing = false;
+        });
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < readers; ++t) {
+            threads.push_back(std::thread([&, t]() {
+                std::mt19937 rng(t);
+                bool last = false;
+                while (!last) {
+                    // Make one more pass after the writer has finished
+                    last = !writing;
+
+                    const RangeSummaryLevel &level0 = pyramid.getLevel(0);
+                    sv_frame_t n = level0.size();
+                    if (n == 0) continue;
+
+                    // The most recently published range, and one
+                    // other, must be exactly as written
+                    sv_frame_t i = sv_frame_t(rng() % n);
+                    if (!same(level0.at(n - 1),
+                              base((n - 1) / channels,
+                                   int((n - 1) % channels))) ||
+                        !same(level0.at(i),
+                              base(i / channels, int(i % channels)))) {
+                        ++partial;
+                    }
+
+                    // Higher levels are published with their own
+                    // counts; the most recent entry in each must
+                    // summarise the base ranges beneath it
+                    int levelCount = pyramid.getLevelCount();
+                    for (int lv = 1; lv < levelCount && lv < 8; ++lv) {
+                        const RangeSummaryLevel &level = pyramid.getLevel(lv);
+                        sv_frame_t m = level.size();
+                        if (m == 0) continue;
+                        sv_frame_t block = (m - 1) / channels;
+                        int c = int((m - 1) % channels);
+                        sv_frame_t span = sv_frame_t(1) << lv;
+                        float min = 0.f, max = 0.f, total = 0.f;
+                        for (sv_frame_t b = block * span;
+                             b < (block + 1) * span; ++b) {
+                            Range r = base(b, c);
+                            if (b == block * span || r.min() < min) min = r.min();
+                            if (b == block * span || r.max() > max) max = r.max();
+                            total += r.absmean();
+                        }
+                        if (!close(level.at(m - 1),
+                                   Range(min, max, total / float(span)))) {
+                            ++partial;
+                        }
+                    }
+
+                    // A summary of published blocks must cover all of
+                    // them and agree with the locked reference
+                    sv_frame_t blocks = n / channels;
+                    sv_frame_t i0 = sv_frame_t(rng() % blocks);
+                    sv_frame_t len = sv_frame_t(rng() % 5000 + 1);
+                    sv_frame_t i1 = std::min(blocks, i0 + len);
+                    int c = int(rng() % channels);
+
+                    Range r;
+                    sv_frame_t got = pyramid.summarise(channels, c, i0, i1, r);
+                    if (got != i1 - i0) {
+                        ++shortfall;
+                        continue;
+                    }
+
+                    float min = 0.f, max = 0.f;
+                    double total = 0.0;
+                    {
+                        QMutexLocker locker(&referenceMutex);
+                        for (sv_frame_t b = i0; b < i1; ++b) {
+                            const Range &ref = reference[b * channels + c];
+                            if (b == i0 || ref.min() < min) min = ref.min();
+                            if (b == i0 || ref.max() > max) max = ref.max();
+                            total += ref.absmean();
+                        }
+                    }
+                    if (!close(r, Range(min, max,
+                                        float(total / double(i1 - i0))))) {
+                        ++mismatches;
+                    }
+                    ++checks;
+                }
+            }));
+        }
+
+        writer.join();
+        for (auto &t: threads) {
+            t.join();
+        }
+
+        QCOMPARE(int(partial), 0);
+        QCOMPARE(int(shortfall), 0);
+        QCOMPARE(int(mismatches), 0);
+        QVERIFY(checks > 0);
+        QCOMPARE(pyramid.getLevel(0).size(), totalBlocks * channels);
+    }
+};
+
+#endif
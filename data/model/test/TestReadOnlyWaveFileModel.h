@@ -0,0 +1,270 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_READ_ONLY_WAVE_FILE_MODEL_H
+#define TEST_READ_ONLY_WAVE_FILE_MODEL_H
+
+#include "../ReadOnlyWaveFileModel.h"
+#include "../PowerOfSqrtTwoZoomConstraint.h"
+
+#include "../../fileio/WavFileWriter.h"
+#include "../../fileio/WavFileReader.h"
+#include "../../fileio/FileSource.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <cmath>
+#include <memory>
+
+using namespace sv;
+
+class TestReadOnlyWaveFileModel : public QObject
+{
+    Q_OBJECT
+
+    typedef RangeSummarisableTimeValueModel::Range Range;
+    typedef RangeSummarisableTimeValueModel::RangeBlock RangeBlock;
+
+    enum { Channels = 2, Frames = 100003 }; // not a multiple of any block
+
+    QTemporaryDir *m_dir;
+    std::unique_ptr<WavFileReader> m_reader;
+    std::unique_ptr<ReadOnlyWaveFileModel> m_model;
+    floatvec_t m_audio; // interleaved, as read back from the file
+
+    static float sample(sv_frame_t i, int c) {
+        if (c == 0) {
+            return float(0.9 * sin(double(i) * 0.0123) * cos(double(i) * 0.00031));
+        } else {
+            return float((i * 37) % 1000) / 1000.f - 0.6f;
+        }
+    }
+
+    // The summary of the given frames as the pyramid defines it:
+    // the extremes of all the samples, and the mean of the absmeans
+    // of the base blocks of cacheBlock frames that they span
+    Range expected(int channel, sv_frame_t f0, sv_frame_t f1,
+                   sv_frame_t cacheBlock) const {
+        float min = 0.f, max = 0.f;
+        double total = 0.0;
+        int blocks = 0;
+        for (sv_frame_t b0 = f0; b0 < f1; b0 += cacheBlock) {
+            sv_frame_t b1 = std::min(b0 + cacheBlock, sv_frame_t(Frames));
+            double abssum = 0.0;
+            for (sv_frame_t i = b0; i < b1; ++i) {
+                float s = m_audio[i * Channels + channel];
+                if (i == f0 || s < min) min = s;
+                if (i == f0 || s > max) max = s;
+                abssum += fabs(s);
+            }
+            total += abssum / double(b1 - b0);
+            ++blocks;
+        }
+        return Range(min, max, float(total / blocks));
+    }
+
+    // Brute-force summary of frames f0 to f1 taken directly
+    Range direct(int channel, sv_frame_t f0, sv_frame_t f1) const {
+        float min = 0.f, max = 0.f;
+        double abssum = 0.0;
+        for (sv_frame_t i = f0; i < f1; ++i) {
+            float s = m_audio[i * Channels + channel];
+            if (i == f0 || s < min) min = s;
+            if (i == f0 || s > max) max = s;
+            abssum += fabs(s);
+        }
+        return Range(min, max, float(abssum / double(f1 - f0)));
+    }
+
+    static bool close(const Range &a, const Range &b) {
+        return a.min() == b.min() && a.max() == b.max() &&
+            fabsf(a.absmean() - b.absmean()) < 1e-4f;
+    }
+
+    struct Span {
+        sv_frame_t start;
+        sv_frame_t count;
+    };
+
+    std::vector<Span> spans() const {
+        return {
+            { 0, Frames },
+            { 1, 999 },
+            { 63, 64 * 7 + 1 },
+            { 89, 91 },
+            { 12345, 54321 },
+            { 65535, 2 },
+            { 777, 1 },
+            { Frames - 100, 500 },
+            { Frames - 1, 1 }
+        };
+    }
+
+private slots:
+    void initTestCase() {
+        m_dir = new QTemporaryDir;
+        QVERIFY(m_dir->isValid());
+        QString path = m_dir->filePath("summaries.wav");
+
+        {
+            WavFileWriter writer(path, 44100, Channels,
+                                 WavFileWriter::WriteToTemporary);
+            QVERIFY(writer.isOK());
+            std::vector<floatvec_t> data(Channels, floatvec_t(Frames));
+            for (int c = 0; c < Channels; ++c) {
+                for (sv_frame_t i = 0; i < Frames; ++i) {
+                    data[c][i] = sample(i, c);
+                }
+            }
+            const float *ptrs[Channels] = { data[0].data(), data[1].data() };
+            QVERIFY(writer.writeSamples(ptrs, Frames));
+            QVERIFY(writer.close());
+        }
+
+        m_reader.reset(new WavFileReader(FileSource(path)));
+        QVERIFY(m_reader->isOK());
+        QCOMPARE(m_reader->getChannelCount(), int(Channels));
+        QCOMPARE(m_reader->getFrameCount(), sv_frame_t(Frames));
+        m_audio = m_reader->getInterleavedFrames(0, Frames);
+        QCOMPARE(sv_frame_t(m_audio.size()), sv_frame_t(Frames * Channels));
+
+        m_model.reset(new ReadOnlyWaveFileModel(path, m_reader.get()));
+        QVERIFY(m_model->isOK());
+        QTRY_VERIFY_WITH_TIMEOUT(m_model->isReady(), 20000);
+    }
+
+    void cleanupTestCase() {
+        m_model.reset();
+        m_reader.reset();
+        delete m_dir;
+        m_dir = nullptr;
+    }
+
+    void pyramidSummaries() {
+        // Block sizes of both cache types, some exact and some to be
+        // rounded down, from the base block size up to spans covering
+        // a large part of the file
+
+        PowerOfSqrtTwoZoomConstraint zc;
+        sv_frame_t base = sv_frame_t(1) << zc.getMinCachePower();
+        sv_frame_t sqrtBase = sv_frame_t(double(base) * sqrt(2.) + 0.01);
+
+        int requested[] = { 64, 90, 100, 128, 181, 256, 1000, 1440,
+                            4096, 23170, 65536 };
+
+        for (int req : requested) {
+            for (const auto &span : spans()) {
+                for (int c = 0; c < Channels; ++c) {
+
+                    int blockSize = req;
+                    RangeBlock ranges;
+                    m_model->getSummaries(c, span.start, span.count,
+                                          ranges, blockSize);
+                    QCOMPARE(blockSize, m_model->getSummaryBlockSize(req));
+
+                    // Ranges start on a base block boundary at or
+                    // before the start, and run until the base block
+                    // that contains the end, or the end of the audio
+
+                    sv_frame_t cacheBlock =
+                        ((blockSize & (blockSize - 1)) == 0) ? base : sqrtBase;
+                    sv_frame_t div = blockSize / cacheBlock;
+                    QCOMPARE(div * cacheBlock, sv_frame_t(blockSize));
+
+                    sv_frame_t startIndex = span.start / cacheBlock;
+                    sv_frame_t endIndex = (span.start + span.count) / cacheBlock;
+
+                    RangeBlock wanted;
+                    for (sv_frame_t i = startIndex; i <= endIndex; i += div) {
+                        sv_frame_t f0 = i * cacheBlock;
+                        if (f0 >= Frames) break;
+                        sv_frame_t n = std::min(div, endIndex + 1 - i);
+                        sv_frame_t f1 = std::min((i + n) * cacheBlock,
+                                                 sv_frame_t(Frames));
+                        wanted.push_back(expected(c, f0, f1, cacheBlock));
+                    }
+
+                    QCOMPARE(ranges.size(), wanted.size());
+                    for (size_t k = 0; k < ranges.size(); ++k) {
+                        if (!close(ranges[k], wanted[k])) {
+                            qDebug() << "block size" << blockSize << "start"
+                                     << span.start << "count" << span.count
+                                     << "channel" << c << "range" << k
+                                     << "got" << ranges[k].min()
+                                     << ranges[k].max() << ranges[k].absmean()
+                                     << "expected" << wanted[k].min()
+                                     << wanted[k].max() << wanted[k].absmean();
+                        }
+                        QVERIFY(close(ranges[k], wanted[k]));
+                    }
+                }
+            }
+        }
+    }
+
+    void directSummaries() {
+        // Block sizes below the smallest cache block are read straight
+        // from the file, in blocks of exactly the size requested
+
+        int requested[] = { 1, 2, 5, 16, 45, 63 };
+
+        for (int req : requested) {
+            for (const auto &span : spans()) {
+                if (span.count > 5000) continue;
+                for (int c = 0; c < Channels; ++c) {
+
+                    int blockSize = req;
+                    RangeBlock ranges;
+                    m_model->getSummaries(c, span.start, span.count,
+                                          ranges, blockSize);
+
+                    sv_frame_t end = std::min(span.start + span.count,
+                                              sv_frame_t(Frames));
+                    RangeBlock wanted;
+                    for (sv_frame_t f0 = span.start; f0 < end;
+                         f0 += blockSize) {
+                        wanted.push_back
+                            (direct(c, f0, std::min(f0 + blockSize, end)));
+                    }
+
+                    QCOMPARE(ranges.size(), wanted.size());
+                    for (size_t k = 0; k < ranges.size(); ++k) {
+                        QVERIFY(close(ranges[k], wanted[k]));
+                    }
+                }
+            }
+        }
+    }
+
+    void summary() {
+        // getSummary combines a span of any length from the pyramid
+        // and direct reads. The pyramid part may take in the rest of
+        // the base block containing the end of the span, so the
+        // result must contain the true extremes but may exceed them
+        for (const auto &span : spans()) {
+            for (int c = 0; c < Channels; ++c) {
+                sv_frame_t end = std::min(span.start + span.count,
+                                          sv_frame_t(Frames));
+                Range got = m_model->getSummary(c, span.start, span.count);
+                Range want = direct(c, span.start, end);
+                QVERIFY(got.min() <= want.min());
+                QVERIFY(got.max() >= want.max());
+            }
+        }
+    }
+};
+
+#endif
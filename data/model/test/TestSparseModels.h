@@ -19,6 +19,8 @@
 #include "../NoteModel.h"
 #include "../TextModel.h"
 #include "../Path.h"
+#include "../AlignmentModel.h"
+#include "../NotificationScheduler.h"
 #include "../ImageModel.h"
 
 #include <QObject>
@@ -301,6 +303,230 @@ private slots:
         }
         QCOMPARE(xml, expected);
     }
+
+    void alignment_batch() {
+        Path path(100, 10);
+        path.add(PathPoint(100, 200));
+        path.add(PathPoint(0, 0));
+        path.add(PathPoint(200, 300));
+        path.add(PathPoint(100, 200));
+        QCOMPARE(path.getPointCount(), 3);
+        QCOMPARE(path.getFrames(), vector<sv_frame_t>({ 0, 100, 200 }));
+        QCOMPARE(path.getMapFrames(), vector<sv_frame_t>({ 0, 200, 300 }));
+
+        AlignmentModel m(ModelId(), ModelId(), ModelId());
+        m.setPath(path);
+        QCOMPARE(m.toReference(-10), sv_frame_t(0));
+        QCOMPARE(m.toReference(50), sv_frame_t(100));
+        QCOMPARE(m.toReference(150), sv_frame_t(250));
+        QCOMPARE(m.toReference(250), sv_frame_t(300));
+        QCOMPARE(m.fromReference(100), sv_frame_t(50));
+        QCOMPARE(m.fromReference(250), sv_frame_t(150));
+
+        // A batch, whether in order or not, must map each frame as
+        // it would be mapped alone
+        vector<sv_frame_t> frames;
+        for (sv_frame_t f = -20; f < 320; f += 7) frames.push_back(f);
+        frames.push_back(5);
+        frames.push_back(5);
+        frames.push_back(-1);
+        vector<sv_frame_t> out(frames.size(), -1);
+        m.toReference(frames.data(), out.data(), int(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            QCOMPARE(out[i], m.toReference(frames[i]));
+        }
+        m.fromReference(frames.data(), out.data(), int(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            QCOMPARE(out[i], m.fromReference(frames[i]));
+        }
+
+        // A path whose mapframes go backwards needs a separate
+        // reverse path
+        path.add(PathPoint(300, 250));
+        m.setPath(path);
+        QCOMPARE(m.fromReference(275), sv_frame_t(250));
+        QCOMPARE(m.fromReference(300), sv_frame_t(200));
+        m.fromReference(frames.data(), out.data(), int(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            QCOMPARE(out[i], m.fromReference(frames[i]));
+        }
+    }
+
+    void path_points() {
+        Path path(100, 10);
+        path.add(PathPoint(40, 60));
+        path.add(PathPoint(20, 30));
+        path.add(PathPoint(40, 50));
+
+        QCOMPARE(path.getPointCount(), 3);
+        QCOMPARE(path.getPoint(0).frame, sv_frame_t(20));
+        QCOMPARE(path.getPoint(1).mapframe, sv_frame_t(50));
+        QCOMPARE(path.getPoint(2).mapframe, sv_frame_t(60));
+
+        path.remove(PathPoint(40, 55));
+        QCOMPARE(path.getPointCount(), 3);
+        path.remove(PathPoint(40, 50));
+        QCOMPARE(path.getPointCount(), 2);
+        QCOMPARE(path.getPoint(1).mapframe, sv_frame_t(60));
+    }
+
+    void model_align_batch() {
+        auto ref = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        ref->add(Event(1000));
+        auto aligned = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        aligned->add(Event(600));
+        ModelId refId = ModelById::add(ref);
+        ModelId alignedId = ModelById::add(aligned);
+
+        Path path(100, 10);
+        path.add(PathPoint(0, 0));
+        path.add(PathPoint(500, 1000));
+        path.add(PathPoint(600, 1500));
+        auto alignment = std::make_shared<AlignmentModel>
+            (refId, alignedId, ModelId());
+        alignment->setPath(path);
+        aligned->setAlignment(ModelById::add(alignment));
+
+        // Array forms, including the clamping to each model's end
+        // frame, should agree with the single-frame forms
+        vector<sv_frame_t> frames;
+        for (sv_frame_t f = -30; f < 2000; f += 37) frames.push_back(f);
+        vector<sv_frame_t> out(frames.size(), -1);
+
+        aligned->alignToReference(frames.data(), out.data(), int(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            QCOMPARE(out[i], aligned->alignToReference(frames[i]));
+        }
+        QCOMPARE(aligned->alignToReference(250), sv_frame_t(500));
+        QCOMPARE(aligned->alignToReference(590), ref->getEndFrame());
+
+        aligned->alignFromReference(frames.data(), out.data(), int(frames.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            QCOMPARE(out[i], aligned->alignFromReference(frames[i]));
+        }
+        QCOMPARE(aligned->alignFromReference(500), sv_frame_t(250));
+
+        // Unaligned models map frames to themselves
+        ref->alignToReference(frames.data(), out.data(), int(frames.size()));
+        QCOMPARE(out, frames);
+
+        ModelById::release(alignment);
+        ModelById::release(alignedId);
+        ModelById::release(refId);
+    }
+
+    void deferred_notification() {
+        SparseOneDimensionalModel m(100, 10, false);
+
+        vector<pair<sv_frame_t, sv_frame_t>> within;
+        int changed = 0;
+        connect(&m, &Model::modelChangedWithin,
+                [&](ModelId, sv_frame_t f0, sv_frame_t f1) {
+                    within.push_back({ f0, f1 });
+                });
+        connect(&m, &Model::modelChanged,
+                [&](ModelId) { ++changed; });
+
+        auto scheduler = NotificationScheduler::getInstance();
+        scheduler->resetCounters();
+
+        // Changes that overlap or touch are coalesced, others kept
+        // apart, and none is notified until the model asks
+        m.add(Event(0));
+        m.add(Event(10));
+        m.add(Event(15));
+        m.add(Event(1000));
+        QCOMPARE(int(within.size()), 0);
+
+        // Deferred changes are not rate-limited, so not suppressed
+        QCOMPARE(scheduler->getSignalsSuppressed(), int64_t(0));
+
+        m.setCompletion(50);
+        QCOMPARE(within, (vector<pair<sv_frame_t, sv_frame_t>>
+                          { { 0, 25 }, { 1000, 1010 } }));
+        QCOMPARE(changed, 1);
+        QCOMPARE(scheduler->getSignalsSent(), int64_t(3));
+
+        // Nothing more to notify
+        within.clear();
+        m.setCompletion(60);
+        QCOMPARE(int(within.size()), 0);
+
+        // Many scattered changes are merged down to a few intervals
+        for (int i = 0; i < 100; ++i) {
+            m.add(Event(i * 1000));
+        }
+        m.setCompletion(70);
+        QVERIFY(int(within.size()) <= 8);
+        QCOMPARE(within.front().first, sv_frame_t(0));
+        QCOMPARE(within.back().second, sv_frame_t(99010));
+    }
+
+    void rate_limited_notification() {
+        // The scheduler only flushes models it can find by id
+        auto m = std::make_shared<SparseOneDimensionalModel>(100, 10, true);
+        auto id = ModelById::add(m);
+
+        int changed = 0;
+        connect(m.get(), &Model::modelChanged,
+                [&](ModelId) { ++changed; });
+
+        auto scheduler = NotificationScheduler::getInstance();
+        scheduler->setMaximumRate(10);
+        scheduler->resetCounters();
+
+        // A burst within the minimum interval gets one notification
+        // straight away and one more, for the rest of the burst, when
+        // the interval has passed
+        for (int i = 0; i < 20; ++i) {
+            m->add(Event(i * 10));
+        }
+        QCOMPARE(changed, 1);
+        QCOMPARE(scheduler->getSignalsSuppressed(), int64_t(19));
+        QTRY_COMPARE(changed, 2);
+        QCOMPARE(scheduler->getSignalsSent(), int64_t(4));
+
+        // and nothing after that
+        QTest::qWait(300);
+        QCOMPARE(changed, 2);
+
+        // With no limit, every change is notified as it happens
+        scheduler->setMaximumRate(0);
+        scheduler->resetCounters();
+        for (int i = 0; i < 5; ++i) {
+            m->add(Event(1000 + i * 10));
+        }
+        QCOMPARE(changed, 7);
+        QCOMPARE(scheduler->getSignalsSuppressed(), int64_t(0));
+        QCOMPARE(scheduler->getSignalsSent(), int64_t(10));
+
+        scheduler->setMaximumRate(30);
+        ModelById::release(id);
+    }
+
+    void rate_limited_model_destroyed() {
+        // A model destroyed while a flush is pending for it must be
+        // skipped by the flush, not notified
+        auto m = std::make_shared<SparseOneDimensionalModel>(100, 10, true);
+        auto id = ModelById::add(m);
+
+        auto scheduler = NotificationScheduler::getInstance();
+        scheduler->setMaximumRate(10);
+        scheduler->resetCounters();
+
+        for (int i = 0; i < 20; ++i) {
+            m->add(Event(i * 10));
+        }
+        QCOMPARE(scheduler->getSignalsSent(), int64_t(2));
+
+        ModelById::release(id);
+        m.reset();
+
+        QTest::qWait(300);
+        QCOMPARE(scheduler->getSignalsSent(), int64_t(2));
+
+        scheduler->setMaximumRate(30);
+    }
 };
 
 #endif
@@ -199,6 +199,16 @@ private slots:
         compareStrided(output, half, 2);
     }
     
+    void testWhole24x() {
+        testStrided(0, 5000, 24, m_source);
+
+        // every eighth value should equal all values at 3x, even
+        // though neither is a multiple of the filter ratio
+        floatvec_t output = get(0, 5000, 24);
+        floatvec_t third = get(0, 5000, 3);
+        compareStrided(output, third, 8);
+    }
+    
     void testSubsets4x() {
         testStrided(0, 500, 4, sourceSubset(0, 500));
         testStrided(4500, 500, 4, sourceSubset(4500, 500));
@@ -1,10 +1,17 @@
 TEST_HEADERS += \
 	Compares.h \
 	MockWaveModel.h \
+	TestAggregateWaveModel.h \
+	TestCompressedColumnStore.h \
+	TestDense3DModelPeakCache.h \
 	TestFFTModel.h \
-        TestSparseModels.h \
-        TestWaveformOversampler.h \
-        TestZoomConstraints.h
+	TestRangeSummaryBuilder.h \
+	TestRangeSummaryFile.h \
+	TestRangeSummaryPyramid.h \
+	TestReadOnlyWaveFileModel.h \
+	TestSparseModels.h \
+	TestWaveformOversampler.h \
+	TestZoomConstraints.h
 	
 TEST_SOURCES += \
 	MockWaveModel.cpp \
@@ -15,6 +15,13 @@
 #include "TestZoomConstraints.h"
 #include "TestWaveformOversampler.h"
 #include "TestSparseModels.h"
+#include "TestRangeSummaryBuilder.h"
+#include "TestRangeSummaryFile.h"
+#include "TestRangeSummaryPyramid.h"
+#include "TestReadOnlyWaveFileModel.h"
+#include "TestAggregateWaveModel.h"
+#include "TestCompressedColumnStore.h"
+#include "TestDense3DModelPeakCache.h"
 
 #include "system/Init.h"
 
@@ -58,6 +65,48 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        TestRangeSummaryBuilder t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestRangeSummaryFile t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestRangeSummaryPyramid t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestReadOnlyWaveFileModel t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestAggregateWaveModel t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestCompressedColumnStore t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestDense3DModelPeakCache t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     (void)good;
     
     if (bad > 0) {
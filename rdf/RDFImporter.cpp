@@ -77,6 +77,9 @@ protected:
 
     std::map<ModelId, std::map<QString, float> > m_labelValueMap;
 
+    // Events gathered by fillModel, to be added to each model at once
+    std::map<ModelId, EventVector> m_pendingEvents;
+
     void getDataModelsAudio(std::vector<ModelId> &, ProgressReporter *);
     void getDataModelsSparse(std::vector<ModelId> &, ProgressReporter *);
     void getDataModelsDense(std::vector<ModelId> &, ProgressReporter *);
@@ -352,11 +355,13 @@ RDFImporterImpl::getDataModelsDense(std::vector<ModelId> &models,
             auto m = std::make_shared<SparseTimeValueModel>
                 (sampleRate, hopSize, false);
 
+            EventVector events;
+            events.reserve(values.size());
             for (int j = 0; j < values.size(); ++j) {
                 float f = values[j].toFloat();
-                Event e(j * hopSize, f, "");
-                m->add(e);
+                events.push_back(Event(j * hopSize, f, ""));
             }
+            m->addAll(events);
 
             m->setObjectName(getDenseModelTitle(feature, type));
             m->setRDFTypeURI(type);
@@ -699,6 +704,13 @@ RDFImporterImpl::getDataModelsSparse(std::vector<ModelId> &models,
             }
         }
     }
+
+    for (const auto &p: m_pendingEvents) {
+        if (auto editable = ModelById::getAs<EventEditable>(p.first)) {
+            editable->addAll(p.second);
+        }
+    }
+    m_pendingEvents.clear();
 }
 
 void
@@ -711,28 +723,28 @@ RDFImporterImpl::fillModel(ModelId modelId,
 {
 //    SVDEBUG << "RDFImporterImpl::fillModel: adding point at frame " << ftime << endl;
 
-    if (auto sodm = ModelById::getAs<SparseOneDimensionalModel>(modelId)) {
+    if (ModelById::isa<SparseOneDimensionalModel>(modelId)) {
         Event point(ftime, label);
-        sodm->add(point);
+        m_pendingEvents[modelId].push_back(point);
         return;
     }
 
-    if (auto tm = ModelById::getAs<TextModel>(modelId)) {
+    if (ModelById::isa<TextModel>(modelId)) {
         Event e
             (ftime,
              values.empty() ? 0.5f : values[0] < 0.f ? 0.f : values[0] > 1.f ? 1.f : values[0], // I was young and feckless once too
              label);
-        tm->add(e);
+        m_pendingEvents[modelId].push_back(e);
         return;
     }
 
-    if (auto stvm = ModelById::getAs<SparseTimeValueModel>(modelId)) {
+    if (ModelById::isa<SparseTimeValueModel>(modelId)) {
         Event e(ftime, values.empty() ? 0.f : values[0], label);
-        stvm->add(e);
+        m_pendingEvents[modelId].push_back(e);
         return;
     }
 
-    if (auto nm = ModelById::getAs<NoteModel>(modelId)) {
+    if (ModelById::isa<NoteModel>(modelId)) {
         if (haveDuration) {
             float value = 0.f, level = 1.f;
             if (!values.empty()) {
@@ -742,7 +754,7 @@ RDFImporterImpl::fillModel(ModelId modelId,
                 }
             }
             Event e(ftime, value, fduration, level, label);
-            nm->add(e);
+            m_pendingEvents[modelId].push_back(e);
         } else {
             float value = 0.f, duration = 1.f, level = 1.f;
             if (!values.empty()) {
@@ -756,12 +768,14 @@ RDFImporterImpl::fillModel(ModelId modelId,
             }
             Event e(ftime, value, sv_frame_t(lrintf(duration)),
                         level, label);
-            nm->add(e);
+            m_pendingEvents[modelId].push_back(e);
         }
         return;
     }
 
     if (auto rm = ModelById::getAs<RegionModel>(modelId)) {
+        // Added directly rather than pended, as we need the model's
+        // value extents to allocate values for labels
         float value = 0.f;
         if (values.empty()) {
             // no values? map each unique label to a distinct value
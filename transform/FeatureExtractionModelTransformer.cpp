@@ -29,11 +29,12 @@
 #include "data/model/DenseTimeValueModel.h"
 #include "data/model/NoteModel.h"
 #include "data/model/RegionModel.h"
-#include "data/model/FFTModel.h"
 #include "data/model/WaveFileModel.h"
 #include "rdf/PluginRDFDescription.h"
 
 #include "TransformFactory.h"
+#include "SharedFFTSource.h"
+#include "TransformerScheduler.h"
 
 #include <iostream>
 
@@ -718,23 +719,19 @@ FeatureExtractionModelTransformer::run()
 
     ModelId inputId = getInputModel();
 
-    bool ready = false;
-    while (!ready && !m_abandoned) {
-        { // scope so as to release input shared_ptr before sleeping
-            auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
-            if (!input || !input->isOK()) {
-                deinitialise();
-                return;
-            }
-            ready = input->isReady();
-        }
-        if (!ready) {
-            SVDEBUG << "FeatureExtractionModelTransformer::run: Waiting for input model "
-                    << inputId << " to be ready..." << endl;
-            usleep(500000);
+    if (!waitForInput()) {
+        if (!m_abandoned) {
+            deinitialise();
         }
+        return;
+    }
+
+    // Wait for our turn to process, so that a large batch of
+    // transforms does not oversubscribe the machine
+    TransformerScheduler::Slot slot(this);
+    if (!slot.isAcquired()) {
+        return;
     }
-    if (m_abandoned) return;
 
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
     SVDEBUG << "FeatureExtractionModelTransformer::run: Input model "
@@ -776,35 +773,35 @@ FeatureExtractionModelTransformer::run()
     bool frequencyDomain = (m_plugin->getInputDomain() ==
                             Vamp::Plugin::FrequencyDomain);
 
-    std::vector<FFTModel *> fftModels;
+    // FFT columns come from sources shared with any other
+    // transformers running at the same time on the same input with
+    // the same parameters, so that each column is calculated only
+    // once however many plugins are consuming it
+    
+    std::vector<std::shared_ptr<SharedFFTSource>> fftSources;
 
     if (frequencyDomain) {
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
         SVDEBUG << "FeatureExtractionModelTransformer::run: Input is frequency-domain" << endl;
 #endif
         for (int ch = 0; ch < channelCount; ++ch) {
-            FFTModel *model = new FFTModel
+            auto source = SharedFFTSource::get
                 (inputId,
                  channelCount == 1 ? m_input.getChannel() : ch,
                  primaryTransform.getWindowType(),
                  blockSize,
-                 stepSize,
-                 blockSize);
-            if (!model->isOK() || model->getError() != "") {
-                QString err = model->getError();
-                delete model;
+                 stepSize);
+            if (!source->isOK()) {
+                QString err = source->getError();
                 for (int j = 0; in_range_for(m_outputNos, j); ++j) {
                     setCompletion(j, 100);
                 }
                 SVDEBUG << "FeatureExtractionModelTransformer::run: Failed to create FFT model for input model " << inputId << ": " << err << endl;
                 m_message = "Failed to create the FFT model for this feature extraction model transformer: error is: " + err;
-                for (int cch = 0; cch < ch; ++cch) {
-                    delete fftModels[cch];
-                }
                 deinitialise();
                 return;
             }
-            fftModels.push_back(model);
+            fftSources.push_back(source);
         }
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
         SVDEBUG << "FeatureExtractionModelTransformer::run: Created FFT model(s) for frequency-domain input" << endl;
@@ -839,13 +836,6 @@ FeatureExtractionModelTransformer::run()
         setCompletion(j, 0);
     }
 
-    float *reals = nullptr;
-    float *imaginaries = nullptr;
-    if (frequencyDomain) {
-        reals = new float[blockSize/2 + 1];
-        imaginaries = new float[blockSize/2 + 1];
-    }
-
     QString error = "";
 
     try {
@@ -911,21 +901,10 @@ FeatureExtractionModelTransformer::run()
             // channelCount is either input->channelCount or 1
 
             if (frequencyDomain) {
+                int column = int((blockFrame - startFrame) / stepSize);
                 for (int ch = 0; ch < channelCount; ++ch) {
-                    int column = int((blockFrame - startFrame) / stepSize);
-                    if (fftModels[ch]->getValuesAt(column, reals, imaginaries)) {
-                        for (int i = 0; i <= blockSize/2; ++i) {
-                            buffers[ch][i*2] = reals[i];
-                            buffers[ch][i*2+1] = imaginaries[i];
-                        }
-                    } else {
-                        for (int i = 0; i <= blockSize/2; ++i) {
-                            buffers[ch][i*2] = 0.f;
-                            buffers[ch][i*2+1] = 0.f;
-                        }
-                    }
-                        
-                    error = fftModels[ch]->getError();
+                    fftSources[ch]->getColumn(column, buffers[ch]);
+                    error = fftSources[ch]->getError();
                     if (error != "") {
                         SVCERR << "FeatureExtractionModelTransformer::run: Abandoning, error is " << error << endl;
                         m_abandoned = true;
@@ -992,13 +971,7 @@ FeatureExtractionModelTransformer::run()
         setCompletion(j, 100);
     }
 
-    if (frequencyDomain) {
-        for (int ch = 0; ch < channelCount; ++ch) {
-            delete fftModels[ch];
-        }
-        delete[] reals;
-        delete[] imaginaries;
-    }
+    fftSources.clear();
 
     for (int ch = 0; ch < channelCount; ++ch) {
         delete[] buffers[ch];
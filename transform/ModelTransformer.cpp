@@ -16,6 +16,9 @@
 #include "ModelTransformer.h"
 
 #include "TransformFactory.h"
+#include "TransformerScheduler.h"
+
+#include "data/model/DenseTimeValueModel.h"
 
 namespace sv {
 
@@ -24,7 +27,8 @@ ModelTransformer::ModelTransformer(Input input,
                                    CompletionReporter *reporter) :
     m_input(input),
     m_reporter(reporter),
-    m_abandoned(false)
+    m_abandoned(false),
+    m_inputSignalled(false)
 {
     m_transforms.push_back(transform);
     checkTransformsExist();
@@ -36,17 +40,93 @@ ModelTransformer::ModelTransformer(Input input,
     m_transforms(transforms),
     m_input(input),
     m_reporter(reporter),
-    m_abandoned(false)
+    m_abandoned(false),
+    m_inputSignalled(false)
 {
     checkTransformsExist();
 }
 
 ModelTransformer::~ModelTransformer()
 {
-    m_abandoned = true;
+    abandon();
     wait();
 }
 
+void
+ModelTransformer::abandon()
+{
+    m_abandoned = true;
+    TransformerScheduler::getInstance()->remove(this);
+    wakeInputWait();
+}
+
+void
+ModelTransformer::wakeInputWait()
+{
+    m_inputSignalled = true;
+    QMutexLocker locker(&m_inputMutex);
+    m_inputCondition.wakeAll();
+}
+
+bool
+ModelTransformer::waitForInput()
+{
+    ModelId inputId = getInputModel();
+
+    QMetaObject::Connection readyConnection, completionConnection;
+
+    { // scope so as to release input shared_ptr before waiting
+        auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
+        if (!input) {
+            return false;
+        }
+        auto wake = [this](ModelId) { wakeInputWait(); };
+        readyConnection = connect(input.get(), &Model::ready,
+                                  this, wake, Qt::DirectConnection);
+        completionConnection = connect(input.get(), &Model::completionChanged,
+                                       this, wake, Qt::DirectConnection);
+    }
+
+    bool ready = false;
+    bool announced = false;
+    
+    while (!m_abandoned) {
+
+        // Reset before checking, so that a signal arriving between
+        // the check and the wait is not missed
+        m_inputSignalled = false;
+        
+        { // scope so as to release input shared_ptr before waiting
+            auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
+            if (!input || !input->isOK()) {
+                break;
+            }
+            ready = input->isReady();
+        }
+        if (ready) {
+            break;
+        }
+
+        if (!announced) {
+            SVDEBUG << "ModelTransformer::waitForInput: Waiting for input model "
+                    << inputId << " to be ready..." << endl;
+            announced = true;
+        }
+
+        // The timeout is a backstop in case the model becomes ready
+        // without telling anyone
+        QMutexLocker locker(&m_inputMutex);
+        if (!m_inputSignalled && !m_abandoned) {
+            m_inputCondition.wait(&m_inputMutex, 1000);
+        }
+    }
+
+    disconnect(readyConnection);
+    disconnect(completionConnection);
+    
+    return ready && !m_abandoned;
+}
+
 void
 ModelTransformer::checkTransformsExist()
 {
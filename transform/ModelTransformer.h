@@ -22,6 +22,11 @@
 
 #include "Transform.h"
 
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+
 namespace sv {
 
 /**
@@ -35,6 +40,11 @@ namespace sv {
  * separate thread populating the output model.  The model is
  * available to the user of the ModelTransformer immediately, but may
  * be initially empty until the background thread has populated it.
+ *
+ * The background thread should wait for its input using
+ * waitForInput(), and should hold a TransformerScheduler::Slot while
+ * it processes, so that only a limited number of transformers are
+ * processing at once.
  */
 class ModelTransformer : public Thread
 {
@@ -84,9 +94,11 @@ public:
      * Hint to the processing thread that it should give up, for
      * example because the process is going to exit or the
      * model/document context is being replaced.  Caller should still
-     * wait() to be sure that processing has ended.
+     * wait() to be sure that processing has ended. Any slot held in
+     * the TransformerScheduler is released straight away, and a
+     * thread waiting in waitForInput or for a slot is woken.
      */
-    void abandon() { m_abandoned = true; }
+    void abandon();
 
     /**
      * Return true if the processing thread is being or has been
@@ -149,6 +161,15 @@ protected:
                      CompletionReporter *reporter = nullptr);
 
     virtual void awaitOutputModels() = 0;
+
+    /**
+     * Wait until the input model is ready. Return true if it is, or
+     * false if the transformer was abandoned or the input model
+     * disappeared or failed while waiting. The wait is woken by the
+     * input model's ready and completionChanged signals, rather than
+     * by polling.
+     */
+    bool waitForInput();
     
     Transforms m_transforms;
     Input m_input;
@@ -159,6 +180,11 @@ protected:
 
 private:
     void checkTransformsExist();
+
+    QMutex m_inputMutex;
+    QWaitCondition m_inputCondition;
+    std::atomic<bool> m_inputSignalled;
+    void wakeInputWait();
 };
 
 } // end namespace sv
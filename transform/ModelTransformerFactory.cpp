@@ -19,6 +19,7 @@
 #include "RealTimeEffectModelTransformer.h"
 
 #include "TransformFactory.h"
+#include "TransformerScheduler.h"
 
 #include "base/AudioPlaySource.h"
 
@@ -384,5 +385,34 @@ ModelTransformerFactory::cancel(ModelId outputModel)
     return found;
 }
 
+bool
+ModelTransformerFactory::setPriority(ModelId outputModel, int priority)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto mt : m_runningTransformers) {
+        for (auto model : mt->getOutputModels()) {
+            if (model == outputModel) {
+                TransformerScheduler::getInstance()->setPriority(mt, priority);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void
+ModelTransformerFactory::setMaximumRunningTransforms(int count)
+{
+    TransformerScheduler::getInstance()->setWorkerCount(count);
+}
+
+int
+ModelTransformerFactory::getMaximumRunningTransforms() const
+{
+    return TransformerScheduler::getInstance()->getWorkerCount();
+}
+
 } // end namespace sv
 
@@ -165,6 +165,27 @@ public:
      * this model.
      */
     bool cancel(ModelId);
+
+    /**
+     * Set the scheduling priority of any running transform associated
+     * with the given output model. Transforms with higher priority
+     * are started first when more are waiting than may run at once;
+     * for example, a host may raise the priority of transforms whose
+     * output is shown in a visible layer. The default priority is 0.
+     *
+     * Return false if there is no running transform associated with
+     * this model.
+     */
+    bool setPriority(ModelId outputModel, int priority);
+
+    /**
+     * Set the maximum number of transforms that may process at once.
+     * Others wait, in order of priority, until one finishes or is
+     * cancelled. Zero means one per available processor core, which
+     * is the default.
+     */
+    void setMaximumRunningTransforms(int count);
+    int getMaximumRunningTransforms() const;
     
 signals:
     void transformFailed(QString transformName, QString message);
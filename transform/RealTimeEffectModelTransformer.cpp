@@ -26,6 +26,7 @@
 #include "data/model/WaveFileModel.h"
 
 #include "TransformFactory.h"
+#include "TransformerScheduler.h"
 
 #include <iostream>
 
@@ -121,22 +122,17 @@ RealTimeEffectModelTransformer::run()
         return;
     }
 
-    bool ready = false;
-    while (!ready && !m_abandoned) {
-        { // scope so as to release input shared_ptr before sleeping
-            auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
-            if (!input) {
-                abandon();
-                return;
-            }
-            ready = input->isReady();
-        }
-        if (!ready) {
-            SVDEBUG << "RealTimeEffectModelTransformer::run: Waiting for input model to be ready..." << endl;
-            usleep(500000);
+    if (!waitForInput()) {
+        if (!m_abandoned) {
+            abandon();
         }
+        return;
+    }
+
+    TransformerScheduler::Slot slot(this);
+    if (!slot.isAcquired()) {
+        return;
     }
-    if (m_abandoned) return;
 
     auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
     if (!input) {
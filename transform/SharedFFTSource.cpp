@@ -0,0 +1,235 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "SharedFFTSource.h"
+
+#include "data/model/FFTModel.h"
+#include "base/Debug.h"
+#include "base/Profiler.h"
+
+#include <QMutexLocker>
+#include <QCoreApplication>
+
+#include <algorithm>
+
+namespace sv {
+
+QMutex
+SharedFFTSource::m_registryMutex;
+
+std::map<SharedFFTSource::Key, std::weak_ptr<SharedFFTSource>>
+SharedFFTSource::m_registry;
+
+std::shared_ptr<SharedFFTSource>
+SharedFFTSource::get(ModelId input, int channel, WindowType windowType,
+                     int blockSize, int stepSize)
+{
+    QMutexLocker locker(&m_registryMutex);
+
+    // Forget about sources that are no longer in use
+    for (auto itr = m_registry.begin(); itr != m_registry.end(); ) {
+        if (itr->second.expired()) {
+            itr = m_registry.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+
+    Key key(input, channel, int(windowType), blockSize, stepSize);
+
+    auto itr = m_registry.find(key);
+    if (itr != m_registry.end()) {
+        if (auto source = itr->second.lock()) {
+            SVDEBUG << "SharedFFTSource::get: Sharing existing FFT source for "
+                    << "input model " << input << ", channel " << channel
+                    << ", block size " << blockSize << ", step size "
+                    << stepSize << endl;
+            return source;
+        }
+    }
+
+    std::shared_ptr<SharedFFTSource> source
+        (new SharedFFTSource(input, channel, windowType,
+                             blockSize, stepSize));
+    m_registry[key] = source;
+    return source;
+}
+
+SharedFFTSource::SharedFFTSource(ModelId input, int channel,
+                                 WindowType windowType,
+                                 int blockSize, int stepSize) :
+    m_blockSize(blockSize),
+    m_maxBatches(MaxBatches),
+    m_model(new FFTModel(input, channel, windowType,
+                         blockSize, stepSize, blockSize,
+                         FFTModel::DoublePrecision)),
+    m_useCount(0),
+    m_calculated(0),
+    m_retrieved(0)
+{
+    // Each column holds blockSize/2 + 1 real and imaginary floats
+    size_t batchBytes =
+        size_t(BatchSize) * size_t(blockSize / 2 + 1) * 2 * sizeof(float);
+    m_maxBatches = int(std::max(size_t(1),
+                                std::min(size_t(MaxBatches),
+                                         MaxCacheBytes / batchBytes)));
+
+    // Each column is read once by each transformer, within the
+    // lifetime of the batch that holds it, so a disc store would
+    // only cost time and space
+    m_model->setColumnStoreEnabled(false);
+
+    // We are created by whichever transformer first needs us, but
+    // may be destroyed by another, so the model belongs to the main
+    // thread and is deleted there
+    if (QCoreApplication::instance()) {
+        m_model->moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+SharedFFTSource::~SharedFFTSource()
+{
+    SVDEBUG << "SharedFFTSource: Calculated " << m_calculated
+            << " column(s) for " << m_retrieved << " retrieved" << endl;
+
+    if (QCoreApplication::instance()) {
+        m_model->deleteLater();
+    } else {
+        delete m_model;
+    }
+}
+
+bool
+SharedFFTSource::isOK() const
+{
+    return m_model->isOK() && m_model->getError() == "";
+}
+
+QString
+SharedFFTSource::getError() const
+{
+    return m_model->getError();
+}
+
+bool
+SharedFFTSource::getColumn(int column, float *interleaved)
+{
+    Profiler profiler("SharedFFTSource::getColumn");
+    
+    int hs1 = m_blockSize / 2 + 1;
+    int start = (column / BatchSize) * BatchSize;
+    
+    std::shared_ptr<Batch> batch;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        while (true) {
+            for (const auto &b: m_batches) {
+                if (b->start == start) {
+                    batch = b;
+                    break;
+                }
+            }
+            if (batch || m_calculating.find(start) == m_calculating.end()) {
+                break;
+            }
+            // Another transformer is calculating this batch already
+            m_condition.wait(&m_mutex);
+        }
+
+        if (batch) {
+            batch->lastUsed = ++m_useCount;
+        } else {
+            m_calculating.insert(start);
+        }
+    }
+
+    if (!batch) {
+
+        try {
+            batch = calculate(start);
+        } catch (...) {
+            // Let anyone waiting for this batch try for themselves
+            QMutexLocker locker(&m_mutex);
+            m_calculating.erase(start);
+            m_condition.wakeAll();
+            throw;
+        }
+        
+        QMutexLocker locker(&m_mutex);
+
+        if (int(m_batches.size()) >= m_maxBatches) {
+            auto lru = std::min_element
+                (m_batches.begin(), m_batches.end(),
+                 [](const std::shared_ptr<Batch> &a,
+                    const std::shared_ptr<Batch> &b) {
+                     return a->lastUsed < b->lastUsed;
+                 });
+            m_batches.erase(lru);
+        }
+
+        batch->lastUsed = ++m_useCount;
+        m_batches.push_back(batch);
+        m_calculating.erase(start);
+        m_condition.wakeAll();
+    }
+
+    // The batch is never modified once calculated, so we can read
+    // from it without the lock, while we retain it
+
+    ++m_retrieved;
+    
+    if (!batch->ok) {
+        std::fill(interleaved, interleaved + hs1 * 2, 0.f);
+        return false;
+    }
+    
+    const float *reals = batch->reals[column - start].data();
+    const float *imaginaries = batch->imaginaries[column - start].data();
+    for (int i = 0; i < hs1; ++i) {
+        interleaved[i*2] = reals[i];
+        interleaved[i*2+1] = imaginaries[i];
+    }
+    return true;
+}
+
+std::shared_ptr<SharedFFTSource::Batch>
+SharedFFTSource::calculate(int start)
+{
+    Profiler profiler("SharedFFTSource::calculate");
+    
+    int hs1 = m_blockSize / 2 + 1;
+
+    auto batch = std::make_shared<Batch>();
+    batch->start = start;
+    batch->lastUsed = 0;
+    batch->reals.resize(BatchSize, floatvec_t(hs1, 0.f));
+    batch->imaginaries.resize(BatchSize, floatvec_t(hs1, 0.f));
+
+    std::vector<float *> realPtrs, imaginaryPtrs;
+    for (int i = 0; i < BatchSize; ++i) {
+        realPtrs.push_back(batch->reals[i].data());
+        imaginaryPtrs.push_back(batch->imaginaries[i].data());
+    }
+
+    batch->ok = m_model->getCartesianColumns
+        (start, BatchSize, realPtrs.data(), imaginaryPtrs.data(), 0, hs1);
+
+    m_calculated += BatchSize;
+    
+    return batch;
+}
+
+} // end namespace sv
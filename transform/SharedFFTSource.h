@@ -0,0 +1,152 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SHARED_FFT_SOURCE_H
+#define SV_SHARED_FFT_SOURCE_H
+
+#include "data/model/Model.h"
+#include "base/Window.h"
+#include "base/BaseTypes.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <tuple>
+
+namespace sv {
+
+class FFTModel;
+
+/**
+ * A source of FFT columns for frequency-domain feature extraction,
+ * shared between all the FeatureExtractionModelTransformers that are
+ * running at once on the same input channel with the same window
+ * type, block size and step size.
+ *
+ * Columns are calculated in batches, aligned to multiples of the
+ * batch size, and the most recently calculated batches are retained
+ * so that other transformers reading the same part of the input can
+ * use them without recalculating. If a transformer asks for a batch
+ * that another is already calculating, it waits for that calculation
+ * rather than repeating it. A transformer that has fallen further
+ * behind than the retained batches reach simply calculates its own.
+ * The number of batches retained is limited by their total size in
+ * bytes, so that large block sizes retain fewer batches.
+ *
+ * Columns are calculated in double precision, as they were when
+ * each transformer made its own FFTModel, so that the input given to
+ * plugins does not depend on whether it was shared.
+ *
+ * The FFTModel used is a QObject. It is moved to the application's
+ * main thread when created, and deleted there with deleteLater()
+ * when the source is destroyed, whichever thread that happens in.
+ *
+ * SharedFFTSource is thread-safe.
+ */
+class SharedFFTSource
+{
+public:
+    /**
+     * Return the shared source for the given input and parameters,
+     * creating it if no one is currently using one. The source lasts
+     * for as long as any caller retains it. The caller should check
+     * isOK() before use.
+     */
+    static std::shared_ptr<SharedFFTSource> get(ModelId input, // a DenseTimeValueModel
+                                                int channel,
+                                                WindowType windowType,
+                                                int blockSize,
+                                                int stepSize);
+
+    ~SharedFFTSource();
+
+    bool isOK() const;
+    QString getError() const;
+
+    int getBlockSize() const { return m_blockSize; }
+
+    /**
+     * Return the maximum number of batches of columns retained.
+     */
+    int getMaxBatches() const { return m_maxBatches; }
+
+    /**
+     * Return the number of columns in each batch.
+     */
+    static int getBatchSize() { return BatchSize; }
+
+    /**
+     * Write the given column into the buffer, in the interleaved
+     * real/imaginary form expected by a frequency-domain Vamp plugin
+     * (blockSize/2 + 1 complex values, i.e. blockSize + 2 floats).
+     * Return false, with the buffer zeroed, if the column could not
+     * be calculated.
+     */
+    bool getColumn(int column, float *interleaved);
+
+    /**
+     * Return the number of columns calculated, and the number
+     * retrieved with getColumn, since this source was created. The
+     * difference is the number of FFTs saved by sharing.
+     */
+    int64_t getColumnsCalculated() const { return m_calculated; }
+    int64_t getColumnsRetrieved() const { return m_retrieved; }
+
+private:
+    SharedFFTSource(ModelId input, int channel, WindowType windowType,
+                    int blockSize, int stepSize);
+
+    SharedFFTSource(const SharedFFTSource &) =delete;
+    SharedFFTSource &operator=(const SharedFFTSource &) =delete;
+
+    enum { BatchSize = 32, MaxBatches = 16 };
+    enum { MaxCacheBytes = 32 * 1024 * 1024 };
+
+    struct Batch {
+        int start;
+        bool ok;
+        uint64_t lastUsed;
+        std::vector<floatvec_t> reals;
+        std::vector<floatvec_t> imaginaries;
+    };
+
+    int m_blockSize;
+    int m_maxBatches;
+    FFTModel *m_model;
+
+    QMutex m_mutex; // for the following
+    QWaitCondition m_condition;
+    std::vector<std::shared_ptr<Batch>> m_batches;
+    std::set<int> m_calculating; // start columns of batches in progress
+    uint64_t m_useCount;
+
+    std::atomic<int64_t> m_calculated;
+    std::atomic<int64_t> m_retrieved;
+
+    std::shared_ptr<Batch> calculate(int start);
+    
+    typedef std::tuple<ModelId, int, int, int, int> Key;
+    static QMutex m_registryMutex;
+    static std::map<Key, std::weak_ptr<SharedFFTSource>> m_registry;
+};
+
+} // end namespace sv
+
+#endif
@@ -0,0 +1,193 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "TransformerScheduler.h"
+#include "ModelTransformer.h"
+
+#include "base/Debug.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+#include <mutex>
+
+namespace sv {
+
+TransformerScheduler *
+TransformerScheduler::m_instance = nullptr;
+
+TransformerScheduler *
+TransformerScheduler::getInstance()
+{
+    static std::once_flag f;
+    std::call_once(f, [&]() { m_instance = new TransformerScheduler(); });
+    return m_instance;
+}
+
+TransformerScheduler::TransformerScheduler() :
+    m_workerCount(0),
+    m_sequence(0)
+{
+}
+
+void
+TransformerScheduler::setWorkerCount(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_workerCount = std::max(0, count);
+    m_condition.wakeAll();
+}
+
+int
+TransformerScheduler::getWorkerCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return getEffectiveWorkerCount();
+}
+
+int
+TransformerScheduler::getEffectiveWorkerCount() const
+{
+    if (m_workerCount > 0) {
+        return m_workerCount;
+    }
+    int count = QThread::idealThreadCount();
+    if (count < 1) count = 1;
+    return count;
+}
+
+void
+TransformerScheduler::setPriority(ModelTransformer *transformer,
+                                  int priority)
+{
+    QMutexLocker locker(&m_mutex);
+    m_priorities[transformer] = priority;
+    auto itr = m_waiting.find(transformer);
+    if (itr != m_waiting.end()) {
+        itr->second.priority = priority;
+        m_condition.wakeAll();
+    }
+}
+
+int
+TransformerScheduler::getPriority(ModelTransformer *transformer) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto itr = m_priorities.find(transformer);
+    if (itr == m_priorities.end()) return 0;
+    return itr->second;
+}
+
+bool
+TransformerScheduler::isNext(ModelTransformer *transformer) const
+{
+    // Called with the mutex held
+    
+    const Waiting &w = m_waiting.at(transformer);
+    
+    for (const auto &other: m_waiting) {
+        if (other.first == transformer) continue;
+        if (other.second.priority > w.priority ||
+            (other.second.priority == w.priority &&
+             other.second.sequence < w.sequence)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+TransformerScheduler::acquire(ModelTransformer *transformer)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_running.find(transformer) != m_running.end()) {
+        return true;
+    }
+
+    Waiting w;
+    auto pitr = m_priorities.find(transformer);
+    w.priority = (pitr == m_priorities.end() ? 0 : pitr->second);
+    w.sequence = ++m_sequence;
+    m_waiting[transformer] = w;
+
+    bool announced = false;
+    
+    while (true) {
+
+        if (transformer->isAbandoned()) {
+            m_waiting.erase(transformer);
+            // Someone else may be next now
+            m_condition.wakeAll();
+            return false;
+        }
+        
+        if (int(m_running.size()) < getEffectiveWorkerCount() &&
+            isNext(transformer)) {
+            m_waiting.erase(transformer);
+            m_running.insert(transformer);
+            // Another slot may also be free
+            m_condition.wakeAll();
+            return true;
+        }
+
+        if (!announced) {
+            SVDEBUG << "TransformerScheduler::acquire: Transformer "
+                    << transformer << " waiting for one of "
+                    << getEffectiveWorkerCount() << " slot(s), "
+                    << m_waiting.size() << " waiting" << endl;
+            announced = true;
+        }
+        
+        m_condition.wait(&m_mutex);
+    }
+}
+
+void
+TransformerScheduler::release(ModelTransformer *transformer)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_running.erase(transformer) > 0) {
+        m_condition.wakeAll();
+    }
+}
+
+void
+TransformerScheduler::remove(ModelTransformer *transformer)
+{
+    QMutexLocker locker(&m_mutex);
+    m_running.erase(transformer);
+    m_priorities.erase(transformer);
+    // If it is waiting, acquire will see that it has been abandoned
+    // and remove it from m_waiting itself
+    m_condition.wakeAll();
+}
+
+int
+TransformerScheduler::getRunningCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_running.size());
+}
+
+int
+TransformerScheduler::getWaitingCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_waiting.size());
+}
+
+} // end namespace sv
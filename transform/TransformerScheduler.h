@@ -0,0 +1,133 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_TRANSFORMER_SCHEDULER_H
+#define SV_TRANSFORMER_SCHEDULER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <map>
+#include <set>
+#include <cstdint>
+
+namespace sv {
+
+class ModelTransformer;
+
+/**
+ * Limits the number of ModelTransformers that may process at once.
+ *
+ * Every transformer still has its own thread, which creates the
+ * transformer's output models and waits for its input to be ready
+ * without holding a slot. Before it starts processing, the thread
+ * must acquire one of a fixed number of slots, and waits (without
+ * using any CPU) until one is free. Waiting transformers are given
+ * slots in order of priority, and in the order in which they asked
+ * within a priority. A transformer that is abandoned gives up its
+ * slot, or its place in the queue, straight away.
+ *
+ * This keeps a large batch of transforms from oversubscribing the
+ * machine, while making sure the output models for every transform
+ * in the batch are available as soon as they are requested.
+ */
+class TransformerScheduler
+{
+public:
+    static TransformerScheduler *getInstance();
+
+    /**
+     * Set the number of transformers that may process at once. Zero
+     * means one per available processor core, which is the default.
+     */
+    void setWorkerCount(int count);
+    int getWorkerCount() const;
+
+    /**
+     * Set the priority of a transformer. Transformers with higher
+     * priority are given a slot first; for example, a host may raise
+     * the priority of transforms whose output is visible. The default
+     * priority is 0. May be called before or while the transformer is
+     * waiting for a slot.
+     */
+    void setPriority(ModelTransformer *transformer, int priority);
+    int getPriority(ModelTransformer *transformer) const;
+
+    /**
+     * Wait for a slot for the given transformer. Return true when the
+     * slot has been acquired, or false if the transformer was
+     * abandoned while waiting.
+     */
+    bool acquire(ModelTransformer *transformer);
+
+    /**
+     * Release the slot held by the given transformer, if any.
+     */
+    void release(ModelTransformer *transformer);
+
+    /**
+     * Forget the given transformer, which has been abandoned or is
+     * being destroyed, releasing its slot if it held one and waking
+     * it if it was waiting for one.
+     */
+    void remove(ModelTransformer *transformer);
+
+    int getRunningCount() const;
+    int getWaitingCount() const;
+
+    /**
+     * A slot acquired on construction, if possible, and released on
+     * destruction.
+     */
+    class Slot {
+    public:
+        Slot(ModelTransformer *transformer) :
+            m_transformer(transformer),
+            m_acquired(getInstance()->acquire(transformer)) { }
+        ~Slot() {
+            if (m_acquired) getInstance()->release(m_transformer);
+        }
+        bool isAcquired() const { return m_acquired; }
+    private:
+        Slot(const Slot &) =delete;
+        Slot &operator=(const Slot &) =delete;
+        ModelTransformer *m_transformer;
+        bool m_acquired;
+    };
+
+private:
+    TransformerScheduler();
+
+    static TransformerScheduler *m_instance;
+
+    struct Waiting {
+        int priority;
+        uint64_t sequence;
+    };
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    int m_workerCount;
+    uint64_t m_sequence;
+    std::set<ModelTransformer *> m_running;
+    std::map<ModelTransformer *, Waiting> m_waiting;
+    std::map<ModelTransformer *, int> m_priorities;
+
+    int getEffectiveWorkerCount() const;
+    bool isNext(ModelTransformer *transformer) const;
+};
+
+} // end namespace sv
+
+#endif
@@ -0,0 +1,206 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SHARED_FFT_SOURCE_H
+#define TEST_SHARED_FFT_SOURCE_H
+
+#include "../SharedFFTSource.h"
+
+#include "data/model/FFTModel.h"
+#include "data/model/test/MockWaveModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <thread>
+#include <cmath>
+
+using namespace sv;
+
+class TestSharedFFTSource : public QObject
+{
+    Q_OBJECT
+
+private:
+    enum { BlockSize = 64 };
+
+    ModelId makeMock(int length) {
+        auto mwm = std::make_shared<MockWaveModel>
+            (std::vector<Sort>({ Sine, Cosine }), length, BlockSize);
+        return ModelById::add(mwm);
+    }
+
+    std::shared_ptr<SharedFFTSource> getSource(ModelId id, int channel = 0,
+                                               int blockSize = BlockSize) {
+        return SharedFFTSource::get(id, channel, HanningWindow,
+                                    blockSize, blockSize);
+    }
+
+    // Compare every column of the source with those from an FFTModel
+    // of our own, made as the transformers used to make theirs
+    bool compareAll(ModelId id, SharedFFTSource *source, int columns) {
+        FFTModel model(id, 0, HanningWindow, BlockSize, BlockSize, BlockSize,
+                       FFTModel::DoublePrecision);
+        int hs1 = BlockSize / 2 + 1;
+        std::vector<float> interleaved(hs1 * 2), reals(hs1), imags(hs1);
+        for (int c = 0; c < columns; ++c) {
+            if (!source->getColumn(c, interleaved.data())) return false;
+            if (!model.getValuesAt(c, reals.data(), imags.data())) {
+                return false;
+            }
+            for (int i = 0; i < hs1; ++i) {
+                if (std::fabs(interleaved[i*2] - reals[i]) > 1e-5 ||
+                    std::fabs(interleaved[i*2+1] - imags[i]) > 1e-5) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private slots:
+
+    void sameKeyShared() {
+        ModelId id = makeMock(4096);
+        auto a = getSource(id);
+        auto b = getSource(id);
+        QVERIFY(a->isOK());
+        QCOMPARE(a.get(), b.get());
+
+        // Both consumers read the same batch, which is calculated
+        // only once
+        int hs1 = BlockSize / 2 + 1;
+        std::vector<float> ca(hs1 * 2), cb(hs1 * 2);
+        for (int c = 0; c < SharedFFTSource::getBatchSize(); ++c) {
+            QVERIFY(a->getColumn(c, ca.data()));
+            QVERIFY(b->getColumn(c, cb.data()));
+            QCOMPARE(ca, cb);
+        }
+        QCOMPARE(a->getColumnsCalculated(),
+                 int64_t(SharedFFTSource::getBatchSize()));
+        QCOMPARE(a->getColumnsRetrieved(),
+                 int64_t(SharedFFTSource::getBatchSize() * 2));
+
+        QVERIFY(compareAll(id, a.get(), 4096 / BlockSize));
+
+        a.reset();
+        b.reset();
+        ModelById::release(id);
+    }
+
+    void keyMismatch() {
+        ModelId id = makeMock(4096);
+        ModelId other = makeMock(4096);
+        auto a = getSource(id);
+        QVERIFY(getSource(id, 1).get() != a.get());
+        QVERIFY(getSource(id, 0, BlockSize * 2).get() != a.get());
+        QVERIFY(getSource(other).get() != a.get());
+        QVERIFY(SharedFFTSource::get(id, 0, BlackmanWindow,
+                                     BlockSize, BlockSize).get() != a.get());
+        QVERIFY(SharedFFTSource::get(id, 0, HanningWindow,
+                                     BlockSize, BlockSize / 2).get()
+                != a.get());
+        a.reset();
+        ModelById::release(id);
+        ModelById::release(other);
+    }
+
+    void notSharedOnceReleased() {
+        ModelId id = makeMock(4096);
+        auto a = getSource(id);
+        int hs1 = BlockSize / 2 + 1;
+        std::vector<float> col(hs1 * 2);
+        QVERIFY(a->getColumn(0, col.data()));
+        a.reset();
+
+        // A new source is made, with nothing calculated yet
+        auto b = getSource(id);
+        QCOMPARE(b->getColumnsCalculated(), int64_t(0));
+        b.reset();
+        ModelById::release(id);
+    }
+
+    void batchesBoundedByBytes() {
+        ModelId id = makeMock(4096);
+        QCOMPARE(getSource(id)->getMaxBatches(), 16);
+        // 32 columns of 32769 complex floats is 8MB per batch, so
+        // only 3 fit in 32MB
+        QCOMPARE(getSource(id, 0, 65536)->getMaxBatches(), 3);
+        ModelById::release(id);
+    }
+
+    void batchEviction() {
+        int batchSize = SharedFFTSource::getBatchSize();
+
+        ModelId id = makeMock(BlockSize * batchSize * 20);
+        auto source = getSource(id);
+        int maxBatches = source->getMaxBatches();
+        int hs1 = BlockSize / 2 + 1;
+        std::vector<float> col(hs1 * 2);
+
+        // Touch one column in each of maxBatches batches, then
+        // return to the first: it should still be retained
+        for (int b = 0; b < maxBatches; ++b) {
+            QVERIFY(source->getColumn(b * batchSize, col.data()));
+        }
+        QVERIFY(source->getColumn(0, col.data()));
+        QCOMPARE(source->getColumnsCalculated(),
+                 int64_t(maxBatches * batchSize));
+
+        // One more batch evicts the least recently used, which is now
+        // the second one rather than the first
+        QVERIFY(source->getColumn(maxBatches * batchSize, col.data()));
+        QVERIFY(source->getColumn(0, col.data()));
+        QCOMPARE(source->getColumnsCalculated(),
+                 int64_t((maxBatches + 1) * batchSize));
+        QVERIFY(source->getColumn(batchSize, col.data()));
+        QCOMPARE(source->getColumnsCalculated(),
+                 int64_t((maxBatches + 2) * batchSize));
+
+        source.reset();
+        ModelById::release(id);
+    }
+
+    void concurrentReaders() {
+        int columns = SharedFFTSource::getBatchSize() * 8;
+        ModelId id = makeMock(BlockSize * columns);
+        auto source = getSource(id);
+
+        bool ok[4] = { false, false, false, false };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.push_back(std::thread([&, t]() {
+                auto mine = getSource(id);
+                ok[t] = compareAll(id, mine.get(), columns);
+            }));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        for (int t = 0; t < 4; ++t) {
+            QVERIFY(ok[t]);
+        }
+
+        // All 8 batches fit in the cache, and a reader never
+        // calculates a batch another is calculating, so each was
+        // calculated once
+        QCOMPARE(source->getColumnsCalculated(), int64_t(columns));
+        QCOMPARE(source->getColumnsRetrieved(), int64_t(columns * 4));
+
+        source.reset();
+        ModelById::release(id);
+    }
+};
+
+#endif
@@ -0,0 +1,303 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_TRANSFORMER_SCHEDULER_H
+#define TEST_TRANSFORMER_SCHEDULER_H
+
+#include "../TransformerScheduler.h"
+#include "../ModelTransformer.h"
+
+#include "data/model/test/MockWaveModel.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+using namespace sv;
+
+class TestTransformerScheduler : public QObject
+{
+    Q_OBJECT
+
+private:
+    /**
+     * A transformer that does nothing but wait for its input, so
+     * that we can see how long the wait takes.
+     */
+    class WaitingTransformer : public ModelTransformer
+    {
+    public:
+        WaitingTransformer(ModelId input) :
+            ModelTransformer(Input(input), Transform()),
+            m_finished(false),
+            m_result(false) { }
+        ~WaitingTransformer() {
+            abandon();
+            wait();
+        }
+
+        std::atomic<bool> m_finished;
+        std::atomic<bool> m_result;
+
+    protected:
+        void awaitOutputModels() override { }
+        void run() override {
+            m_result = waitForInput();
+            m_finished = true;
+        }
+    };
+
+    /**
+     * A wave model that is not ready until we say so.
+     */
+    class PendingWaveModel : public MockWaveModel
+    {
+    public:
+        PendingWaveModel() :
+            MockWaveModel({ DC }, 1024, 0),
+            m_completion(0) { }
+        int getCompletion() const override { return m_completion; }
+        void setCompletion(int completion) {
+            m_completion = completion;
+            emit completionChanged(getId());
+            if (completion == 100) emit ready(getId());
+        }
+    private:
+        std::atomic<int> m_completion;
+    };
+
+    // Acquire a slot for the transformer in a new thread, recording
+    // the order in which slots are acquired
+    std::thread acquireInThread(ModelTransformer *t,
+                                std::atomic<int> &result,
+                                std::atomic<int> &order) {
+        return std::thread([=, &result, &order]() {
+            bool acquired = TransformerScheduler::getInstance()->acquire(t);
+            result = (acquired ? ++order : -1);
+        });
+    }
+
+    TransformerScheduler *s() {
+        return TransformerScheduler::getInstance();
+    }
+
+private slots:
+
+    void init() {
+        s()->setWorkerCount(0);
+    }
+
+    void cleanup() {
+        s()->setWorkerCount(0);
+        QCOMPARE(s()->getRunningCount(), 0);
+        QCOMPARE(s()->getWaitingCount(), 0);
+    }
+
+    void defaultWorkerCount() {
+        QVERIFY(s()->getWorkerCount() >= 1);
+        s()->setWorkerCount(3);
+        QCOMPARE(s()->getWorkerCount(), 3);
+    }
+    
+    void slotLimit() {
+        s()->setWorkerCount(2);
+        WaitingTransformer a(ModelId()), b(ModelId()), c(ModelId());
+
+        QVERIFY(s()->acquire(&a));
+        QVERIFY(s()->acquire(&b));
+        QCOMPARE(s()->getRunningCount(), 2);
+
+        std::atomic<int> result(0), order(0);
+        std::thread t = acquireInThread(&c, result, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 1);
+        QCOMPARE(int(result), 0);
+
+        s()->release(&a);
+        t.join();
+        QCOMPARE(int(result), 1);
+        QCOMPARE(s()->getRunningCount(), 2);
+        QCOMPARE(s()->getWaitingCount(), 0);
+
+        s()->release(&b);
+        s()->release(&c);
+    }
+
+    void raisingWorkerCountWakes() {
+        s()->setWorkerCount(1);
+        WaitingTransformer a(ModelId()), b(ModelId());
+        QVERIFY(s()->acquire(&a));
+
+        std::atomic<int> result(0), order(0);
+        std::thread t = acquireInThread(&b, result, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 1);
+
+        s()->setWorkerCount(2);
+        t.join();
+        QCOMPARE(int(result), 1);
+
+        s()->release(&a);
+        s()->release(&b);
+    }
+    
+    void priorityOrdering() {
+        s()->setWorkerCount(1);
+        WaitingTransformer holder(ModelId()), low(ModelId()),
+            high(ModelId()), later(ModelId());
+        QVERIFY(s()->acquire(&holder));
+
+        s()->setPriority(&high, 5);
+        QCOMPARE(s()->getPriority(&high), 5);
+        QCOMPARE(s()->getPriority(&low), 0);
+
+        std::atomic<int> lowResult(0), highResult(0), laterResult(0);
+        std::atomic<int> order(0);
+        std::thread tl = acquireInThread(&low, lowResult, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 1);
+        std::thread th = acquireInThread(&high, highResult, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 2);
+        std::thread tr = acquireInThread(&later, laterResult, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 3);
+
+        // The higher priority goes first although it asked later;
+        // within a priority, the first to ask goes first
+        s()->release(&holder);
+        th.join();
+        QCOMPARE(int(highResult), 1);
+        s()->release(&high);
+        tl.join();
+        QCOMPARE(int(lowResult), 2);
+        s()->release(&low);
+        tr.join();
+        QCOMPARE(int(laterResult), 3);
+        s()->release(&later);
+    }
+
+    void raisingPriorityWhileWaiting() {
+        s()->setWorkerCount(1);
+        WaitingTransformer holder(ModelId()), first(ModelId()),
+            second(ModelId());
+        QVERIFY(s()->acquire(&holder));
+
+        std::atomic<int> firstResult(0), secondResult(0), order(0);
+        std::thread t1 = acquireInThread(&first, firstResult, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 1);
+        std::thread t2 = acquireInThread(&second, secondResult, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 2);
+
+        s()->setPriority(&second, 1);
+        s()->release(&holder);
+        t2.join();
+        QCOMPARE(int(secondResult), 1);
+        s()->release(&second);
+        t1.join();
+        QCOMPARE(int(firstResult), 2);
+        s()->release(&first);
+    }
+    
+    void abandonWhileWaiting() {
+        s()->setWorkerCount(1);
+        WaitingTransformer holder(ModelId()), waiting(ModelId());
+        QVERIFY(s()->acquire(&holder));
+
+        std::atomic<int> result(0), order(0);
+        std::thread t = acquireInThread(&waiting, result, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 1);
+
+        waiting.abandon();
+        t.join();
+        QCOMPARE(int(result), -1);
+        QCOMPARE(s()->getWaitingCount(), 0);
+        QCOMPARE(s()->getRunningCount(), 1);
+
+        s()->release(&holder);
+    }
+
+    void abandonReleasesSlot() {
+        s()->setWorkerCount(1);
+        WaitingTransformer holder(ModelId()), waiting(ModelId());
+        QVERIFY(s()->acquire(&holder));
+
+        std::atomic<int> result(0), order(0);
+        std::thread t = acquireInThread(&waiting, result, order);
+        QTRY_COMPARE(s()->getWaitingCount(), 1);
+
+        holder.abandon();
+        t.join();
+        QCOMPARE(int(result), 1);
+
+        s()->release(&waiting);
+    }
+
+    void slotReleasedOnDestruction() {
+        s()->setWorkerCount(1);
+        WaitingTransformer a(ModelId());
+        {
+            TransformerScheduler::Slot slot(&a);
+            QVERIFY(slot.isAcquired());
+            QCOMPARE(s()->getRunningCount(), 1);
+        }
+        QCOMPARE(s()->getRunningCount(), 0);
+
+        a.abandon();
+        TransformerScheduler::Slot slot(&a);
+        QVERIFY(!slot.isAcquired());
+    }
+
+    void inputWaitWokenByReady() {
+        auto model = std::make_shared<PendingWaveModel>();
+        ModelId id = ModelById::add(model);
+        
+        WaitingTransformer t(id);
+        t.start();
+
+        // Give it time to start waiting, then make the input ready:
+        // the wait should end well before the one-second backstop
+        QTest::qWait(100);
+        QVERIFY(!t.m_finished);
+
+        QElapsedTimer timer;
+        timer.start();
+        model->setCompletion(100);
+        QVERIFY(t.wait(5000));
+        QVERIFY(timer.elapsed() < 500);
+        QVERIFY(t.m_result);
+
+        ModelById::release(id);
+    }
+
+    void inputWaitWokenByAbandon() {
+        auto model = std::make_shared<PendingWaveModel>();
+        ModelId id = ModelById::add(model);
+        
+        WaitingTransformer t(id);
+        t.start();
+        QTest::qWait(100);
+        QVERIFY(!t.m_finished);
+
+        QElapsedTimer timer;
+        timer.start();
+        t.abandon();
+        QVERIFY(t.wait(5000));
+        QVERIFY(timer.elapsed() < 500);
+        QVERIFY(!t.m_result);
+
+        ModelById::release(id);
+    }
+};
+
+#endif
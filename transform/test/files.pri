@@ -0,0 +1,8 @@
+TEST_HEADERS += \
+	../../data/model/test/MockWaveModel.h \
+	TestSharedFFTSource.h \
+	TestTransformerScheduler.h
+	
+TEST_SOURCES += \
+	../../data/model/test/MockWaveModel.cpp \
+	svcore-transform-test.cpp